@@ -32,6 +32,7 @@ var (
 	VMIP            string
 	ContainLibsPath []string
 	FuseMount       []string
+	PrefetchRecord  string
 
 	IsBoot          bool
 	IsFakeroot      bool
@@ -140,6 +141,18 @@ var actionWorkdirFlag = cmdline.Flag{
 	ExcludedOS:   []string{cmdline.Darwin},
 }
 
+// --prefetch-record
+var actionPrefetchRecordFlag = cmdline.Flag{
+	ID:           "actionPrefetchRecordFlag",
+	Value:        &PrefetchRecord,
+	DefaultValue: "",
+	Name:         "prefetch-record",
+	Usage:        "record the image files opened by the container in a prefetch manifest written at exit, for build --prefetch-manifest",
+	EnvKeys:      []string{"PREFETCH_RECORD"},
+	Tag:          "<path>",
+	ExcludedOS:   []string{cmdline.Darwin},
+}
+
 // --disable-cache
 var actionDisableCacheFlag = cmdline.Flag{
 	ID:           "actionDisableCacheFlag",
@@ -667,6 +680,7 @@ func init() {
 		cmdManager.RegisterFlagForCmd(&commonPromptForPassphraseFlag, actionsInstanceCmd...)
 		cmdManager.RegisterFlagForCmd(&commonPEMFlag, actionsInstanceCmd...)
 		cmdManager.RegisterFlagForCmd(&actionPidNamespaceFlag, actionsInstanceCmd...)
+		cmdManager.RegisterFlagForCmd(&actionPrefetchRecordFlag, actionsInstanceCmd...)
 		cmdManager.RegisterFlagForCmd(&actionPwdFlag, actionsCmd...)
 		cmdManager.RegisterFlagForCmd(&actionScratchFlag, actionsInstanceCmd...)
 		cmdManager.RegisterFlagForCmd(&actionSecurityFlag, actionsInstanceCmd...)
@@ -22,7 +22,9 @@ import (
 	library "github.com/sylabs/scs-library-client/client"
 	"github.com/sylabs/singularity/docs"
 	"github.com/sylabs/singularity/internal/pkg/build"
+	"github.com/sylabs/singularity/internal/pkg/buildcfg"
 	"github.com/sylabs/singularity/internal/pkg/client/cache"
+	"github.com/sylabs/singularity/internal/pkg/client/download"
 	ociclient "github.com/sylabs/singularity/internal/pkg/client/oci"
 	libraryhelper "github.com/sylabs/singularity/internal/pkg/library"
 	"github.com/sylabs/singularity/internal/pkg/oras"
@@ -32,6 +34,7 @@ import (
 	"github.com/sylabs/singularity/pkg/build/types"
 	net "github.com/sylabs/singularity/pkg/client/net"
 	shub "github.com/sylabs/singularity/pkg/client/shub"
+	"github.com/sylabs/singularity/pkg/runtime/engine/config"
 )
 
 const (
@@ -39,10 +42,20 @@ const (
 )
 
 func getCacheHandle(cfg cache.Config) *cache.Handle {
-	h, err := cache.NewHandle(cache.Config{
+	cacheConfig := cache.Config{
 		BaseDir: os.Getenv(cache.DirEnv),
 		Disable: cfg.Disable,
-	})
+	}
+	// the cache size is unlimited if the configuration can't be read
+	if c, err := config.ParseFile(buildcfg.SINGULARITY_CONF_FILE); err == nil {
+		cacheConfig.MaxSize = int64(c.CacheMaxSize) << 20
+		cacheConfig.Eviction = c.CacheEviction
+		cacheConfig.SystemDir = c.SystemCacheDir
+	} else {
+		sylog.Debugf("Could not read cache configuration: %s", err)
+	}
+
+	h, err := cache.NewHandle(cacheConfig)
 	if err != nil {
 		sylog.Fatalf("Failed to create an image cache handle: %s", err)
 	}
@@ -122,16 +135,20 @@ func handleOCI(ctx context.Context, imgCache *cache.Handle, cmd *cobra.Command,
 		}
 		imgabs = imgCache.OciTempImage(sum, name)
 
-		exists, err := imgCache.OciTempExists(sum, name)
+		f, err := imgCache.FillEntry(imgabs, func() (bool, error) {
+			return imgCache.OciTempExists(sum, name)
+		})
 		if err != nil {
-			return "", fmt.Errorf("unable to check if %s exists: %s", name, err)
+			return "", err
 		}
-		if !exists {
+		if f != nil {
+			defer f.Close()
+
 			sylog.Infof("Converting OCI blobs to SIF format")
 			b, err := build.NewBuild(
 				u,
 				build.Config{
-					Dest:   imgabs,
+					Dest:   f.Temp,
 					Format: "sif",
 					Opts: types.Options{
 						TmpDir:           tmpDir,
@@ -148,6 +165,9 @@ func handleOCI(ctx context.Context, imgCache *cache.Handle, cmd *cobra.Command,
 			if err := b.Full(ctx); err != nil {
 				return "", fmt.Errorf("unable to build: %v", err)
 			}
+			if err := f.Commit(); err != nil {
+				return "", err
+			}
 
 			sylog.Verbosef("Image cached as SIF at %s", imgabs)
 		}
@@ -170,20 +190,29 @@ func handleOras(ctx context.Context, imgCache *cache.Handle, cmd *cobra.Command,
 
 	imageName := uri.GetName(u)
 	cacheImagePath := imgCache.OrasImage(sum, imageName)
-	if exists, err := imgCache.OrasImageExists(sum, imageName); err != nil {
-		return "", fmt.Errorf("unable to check if %v exists: %v", cacheImagePath, err)
-	} else if !exists {
+	f, err := imgCache.FillEntry(cacheImagePath, func() (bool, error) {
+		return imgCache.OrasImageExists(sum, imageName)
+	})
+	if err != nil {
+		return "", err
+	}
+	if f != nil {
+		defer f.Close()
+
 		sylog.Infof("Downloading image with ORAS")
 
-		if err := oras.DownloadImage(cacheImagePath, ref, ociAuth); err != nil {
+		if err := oras.DownloadImage(f.Temp, ref, ociAuth); err != nil {
 			return "", fmt.Errorf("unable to Download Image: %v", err)
 		}
 
-		if cacheFileHash, err := oras.ImageHash(cacheImagePath); err != nil {
+		if cacheFileHash, err := oras.ImageHash(f.Temp); err != nil {
 			return "", fmt.Errorf("error getting ImageHash: %v", err)
 		} else if cacheFileHash != sum {
 			return "", fmt.Errorf("cached file hash(%s) and expected hash(%s) does not match", cacheFileHash, sum)
 		}
+		if err := f.Commit(); err != nil {
+			return "", err
+		}
 	}
 
 	return cacheImagePath, nil
@@ -217,7 +246,7 @@ func handleLibrary(ctx context.Context, imgCache *cache.Handle, u, libraryURL st
 		imagePath = file.Name()
 		sylog.Infof("Downloading library image to tmp cache: %s", imagePath)
 
-		if err = libraryhelper.DownloadImageNoProgress(ctx, c, imagePath, runtime.GOARCH, imageRef); err != nil {
+		if err = libraryhelper.DownloadImageNoProgress(ctx, c, imagePath, runtime.GOARCH, imageRef, libraryImage.Hash); err != nil {
 			return "", fmt.Errorf("unable to download image: %v", err)
 		}
 
@@ -225,19 +254,41 @@ func handleLibrary(ctx context.Context, imgCache *cache.Handle, u, libraryURL st
 		imageName := uri.GetName("library://" + imageRef)
 		imagePath = imgCache.LibraryImage(libraryImage.Hash, imageName)
 
-		if exists, err := imgCache.LibraryImageExists(libraryImage.Hash, imageName); err != nil {
-			return "", fmt.Errorf("unable to check if %v exists: %v", imagePath, err)
-		} else if !exists {
+		f, err := imgCache.FillEntry(imagePath, func() (bool, error) {
+			return imgCache.LibraryImageExists(libraryImage.Hash, imageName)
+		})
+		if err != nil {
+			return "", err
+		}
+		if f != nil {
+			defer f.Close()
+
+			checkHash := func(path string) error {
+				if cacheFileHash, err := library.ImageHash(path); err != nil {
+					return fmt.Errorf("error getting image hash: %v", err)
+				} else if cacheFileHash != libraryImage.Hash {
+					return fmt.Errorf("cached file hash(%s) and expected hash(%s) does not match", cacheFileHash, libraryImage.Hash)
+				}
+				return nil
+			}
+
+			if imageURL, opts, err := libraryhelper.ImageFileRequest(c, runtime.GOARCH, imageRef); err == nil {
+				if path := lazyImage(ctx, imagePath, imageURL, opts, checkHash); path != "" {
+					return path, nil
+				}
+			}
+
 			sylog.Infof("Downloading library image")
 
-			if err := libraryhelper.DownloadImageNoProgress(ctx, c, imagePath, runtime.GOARCH, imageRef); err != nil {
+			if err := libraryhelper.DownloadImageNoProgress(ctx, c, f.Temp, runtime.GOARCH, imageRef, libraryImage.Hash); err != nil {
 				return "", fmt.Errorf("unable to download image: %v", err)
 			}
 
-			if cacheFileHash, err := library.ImageHash(imagePath); err != nil {
-				return "", fmt.Errorf("error getting image hash: %v", err)
-			} else if cacheFileHash != libraryImage.Hash {
-				return "", fmt.Errorf("cached file hash(%s) and expected hash(%s) does not match", cacheFileHash, libraryImage.Hash)
+			if err := checkHash(f.Temp); err != nil {
+				return "", err
+			}
+			if err := f.Commit(); err != nil {
+				return "", err
 			}
 		}
 	}
@@ -275,16 +326,23 @@ func handleShub(imgCache *cache.Handle, u string) (string, error) {
 		imageName := uri.GetName(u)
 		imagePath = imgCache.ShubImage(manifest.Commit, imageName)
 
-		exists, err := imgCache.ShubImageExists(manifest.Commit, imageName)
+		f, err := imgCache.FillEntry(imagePath, func() (bool, error) {
+			return imgCache.ShubImageExists(manifest.Commit, imageName)
+		})
 		if err != nil {
-			return "", fmt.Errorf("unable to check if %v exists: %v", imagePath, err)
+			return "", err
 		}
-		if !exists {
+		if f != nil {
+			defer f.Close()
+
 			sylog.Infof("Downloading shub image")
-			err := shub.DownloadImage(manifest, imagePath, u, true, noHTTPS)
+			err := shub.DownloadImage(manifest, f.Temp, u, true, noHTTPS)
 			if err != nil {
 				sylog.Fatalf("%v\n", err)
 			}
+			if err := f.Commit(); err != nil {
+				return "", err
+			}
 		} else {
 			sylog.Verbosef("Use image from cache")
 		}
@@ -293,7 +351,7 @@ func handleShub(imgCache *cache.Handle, u string) (string, error) {
 	return imagePath, nil
 }
 
-func handleNet(imgCache *cache.Handle, u string) (string, error) {
+func handleNet(ctx context.Context, imgCache *cache.Handle, u string) (string, error) {
 	// We will cache using a sha256 over the URL and the date of the file that
 	// is to be fetched, as returned by an HTTP HEAD call and the Last-Modified
 	// header. If no date is available, use the current date-time, which will
@@ -322,16 +380,27 @@ func handleNet(imgCache *cache.Handle, u string) (string, error) {
 
 	imagePath := imgCache.NetImage("hash", imageHash)
 
-	exists, err := imgCache.NetImageExists("hash", imageHash)
+	f, err := imgCache.FillEntry(imagePath, func() (bool, error) {
+		return imgCache.NetImageExists("hash", imageHash)
+	})
 	if err != nil {
-		return "", fmt.Errorf("unable to check if %v exists: %v", imagePath, err)
+		return "", err
 	}
-	if !exists {
+	if f != nil {
+		defer f.Close()
+
+		if path := lazyImage(ctx, imagePath, u, download.Options{}, nil); path != "" {
+			return path, nil
+		}
+
 		sylog.Infof("Downloading network image")
-		err := net.DownloadImage(imagePath, u)
+		err := net.DownloadImage(f.Temp, u)
 		if err != nil {
 			sylog.Fatalf("%v\n", err)
 		}
+		if err := f.Commit(); err != nil {
+			return "", err
+		}
 	} else {
 		sylog.Verbosef("Using image from cache")
 	}
@@ -361,9 +430,9 @@ func replaceURIWithImage(ctx context.Context, imgCache *cache.Handle, cmd *cobra
 	case ociclient.IsSupported(t):
 		image, err = handleOCI(ctx, imgCache, cmd, args[0])
 	case uri.HTTP:
-		image, err = handleNet(imgCache, args[0])
+		image, err = handleNet(ctx, imgCache, args[0])
 	case uri.HTTPS:
-		image, err = handleNet(imgCache, args[0])
+		image, err = handleNet(ctx, imgCache, args[0])
 	default:
 		sylog.Fatalf("Unsupported transport type: %s", t)
 	}
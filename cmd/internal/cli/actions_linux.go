@@ -6,6 +6,7 @@
 package cli
 
 import (
+	"context"
 	"fmt"
 	"io"
 	"io/ioutil"
@@ -19,6 +20,8 @@ import (
 	"github.com/opencontainers/runtime-tools/generate"
 	"github.com/spf13/cobra"
 	"github.com/sylabs/singularity/internal/pkg/buildcfg"
+	"github.com/sylabs/singularity/internal/pkg/client/cache"
+	"github.com/sylabs/singularity/internal/pkg/client/download"
 	"github.com/sylabs/singularity/internal/pkg/instance"
 	"github.com/sylabs/singularity/internal/pkg/plugin"
 	"github.com/sylabs/singularity/internal/pkg/runtime/engine/config/oci"
@@ -26,8 +29,10 @@ import (
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/internal/pkg/util/env"
 	"github.com/sylabs/singularity/internal/pkg/util/fs"
+	"github.com/sylabs/singularity/internal/pkg/util/fs/squashfs"
 	"github.com/sylabs/singularity/internal/pkg/util/starter"
 	"github.com/sylabs/singularity/internal/pkg/util/user"
+	"github.com/sylabs/singularity/internal/pkg/zygote"
 	imgutil "github.com/sylabs/singularity/pkg/image"
 	"github.com/sylabs/singularity/pkg/image/unpacker"
 	"github.com/sylabs/singularity/pkg/runtime/engine/config"
@@ -37,6 +42,7 @@ import (
 	"github.com/sylabs/singularity/pkg/util/gpu"
 	"github.com/sylabs/singularity/pkg/util/namespaces"
 	"github.com/sylabs/singularity/pkg/util/rlimit"
+	"golang.org/x/sys/unix"
 )
 
 // EnsureRootPriv ensures that a command is executed with root privileges.
@@ -93,9 +99,124 @@ func convertImage(filename string, unsquashfsPath string) (string, error) {
 		return "", fmt.Errorf("root filesystem extraction failed: %s", err)
 	}
 
+	// apply squashfs overlay partitions created by incremental builds
+	for i := 1; i < len(img.Partitions); i++ {
+		if !img.Partitions[i].Overlay || img.Partitions[i].Type != imgutil.SQUASHFS {
+			continue
+		}
+		reader, err := imgutil.NewPartitionReader(img, "", i)
+		if err == nil {
+			err = s.ExtractAll(reader, dir)
+		}
+		if err != nil {
+			os.RemoveAll(dir)
+			return "", fmt.Errorf("overlay partition extraction failed: %s", err)
+		}
+	}
+
 	return dir, err
 }
 
+// fuseImage returns if image root filesystem can be mounted with
+// squashfuse instead of being converted to a sandbox when running
+// with user namespace.
+func fuseImage(filename string, cfg *config.FileConfig) bool {
+	if cfg.ImageBackend != "fuse" {
+		return false
+	}
+	if _, err := squashfs.GetFusePath(cfg); err != nil {
+		sylog.Verbosef("squashfuse not found: %s", err)
+		return false
+	}
+	if err := unix.Access("/dev/fuse", unix.R_OK|unix.W_OK); err != nil {
+		sylog.Verbosef("/dev/fuse not accessible: %s", err)
+		return false
+	}
+
+	img, err := imgutil.Init(filename, false)
+	if err != nil {
+		return false
+	}
+	defer img.File.Close()
+
+	// images with overlay partitions from incremental builds
+	// are converted as overlay is not available with user
+	// namespace
+	return img.Type == imgutil.SIF && img.HasRootFs() && len(img.Partitions) == 1 && img.Partitions[0].Type == imgutil.SQUASHFS
+}
+
+// lazyImage returns the path of the image at rawurl fetched lazily for
+// the cache entry imagePath when lazy image fetch is enabled, or an empty
+// path when the image must be downloaded. Only the SIF header and metadata
+// are fetched, the root filesystem is fetched on demand once mounted. A
+// lazy image fetched entirely is moved to the cache entry after being
+// checked with verify if not nil. The entry lock must be held.
+func lazyImage(ctx context.Context, imagePath, rawurl string, opts download.Options, verify func(string) error) string {
+	cfg, err := config.ParseFile(buildcfg.SINGULARITY_CONF_FILE)
+	if err != nil || !cfg.LazyImageFetch || UserNamespace {
+		return ""
+	}
+	opts.ChunkSize = int64(cfg.LazyImageChunkSize) << 20
+
+	path := imagePath + cache.LazySuffix
+
+	l, err := download.CreateLazy(ctx, rawurl, path, opts)
+	if err == download.ErrRangeNotSupported {
+		sylog.Verbosef("Range requests not supported, downloading %s", rawurl)
+		return ""
+	} else if err != nil {
+		sylog.Warningf("Could not fetch image lazily, downloading it: %s", err)
+		return ""
+	}
+	defer l.Close()
+
+	if l.Complete() {
+		// fetched in background by previous runs
+		if verify != nil {
+			if err := verify(path); err != nil {
+				download.RemoveLazy(path)
+				sylog.Warningf("Lazily fetched image is corrupted, downloading it: %s", err)
+				return ""
+			}
+		}
+		if err := l.Commit(imagePath); err != nil {
+			sylog.Warningf("Could not add lazily fetched image to the cache: %s", err)
+			return path
+		}
+		return imagePath
+	}
+
+	if err := imgutil.FetchSIFMetadata(ctx, l, path); err != nil {
+		download.RemoveLazy(path)
+		sylog.Verbosef("Could not fetch image lazily, downloading it: %s", err)
+		return ""
+	}
+
+	sylog.Infof("Fetching image lazily")
+
+	return path
+}
+
+// fetchLazyImage fetches the chunks of the lazily fetched image filename
+// not fetched yet, lazy images are only served by privileged processes.
+func fetchLazyImage(filename string) {
+	l, err := download.OpenLazy(filename, download.Options{})
+	if err != nil {
+		sylog.Fatalf("While opening lazily fetched image: %s", err)
+	}
+	defer l.Close()
+
+	if l.Complete() {
+		return
+	}
+
+	sylog.Infof("Fetching image")
+
+	if err := l.Prefetch(context.TODO()); err != nil {
+		sylog.Fatalf("While fetching image: %s", err)
+	}
+}
+
 // checkHidepid checks if hidepid is set on /proc mount point, when this
 // option is an instance started with setuid workflow could not even be
 // joined later or stopped correctly.
@@ -117,6 +238,16 @@ func hidepidProc() bool {
 	return false
 }
 
+// identityCacheDir returns the directory where the container process stores
+// the user and group entries looked up on the host, or an empty string if the
+// cache is disabled.
+func identityCacheDir() string {
+	if disableCache {
+		return ""
+	}
+	return cache.DataDir("identity")
+}
+
 // TODO: Let's stick this in another file so that that CLI is just CLI
 func execStarter(cobraCmd *cobra.Command, image string, args []string, name string) {
 	var err error
@@ -125,6 +256,7 @@ func execStarter(cobraCmd *cobra.Command, image string, args []string, name stri
 	targetGID := make([]int, 0)
 
 	procname := ""
+	zygoteSocket := ""
 
 	uid := uint32(os.Getuid())
 	gid := uint32(os.Getgid())
@@ -205,6 +337,7 @@ func execStarter(cobraCmd *cobra.Command, image string, args []string, name stri
 		generator.AddProcessEnv("SINGULARITY_NAME", filepath.Base(file.Image))
 		engineConfig.SetImage(image)
 		engineConfig.SetInstanceJoin(true)
+		zygoteSocket = file.Zygote
 	} else {
 		abspath, err := filepath.Abs(image)
 		generator.AddProcessEnv("SINGULARITY_CONTAINER", abspath)
@@ -425,6 +558,16 @@ func execStarter(cobraCmd *cobra.Command, image string, args []string, name stri
 	engineConfig.SetScratchDir(ScratchPath)
 	engineConfig.SetWorkdir(WorkdirPath)
 
+	if PrefetchRecord != "" {
+		path, err := filepath.Abs(PrefetchRecord)
+		if err != nil {
+			sylog.Fatalf("Failed to determine prefetch manifest path: %s", err)
+		}
+		engineConfig.SetPrefetchRecord(path)
+	}
+
+	engineConfig.SetIdentityCacheDir(identityCacheDir())
+
 	homeSlice := strings.Split(HomePath, ":")
 
 	if len(homeSlice) > 2 || len(homeSlice) == 0 {
@@ -448,6 +591,7 @@ func execStarter(cobraCmd *cobra.Command, image string, args []string, name stri
 		IpcNamespace = true
 		engineConfig.SetInstance(true)
 		engineConfig.SetBootInstance(IsBoot)
+		engineConfig.SetZygote(instanceStartZygote)
 
 		if useSuid && !UserNamespace && hidepidProc() {
 			sylog.Fatalf("hidepid option set on /proc mount, require 'hidepid=0' to start instance with setuid workflow")
@@ -459,6 +603,11 @@ func execStarter(cobraCmd *cobra.Command, image string, args []string, name stri
 		}
 
 		if IsBoot {
+			// the zygote forks the instance process, init
+			// wouldn't run as PID 1
+			if instanceStartZygote {
+				sylog.Fatalf("--zygote can't be used with --boot")
+			}
 			UtsNamespace = true
 			NetNamespace = true
 			if Hostname == "" {
@@ -553,10 +702,17 @@ func execStarter(cobraCmd *cobra.Command, image string, args []string, name stri
 
 	generator.AddProcessEnv("SINGULARITY_APPNAME", AppName)
 
+	// lazily fetched images are served as block devices by the
+	// privileged master process, they are fetched entirely before
+	// running with user namespace
+	if (UserNamespace || insideUserNs) && download.IsLazy(image) {
+		fetchLazyImage(image)
+	}
+
 	// convert image file to sandbox if we are using user
 	// namespace or if we are currently running inside a
 	// user namespace
-	if (UserNamespace || insideUserNs) && fs.IsFile(image) {
+	if (UserNamespace || insideUserNs) && fs.IsFile(image) && !fuseImage(image, engineConfig.File) {
 		unsquashfsPath := ""
 		if engineConfig.File.MksquashfsPath != "" {
 			d := filepath.Dir(engineConfig.File.MksquashfsPath)
@@ -647,6 +803,8 @@ func execStarter(cobraCmd *cobra.Command, image string, args []string, name stri
 			sylog.Verbosef("you will find instance error here: %s", stderr.Name())
 			sylog.Infof("instance started successfully")
 		}
+	} else if zygoteSocket != "" {
+		execZygote(zygoteSocket, &generator)
 	} else {
 		err := starter.Exec(
 			procname,
@@ -657,3 +815,26 @@ func execStarter(cobraCmd *cobra.Command, image string, args []string, name stri
 		sylog.Fatalf("%s", err)
 	}
 }
+
+// execZygote sends the container process launch request to the zygote
+// of the joined instance and exits with the container process status.
+func execZygote(socket string, generator *generate.Generator) {
+	sylog.Debugf("Sending launch request to instance zygote %s", socket)
+
+	r := &zygote.Request{
+		Args: generator.Config.Process.Args,
+		Env:  generator.Config.Process.Env,
+		Cwd:  generator.Config.Process.Cwd,
+	}
+	status, err := zygote.Exec(socket, r)
+	if err != nil {
+		sylog.Fatalf("%s", err)
+	}
+
+	if status.Signaled() {
+		s := status.Signal()
+		sylog.Debugf("Container process exited due to signal %d", s)
+		os.Exit(128 + int(s))
+	}
+	os.Exit(status.ExitStatus())
+}
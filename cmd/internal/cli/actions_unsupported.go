@@ -8,10 +8,19 @@
 package cli
 
 import (
+	"context"
+
 	"github.com/spf13/cobra"
+	"github.com/sylabs/singularity/internal/pkg/client/download"
 )
 
 // TODO: Let's stick this in another file so that that CLI is just CLI
 func execStarter(cobraCmd *cobra.Command, image string, args []string, name string) {
 	panic("starter is unsupported on this platform")
 }
+
+// lazyImage returns an empty path, images are always downloaded on
+// this platform.
+func lazyImage(ctx context.Context, imagePath, rawurl string, opts download.Options, verify func(string) error) string {
+	return ""
+}
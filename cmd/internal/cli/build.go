@@ -22,20 +22,24 @@ import (
 )
 
 var buildArgs struct {
-	sections   []string
-	arch       string
-	builderURL string
-	libraryURL string
-	detached   bool
-	encrypt    bool
-	fakeroot   bool
-	fixPerms   bool
-	isJSON     bool
-	noCleanUp  bool
-	noTest     bool
-	remote     bool
-	sandbox    bool
-	update     bool
+	sections    []string
+	arch        string
+	builderURL  string
+	libraryURL  string
+	prefetch    string
+	order       string
+	detached    bool
+	encrypt     bool
+	fakeroot    bool
+	fixPerms    bool
+	incremental bool
+	isJSON      bool
+	layered     bool
+	noCleanUp   bool
+	noTest      bool
+	remote      bool
+	sandbox     bool
+	update      bool
 }
 
 // -s|--sandbox
@@ -80,6 +84,48 @@ var buildUpdateFlag = cmdline.Flag{
 	EnvKeys:      []string{"UPDATE"},
 }
 
+// --incremental
+var buildIncrementalFlag = cmdline.Flag{
+	ID:           "buildIncrementalFlag",
+	Value:        &buildArgs.incremental,
+	DefaultValue: false,
+	Name:         "incremental",
+	Usage:        "only pack files changed since the base SIF image in an overlay partition (requires overlay support to run)",
+	EnvKeys:      []string{"INCREMENTAL"},
+}
+
+// --layered
+var buildLayeredFlag = cmdline.Flag{
+	ID:           "buildLayeredFlag",
+	Value:        &buildArgs.layered,
+	DefaultValue: false,
+	Name:         "layered",
+	Usage:        "pack OCI image layers in overlay partitions cached across builds (requires overlay support to run)",
+	EnvKeys:      []string{"LAYERED"},
+}
+
+// --prefetch-manifest
+var buildPrefetchManifestFlag = cmdline.Flag{
+	ID:           "buildPrefetchManifestFlag",
+	Value:        &buildArgs.prefetch,
+	DefaultValue: "",
+	Name:         "prefetch-manifest",
+	Usage:        "store a prefetch manifest recorded with --prefetch-record in the SIF image, its files are read in background at the container start",
+	EnvKeys:      []string{"PREFETCH_MANIFEST"},
+	Tag:          "<path>",
+}
+
+// --startup-order
+var buildStartupOrderFlag = cmdline.Flag{
+	ID:           "buildStartupOrderFlag",
+	Value:        &buildArgs.order,
+	DefaultValue: "",
+	Name:         "startup-order",
+	Usage:        "place first in the SIF image the files read at startup, listed by a prefetch manifest or guessed with \"auto\"",
+	EnvKeys:      []string{"STARTUP_ORDER"},
+	Tag:          "<path|auto>",
+}
+
 // -T|--notest
 var buildNoTestFlag = cmdline.Flag{
 	ID:           "buildNoTestFlag",
@@ -206,13 +252,17 @@ func init() {
 		cmdManager.RegisterFlagForCmd(&buildEncryptFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildFakerootFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildFixPermsFlag, buildCmd)
+		cmdManager.RegisterFlagForCmd(&buildIncrementalFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildJSONFlag, buildCmd)
+		cmdManager.RegisterFlagForCmd(&buildLayeredFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildLibraryFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildNoCleanupFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildNoTestFlag, buildCmd)
+		cmdManager.RegisterFlagForCmd(&buildPrefetchManifestFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildRemoteFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildSandboxFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildSectionFlag, buildCmd)
+		cmdManager.RegisterFlagForCmd(&buildStartupOrderFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&buildUpdateFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&commonForceFlag, buildCmd)
 		cmdManager.RegisterFlagForCmd(&commonNoHTTPSFlag, buildCmd)
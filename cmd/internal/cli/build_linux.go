@@ -11,6 +11,7 @@ import (
 	"io/ioutil"
 	"os"
 	osExec "os/exec"
+	"path/filepath"
 	"runtime"
 	"syscall"
 
@@ -219,6 +220,27 @@ func runBuildLocal(ctx context.Context, cmd *cobra.Command, dst, spec string) {
 		sylog.Fatalf("Could not check build sections: %v", err)
 	}
 
+	prefetchManifest := ""
+	if buildArgs.prefetch != "" {
+		if buildArgs.sandbox {
+			sylog.Warningf("Prefetch manifests are only stored in SIF images, ignoring --prefetch-manifest")
+		} else if prefetchManifest, err = filepath.Abs(buildArgs.prefetch); err != nil {
+			sylog.Fatalf("Failed to determine prefetch manifest path: %v", err)
+		}
+	}
+
+	startupOrder := buildArgs.order
+	if startupOrder != "" {
+		if buildArgs.sandbox {
+			sylog.Warningf("Sandbox data can't be ordered, ignoring --startup-order")
+			startupOrder = ""
+		} else if startupOrder != "auto" {
+			if startupOrder, err = filepath.Abs(startupOrder); err != nil {
+				sylog.Fatalf("Failed to determine startup order manifest path: %v", err)
+			}
+		}
+	}
+
 	authConf, err := makeDockerCredentials(cmd)
 	if err != nil {
 		sylog.Fatalf("While creating Docker credentials: %v", err)
@@ -257,6 +279,10 @@ func runBuildLocal(ctx context.Context, cmd *cobra.Command, dst, spec string) {
 				TmpDir:            tmpDir,
 				NoCache:           disableCache,
 				Update:            buildArgs.update,
+				Incremental:       buildArgs.incremental,
+				Layered:           buildArgs.layered,
+				PrefetchManifest:  prefetchManifest,
+				StartupOrder:      startupOrder,
 				Force:             forceOverwrite,
 				Sections:          buildArgs.sections,
 				NoTest:            buildArgs.noTest,
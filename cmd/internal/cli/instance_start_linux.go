@@ -16,6 +16,7 @@ import (
 func init() {
 	addCmdInit(func(cmdManager *cmdline.CommandManager) {
 		cmdManager.RegisterFlagForCmd(&instanceStartPidFileFlag, instanceStartCmd)
+		cmdManager.RegisterFlagForCmd(&instanceStartZygoteFlag, instanceStartCmd)
 	})
 }
 
@@ -30,6 +31,17 @@ var instanceStartPidFileFlag = cmdline.Flag{
 	EnvKeys:      []string{"PID_FILE"},
 }
 
+// --zygote
+var instanceStartZygote bool
+var instanceStartZygoteFlag = cmdline.Flag{
+	ID:           "instanceStartZygoteFlag",
+	Value:        &instanceStartZygote,
+	DefaultValue: false,
+	Name:         "zygote",
+	Usage:        "serve exec requests from the running instance container to speed up their startup, requests use instance security settings",
+	EnvKeys:      []string{"ZYGOTE"},
+}
+
 // singularity instance start
 var instanceStartCmd = &cobra.Command{
 	Args:                  cobra.MinimumNArgs(2),
@@ -0,0 +1,231 @@
+/*
+  Copyright (c) 2019, Sylabs, Inc. All rights reserved.
+
+  This software is licensed under a 3-clause BSD license.  Please
+  consult LICENSE.md file distributed with the sources of this project regarding
+  your rights to use or distribute this software.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "include/message.h"
+#include "include/starter.h"
+#include "include/fdset.h"
+
+#ifndef __NR_close_range
+#define __NR_close_range    436
+#endif
+
+/* fdset_add adds fd to the set, the bitmap grows as needed */
+void fdset_add(fdset_t *set, int fd) {
+    unsigned int word = fd / FDSET_BITS;
+
+    if ( fd < 0 ) {
+        return;
+    }
+
+    if ( word >= set->words ) {
+        unsigned int words = set->words ? set->words : 1;
+        unsigned long *bits;
+
+        while ( words <= word ) {
+            words *= 2;
+        }
+        bits = (unsigned long *)realloc(set->bits, words * sizeof(unsigned long));
+        if ( bits == NULL ) {
+            fatalf("Memory allocation failed: %s\n", strerror(errno));
+        }
+        memset(bits + set->words, 0, (words - set->words) * sizeof(unsigned long));
+        set->bits = bits;
+        set->words = words;
+    }
+
+    set->bits[word] |= 1UL << (fd % FDSET_BITS);
+}
+
+/* fdset_has returns whether fd is in the set or not */
+int fdset_has(fdset_t *set, int fd) {
+    unsigned int word = fd / FDSET_BITS;
+
+    if ( fd < 0 || word >= set->words ) {
+        return 0;
+    }
+    return (set->bits[word] & (1UL << (fd % FDSET_BITS))) != 0;
+}
+
+/* proc_fd_foreach calls fn for each opened file descriptor listed in /proc/self/fd */
+static void proc_fd_foreach(void (*fn)(fdset_t *, int), fdset_t *set) {
+    int fd_proc;
+    DIR *dir;
+    struct dirent *dirent;
+
+    if ( ( fd_proc = open("/proc/self/fd", O_RDONLY) ) < 0 ) {
+        fatalf("Failed to open /proc/self/fd: %s\n", strerror(errno));
+    }
+
+    if ( ( dir = fdopendir(fd_proc) ) == NULL ) {
+        fatalf("Failed to list /proc/self/fd directory: %s\n", strerror(errno));
+    }
+
+    while ( ( dirent = readdir(dir) ) ) {
+        int fd;
+
+        if ( dirent->d_name[0] == '.' ) {
+            continue;
+        }
+        fd = atoi(dirent->d_name);
+        if ( fd == fd_proc ) {
+            continue;
+        }
+        fn(set, fd);
+    }
+
+    closedir(dir);
+}
+
+/* fd_table_size returns the size of the process file descriptor table */
+static int fd_table_size(void) {
+    char buffer[4096];
+    char *line;
+    ssize_t size;
+    int fd, fdsize = -1;
+
+    if ( ( fd = open("/proc/self/status", O_RDONLY) ) < 0 ) {
+        return -1;
+    }
+    size = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if ( size <= 0 ) {
+        return -1;
+    }
+    buffer[size] = '\0';
+
+    line = strstr(buffer, "\nFDSize:");
+    if ( line == NULL || sscanf(line, "\nFDSize: %d", &fdsize) != 1 ) {
+        return -1;
+    }
+    return fdsize;
+}
+
+/*
+ * poll_fds adds opened file descriptors to set, poll reports closed file
+ * descriptors with POLLNVAL which allows to probe FDSET_POLL_FDS file
+ * descriptors with a single system call, this is far cheaper than reading
+ * /proc/self/fd when hundreds of file descriptors are inherited. O_PATH
+ * file descriptors are reported with POLLNVAL too, so closure is confirmed
+ * with fcntl for those.
+ */
+static int poll_fds(fdset_t *set) {
+    struct pollfd pfds[FDSET_POLL_FDS];
+    struct rlimit rlim;
+    int fdsize = fd_table_size();
+    int fd, i, num, max = FDSET_POLL_FDS;
+
+    if ( fdsize < 0 || getrlimit(RLIMIT_NOFILE, &rlim) < 0 ) {
+        return -1;
+    }
+    /* poll returns EINVAL if the number of file descriptors exceeds this limit */
+    if ( rlim.rlim_cur == 0 ) {
+        return -1;
+    } else if ( rlim.rlim_cur < (rlim_t)max ) {
+        max = rlim.rlim_cur;
+    }
+
+    for ( fd = 0; fd < fdsize; fd += num ) {
+        num = fdsize - fd < max ? fdsize - fd : max;
+
+        for ( i = 0; i < num; i++ ) {
+            pfds[i].fd = fd + i;
+            pfds[i].events = 0;
+            pfds[i].revents = 0;
+        }
+        if ( poll(pfds, num, 0) < 0 ) {
+            return -1;
+        }
+        for ( i = 0; i < num; i++ ) {
+            if ( !(pfds[i].revents & POLLNVAL) || fcntl(fd + i, F_GETFD) >= 0 ) {
+                fdset_add(set, fd + i);
+            }
+        }
+    }
+    return 0;
+}
+
+/* fdset_open returns the set of currently opened file descriptors */
+fdset_t *fdset_open(void) {
+    fdset_t *set = (fdset_t *)calloc(1, sizeof(fdset_t));
+
+    if ( set == NULL ) {
+        fatalf("Memory allocation failed: %s\n", strerror(errno));
+    }
+
+    if ( poll_fds(set) < 0 ) {
+        debugf("Failed to poll file descriptors, fallback to /proc/self/fd scan\n");
+        if ( set->words ) {
+            memset(set->bits, 0, set->words * sizeof(unsigned long));
+        }
+        proc_fd_foreach(fdset_add, set);
+    }
+
+    return set;
+}
+
+void fdset_free(fdset_t *set) {
+    free(set->bits);
+    free(set);
+}
+
+static int close_fd_range(unsigned int first, unsigned int last) {
+    debugf("Close file descriptors from %u to %u\n", first, last);
+    return syscall(__NR_close_range, first, last, 0);
+}
+
+static void close_unkept(fdset_t *keep, int fd) {
+    if ( !fdset_has(keep, fd) ) {
+        debugf("Close file descriptor %d\n", fd);
+        close(fd);
+    }
+}
+
+/*
+ * fdset_close_others closes all file descriptors which are not in
+ * the keep set, the gaps between kept file descriptors are closed
+ * with one close_range call each.
+ */
+void fdset_close_others(fdset_t *keep) {
+    unsigned int first = 0;
+    unsigned int i;
+
+    for ( i = 0; i < keep->words; i++ ) {
+        unsigned long word = keep->bits[i];
+
+        while ( word ) {
+            unsigned int fd = i * FDSET_BITS + __builtin_ctzl(word);
+
+            if ( fd > first && close_fd_range(first, fd - 1) < 0 ) {
+                goto fallback;
+            }
+            first = fd + 1;
+            word &= word - 1;
+        }
+    }
+
+    if ( close_fd_range(first, ~0U) == 0 ) {
+        return;
+    }
+
+fallback:
+    /* kernel without close_range (< 5.9) */
+    debugf("close_range failed (%s), fallback to /proc/self/fd scan\n", strerror(errno));
+    proc_fd_foreach(close_unkept, keep);
+}
@@ -0,0 +1,29 @@
+/*
+  Copyright (c) 2019, Sylabs, Inc. All rights reserved.
+
+  This software is licensed under a 3-clause BSD license.  Please
+  consult LICENSE.md file distributed with the sources of this project regarding
+  your rights to use or distribute this software.
+*/
+
+#ifndef _SINGULARITY_FDSET_H
+#define _SINGULARITY_FDSET_H
+
+#define FDSET_BITS      (sizeof(unsigned long) * 8)
+/* number of file descriptors probed per poll call */
+#define FDSET_POLL_FDS  1024
+
+/* set of file descriptors stored as a bitmap */
+typedef struct fdset {
+    unsigned long *bits;
+    /* number of words allocated for bits */
+    unsigned int words;
+} fdset_t;
+
+fdset_t *fdset_open(void);
+void fdset_add(fdset_t *set, int fd);
+int fdset_has(fdset_t *set, int fd);
+void fdset_free(fdset_t *set);
+void fdset_close_others(fdset_t *keep);
+
+#endif /* _SINGULARITY_FDSET_H */
@@ -19,7 +19,7 @@
 #define warningf(b...)   singularity_message(WARNING, b)
 #define errorf(b...)     singularity_message(ERROR, b)
 
-#define MAX_JSON_SIZE       128*1024
+#define JSON_SLACK_SIZE     128*1024
 #define MAX_MAP_SIZE        4096
 #define MAX_PATH_SIZE       PATH_MAX
 #define MAX_GID             32
@@ -34,6 +34,22 @@
 #define PR_GET_NO_NEW_PRIVS 39
 #endif
 
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#endif
+
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING   0x0002U
+#endif
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS         1033
+#define F_SEAL_SEAL         0x0001
+#define F_SEAL_SHRINK       0x0002
+#define F_SEAL_GROW         0x0004
+#define F_SEAL_WRITE        0x0008
+#endif
+
 #define NO_NAMESPACE        -1
 #define CREATE_NAMESPACE    0
 #define ENTER_NAMESPACE     1
@@ -144,6 +160,8 @@ struct container {
 struct starter {
     /* control starter working directory from a file descriptor */
     int workingDirectoryFd;
+    /* listening socket of an instance started in zygote mode */
+    int zygoteFd;
 
     /* hold file descriptors that need to be remains open after stage 1 */
     int fds[MAX_STARTER_FDS];
@@ -159,8 +177,21 @@ struct starter {
 
 /* engine configuration */
 struct engine {
-    char config[MAX_JSON_SIZE];
+    /*
+     * sealed memfd holding the configuration written by stage 1,
+     * mapped and closed by starter once stage 1 exits
+     */
+    int fd;
+    /* configuration size */
     size_t size;
+    /* configuration mapping size */
+    size_t mapSize;
+    /*
+     * configuration mapping inherited by forked processes, read-only
+     * unless memfd isn't supported, in which case this is an anonymous
+     * shared mapping with JSON_SLACK_SIZE bytes reserved for stage 1
+     */
+    char *config;
 };
 
 /* starter configuration */
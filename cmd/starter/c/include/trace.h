@@ -0,0 +1,46 @@
+/*
+  Copyright (c) 2019, Sylabs, Inc. All rights reserved.
+
+  This software is licensed under a 3-clause BSD license.  Please
+  consult LICENSE.md file distributed with the sources of this project regarding
+  your rights to use or distribute this software.
+*/
+
+#ifndef _SINGULARITY_TRACE_H
+#define _SINGULARITY_TRACE_H
+
+#include <sys/types.h>
+
+#define TRACE_ENV           "SINGULARITY_STARTUP_TRACE"
+#define MAX_TRACE_EVENTS    256
+#define MAX_TRACE_NAME      32
+
+/* startup phase timestamp */
+struct traceEvent {
+    /* phase name */
+    char name[MAX_TRACE_NAME];
+    /* process which reached the phase boundary */
+    pid_t pid;
+    /* CLOCK_MONOTONIC timestamp in nanoseconds */
+    unsigned long long ns;
+};
+
+/* startup trace shared by all starter processes */
+struct trace {
+    /* file descriptor where the trace record is written */
+    int fd;
+    /* PID of the initial starter process */
+    pid_t pid;
+    /* number of allocated event slots, may exceed MAX_TRACE_EVENTS */
+    unsigned int numEvents;
+    struct traceEvent events[MAX_TRACE_EVENTS];
+};
+
+/* current startup trace, NULL when tracing is disabled */
+extern struct trace *starter_trace;
+
+unsigned long long trace_now(void);
+void trace_init(const char *output, unsigned long long start);
+void trace_event(const char *name);
+
+#endif /* _SINGULARITY_TRACE_H */
@@ -0,0 +1,32 @@
+/*
+  Copyright (c) 2019, Sylabs, Inc. All rights reserved.
+
+  This software is licensed under a 3-clause BSD license.  Please
+  consult LICENSE.md file distributed with the sources of this project regarding
+  your rights to use or distribute this software.
+*/
+
+#ifndef _SINGULARITY_ZYGOTE_H
+#define _SINGULARITY_ZYGOTE_H
+
+#include <stddef.h>
+
+/* maximum number of concurrent launch requests */
+#define MAX_ZYGOTE_CLIENTS      256
+/* maximum size of a launch request payload */
+#define MAX_ZYGOTE_REQUEST      128*1024
+/* number of standard I/O file descriptors sent with a request */
+#define ZYGOTE_NUM_FDS          3
+/* timeout in seconds to receive a launch request once connected */
+#define ZYGOTE_REQUEST_TIMEOUT  5
+
+/*
+ * launch request payload received by the stage 2 process
+ * forked by the zygote, NULL in any other process
+ */
+extern char *zygote_request;
+extern size_t zygote_request_size;
+
+void zygote_init(int listenfd, int *masterfd);
+
+#endif /* _SINGULARITY_ZYGOTE_H */
@@ -22,6 +22,7 @@
 #include <dirent.h>
 #include <libgen.h>
 #include <limits.h>
+#include <endian.h>
 #include <sys/mman.h>
 #include <sys/fsuid.h>
 #include <sys/mount.h>
@@ -47,6 +48,9 @@
 #include "include/capability.h"
 #include "include/message.h"
 #include "include/starter.h"
+#include "include/fdset.h"
+#include "include/trace.h"
+#include "include/zygote.h"
 
 #define SELF_PID_NS     "/proc/self/ns/pid"
 #define SELF_NET_NS     "/proc/self/ns/net"
@@ -65,11 +69,6 @@ int master_socket[2] = {-1, -1};
 /* set Go execution call after init function returns */
 enum goexec goexecute;
 
-typedef struct fdlist {
-    int *fds;
-    unsigned int num;
-} fdlist_t;
-
 typedef struct stack {
     char alloc[4096] __attribute__((aligned(16)));
     char ptr[0];
@@ -665,130 +664,27 @@ static bool is_suid(void) {
     return suid;
 }
 
-/* list_fd returns list of currently opened file descriptors (from /proc/self/fd) */
-static fdlist_t *list_fd(void) {
-    int i = 0;
-    int fd_proc;
-    DIR *dir;
-    struct dirent *dirent;
-    fdlist_t *fl = (fdlist_t *)malloc(sizeof(fdlist_t));
-
-    if ( fl == NULL ) {
-        fatalf("Memory allocation failed: %s\n", strerror(errno));
-    }
-
-    fl->fds = NULL;
-    fl->num = 0;
-
-    if ( ( fd_proc = open("/proc/self/fd", O_RDONLY) ) < 0 ) {
-        fatalf("Failed to open /proc/self/fd: %s\n", strerror(errno));
-    }
-
-    if ( ( dir = fdopendir(fd_proc) ) == NULL ) {
-        fatalf("Failed to list /proc/self/fd directory: %s\n", strerror(errno));
-    }
-
-    while ( ( dirent = readdir(dir) ) ) {
-        if ( strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0 ) {
-            continue;
-        }
-        if ( atoi(dirent->d_name) == fd_proc ) {
-            continue;
-        }
-        fl->num++;
-    }
-
-    rewinddir(dir);
-
-    fl->fds = (int *)malloc(sizeof(int)*fl->num);
-    if ( fl->fds == NULL ) {
-        fatalf("Memory allocation failed: %s\n", strerror(errno));
-    }
-
-    while ( ( dirent = readdir(dir ) ) ) {
-        int cv;
-        if ( strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0 ) {
-            continue;
-        }
-
-        cv = atoi(dirent->d_name);
-        if ( cv == fd_proc ) {
-            continue;
-        }
-
-        fl->fds[i++] = cv;
-    }
-
-    closedir(dir);
-    close(fd_proc);
-
-    return fl;
-}
-
 /*
  * cleanup_fd closes all file descriptors that are not in
- * master's fdlist and not in starter's fds list as well.
+ * master's set and not in starter's fds list as well.
  */
-static void cleanup_fd(fdlist_t *master, struct starter *starter) {
-    int fd_proc;
-    DIR *dir;
-    struct dirent *dirent;
-    int i, fd;
-    bool found;
-
-    if ( ( fd_proc = open("/proc/self/fd", O_RDONLY) ) < 0 ) {
-        fatalf("Failed to open /proc/self/fd: %s\n", strerror(errno));
-    }
-
-    if ( ( dir = fdopendir(fd_proc) ) == NULL ) {
-        fatalf("Failed to list /proc/self/fd directory: %s\n", strerror(errno));
-    }
-
-    while ( ( dirent = readdir(dir) ) ) {
-        if ( strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0 ) {
-            continue;
-        }
-        fd = atoi(dirent->d_name);
-        if ( fd == fd_proc ) {
-            continue;
-        }
-
-        found = false;
+static void cleanup_fd(fdset_t *master, struct starter *starter) {
+    int i;
 
+    for ( i = 0; i < starter->numfds; i++ ) {
         /* check if the file descriptor was open before stage 1 execution */
-        for ( i = 0; i < master->num; i++ ) {
-            if ( master->fds[i] == fd ) {
-                found = true;
-                break;
-            }
-        }
-        if ( found ) {
+        if ( fdset_has(master, starter->fds[i]) ) {
             continue;
         }
-
-        found = false;
-
-        /* check if the file descriptor need to remain opened */
-        for ( i = 0; i < starter->numfds; i++ ) {
-            if ( starter->fds[i] == fd ) {
-                found = true;
-                /* set force close on exec */
-                if ( fcntl(starter->fds[i], F_SETFD, FD_CLOEXEC) < 0 ) {
-                    debugf("Can't set FD_CLOEXEC on file descriptor %d: %s\n", starter->fds[i], strerror(errno));
-                }
-                break;
-            }
-        }
-
-        /* close unattended file descriptors opened during stage 1 execution */
-        if ( !found ) {
-            debugf("Close file descriptor %d\n", fd);
-            close(fd);
+        /* file descriptor need to remain opened, set force close on exec */
+        if ( fcntl(starter->fds[i], F_SETFD, FD_CLOEXEC) < 0 ) {
+            debugf("Can't set FD_CLOEXEC on file descriptor %d: %s\n", starter->fds[i], strerror(errno));
         }
+        fdset_add(master, starter->fds[i]);
     }
 
-    closedir(dir);
-    close(fd_proc);
+    /* close unattended file descriptors opened during stage 1 execution */
+    fdset_close_others(master);
 }
 
 static int wait_event(int fd) {
@@ -935,6 +831,120 @@ static int get_pipe_exec_fd(void) {
     return pipe_fd;
 }
 
+/*
+ * read_pipe_full reads count bytes from fd into buffer, it returns
+ * the number of bytes read which is lower than count if the end
+ * of file was reached, or -1 on error.
+ */
+static ssize_t read_pipe_full(int fd, void *buffer, size_t count) {
+    size_t total = 0;
+
+    while ( total < count ) {
+        ssize_t n = read(fd, (char *)buffer + total, count - total);
+        if ( n < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            return -1;
+        } else if ( n == 0 ) {
+            break;
+        }
+        total += n;
+    }
+
+    return total;
+}
+
+static int memfd_create_sealable(const char *name) {
+#ifdef __NR_memfd_create
+    return syscall(__NR_memfd_create, name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*
+ * map_engine_config maps the sealed memfd engine->fd holding the
+ * configuration written by stage 1 and closes it. The mapping is
+ * private, kernels before 6.7 deny shared mappings of memfd sealed
+ * with F_SEAL_WRITE even if read-only, and the sealed content can't
+ * change anyway.
+ */
+static void map_engine_config(struct engine *engine) {
+    void *config = NULL;
+
+    if ( engine->size > 0 ) {
+        config = mmap(NULL, engine->size, PROT_READ, MAP_PRIVATE, engine->fd, 0);
+        if ( config == MAP_FAILED ) {
+            fatalf("Failed to map engine configuration: %s\n", strerror(errno));
+        }
+    }
+    close(engine->fd);
+
+    engine->fd = -1;
+    engine->mapSize = engine->size;
+    engine->config = config;
+}
+
+/*
+ * read_engine_config reads engine configuration from fd, the
+ * configuration is preceded by its size encoded as a big endian
+ * 64 bits integer. The configuration is stored in a memfd sized
+ * and sealed accordingly, so that it can't be altered by processes
+ * sharing the read-only mapping.
+ */
+static void read_engine_config(int fd, struct engine *engine) {
+    uint64_t header;
+    ssize_t n;
+    void *config;
+
+    if ( ( n = read_pipe_full(fd, &header, sizeof(header)) ) != sizeof(header) ) {
+        fatalf("Failed to read engine configuration size: %s\n", n < 0 ? strerror(errno) : "short read");
+    }
+    engine->size = be64toh(header);
+    if ( engine->size == 0 || engine->size > SSIZE_MAX ) {
+        fatalf("Bad engine configuration size: %zu\n", engine->size);
+    }
+
+    engine->fd = memfd_create_sealable("engine-config");
+    if ( engine->fd >= 0 ) {
+        if ( ftruncate(engine->fd, engine->size) < 0 ) {
+            fatalf("Failed to resize engine configuration: %s\n", strerror(errno));
+        }
+        config = mmap(NULL, engine->size, PROT_READ | PROT_WRITE, MAP_SHARED, engine->fd, 0);
+    } else if ( errno == ENOSYS || errno == EINVAL ) {
+        /* kernel without memfd (< 3.17) or sealing support */
+        debugf("memfd not supported, fallback to anonymous shared memory\n");
+        engine->mapSize = engine->size + JSON_SLACK_SIZE;
+        config = mmap(NULL, engine->mapSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+    } else {
+        fatalf("Failed to create engine configuration memfd: %s\n", strerror(errno));
+    }
+    if ( config == MAP_FAILED ) {
+        fatalf("Memory allocation failed: %s\n", strerror(errno));
+    }
+
+    if ( ( n = read_pipe_full(fd, config, engine->size) ) != (ssize_t)engine->size ) {
+        if ( n < 0 ) {
+            fatalf("Read engine configuration failed: %s\n", strerror(errno));
+        }
+        fatalf("Read engine configuration failed: got %zd bytes out of %zu\n", n, engine->size);
+    }
+
+    if ( engine->fd < 0 ) {
+        engine->config = config;
+        return;
+    }
+
+    /* writable shared mapping must be released before sealing */
+    munmap(config, engine->size);
+    if ( fcntl(engine->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0 ) {
+        fatalf("Failed to seal engine configuration: %s\n", strerror(errno));
+    }
+    map_engine_config(engine);
+}
+
 /* "noop" mount operation to force kernel to load overlay module */
 void load_overlay_module(void) {
     if ( geteuid() == 0 && getenv("LOAD_OVERLAY_MODULE") != NULL ) {
@@ -967,7 +977,11 @@ __attribute__((constructor)) static void init(void) {
     int pipe_fd = -1;
     int clone_flags = 0;
     int userns = NO_NAMESPACE, pidns = NO_NAMESPACE;
-    fdlist_t *master_fds;
+    fdset_t *master_fds;
+    char *engine_config;
+    size_t engine_map_size;
+    unsigned long long start = trace_now();
+    char *trace_output = getenv(TRACE_ENV);
 
     verbosef("Starter initialization\n");
 
@@ -1000,22 +1014,24 @@ __attribute__((constructor)) static void init(void) {
         priv_drop(false);
     }
 
+    /* startup trace output is opened with user privileges */
+    trace_init(trace_output, start);
+
     debugf("Read engine configuration\n");
 
-    /* read engine configuration from pipe */
-    if ( ( sconfig->engine.size = read(pipe_fd, sconfig->engine.config, MAX_JSON_SIZE - 1) ) <= 0 ) {
-        fatalf("Read engine configuration from pipe failed: %s\n", strerror(errno));
-    }
+    read_engine_config(pipe_fd, &sconfig->engine);
     close(pipe_fd);
+    trace_event("read_config");
 
     /* fix I/O streams to point to /dev/null if they are closed */
     fix_streams();
 
     /* save opened file descriptors that won't be closed when stage 1 exits */
-    master_fds = list_fd();
+    master_fds = fdset_open();
 
     /* set an invalid value for check */
     sconfig->starter.workingDirectoryFd = -1;
+    sconfig->starter.zygoteFd = -1;
 
     /*
      *  CLONE_FILES will share file descriptors opened during stage 1,
@@ -1025,6 +1041,10 @@ __attribute__((constructor)) static void init(void) {
      *  with a file descriptor in order to keep it open during cleanup
      *  step below.
      */
+    engine_config = sconfig->engine.config;
+    engine_map_size = sconfig->engine.mapSize;
+
+    trace_event("fork_stage1");
     process = fork_ns(CLONE_FILES);
     if ( process == 0 ) {
         /*
@@ -1047,6 +1067,14 @@ __attribute__((constructor)) static void init(void) {
 
     debugf("Wait completion of stage1\n");
     wait_child("stage 1", process, false);
+    trace_event("wait_stage1");
+
+    /* map engine configuration updated by stage 1 */
+    if ( sconfig->engine.fd >= 0 ) {
+        debugf("Map engine configuration updated by stage 1\n");
+        munmap(engine_config, engine_map_size);
+        map_engine_config(&sconfig->engine);
+    }
 
     /* change current working directory if requested by stage 1 */
     if ( sconfig->starter.workingDirectoryFd >= 0 ) {
@@ -1058,9 +1086,9 @@ __attribute__((constructor)) static void init(void) {
 
     /* close all unattended and not registered file descriptors opened in stage 1 */
     cleanup_fd(master_fds, &sconfig->starter);
-    /* free previously allocated resources during list_fd call */
-    free(master_fds->fds);
-    free(master_fds);
+    /* free previously allocated resources during fdset_open call */
+    fdset_free(master_fds);
+    trace_event("cleanup_fd");
 
     /* block SIGCHLD signal handled later by stage 2/master */
     debugf("Set child signal mask\n");
@@ -1168,6 +1196,7 @@ __attribute__((constructor)) static void init(void) {
     if ( pidns == CREATE_NAMESPACE ) {
         clone_flags |= CLONE_NEWPID;
     }
+    trace_event("user_pid_namespace_init");
 
     process = fork_ns(clone_flags);
     if ( process == 0 ) {
@@ -1190,6 +1219,7 @@ __attribute__((constructor)) static void init(void) {
         uts_namespace_init(&sconfig->container.namespace);
         ipc_namespace_init(&sconfig->container.namespace);
         cgroup_namespace_init(&sconfig->container.namespace);
+        trace_event("namespace_init");
 
         /*
          * depending of engines, the master process may require to propagate mount point
@@ -1209,6 +1239,7 @@ __attribute__((constructor)) static void init(void) {
             send_event(master_socket[1]);
             mount_namespace_init(&sconfig->container.namespace, false);
         }
+        trace_event("mount_namespace_init");
 
         if ( !sconfig->container.namespace.joinOnly ) {
             /* close master end of rpc communication socket */
@@ -1219,9 +1250,13 @@ __attribute__((constructor)) static void init(void) {
              * occurring in RPC server process also affect stage 2 process
              * which is the final container process
              */
+            trace_event("fork_rpc_server");
             process = fork_ns(CLONE_FS);
             if ( process == 0 ) {
                 set_parent_death_signal(SIGKILL);
+                if ( sconfig->starter.zygoteFd >= 0 ) {
+                    close(sconfig->starter.zygoteFd);
+                }
                 verbosef("Spawn RPC server\n");
                 goexecute = RPC_SERVER;
                 /* continue execution with Go runtime in main_linux.go */
@@ -1232,6 +1267,7 @@ __attribute__((constructor)) static void init(void) {
 
                 /* wait RPC server exits before running container process */
                 wait_child("rpc server", process, false);
+                trace_event("wait_rpc_server");
 
                 if ( sconfig->starter.hybridWorkflow && sconfig->starter.isSuid ) {
                     /* make /proc/self readable by user to join instance without SUID workflow */
@@ -1248,6 +1284,13 @@ __attribute__((constructor)) static void init(void) {
         }
 
         apply_container_privileges(&sconfig->container.privileges);
+        trace_event("apply_privileges");
+
+        if ( sconfig->starter.zygoteFd >= 0 ) {
+            verbosef("Run instance in zygote mode\n");
+            /* only returns in stage 2 processes forked by zygote */
+            zygote_init(sconfig->starter.zygoteFd, &master_socket[1]);
+        }
         goexecute = STAGE2;
         /* continue execution with Go runtime in main_linux.go */
         return;
@@ -1257,6 +1300,11 @@ __attribute__((constructor)) static void init(void) {
         verbosef("Spawn master process\n");
         sconfig->container.pid = process;
 
+        /* zygote socket is only used by container process */
+        if ( sconfig->starter.zygoteFd >= 0 ) {
+            close(sconfig->starter.zygoteFd);
+        }
+
         /*
          * case where we joined a PID namespace already,
          * but a new mount namespace was requested (e.g. kubernetes POD).
@@ -1311,6 +1359,7 @@ __attribute__((constructor)) static void init(void) {
                 chdir_to_proc_pid(sconfig->container.pid);
                 setup_userns_mappings(&sconfig->container.privileges);
             }
+            trace_event("userns_mappings");
             send_event(master_socket[0]);
         } else {
             chdir_to_proc_pid(sconfig->container.pid);
@@ -1321,6 +1370,7 @@ __attribute__((constructor)) static void init(void) {
             /* child has exited before sending data */
             wait_child("stage 2", sconfig->container.pid, true);
         }
+        trace_event("wait_namespace_init");
 
         /* engine requested to propagate mount to container */
         if ( sconfig->starter.masterPropagateMount && userns != ENTER_NAMESPACE ) {
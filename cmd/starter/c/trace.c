@@ -0,0 +1,107 @@
+/*
+  Copyright (c) 2019, Sylabs, Inc. All rights reserved.
+
+  This software is licensed under a 3-clause BSD license.  Please
+  consult LICENSE.md file distributed with the sources of this project regarding
+  your rights to use or distribute this software.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "include/message.h"
+#include "include/trace.h"
+
+struct trace *starter_trace = NULL;
+
+/* trace_now returns the current CLOCK_MONOTONIC time in nanoseconds */
+unsigned long long trace_now(void) {
+    struct timespec ts;
+
+    if ( clock_gettime(CLOCK_MONOTONIC, &ts) < 0 ) {
+        return 0;
+    }
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * trace_open returns a close-on-exec file descriptor for the trace
+ * output, output is either a file descriptor number inherited from
+ * the caller or a file path opened in append mode so that records
+ * from concurrent launches can be collected in the same file.
+ */
+static int trace_open(const char *output) {
+    int fd;
+
+    if ( output[strspn(output, "0123456789")] == '\0' ) {
+        if ( sscanf(output, "%d", &fd) != 1 ) {
+            return -1;
+        }
+        return fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    }
+    return open(output, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+
+/*
+ * trace_init enables startup tracing when output is set, the trace
+ * area is allocated in shared memory in order to be inherited by
+ * all processes forked by starter. This must be called with dropped
+ * privileges as the output path is provided by the user.
+ */
+void trace_init(const char *output, unsigned long long start) {
+    struct trace *trace;
+    int fd;
+
+    if ( output == NULL || output[0] == '\0' ) {
+        return;
+    }
+
+    fd = trace_open(output);
+    if ( fd < 0 ) {
+        singularity_message(WARNING, "Startup tracing disabled, could not open %s: %s\n", output, strerror(errno));
+        return;
+    }
+
+    trace = (struct trace *)mmap(NULL, sizeof(struct trace), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+    if ( trace == MAP_FAILED ) {
+        singularity_message(WARNING, "Startup tracing disabled, memory allocation failed: %s\n", strerror(errno));
+        close(fd);
+        return;
+    }
+
+    trace->fd = fd;
+    trace->pid = getpid();
+    starter_trace = trace;
+
+    singularity_message(DEBUG, "Startup tracing enabled, writing record to %s\n", output);
+
+    trace_event("starter_init");
+    starter_trace->events[0].ns = start;
+}
+
+/* trace_event records timestamp of the phase identified by name */
+void trace_event(const char *name) {
+    unsigned int slot;
+    struct traceEvent *event;
+
+    if ( starter_trace == NULL ) {
+        return;
+    }
+
+    slot = __atomic_fetch_add(&starter_trace->numEvents, 1, __ATOMIC_SEQ_CST);
+    if ( slot >= MAX_TRACE_EVENTS ) {
+        return;
+    }
+
+    event = &starter_trace->events[slot];
+    event->ns = trace_now();
+    event->pid = getpid();
+    strncpy(event->name, name, MAX_TRACE_NAME - 1);
+}
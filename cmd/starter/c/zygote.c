@@ -0,0 +1,482 @@
+/*
+  Copyright (c) 2019, Sylabs, Inc. All rights reserved.
+
+  This software is licensed under a 3-clause BSD license.  Please
+  consult LICENSE.md file distributed with the sources of this project regarding
+  your rights to use or distribute this software.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#include "include/message.h"
+#include "include/starter.h"
+#include "include/trace.h"
+#include "include/zygote.h"
+
+/*
+ * The zygote is the container process of an instance started in
+ * zygote mode, it's the PID 1 of the instance PID namespace and
+ * lives with the container privileges applied in a fully set up
+ * container. It forks the instance process first and then each
+ * connection on the zygote socket forks a new stage 2 process,
+ * skipping starter initialization, stage 1 and container creation.
+ * Requests are read without blocking along with the other events,
+ * a client not sending its request is dropped after a timeout.
+ *
+ * Wire protocol (integers are 32 bits in network byte order):
+ * - client sends the payload size along with its standard I/O file
+ *   descriptors (SCM_RIGHTS), followed by the JSON payload
+ * - client sends signal numbers to forward them to the process
+ * - zygote sends the wait status once the process exited
+ */
+
+struct zygoteClient {
+    /* forked stage 2 process, 0 while the request is received */
+    pid_t pid;
+    /* client connection, -1 once the client is gone */
+    int conn;
+    /* zygote end of the stage 2 master socket */
+    int master;
+    /* request being received, NULL until the header is received */
+    char *request;
+    size_t size;
+    size_t received;
+    int fds[ZYGOTE_NUM_FDS];
+    /* monotonic time in seconds after which the request is dropped */
+    time_t deadline;
+};
+
+char *zygote_request = NULL;
+size_t zygote_request_size = 0;
+
+static struct zygoteClient clients[MAX_ZYGOTE_CLIENTS];
+static int num_clients = 0;
+static int listen_fd = -1;
+static int signal_fd = -1;
+
+static int read_full(int fd, void *buf, size_t size) {
+    size_t done = 0;
+    ssize_t ret;
+
+    while ( done < size ) {
+        ret = read(fd, (char *)buf + done, size - done);
+        if ( ret < 0 && errno == EINTR ) {
+            continue;
+        } else if ( ret <= 0 ) {
+            return -1;
+        }
+        done += ret;
+    }
+    return 0;
+}
+
+static time_t monotonic_time(void) {
+    struct timespec ts;
+
+    if ( clock_gettime(CLOCK_MONOTONIC, &ts) < 0 ) {
+        fatalf("Failed to get monotonic time: %s\n", strerror(errno));
+    }
+    return ts.tv_sec;
+}
+
+/*
+ * recv_request receives the request header and payload available on the
+ * client connection without blocking, it returns 1 once the request is
+ * complete, 0 if more data are expected and -1 on error.
+ */
+static int recv_request(struct zygoteClient *client) {
+    char control[CMSG_SPACE(sizeof(int) * ZYGOTE_NUM_FDS)];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    uint32_t len;
+    ssize_t ret;
+    int numfds = 0;
+    int i;
+
+    if ( client->request == NULL ) {
+        memset(&msg, 0, sizeof(msg));
+        iov.iov_base = &len;
+        iov.iov_len = sizeof(len);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ret = recvmsg(client->conn, &msg, MSG_CMSG_CLOEXEC|MSG_DONTWAIT);
+        if ( ret < 0 && (errno == EAGAIN || errno == EINTR) ) {
+            return 0;
+        }
+
+        for ( cmsg = CMSG_FIRSTHDR(&msg); ret > 0 && cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg) ) {
+            if ( cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS ) {
+                numfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                memcpy(client->fds, CMSG_DATA(cmsg), numfds * sizeof(int));
+                break;
+            }
+        }
+
+        if ( ret != sizeof(len) || numfds != ZYGOTE_NUM_FDS || (msg.msg_flags & MSG_CTRUNC) ) {
+            debugf("Zygote request header received with %d file descriptors\n", numfds);
+            for ( i = 0; i < numfds; i++ ) {
+                close(client->fds[i]);
+            }
+            return -1;
+        }
+
+        client->size = ntohl(len);
+        if ( client->size == 0 || client->size > MAX_ZYGOTE_REQUEST ) {
+            debugf("Bad zygote request size %zu\n", client->size);
+            goto bad_request;
+        }
+        client->request = (char *)malloc(client->size);
+        if ( client->request == NULL ) {
+            goto bad_request;
+        }
+        client->received = 0;
+    }
+
+    while ( client->received < client->size ) {
+        ret = read(client->conn, client->request + client->received, client->size - client->received);
+        if ( ret < 0 && errno == EINTR ) {
+            continue;
+        } else if ( ret < 0 && errno == EAGAIN ) {
+            return 0;
+        } else if ( ret <= 0 ) {
+            debugf("Failed to receive zygote request payload\n");
+            return -1;
+        }
+        client->received += ret;
+    }
+    return 1;
+
+bad_request:
+    for ( i = 0; i < ZYGOTE_NUM_FDS; i++ ) {
+        close(client->fds[i]);
+    }
+    return -1;
+}
+
+/* send_status reports process wait status to the client if still connected */
+static void send_status(struct zygoteClient *client, int status) {
+    uint32_t data = htonl((uint32_t)status);
+
+    if ( client->conn < 0 ) {
+        return;
+    }
+    if ( send(client->conn, &data, sizeof(data), MSG_NOSIGNAL) != sizeof(data) ) {
+        debugf("Failed to send exit status of process %d: %s\n", client->pid, strerror(errno));
+    }
+}
+
+/* close_client releases resources held by a client */
+static void close_client(struct zygoteClient *client) {
+    int i;
+
+    if ( client->conn >= 0 ) {
+        close(client->conn);
+    }
+    if ( client->master >= 0 ) {
+        close(client->master);
+    }
+    if ( client->request != NULL ) {
+        for ( i = 0; i < ZYGOTE_NUM_FDS; i++ ) {
+            close(client->fds[i]);
+        }
+        free(client->request);
+    }
+}
+
+static void remove_client(int index) {
+    close_client(&clients[index]);
+    clients[index] = clients[--num_clients];
+}
+
+/* accept_client registers a connection accepted on the zygote socket */
+static void accept_client(int conn) {
+    struct ucred cred;
+    socklen_t credlen = sizeof(cred);
+
+    if ( getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) < 0 ) {
+        warningf("Failed to get zygote client credentials: %s\n", strerror(errno));
+        close(conn);
+        return;
+    }
+    if ( cred.uid != getuid() ) {
+        warningf("Zygote request from UID %d rejected\n", cred.uid);
+        close(conn);
+        return;
+    }
+    if ( num_clients >= MAX_ZYGOTE_CLIENTS ) {
+        warningf("Zygote request rejected, too many processes running\n");
+        close(conn);
+        return;
+    }
+
+    memset(&clients[num_clients], 0, sizeof(struct zygoteClient));
+    clients[num_clients].conn = conn;
+    clients[num_clients].master = -1;
+    clients[num_clients].deadline = monotonic_time() + ZYGOTE_REQUEST_TIMEOUT;
+    num_clients++;
+}
+
+/*
+ * spawn forks a stage 2 process for the request received by the client
+ * at index, it returns 0 in the child process, the child PID in zygote
+ * or -1 if the process couldn't be forked in which case the client is
+ * removed.
+ */
+static pid_t spawn(int index, sigset_t *oldmask, int *masterfd) {
+    struct zygoteClient *client = &clients[index];
+    int master[2];
+    pid_t pid;
+    int i;
+
+    /* stage 2 reports StartProcess errors on master socket */
+    if ( socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, master) < 0 ) {
+        warningf("Failed to create communication socket: %s\n", strerror(errno));
+        remove_client(index);
+        return -1;
+    }
+
+    pid = fork();
+    if ( pid == 0 ) {
+        for ( i = 0; i < ZYGOTE_NUM_FDS; i++ ) {
+            if ( dup2(client->fds[i], i) < 0 ) {
+                fatalf("Failed to duplicate file descriptor %d: %s\n", client->fds[i], strerror(errno));
+            }
+            close(client->fds[i]);
+        }
+        zygote_request = client->request;
+        zygote_request_size = client->size;
+        client->request = NULL;
+
+        for ( i = 0; i < num_clients; i++ ) {
+            close_client(&clients[i]);
+        }
+        close(master[0]);
+        close(listen_fd);
+        close(signal_fd);
+
+        if ( sigprocmask(SIG_SETMASK, oldmask, NULL) < 0 ) {
+            fatalf("Failed to restore signal mask: %s\n", strerror(errno));
+        }
+
+        /* startup trace was already emitted by the instance process */
+        starter_trace = NULL;
+
+        *masterfd = master[1];
+        return 0;
+    } else if ( pid < 0 ) {
+        warningf("Failed to fork zygote process: %s\n", strerror(errno));
+        close(master[0]);
+        close(master[1]);
+        remove_client(index);
+        return -1;
+    }
+
+    debugf("Zygote spawned process %d\n", pid);
+
+    /* signal numbers are read once the connection is readable */
+    if ( fcntl(client->conn, F_SETFL, 0) < 0 ) {
+        warningf("Failed to set zygote connection blocking: %s\n", strerror(errno));
+    }
+
+    close(master[1]);
+    for ( i = 0; i < ZYGOTE_NUM_FDS; i++ ) {
+        close(client->fds[i]);
+    }
+    free(client->request);
+    client->request = NULL;
+    client->pid = pid;
+    client->master = master[0];
+
+    return pid;
+}
+
+/* reap collects exited processes and exits if the instance process exited */
+static void reap(pid_t instance) {
+    int status;
+    pid_t pid;
+    int i;
+
+    while ( (pid = waitpid(-1, &status, WNOHANG)) > 0 ) {
+        if ( pid == instance ) {
+            verbosef("Instance process exited, stopping zygote\n");
+            for ( i = 0; i < num_clients; i++ ) {
+                if ( clients[i].pid > 0 ) {
+                    kill(clients[i].pid, SIGKILL);
+                }
+            }
+            if ( WIFSIGNALED(status) ) {
+                exit(128 + WTERMSIG(status));
+            }
+            exit(WEXITSTATUS(status));
+        }
+        for ( i = 0; i < num_clients; i++ ) {
+            if ( clients[i].pid == pid ) {
+                send_status(&clients[i], status);
+                remove_client(i);
+                break;
+            }
+        }
+    }
+}
+
+/* forward_signal reads a signal number sent by a client and forwards it */
+static void forward_signal(struct zygoteClient *client) {
+    uint32_t data;
+    int signo;
+
+    if ( read_full(client->conn, &data, sizeof(data)) < 0 ) {
+        /* client is gone, don't leave process running behind */
+        debugf("Zygote client of process %d disconnected\n", client->pid);
+        kill(client->pid, SIGKILL);
+        close(client->conn);
+        client->conn = -1;
+        return;
+    }
+
+    signo = (int)ntohl(data);
+    if ( signo <= 0 || signo >= NSIG ) {
+        return;
+    }
+    kill(client->pid, signo);
+}
+
+/*
+ * zygote_init forks the instance process and serves launch requests
+ * received on the listening socket listenfd until the instance process
+ * exits. It returns only in forked stage 2 processes with masterfd set
+ * to their master socket.
+ */
+void zygote_init(int listenfd, int *masterfd) {
+    struct pollfd pfds[MAX_ZYGOTE_CLIENTS + 2];
+    struct signalfd_siginfo siginfo;
+    sigset_t mask, oldmask;
+    pid_t instance;
+    time_t now, deadline;
+    int nfds, timeout, ret, i;
+
+    listen_fd = listenfd;
+
+    sigfillset(&mask);
+    if ( sigprocmask(SIG_SETMASK, &mask, &oldmask) < 0 ) {
+        fatalf("Blocked signals error: %s\n", strerror(errno));
+    }
+
+    instance = fork();
+    if ( instance == 0 ) {
+        close(listen_fd);
+        if ( sigprocmask(SIG_SETMASK, &oldmask, NULL) < 0 ) {
+            fatalf("Failed to restore signal mask: %s\n", strerror(errno));
+        }
+        return;
+    } else if ( instance < 0 ) {
+        fatalf("Failed to spawn instance process: %s\n", strerror(errno));
+    }
+
+    /* master process is waiting the instance process closes its end */
+    close(*masterfd);
+
+    signal_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if ( signal_fd < 0 ) {
+        fatalf("Failed to create signal file descriptor: %s\n", strerror(errno));
+    }
+
+    /* instance join checks that the instance PID is a sinit process */
+    if ( prctl(PR_SET_NAME, "sinit", 0, 0, 0) < 0 ) {
+        fatalf("Failed to set process name: %s\n", strerror(errno));
+    }
+
+    verbosef("Zygote ready, instance process %d\n", instance);
+
+    while ( 1 ) {
+        /* drop clients which didn't send their request in time */
+        now = monotonic_time();
+        timeout = -1;
+        for ( i = num_clients - 1; i >= 0; i-- ) {
+            if ( clients[i].pid > 0 ) {
+                continue;
+            }
+            if ( clients[i].deadline <= now ) {
+                debugf("Zygote request timed out\n");
+                remove_client(i);
+                continue;
+            }
+            deadline = (clients[i].deadline - now) * 1000;
+            if ( timeout < 0 || deadline < timeout ) {
+                timeout = deadline;
+            }
+        }
+
+        pfds[0].fd = signal_fd;
+        pfds[0].events = POLLIN;
+        pfds[1].fd = listen_fd;
+        pfds[1].events = POLLIN;
+        for ( i = 0; i < num_clients; i++ ) {
+            pfds[i+2].fd = clients[i].conn;
+            pfds[i+2].events = POLLIN;
+        }
+        nfds = num_clients + 2;
+
+        if ( poll(pfds, nfds, timeout) < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            fatalf("Zygote poll failed: %s\n", strerror(errno));
+        }
+
+        /* client connections first as reap may reorder the client list */
+        for ( i = nfds - 1; i >= 2; i-- ) {
+            if ( !pfds[i].revents || clients[i-2].conn < 0 ) {
+                continue;
+            }
+            if ( clients[i-2].pid > 0 ) {
+                forward_signal(&clients[i-2]);
+                continue;
+            }
+            ret = recv_request(&clients[i-2]);
+            if ( ret < 0 ) {
+                remove_client(i-2);
+            } else if ( ret > 0 && spawn(i-2, &oldmask, masterfd) == 0 ) {
+                return;
+            }
+        }
+
+        if ( pfds[0].revents & POLLIN ) {
+            if ( read_full(signal_fd, &siginfo, sizeof(siginfo)) < 0 ) {
+                fatalf("Failed to read signal information: %s\n", strerror(errno));
+            }
+            if ( siginfo.ssi_signo == SIGCHLD ) {
+                reap(instance);
+            } else {
+                kill(instance, siginfo.ssi_signo);
+            }
+        }
+
+        if ( pfds[1].revents & POLLIN ) {
+            int conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC|SOCK_NONBLOCK);
+            if ( conn < 0 ) {
+                warningf("Failed to accept zygote connection: %s\n", strerror(errno));
+                continue;
+            }
+            accept_client(conn);
+        }
+    }
+}
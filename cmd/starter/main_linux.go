@@ -9,6 +9,9 @@ package main
 #include "c/message.c"
 #include "c/capability.c"
 #include "c/setns.c"
+#include "c/fdset.c"
+#include "c/trace.c"
+#include "c/zygote.c"
 #include "c/starter.c"
 */
 import "C"
@@ -23,6 +26,7 @@ import (
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	_ "github.com/sylabs/singularity/internal/pkg/util/goversion"
 	"github.com/sylabs/singularity/internal/pkg/util/mainthread"
+	"github.com/sylabs/singularity/internal/pkg/util/trace"
 
 	// register engines
 	_ "github.com/sylabs/singularity/cmd/starter/engines"
@@ -36,7 +40,28 @@ func getEngine(jsonConfig []byte) *engine.Engine {
 	return e
 }
 
+// stageName returns the name of the current execution stage
+// used to identify startup trace events.
+func stageName() string {
+	switch C.goexecute {
+	case C.STAGE1:
+		return "stage1"
+	case C.STAGE2:
+		return "stage2"
+	case C.MASTER:
+		return "master"
+	case C.RPC_SERVER:
+		return "rpc_server"
+	}
+	return "unknown"
+}
+
 func startup() {
+	// global variable defined in cmd/starter/c/trace.c,
+	// C.starter_trace is nil if startup tracing is disabled
+	trace.Init(unsafe.Pointer(C.starter_trace))
+	trace.Event(stageName() + "_go_runtime")
+
 	// global variable defined in cmd/starter/c/starter.c,
 	// C.sconfig points to a shared memory area
 	csconf := unsafe.Pointer(C.sconfig)
@@ -48,6 +73,7 @@ func startup() {
 	// get engine operations previously registered
 	// by the above import
 	e := getEngine(jsonConfig)
+	trace.Event(stageName() + "_engine_config")
 	sylog.Debugf("%s runtime engine selected", e.EngineName)
 
 	switch C.goexecute {
@@ -60,8 +86,15 @@ func startup() {
 			sylog.Fatalf("%s", err)
 		}
 
+		// global variable defined in cmd/starter/c/zygote.c,
+		// set only when forked by an instance zygote
+		var zygoteRequest []byte
+		if C.zygote_request != nil {
+			zygoteRequest = C.GoBytes(unsafe.Pointer(C.zygote_request), C.int(C.zygote_request_size))
+		}
+
 		mainthread.Execute(func() {
-			starter.StageTwo(int(C.master_socket[1]), e)
+			starter.StageTwo(int(C.master_socket[1]), zygoteRequest, e)
 		})
 	case C.MASTER:
 		sylog.Verbosef("Execute master process\n")
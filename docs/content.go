@@ -196,7 +196,10 @@ Enterprise Performance Computing (EPC)`
 	CacheListShort string = `List your local Singularity cache`
 	CacheListLong  string = `
   This will list your local cache (stored at $HOME/.singularity/cache if
-  SINGULARITY_CACHEDIR is not set).`
+  SINGULARITY_CACHEDIR is not set), along with the last time each image was
+  used. When the cache exceeds its maximum size ('cache max size' in
+  singularity.conf, or SINGULARITY_CACHE_MAXSIZE in MiB), images are evicted
+  as new ones are added to the cache.`
 	CacheListExample string = `
   All group commands have their own help output:
 
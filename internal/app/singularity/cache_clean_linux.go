@@ -51,6 +51,10 @@ func cleanOrasCache(imgCache *cache.Handle, op func(string) error) error {
 	return cleanCacheDir("oras", imgCache.Oras, op)
 }
 
+func cleanLayerCache(imgCache *cache.Handle, op func(string) error) error {
+	return cleanCacheDir("layer", imgCache.Layer, op)
+}
+
 // cleanCache cleans the given type of cache cacheType. It will return a
 // error if one occurs.
 func cleanCache(imgCache *cache.Handle, cacheType string, op func(string) error) error {
@@ -71,6 +75,8 @@ func cleanCache(imgCache *cache.Handle, cacheType string, op func(string) error)
 		return cleanNetCache(imgCache, op)
 	case "oras":
 		return cleanOrasCache(imgCache, op)
+	case "layer":
+		return cleanLayerCache(imgCache, op)
 	default:
 		// The caller checks the returned error and will exit as required
 		return fmt.Errorf("not a valid type: %s", cacheType)
@@ -151,7 +157,7 @@ func CleanSingularityCache(imgCache *cache.Handle, force bool, cacheCleanTypes [
 				sylog.Warningf("No cache found with given name: %s", name)
 			}
 		}
-		return nil
+		return syncCacheIndex(imgCache, force)
 	}
 
 	// no name specified, clean everything in the specified
@@ -167,5 +173,16 @@ func CleanSingularityCache(imgCache *cache.Handle, force bool, cacheCleanTypes [
 		}
 	}
 
+	return syncCacheIndex(imgCache, force)
+}
+
+// syncCacheIndex removes the cleaned entries from the cache index.
+func syncCacheIndex(imgCache *cache.Handle, force bool) error {
+	if !force {
+		return nil
+	}
+	if err := imgCache.SyncIndex(); err != nil {
+		return fmt.Errorf("unable to update cache index: %v", err)
+	}
 	return nil
 }
@@ -39,10 +39,35 @@ func findSize(size int64) string {
 	return fmt.Sprintf("%.2f %s", float64(size)/factor, unit)
 }
 
-// listTypeCache will list a cache type with given name (cacheType). The options are 'library', and 'oci'.
-// Will return: the number of containers for that type (int), the total space the container type is using (int64),
-// and an error if one occurs.
-func listTypeCache(printList bool, name, cachePath string) (int, int64, error) {
+// listTypeCache will list a cache type with given name (cacheType) from
+// the cache index. Will return: the number of containers for that type (int),
+// the total space the container type is using (int64), and an error if one occurs.
+func listTypeCache(imgCache *cache.Handle, printList bool, name, cachePath string) (int, int64, error) {
+	entries, err := imgCache.Entries(cachePath)
+	if err != nil {
+		return 0, 0, fmt.Errorf("unable to list cache %s: %v", name, err)
+	}
+
+	var totalSize int64
+
+	for _, entry := range entries {
+		if printList {
+			fmt.Printf("%-24.22s %-22s %-16s %s\n",
+				filepath.Base(entry.Path),
+				entry.LastAccess.Format("2006-01-02 15:04:05"),
+				findSize(entry.Size),
+				name)
+		}
+		totalSize += entry.Size
+	}
+
+	return len(entries), totalSize, nil
+}
+
+// listBlobCache will list the OCI blobs in cachePath, blobs are not
+// indexed. Will return: the number of blobs (int), the total space used
+// by blobs (int64), and an error if one occurs.
+func listBlobCache(printList bool, name, cachePath string) (int, int64, error) {
 	_, err := os.Stat(cachePath)
 	if os.IsNotExist(err) {
 		return 0, 0, nil
@@ -120,7 +145,7 @@ func ListSingularityCache(imgCache *cache.Handle, cacheListTypes []string, cache
 	)
 
 	if cacheListVerbose {
-		fmt.Printf("%-24s %-22s %-16s %s\n", "NAME", "DATE CREATED", "SIZE", "TYPE")
+		fmt.Printf("%-24s %-22s %-16s %s\n", "NAME", "LAST ACCESS", "SIZE", "TYPE")
 	}
 
 	containersShown := false
@@ -133,7 +158,7 @@ func ListSingularityCache(imgCache *cache.Handle, cacheListTypes []string, cache
 			// are actually one level deeper
 			cacheDir, _ := cacheTypeToDir(imgCache, cacheType)
 			cacheDir = filepath.Join(cacheDir, "blobs")
-			blobsCount, blobsSize, err := listTypeCache(cacheListVerbose, cacheType, cacheDir)
+			blobsCount, blobsSize, err := listBlobCache(cacheListVerbose, cacheType, cacheDir)
 			if err != nil {
 				fmt.Print(err)
 				return err
@@ -144,7 +169,7 @@ func ListSingularityCache(imgCache *cache.Handle, cacheListTypes []string, cache
 			blobsShown = true
 		} else {
 			cacheDir, _ := cacheTypeToDir(imgCache, cacheType)
-			count, size, err := listTypeCache(cacheListVerbose, cacheType, cacheDir)
+			count, size, err := listTypeCache(imgCache, cacheListVerbose, cacheType, cacheDir)
 			if err != nil {
 				fmt.Print(err)
 				return err
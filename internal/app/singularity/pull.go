@@ -21,7 +21,6 @@ import (
 	"github.com/sylabs/singularity/internal/pkg/util/uri"
 	"github.com/sylabs/singularity/pkg/build/types"
 	shub "github.com/sylabs/singularity/pkg/client/shub"
-	"gopkg.in/cheggaaa/pb.v1"
 )
 
 var (
@@ -52,18 +51,25 @@ func PullShub(imgCache *cache.Handle, filePath string, shubRef string, noHTTPS b
 			return err
 		}
 	} else {
-		exists, err := imgCache.ShubImageExists(manifest.Commit, imageName)
+		f, err := imgCache.FillEntry(imagePath, func() (bool, error) {
+			return imgCache.ShubImageExists(manifest.Commit, imageName)
+		})
 		if err != nil {
-			return fmt.Errorf("unable to check if %v exists: %v", imagePath, err)
+			return err
 		}
-		if !exists {
+		if f != nil {
+			defer f.Close()
+
 			sylog.Infof("Downloading shub image")
-			go interruptCleanup(imagePath)
+			go interruptCleanup(f.Temp)
 
-			err := shub.DownloadImage(manifest, imagePath, shubRef, true, noHTTPS)
+			err := shub.DownloadImage(manifest, f.Temp, shubRef, true, noHTTPS)
 			if err != nil {
 				return err
 			}
+			if err := f.Commit(); err != nil {
+				return err
+			}
 		} else {
 			sylog.Infof("Use image from cache")
 		}
@@ -90,28 +96,6 @@ func PullShub(imgCache *cache.Handle, filePath string, shubRef string, noHTTPS b
 	return nil
 }
 
-// printProgress is called to display progress bar while downloading image from library.
-func printProgress(totalSize int64, r io.Reader, w io.Writer) error {
-	bar := pb.New64(totalSize).SetUnits(pb.U_BYTES)
-	bar.ShowTimeLeft = true
-	bar.ShowSpeed = true
-
-	// create proxy reader
-	bodyProgress := bar.NewProxyReader(r)
-
-	bar.Start()
-
-	// Write the body to file
-	_, err := io.Copy(w, bodyProgress)
-	if err != nil {
-		return err
-	}
-
-	bar.Finish()
-
-	return nil
-}
-
 // OrasPull will download the image specified by the provided oci reference and store
 // it at the location specified by file, it will use credentials if supplied
 func OrasPull(ctx context.Context, imgCache *cache.Handle, name, ref string, force bool, ociAuth *ocitypes.DockerAuthConfig) error {
@@ -123,30 +107,37 @@ func OrasPull(ctx context.Context, imgCache *cache.Handle, name, ref string, for
 	imageName := uri.GetName("oras:" + ref)
 
 	cacheImagePath := imgCache.OrasImage(sum, imageName)
-	exists, err := imgCache.OrasImageExists(sum, imageName)
-	if err == cache.ErrBadChecksum {
-		sylog.Warningf("Removing cached image: %s: cache could be corrupted", cacheImagePath)
-		err := os.Remove(cacheImagePath)
-		if err != nil {
-			return fmt.Errorf("unable to remove corrupted cache: %v", err)
+	f, err := imgCache.FillEntry(cacheImagePath, func() (bool, error) {
+		exists, err := imgCache.OrasImageExists(sum, imageName)
+		if err == cache.ErrBadChecksum {
+			// replaced by the image downloaded
+			sylog.Warningf("Replacing cached image: %s: cache could be corrupted", cacheImagePath)
+			return false, nil
 		}
-	} else if err != nil {
-		return fmt.Errorf("unable to check if %s exists: %v", cacheImagePath, err)
+		return exists, err
+	})
+	if err != nil {
+		return err
 	}
 
-	if !exists {
+	if f != nil {
+		defer f.Close()
+
 		sylog.Infof("Downloading image with ORAS")
-		go interruptCleanup(cacheImagePath)
+		go interruptCleanup(f.Temp)
 
-		if err := oras.DownloadImage(cacheImagePath, ref, ociAuth); err != nil {
+		if err := oras.DownloadImage(f.Temp, ref, ociAuth); err != nil {
 			return fmt.Errorf("unable to Download Image: %v", err)
 		}
 
-		if cacheFileHash, err := oras.ImageHash(cacheImagePath); err != nil {
+		if cacheFileHash, err := oras.ImageHash(f.Temp); err != nil {
 			return fmt.Errorf("error getting ImageHash: %v", err)
 		} else if cacheFileHash != sum {
 			return fmt.Errorf("cached file hash(%s) and expected hash(%s) does not match", cacheFileHash, sum)
 		}
+		if err := f.Commit(); err != nil {
+			return err
+		}
 	} else {
 		sylog.Infof("Using cached image")
 	}
@@ -195,17 +186,24 @@ func OciPull(ctx context.Context, imgCache *cache.Handle, name, imageURI, tmpDir
 		imgName := uri.GetName(imageURI)
 		cachedImgPath := imgCache.OciTempImage(sum, imgName)
 
-		exists, err := imgCache.OciTempExists(sum, imgName)
+		f, err := imgCache.FillEntry(cachedImgPath, func() (bool, error) {
+			return imgCache.OciTempExists(sum, imgName)
+		})
 		if err != nil {
-			return fmt.Errorf("unable to check if %s exists: %s", imgName, err)
+			return err
 		}
-		if !exists {
+		if f != nil {
+			defer f.Close()
+
 			sylog.Infof("Converting OCI blobs to SIF format")
-			go interruptCleanup(imgName)
+			go interruptCleanup(f.Temp)
 
-			if err := convertDockerToSIF(ctx, imgCache, imageURI, cachedImgPath, tmpDir, noHTTPS, noCleanUp, ociAuth); err != nil {
+			if err := convertDockerToSIF(ctx, imgCache, imageURI, f.Temp, tmpDir, noHTTPS, noCleanUp, ociAuth); err != nil {
 				return fmt.Errorf("while building SIF from layers: %v", err)
 			}
+			if err := f.Commit(); err != nil {
+				return err
+			}
 			sylog.Infof("Build complete: %s", name)
 		}
 
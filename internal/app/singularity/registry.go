@@ -14,6 +14,7 @@ import (
 
 	scs "github.com/sylabs/scs-library-client/client"
 	"github.com/sylabs/singularity/internal/pkg/client/cache"
+	"github.com/sylabs/singularity/internal/pkg/client/download"
 	"github.com/sylabs/singularity/internal/pkg/library"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/internal/pkg/util/fs"
@@ -60,6 +61,8 @@ func (l *Library) Pull(ctx context.Context, from, to, arch string) error {
 		return fmt.Errorf("could not get image info: %v", err)
 	}
 
+	var fill *cache.EntryFill
+
 	dst, tmpName, err := func() (string, string, error) {
 		dst := to
 		if !l.cache.IsDisabled() {
@@ -67,8 +70,22 @@ func (l *Library) Pull(ctx context.Context, from, to, arch string) error {
 			dst = l.cache.LibraryImage(imageMeta.Hash, imageName)
 
 			// here we can check if the file is already in
-			// the cache
-			if _, err := os.Stat(dst); err == nil {
+			// the cache, or in the system cache, another
+			// process downloading the same image is waited
+			// for and the cache checked again once it's done
+			var err error
+			fill, err = l.cache.FillEntry(dst, func() (bool, error) {
+				exists, err := l.cache.LibraryImageExists(imageMeta.Hash, imageName)
+				if err == cache.ErrBadChecksum {
+					// replaced by the image downloaded
+					return false, nil
+				}
+				return exists, err
+			})
+			if err != nil {
+				return "", "", err
+			}
+			if fill == nil {
 				// we have the file in the cache, return
 				// the same name for the final
 				// destination and the temporary
@@ -76,6 +93,13 @@ func (l *Library) Pull(ctx context.Context, from, to, arch string) error {
 				// necessary
 				return dst, dst, nil
 			}
+
+			// the entry lock is held, the download goes to a
+			// fixed location so that an interrupted download
+			// is resumed by the next pull
+			go interruptCleanup(fill.Temp)
+
+			return dst, fill.Temp, nil
 		}
 
 		tmpHandle, err := ioutil.TempFile(filepath.Dir(dst), filepath.Base(dst)+".")
@@ -96,6 +120,10 @@ func (l *Library) Pull(ctx context.Context, from, to, arch string) error {
 		return dst, tmpName, nil
 	}()
 
+	if fill != nil {
+		defer fill.Close()
+	}
+
 	if err != nil {
 		return fmt.Errorf("unable to obtain intermediate location for %s: %w", to, err)
 	}
@@ -112,7 +140,13 @@ func (l *Library) Pull(ctx context.Context, from, to, arch string) error {
 		}
 
 		sylog.Debugf("Renaming temporary file %s to %s", tmpName, dst)
-		os.Rename(tmpName, dst)
+		if fill != nil {
+			if err := fill.Commit(); err != nil {
+				return err
+			}
+		} else {
+			os.Rename(tmpName, dst)
+		}
 	}
 
 	// now we either have the image in the correct location (dst ==
@@ -144,7 +178,7 @@ func (l *Library) pullAndVerify(ctx context.Context, imgMeta *scs.Image, from, t
 	sylog.Infof("Downloading library image")
 	go interruptCleanup(to)
 
-	err := library.DownloadImage(ctx, l.client, to, arch, from, printProgress)
+	err := library.DownloadImage(ctx, l.client, to, arch, from, imgMeta.Hash, download.NewProgressBar())
 	if err != nil {
 		return fmt.Errorf("unable to download image: %v", err)
 	}
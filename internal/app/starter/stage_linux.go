@@ -6,12 +6,16 @@
 package starter
 
 import (
+	"encoding/json"
+	"fmt"
 	"net"
 	"os"
 
 	"github.com/sylabs/singularity/internal/pkg/runtime/engine"
 	starterConfig "github.com/sylabs/singularity/internal/pkg/runtime/engine/config/starter"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
+	"github.com/sylabs/singularity/internal/pkg/zygote"
+	"github.com/sylabs/singularity/pkg/runtime/engine/config"
 )
 
 // StageOne validates and prepares container configuration which is
@@ -28,17 +32,30 @@ func StageOne(sconfig *starterConfig.Config, e *engine.Engine) {
 		sylog.Fatalf("%s\n", err)
 	}
 
-	if err := sconfig.Write(e.Common); err != nil {
+	// forward configuration with the encoding received from CLI
+	data, err := config.Marshal(e.Common, e.Encoding)
+	if err != nil {
+		sylog.Fatalf("failed to marshal engine configuration: %s", err)
+	}
+	if err := sconfig.Write(data); err != nil {
 		sylog.Fatalf("%s", err)
 	}
 
 	os.Exit(0)
 }
 
-// StageTwo performs container execution.
-func StageTwo(masterSocket int, e *engine.Engine) {
+// StageTwo performs container execution. A non-nil zygoteRequest
+// means that the stage 2 process was forked by the container process
+// of an instance running in zygote mode to serve this launch request.
+func StageTwo(masterSocket int, zygoteRequest []byte, e *engine.Engine) {
 	sylog.Debugf("Entering stage 2\n")
 
+	if zygoteRequest != nil {
+		if err := applyZygoteRequest(zygoteRequest, e); err != nil {
+			sylog.Fatalf("%s", err)
+		}
+	}
+
 	// master socket allows communications between
 	// stage 2 and master process, typically used for
 	// synchronization or for sending state
@@ -64,3 +81,21 @@ func StageTwo(masterSocket int, e *engine.Engine) {
 		sylog.Fatalf("%s\n", err)
 	}
 }
+
+func applyZygoteRequest(b []byte, e *engine.Engine) error {
+	r := new(zygote.Request)
+	if err := json.Unmarshal(b, r); err != nil {
+		return fmt.Errorf("while decoding zygote request: %s", err)
+	}
+
+	obj, ok := e.Operations.(interface {
+		ZygoteRequest(*zygote.Request) error
+	})
+	if !ok {
+		return fmt.Errorf("%s engine doesn't support zygote mode", e.EngineName)
+	}
+	if err := obj.ZygoteRequest(r); err != nil {
+		return fmt.Errorf("while applying zygote request: %s", err)
+	}
+	return nil
+}
@@ -6,10 +6,15 @@
 package assemblers
 
 import (
+	"crypto/sha256"
 	"encoding/binary"
+	"encoding/hex"
+	"encoding/json"
 	"fmt"
+	"io"
 	"io/ioutil"
 	"os"
+	"path/filepath"
 	"regexp"
 	"runtime"
 	"strconv"
@@ -17,16 +22,18 @@ import (
 
 	uuid "github.com/satori/go.uuid"
 	"github.com/sylabs/sif/pkg/sif"
+	"github.com/sylabs/singularity/internal/pkg/prefetch"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/internal/pkg/util/machine"
 	"github.com/sylabs/singularity/pkg/build/types"
+	"github.com/sylabs/singularity/pkg/image"
 	"github.com/sylabs/singularity/pkg/image/packer"
 	"github.com/sylabs/singularity/pkg/util/crypt"
 )
 
 // SIFAssembler doesn't store anything.
 type SIFAssembler struct {
-	GzipFlag       bool
+	MksquashfsOpts []string
 	MksquashfsPath string
 }
 
@@ -35,7 +42,10 @@ type encryptionOptions struct {
 	plaintext []byte
 }
 
-func createSIF(path string, definition, ociConf []byte, squashfile string, encOpts *encryptionOptions, arch string) (err error) {
+func createSIF(path string, b *types.Bundle, squashfile string, overlayfiles []string, encOpts *encryptionOptions, arch string) (err error) {
+	definition := b.Recipe.Raw
+	ociConf := b.JSONObjects[types.OCIConfigJSON]
+
 	// general info for the new SIF file creation
 	cinfo := sif.CreateInfo{
 		Pathname:   path,
@@ -71,6 +81,29 @@ func createSIF(path string, definition, ociConf []byte, squashfile string, encOp
 		cinfo.InputDescr = append(cinfo.InputDescr, ociInput)
 	}
 
+	if b.Opts.PrefetchManifest != "" {
+		m, err := prefetch.Load(b.Opts.PrefetchManifest)
+		if err != nil {
+			return err
+		}
+		data, err := json.Marshal(m)
+		if err != nil {
+			return fmt.Errorf("while encoding prefetch manifest: %s", err)
+		}
+		sylog.Verbosef("Adding prefetch manifest listing %d files", len(m.Files))
+
+		prefetchInput := sif.DescriptorInput{
+			Datatype: sif.DataGenericJSON,
+			Groupid:  sif.DescrDefaultGroup,
+			Link:     sif.DescrUnusedLink,
+			Data:     data,
+			Fname:    prefetch.DescriptorName,
+		}
+		prefetchInput.Size = int64(len(data))
+
+		cinfo.InputDescr = append(cinfo.InputDescr, prefetchInput)
+	}
+
 	// data we need to create a system partition descriptor
 	parinput := sif.DescriptorInput{
 		Datatype: sif.DataPartition,
@@ -108,6 +141,37 @@ func createSIF(path string, definition, ociConf []byte, squashfile string, encOp
 	// add this descriptor input element to the list
 	cinfo.InputDescr = append(cinfo.InputDescr, parinput)
 
+	// overlay partitions are stacked in order at runtime, the last
+	// one being the upper one
+	for _, overlayfile := range overlayfiles {
+		ovinput := sif.DescriptorInput{
+			Datatype: sif.DataPartition,
+			Groupid:  sif.DescrDefaultGroup,
+			Link:     sif.DescrUnusedLink,
+			Fname:    overlayfile,
+		}
+		ofp, err := os.Open(ovinput.Fname)
+		if err != nil {
+			return fmt.Errorf("while opening overlay partition file: %s", err)
+		}
+
+		defer ofp.Close()
+
+		ofi, err := ofp.Stat()
+		if err != nil {
+			return fmt.Errorf("while calling stat on overlay partition file: %s", err)
+		}
+
+		ovinput.Fp = ofp
+		ovinput.Size = ofi.Size()
+
+		if err := ovinput.SetPartExtra(sif.FsSquash, sif.PartOverlay, sif.GetSIFArch(arch)); err != nil {
+			return err
+		}
+
+		cinfo.InputDescr = append(cinfo.InputDescr, ovinput)
+	}
+
 	if encOpts != nil {
 		data, err := crypt.EncryptKey(encOpts.keyInfo, encOpts.plaintext)
 		if err != nil {
@@ -173,19 +237,54 @@ func (a *SIFAssembler) Assemble(b *types.Bundle, path string) error {
 	if syscall.Getuid() != 0 {
 		flags = append(flags, "-all-root")
 	}
-	// specify compression if needed
-	if a.GzipFlag {
-		flags = append(flags, "-comp", "gzip")
-	}
+	flags = append(flags, a.MksquashfsOpts...)
 
-	arch := machine.ArchFromContainer(b.RootfsPath)
+	var arch string
+	if b.Layers != nil {
+		arch = b.Layers.Arch
+	} else {
+		arch = machine.ArchFromContainer(b.RootfsPath)
+	}
 	if arch == "" {
 		sylog.Infof("Architecture not recognized, use native")
 		arch = runtime.GOARCH
 	}
 	sylog.Verbosef("Set SIF container architecture to %s", arch)
 
-	if err := s.Create([]string{b.RootfsPath}, fsPath, flags); err != nil {
+	if b.Opts.StartupOrder != "" && b.Base != nil {
+		sylog.Infof("Ordering files read at startup, creating a full SIF image")
+	} else if b.Base != nil && b.Opts.EncryptionKeyInfo == nil {
+		done, err := a.assembleIncremental(b, path, flags, arch)
+		if err != nil || done {
+			return err
+		}
+	}
+
+	if b.Opts.Layered {
+		switch {
+		case b.Layers == nil:
+			sylog.Warningf("Image layers were unpacked, creating a SIF image with a single root filesystem partition")
+		case b.Opts.EncryptionKeyInfo != nil:
+			sylog.Warningf("Encrypted images can't be layered, creating a SIF image with a single root filesystem partition")
+		default:
+			return a.assembleLayered(b, path, flags, arch)
+		}
+	}
+
+	if b.Layers != nil {
+		sylog.Debugf("Converting image layers directly to squashfs")
+		err = s.CreateFromLayers(b.Layers, b.RootfsPath, fsPath, flags)
+	} else {
+		if b.Opts.StartupOrder != "" {
+			sortFile, err := startupSortFile(b)
+			if err != nil {
+				return err
+			}
+			flags = append(flags, "-sort", sortFile)
+		}
+		err = s.Create([]string{b.RootfsPath}, fsPath, flags)
+	}
+	if err != nil {
 		return fmt.Errorf("while creating squashfs: %v", err)
 	}
 
@@ -219,10 +318,334 @@ func (a *SIFAssembler) Assemble(b *types.Bundle, path string) error {
 
 	}
 
-	err = createSIF(path, b.Recipe.Raw, b.JSONObjects[types.OCIConfigJSON], fsPath, encOpts, arch)
+	err = createSIF(path, b, fsPath, nil, encOpts, arch)
+	if err != nil {
+		return fmt.Errorf("while creating SIF: %v", err)
+	}
+
+	return nil
+}
+
+// assembleIncremental creates a SIF image from the root filesystem partition
+// of the base image and an overlay partition containing the files added or
+// changed since its extraction. Squashfs filesystems can't be updated in
+// place, mksquashfs append mode adds files but doesn't replace nor remove
+// them, so the changed files are packed in a separate partition applied
+// as an overlay at runtime. It returns false when a full build is required.
+func (a *SIFAssembler) assembleIncremental(b *types.Bundle, path string, flags []string, arch string) (bool, error) {
+	diff, err := b.Base.Manifest.Diff(b.RootfsPath)
+	if err != nil {
+		return false, err
+	}
+	if diff.Removed > 0 {
+		sylog.Infof("Files removed since %s extraction, creating a full SIF image", b.Base.Path)
+		return false, nil
+	}
+
+	base, err := image.Init(b.Base.Path, false)
+	if err != nil {
+		return false, fmt.Errorf("while opening base image: %v", err)
+	}
+	defer base.File.Close()
+
+	if base.Type != image.SIF || base.Partitions[0].Type != image.SQUASHFS {
+		return false, fmt.Errorf("base image %s is not a SIF image with a squashfs root filesystem", b.Base.Path)
+	}
+
+	// copy the root filesystem partition from the base image
+	f, err := ioutil.TempFile(b.TmpDir, "squashfs-")
+	if err != nil {
+		return false, fmt.Errorf("while creating temporary file for squashfs: %v", err)
+	}
+	defer os.Remove(f.Name())
+
+	reader, err := image.NewPartitionReader(base, "", 0)
+	if err == nil {
+		_, err = io.Copy(f, reader)
+	}
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err != nil {
+		return false, fmt.Errorf("while copying base image root filesystem: %v", err)
+	}
+
+	var overlays []string
+
+	if len(diff.Changed) > 0 {
+		staging, err := ioutil.TempDir(b.TmpDir, "overlay-")
+		if err != nil {
+			return false, fmt.Errorf("while creating overlay staging directory: %v", err)
+		}
+		defer os.RemoveAll(staging)
+
+		if err := stageChanges(b.RootfsPath, staging, diff.Changed); err != nil {
+			sylog.Infof("Could not stage changed files (%s), creating a full SIF image", err)
+			return false, nil
+		}
+
+		o, err := ioutil.TempFile(b.TmpDir, "overlay-")
+		if err != nil {
+			return false, fmt.Errorf("while creating temporary file for overlay squashfs: %v", err)
+		}
+		overlayPath := o.Name()
+		o.Close()
+		defer os.Remove(overlayPath)
+		overlays = append(overlays, overlayPath)
+
+		s := packer.NewSquashfs()
+		s.MksquashfsPath = a.MksquashfsPath
+
+		if err := s.Create([]string{staging}, overlayPath, flags); err != nil {
+			return false, fmt.Errorf("while creating overlay squashfs: %v", err)
+		}
+	}
+
+	sylog.Infof("Packing %d changed files over %s root filesystem", len(diff.Changed), b.Base.Path)
+
+	err = createSIF(path, b, f.Name(), overlays, nil, arch)
+	if err != nil {
+		return false, fmt.Errorf("while creating SIF: %v", err)
+	}
+	return true, nil
+}
+
+// startupSortFile creates a mksquashfs sort file placing first the files
+// read at container startup, listed by the prefetch manifest set by the
+// startup order option or guessed from the root filesystem with "auto".
+func startupSortFile(b *types.Bundle) (string, error) {
+	var files []string
+
+	if b.Opts.StartupOrder == "auto" {
+		files = packer.StartupFiles(b.RootfsPath)
+	} else {
+		m, err := prefetch.Load(b.Opts.StartupOrder)
+		if err != nil {
+			return "", err
+		}
+		files = m.Files
+	}
+
+	f, err := ioutil.TempFile(b.TmpDir, "sort-")
+	if err != nil {
+		return "", fmt.Errorf("while creating temporary file for sort file: %v", err)
+	}
+	f.Close()
+
+	n, err := packer.CreateSortFile(f.Name(), b.RootfsPath, files)
+	if err != nil {
+		return "", err
+	}
+	sylog.Verbosef("Placing %d files read at startup first in the image", n)
+
+	return f.Name(), nil
+}
+
+// layerImageName is the name of squashfs filesystems in the layer cache.
+const layerImageName = "layers.sqfs"
+
+// assembleLayered creates a SIF image from the squashfs filesystems of
+// the image layer groups, the first one as root filesystem partition and
+// the others as overlay partitions, topped by an overlay partition with
+// the root filesystem entries added by the build. Groups are converted
+// once and cached by the digests of their layers, so that images sharing
+// base layers reuse their filesystems.
+func (a *SIFAssembler) assembleLayered(b *types.Bundle, path string, flags []string, arch string) error {
+	s := packer.NewSquashfs()
+	s.MksquashfsPath = a.MksquashfsPath
+
+	groups := b.Layers.Groups()
+	parts := make([]string, 0, len(groups)+1)
+
+	for i, start := range groups {
+		end := b.Layers.Len()
+		if i+1 < len(groups) {
+			end = groups[i+1]
+		}
+		part, temporary, err := a.layerGroup(s, b, start, end, flags)
+		if err != nil {
+			return fmt.Errorf("while converting layers %d to %d: %v", start+1, end, err)
+		}
+		if temporary {
+			defer os.Remove(part)
+		}
+		parts = append(parts, part)
+	}
+
+	f, err := ioutil.TempFile(b.TmpDir, "overlay-")
+	if err != nil {
+		return fmt.Errorf("while creating temporary file for overlay squashfs: %v", err)
+	}
+	f.Close()
+	defer os.Remove(f.Name())
+
+	if err := s.CreateRootfsLayer(b.Layers, b.RootfsPath, f.Name(), flags); err != nil {
+		return fmt.Errorf("while creating overlay squashfs: %v", err)
+	}
+	parts = append(parts, f.Name())
+
+	sylog.Infof("Packing %d image layers in %d partitions", b.Layers.Len(), len(parts))
+
+	err = createSIF(path, b, parts[0], parts[1:], nil, arch)
 	if err != nil {
 		return fmt.Errorf("while creating SIF: %v", err)
 	}
+	return nil
+}
+
+// layerGroup returns the path of the squashfs filesystem of the image
+// layers from start to end excluded, taken from the layer cache or
+// converted. The returned boolean is true when the filesystem is a
+// temporary file to remove once used.
+func (a *SIFAssembler) layerGroup(s packer.Squashfs, b *types.Bundle, start, end int, flags []string) (string, bool, error) {
+	convert := func(dest string) error {
+		g, err := b.Layers.Group(start, end)
+		if err != nil {
+			return err
+		}
+		return s.CreateFromLayers(g, "", dest, flags)
+	}
+
+	c := b.Opts.ImgCache
+	if c == nil || c.IsDisabled() || len(b.Layers.Digests) != b.Layers.Len() {
+		f, err := ioutil.TempFile(b.TmpDir, "squashfs-")
+		if err != nil {
+			return "", false, fmt.Errorf("while creating temporary file for squashfs: %v", err)
+		}
+		f.Close()
+		if err := convert(f.Name()); err != nil {
+			os.Remove(f.Name())
+			return "", false, err
+		}
+		return f.Name(), true, nil
+	}
+
+	sum := layerGroupSum(b.Layers, start, end, flags)
+	path := c.LayerImage(sum, layerImageName)
+
+	// another build converting the same layers is waited for, the
+	// layers are converted to a temporary file moved in place once
+	// complete so that an entry found is never a partial filesystem
+	f, err := c.FillEntry(path, func() (bool, error) {
+		return c.LayerImageExists(sum, layerImageName)
+	})
+	if err != nil {
+		return "", false, err
+	}
+	if f == nil {
+		sylog.Verbosef("Using cached squashfs filesystem of layers %d to %d", start+1, end)
+		return path, false, nil
+	}
+	defer f.Close()
+
+	if err := convert(f.Temp); err != nil {
+		return "", false, err
+	}
+	if err := f.Commit(); err != nil {
+		return "", false, fmt.Errorf("while caching squashfs: %v", err)
+	}
+	return path, false, nil
+}
+
+// layerGroupSum returns the layer cache key of the layers from start to
+// end excluded, derived from their digests and from the conversion
+// options. The number of mksquashfs processors doesn't change the
+// filesystem and is left out.
+func layerGroupSum(l *packer.Layers, start, end int, flags []string) string {
+	h := sha256.New()
+	for _, d := range l.Digests[start:end] {
+		fmt.Fprintln(h, d)
+	}
+	fmt.Fprintln(h, l.FixPerms, l.Rootless)
+	for i := 0; i < len(flags); i++ {
+		if flags[i] == "-processors" {
+			i++
+			continue
+		}
+		fmt.Fprintln(h, flags[i])
+	}
+	return hex.EncodeToString(h.Sum(nil))
+}
+
+// stageChanges populates the staging directory with hard links to the
+// changed entries of rootfs, directories are created with the rootfs
+// directory attributes. It fails if rootfs and staging directories are
+// not on the same filesystem.
+func stageChanges(rootfs, staging string, changed []string) error {
+	var dirs []string
+
+	mkdir := func(path string) error {
+		fi, err := os.Lstat(filepath.Join(rootfs, path))
+		if err != nil {
+			return err
+		}
+		dst := filepath.Join(staging, path)
+		if path != "." {
+			if err := os.Mkdir(dst, 0700); err != nil {
+				return err
+			}
+		}
+		dirs = append(dirs, path)
+		st := fi.Sys().(*syscall.Stat_t)
+		if syscall.Getuid() == 0 {
+			return os.Lchown(dst, int(st.Uid), int(st.Gid))
+		}
+		return nil
+	}
+
+	created := map[string]bool{".": true}
+	if err := mkdir("."); err != nil {
+		return err
+	}
+
+	for _, path := range changed {
+		// parent directories are always staged to keep the
+		// hierarchy, changed or not
+		parent := filepath.Dir(path)
+		var missing []string
+		for !created[parent] {
+			missing = append([]string{parent}, missing...)
+			parent = filepath.Dir(parent)
+		}
+		for _, dir := range missing {
+			if err := mkdir(dir); err != nil {
+				return err
+			}
+			created[dir] = true
+		}
+
+		if created[path] {
+			continue
+		}
+		fi, err := os.Lstat(filepath.Join(rootfs, path))
+		if err != nil {
+			return err
+		}
+		if fi.IsDir() {
+			if err := mkdir(path); err != nil {
+				return err
+			}
+			created[path] = true
+		} else if err := os.Link(filepath.Join(rootfs, path), filepath.Join(staging, path)); err != nil {
+			return err
+		}
+	}
+
+	// set directories permissions and times once populated,
+	// deepest first
+	for i := len(dirs) - 1; i >= 0; i-- {
+		fi, err := os.Lstat(filepath.Join(rootfs, dirs[i]))
+		if err != nil {
+			return err
+		}
+		dst := filepath.Join(staging, dirs[i])
+		if err := os.Chmod(dst, fi.Mode()); err != nil {
+			return err
+		}
+		if err := os.Chtimes(dst, fi.ModTime(), fi.ModTime()); err != nil {
+			return err
+		}
+	}
 
 	return nil
 }
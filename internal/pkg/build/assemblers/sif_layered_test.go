@@ -0,0 +1,34 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package assemblers
+
+import (
+	"testing"
+
+	"github.com/sylabs/singularity/pkg/image/packer"
+)
+
+func TestLayerGroupSum(t *testing.T) {
+	l := &packer.Layers{Digests: []string{"sha256:aaaa", "sha256:bbbb", "sha256:cccc"}}
+	flags := []string{"-noappend", "-processors", "4"}
+
+	sum := layerGroupSum(l, 0, 2, flags)
+
+	if s := layerGroupSum(l, 0, 2, []string{"-noappend", "-processors", "8"}); s != sum {
+		t.Errorf("number of processors changed the layer cache key")
+	}
+	if s := layerGroupSum(l, 1, 3, flags); s == sum {
+		t.Errorf("same layer cache key for different layers")
+	}
+	if s := layerGroupSum(l, 0, 2, append(flags, "-all-root")); s == sum {
+		t.Errorf("same layer cache key for different mksquashfs options")
+	}
+
+	l.FixPerms = true
+	if s := layerGroupSum(l, 0, 2, flags); s == sum {
+		t.Errorf("same layer cache key with fixed permissions")
+	}
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package assemblers
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+func TestStageChanges(t *testing.T) {
+	dir, err := ioutil.TempDir("", "stage-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	rootfs := filepath.Join(dir, "rootfs")
+	staging := filepath.Join(dir, "staging")
+
+	for _, f := range []string{"usr/bin/tool", "usr/lib/lib.so", "etc/hosts", "opt/new/file"} {
+		path := filepath.Join(rootfs, f)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			t.Fatal(err)
+		}
+		if err := ioutil.WriteFile(path, []byte(f), 0644); err != nil {
+			t.Fatal(err)
+		}
+	}
+	if err := os.Symlink("tool", filepath.Join(rootfs, "usr/bin/link")); err != nil {
+		t.Fatal(err)
+	}
+	if err := os.Chmod(filepath.Join(rootfs, "usr/bin"), 0555); err != nil {
+		t.Fatal(err)
+	}
+	defer os.Chmod(filepath.Join(rootfs, "usr/bin"), 0755)
+
+	if err := os.Mkdir(staging, 0700); err != nil {
+		t.Fatal(err)
+	}
+
+	changed := []string{"opt", "opt/new", "opt/new/file", "usr/bin/link", "usr/bin/tool"}
+	if err := stageChanges(rootfs, staging, changed); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	defer os.Chmod(filepath.Join(staging, "usr/bin"), 0755)
+
+	for _, f := range changed {
+		if _, err := os.Lstat(filepath.Join(staging, f)); err != nil {
+			t.Errorf("%s not staged: %s", f, err)
+		}
+	}
+	for _, f := range []string{"etc", "usr/lib"} {
+		if _, err := os.Lstat(filepath.Join(staging, f)); err == nil {
+			t.Errorf("unchanged %s staged", f)
+		}
+	}
+
+	fi, err := os.Stat(filepath.Join(staging, "usr/bin"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if fi.Mode().Perm() != 0555 {
+		t.Errorf("unexpected staged directory permissions %o", fi.Mode().Perm())
+	}
+	if link, _ := os.Readlink(filepath.Join(staging, "usr/bin/link")); link != "tool" {
+		t.Errorf("symlink not staged as is")
+	}
+}
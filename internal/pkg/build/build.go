@@ -8,10 +8,10 @@ package build
 import (
 	"context"
 	"fmt"
-	"io/ioutil"
 	"os"
 	"os/signal"
 	"path/filepath"
+	"strconv"
 	"strings"
 	"syscall"
 
@@ -23,6 +23,7 @@ import (
 	"github.com/sylabs/singularity/internal/pkg/build/assemblers"
 	"github.com/sylabs/singularity/internal/pkg/build/files"
 	"github.com/sylabs/singularity/internal/pkg/build/sources"
+	"github.com/sylabs/singularity/internal/pkg/buildcfg"
 	"github.com/sylabs/singularity/internal/pkg/runtime/engine/config/oci"
 	imgbuildConfig "github.com/sylabs/singularity/internal/pkg/runtime/engine/imgbuild/config"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
@@ -93,6 +94,14 @@ func newBuild(defs []types.Definition, conf Config) (*Build, error) {
 		conf.Format = "sandbox"
 	}
 
+	if conf.Opts.DownloadConcurrency == 0 {
+		if c, err := config.ParseFile(buildcfg.SINGULARITY_CONF_FILE); err == nil {
+			conf.Opts.DownloadConcurrency = c.DownloadConcurrency
+		} else {
+			sylog.Debugf("Downloading image layers one at a time: %s", err)
+		}
+	}
+
 	b := &Build{
 		Conf: conf,
 	}
@@ -194,12 +203,19 @@ func newBuild(defs []types.Definition, conf Config) (*Build, error) {
 			return nil, fmt.Errorf("while searching for mksquashfs: %v", err)
 		}
 
-		flag, err := ensureGzipComp(b.stages[lastStageIndex].b.TmpDir, mksquashfsPath)
+		opts, caps, err := mksquashfsOptions(mksquashfsPath)
 		if err != nil {
-			return nil, fmt.Errorf("while ensuring correct compression algorithm: %v", err)
+			return nil, fmt.Errorf("while setting mksquashfs options: %v", err)
+		}
+		// image layers can be streamed to mksquashfs when nothing
+		// runs in or copies to the root filesystem, files are ordered
+		// from the unpacked root filesystem
+		last := b.stages[lastStageIndex].b
+		if caps.Tar && !conf.Opts.Update && conf.Opts.StartupOrder == "" && !engineRequired(last.Recipe) && len(last.Recipe.CustomData) == 0 {
+			last.Opts.StreamLayers = true
 		}
 		b.stages[lastStageIndex].a = &assemblers.SIFAssembler{
-			GzipFlag:       flag,
+			MksquashfsOpts: opts,
 			MksquashfsPath: mksquashfsPath,
 		}
 	default:
@@ -209,72 +225,44 @@ func newBuild(defs []types.Definition, conf Config) (*Build, error) {
 	return b, nil
 }
 
-// ensureGzipComp builds dummy squashfs images and checks the type of compression used
-// to deduce if we can successfully build with gzip compression. It returns an error
-// if we cannot and a boolean to indicate if the `-comp` flag is needed to specify
-// gzip compression when the final squashfs is built
-func ensureGzipComp(tmpdir, mksquashfsPath string) (bool, error) {
-	sylog.Debugf("Ensuring gzip compression for mksquashfs")
-
-	var err error
-	s := packer.NewSquashfs()
-	s.MksquashfsPath = mksquashfsPath
-
-	srcf, err := ioutil.TempFile(tmpdir, "squashfs-gzip-comp-test-src")
+// mksquashfsOptions returns the mksquashfs processors, block size and
+// compressor options set in singularity.conf, along with mksquashfs
+// capabilities cached across builds. The compressor option is only
+// passed when it's not the mksquashfs default compressor.
+func mksquashfsOptions(mksquashfsPath string) ([]string, *packer.Capabilities, error) {
+	c, err := config.ParseFile(buildcfg.SINGULARITY_CONF_FILE)
 	if err != nil {
-		return false, fmt.Errorf("while creating temporary file for squashfs source: %v", err)
-	}
-
-	srcf.Write([]byte("Test File Content"))
-	srcf.Close()
-
-	f, err := ioutil.TempFile(tmpdir, "squashfs-gzip-comp-test-")
-	if err != nil {
-		return false, fmt.Errorf("while creating temporary file for squashfs: %v", err)
-	}
-	f.Close()
-
-	flags := []string{"-noappend"}
-	if err := s.Create([]string{srcf.Name()}, f.Name(), flags); err != nil {
-		return false, fmt.Errorf("while creating squashfs: %v", err)
+		return nil, nil, fmt.Errorf("unable to parse singularity.conf file: %s", err)
 	}
 
-	content, err := ioutil.ReadFile(f.Name())
-	if err != nil {
-		return false, fmt.Errorf("while reading test squashfs: %v", err)
-	}
+	s := packer.NewSquashfs()
+	s.MksquashfsPath = mksquashfsPath
 
-	comp, err := image.GetSquashfsComp(content)
+	caps, err := s.Capabilities()
 	if err != nil {
-		return false, fmt.Errorf("could not verify squashfs compression type: %v", err)
-	}
-
-	if comp == "gzip" {
-		sylog.Debugf("Gzip compression by default ensured")
-		return false, nil
+		return nil, nil, err
 	}
 
-	flags = []string{"-noappend", "-comp", "gzip"}
-	if err := s.Create([]string{srcf.Name()}, f.Name(), flags); err != nil {
-		return false, fmt.Errorf("could not build squashfs with required gzip compression")
-	}
+	var opts []string
 
-	content, err = ioutil.ReadFile(f.Name())
-	if err != nil {
-		return false, fmt.Errorf("while reading test squashfs: %v", err)
+	if c.MksquashfsComp != caps.DefaultComp {
+		if !caps.HasCompressor(c.MksquashfsComp) {
+			return nil, nil, fmt.Errorf("%s doesn't support %s compression", mksquashfsPath, c.MksquashfsComp)
+		}
+		sylog.Debugf("Using %s compression with -comp flag", c.MksquashfsComp)
+		opts = append(opts, "-comp", c.MksquashfsComp)
 	}
-
-	comp, err = image.GetSquashfsComp(content)
-	if err != nil {
-		return false, fmt.Errorf("could not verify squashfs compression type: %v", err)
+	if c.MksquashfsProcs > 0 {
+		opts = append(opts, "-processors", strconv.FormatUint(uint64(c.MksquashfsProcs), 10))
 	}
-
-	if comp == "gzip" {
-		sylog.Debugf("Gzip compression with -comp flag ensured")
-		return true, nil
+	if bs := c.MksquashfsBlockSize; bs > 0 {
+		if bs < 4 || bs > 1024 || bs&(bs-1) != 0 {
+			return nil, nil, fmt.Errorf("invalid mksquashfs block size %d: must be a power of two between 4 and 1024", bs)
+		}
+		opts = append(opts, "-b", fmt.Sprintf("%dK", bs))
 	}
 
-	return false, fmt.Errorf("could not build squashfs with required gzip compression")
+	return opts, caps, nil
 }
 
 // cleanUp removes remnants of build from file system unless NoCleanUp is specified.
@@ -83,26 +83,38 @@ func (cp *LibraryConveyorPacker) Get(ctx context.Context, b *types.Bundle) (err
 
 		sylog.Infof("Downloading library image to tmp cache: %s", imagePath)
 
-		if err = library.DownloadImageNoProgress(ctx, libraryClient, imagePath, runtime.GOARCH, imageRef); err != nil {
+		if err = library.DownloadImageNoProgress(ctx, libraryClient, imagePath, runtime.GOARCH, imageRef, libraryImage.Hash); err != nil {
 			return fmt.Errorf("unable to download image: %v", err)
 		}
 	} else {
 		imagePath = b.Opts.ImgCache.LibraryImage(libraryImage.Hash, imageName)
 
-		if exists, err := b.Opts.ImgCache.LibraryImageExists(libraryImage.Hash, imageName); err != nil {
-			return fmt.Errorf("unable to check if %v exists: %v", imagePath, err)
-		} else if !exists {
+		// the entry is filled once, another process downloading the
+		// same image is waited for and its image used
+		err := func() error {
+			f, err := b.Opts.ImgCache.FillEntry(imagePath, func() (bool, error) {
+				return b.Opts.ImgCache.LibraryImageExists(libraryImage.Hash, imageName)
+			})
+			if err != nil || f == nil {
+				return err
+			}
+			defer f.Close()
+
 			sylog.Infof("Downloading library image")
 
-			if err := library.DownloadImageNoProgress(ctx, libraryClient, imagePath, runtime.GOARCH, imageRef); err != nil {
+			if err := library.DownloadImageNoProgress(ctx, libraryClient, f.Temp, runtime.GOARCH, imageRef, libraryImage.Hash); err != nil {
 				return fmt.Errorf("unable to download image: %v", err)
 			}
 
-			if cacheFileHash, err := client.ImageHash(imagePath); err != nil {
+			if cacheFileHash, err := client.ImageHash(f.Temp); err != nil {
 				return fmt.Errorf("error getting image hash: %v", err)
 			} else if cacheFileHash != libraryImage.Hash {
 				return fmt.Errorf("cached file hash(%s) and expected Hash(%s) does not match", cacheFileHash, libraryImage.Hash)
 			}
+			return f.Commit()
+		}()
+		if err != nil {
+			return err
 		}
 	}
 
@@ -122,10 +122,12 @@ func (cp *OCIConveyorPacker) Get(ctx context.Context, b *sytypes.Bundle) (err er
 
 	if !cp.b.Opts.NoCache {
 		// Grab the modified source ref from the cache
-		cp.srcRef, err = ociclient.ConvertReference(ctx, b.Opts.ImgCache, cp.srcRef, cp.sysCtx)
+		ref, err := ociclient.ConvertReference(ctx, b.Opts.ImgCache, cp.srcRef, cp.sysCtx)
 		if err != nil {
 			return err
 		}
+		ref.Concurrency = int(b.Opts.DownloadConcurrency)
+		cp.srcRef = ref
 	}
 
 	// To to do the RootFS extraction we also have to have a location that
@@ -14,12 +14,14 @@ import (
 	"os"
 	"os/exec"
 	"path/filepath"
+	"syscall"
 	"testing"
 
 	"github.com/sylabs/singularity/internal/pkg/build/sources"
 	"github.com/sylabs/singularity/internal/pkg/client/cache"
 	testCache "github.com/sylabs/singularity/internal/pkg/test/tool/cache"
 	"github.com/sylabs/singularity/pkg/build/types"
+	"github.com/sylabs/singularity/pkg/image/packer"
 	useragent "github.com/sylabs/singularity/pkg/util/user-agent"
 )
 
@@ -276,6 +278,120 @@ func TestOCIPacker(t *testing.T) {
 	}
 }
 
+// diskUsage returns the disk space used by the files below path.
+func diskUsage(path string) (size int64) {
+	filepath.Walk(path, func(_ string, fi os.FileInfo, err error) error {
+		if err == nil {
+			size += fi.Sys().(*syscall.Stat_t).Blocks * 512
+		}
+		return nil
+	})
+	return size
+}
+
+// BenchmarkOCIToSquashfs compares the conversion of an OCI image to
+// squashfs through an unpacked root filesystem with the direct layers
+// conversion. The image is docker://alpine unless set with the
+// SINGULARITY_BENCH_OCI_IMAGE environment variable, the peak disk
+// usage of the OCI layout, root filesystem and squashfs image is
+// reported along with the conversion time.
+func BenchmarkOCIToSquashfs(b *testing.B) {
+	if testing.Short() {
+		b.SkipNow()
+	}
+
+	s := packer.NewSquashfs()
+	if !s.HasMksquashfs() {
+		b.Skip("mksquashfs not found, skipping")
+	}
+	caps, err := s.Capabilities()
+	if err != nil {
+		b.Fatalf("failed to get mksquashfs capabilities: %s", err)
+	}
+
+	uri := os.Getenv("SINGULARITY_BENCH_OCI_IMAGE")
+	if uri == "" {
+		uri = dockerURI
+	}
+
+	dir, err := ioutil.TempDir("", "image_cache-")
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+	imgCache, err := cache.NewHandle(cache.Config{BaseDir: dir})
+	if err != nil {
+		b.Fatalf("failed to create an image cache handle: %s", err)
+	}
+
+	flags := []string{"-noappend"}
+	if os.Getuid() != 0 {
+		flags = append(flags, "-all-root")
+	}
+
+	for _, stream := range []bool{false, true} {
+		name := "unpack"
+		if stream {
+			name = "stream"
+		}
+
+		b.Run(name, func(b *testing.B) {
+			if stream && !caps.Tar {
+				b.Skip("mksquashfs doesn't support tar input, skipping")
+			}
+
+			var peak int64
+
+			for i := 0; i < b.N; i++ {
+				b.StopTimer()
+				bundle, err := types.NewBundle(filepath.Join(os.TempDir(), "sbuild-oci"), os.TempDir())
+				if err != nil {
+					b.Fatalf("failed to create new bundle: %s", err)
+				}
+				bundle.Recipe, err = types.NewDefinitionFromURI(uri)
+				if err != nil {
+					b.Fatalf("unable to parse URI %s: %v\n", uri, err)
+				}
+				bundle.Opts.ImgCache = imgCache
+				bundle.Opts.StreamLayers = stream
+
+				cp := &sources.OCIConveyorPacker{}
+				if err := cp.Get(context.Background(), bundle); err != nil {
+					cp.CleanUp()
+					b.Fatalf("failed to Get from %s: %v\n", uri, err)
+				}
+				b.StartTimer()
+
+				_, err = cp.Pack(context.Background())
+				dest := filepath.Join(bundle.TmpDir, "image.sqfs")
+				if err == nil && bundle.Layers != nil {
+					err = s.CreateFromLayers(bundle.Layers, bundle.RootfsPath, dest, flags)
+				} else if err == nil {
+					err = s.Create([]string{bundle.RootfsPath}, dest, flags)
+				}
+
+				b.StopTimer()
+				if err != nil {
+					cp.CleanUp()
+					b.Fatalf("failed to convert %s: %v", uri, err)
+				}
+				if stream && bundle.Layers == nil {
+					cp.CleanUp()
+					b.Fatalf("%s layers can't be converted directly", uri)
+				}
+				// the OCI layout includes the squashfs image
+				if usage := diskUsage(bundle.TmpDir) + diskUsage(bundle.RootfsPath); usage > peak {
+					peak = usage
+				}
+				cp.CleanUp()
+				b.StartTimer()
+			}
+
+			b.ReportMetric(float64(peak), "peak-disk-bytes")
+		})
+	}
+}
+
 func getTestTar(url string) (path string, err error) {
 	dl, err := ioutil.TempFile("", "oci-test")
 	if err != nil {
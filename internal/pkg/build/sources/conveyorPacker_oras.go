@@ -37,20 +37,32 @@ func (cp *OrasConveyorPacker) Get(ctx context.Context, b *types.Bundle) (err err
 
 	imageName := uri.GetName(fullRef)
 	cacheImagePath := b.Opts.ImgCache.OrasImage(sum, imageName)
-	if exists, err := b.Opts.ImgCache.OrasImageExists(sum, imageName); err != nil {
-		return fmt.Errorf("unable to check if %v exists: %v", cacheImagePath, err)
-	} else if !exists {
+	// the entry is filled once, another process downloading the same
+	// image is waited for and its image used
+	err = func() error {
+		f, err := b.Opts.ImgCache.FillEntry(cacheImagePath, func() (bool, error) {
+			return b.Opts.ImgCache.OrasImageExists(sum, imageName)
+		})
+		if err != nil || f == nil {
+			return err
+		}
+		defer f.Close()
+
 		sylog.Infof("Downloading image with ORAS")
 
-		if err := oras.DownloadImage(cacheImagePath, ref, b.Opts.DockerAuthConfig); err != nil {
+		if err := oras.DownloadImage(f.Temp, ref, b.Opts.DockerAuthConfig); err != nil {
 			return fmt.Errorf("unable to Download Image: %v", err)
 		}
 
-		if cacheFileHash, err := oras.ImageHash(cacheImagePath); err != nil {
+		if cacheFileHash, err := oras.ImageHash(f.Temp); err != nil {
 			return fmt.Errorf("error getting ImageHash: %v", err)
 		} else if cacheFileHash != sum {
 			return fmt.Errorf("cached file hash(%s) and expected hash(%s) does not match", cacheFileHash, sum)
 		}
+		return f.Commit()
+	}()
+	if err != nil {
+		return err
 	}
 
 	// insert base metadata before unpacking fs
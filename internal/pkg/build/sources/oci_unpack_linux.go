@@ -14,16 +14,20 @@ import (
 	"encoding/json"
 	"errors"
 	"fmt"
+	"io/ioutil"
 	"os"
+	"path/filepath"
 
 	"github.com/containers/image/types"
 	"github.com/openSUSE/umoci"
 	umocilayer "github.com/openSUSE/umoci/oci/layer"
 	"github.com/openSUSE/umoci/pkg/idtools"
+	"github.com/opencontainers/go-digest"
 	imgspecv1 "github.com/opencontainers/image-spec/specs-go/v1"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/internal/pkg/util/fs"
 	sytypes "github.com/sylabs/singularity/pkg/build/types"
+	"github.com/sylabs/singularity/pkg/image/packer"
 )
 
 // unpackRootfs extracts all of the layers of the given image reference into the rootfs of the provided bundle
@@ -67,6 +71,17 @@ func unpackRootfs(ctx context.Context, b *sytypes.Bundle, tmpfsRef types.ImageRe
 	var manifest imgspecv1.Manifest
 	json.Unmarshal(manifestData, &manifest)
 
+	// Keep layers packed when they can be converted directly to the
+	// image filesystem by the assembler
+	if b.Opts.StreamLayers {
+		layers, err := indexLayers(b, manifest)
+		if err == nil {
+			b.Layers = layers
+			return nil
+		}
+		sylog.Verbosef("Unpacking image layers, they can't be converted directly: %s", err)
+	}
+
 	// UnpackRootfs from umoci v0.4.2 expects a path to a non-existing directory
 	os.RemoveAll(b.RootfsPath)
 
@@ -97,6 +112,51 @@ func unpackRootfs(ctx context.Context, b *sytypes.Bundle, tmpfsRef types.ImageRe
 
 }
 
+// indexLayers indexes the layers of the image manifest from the OCI
+// layout in the bundle temporary directory, without unpacking them.
+func indexLayers(b *sytypes.Bundle, manifest imgspecv1.Manifest) (*packer.Layers, error) {
+	blobPath := func(d digest.Digest) string {
+		return filepath.Join(b.TmpDir, "blobs", d.Algorithm().String(), d.Hex())
+	}
+
+	data, err := ioutil.ReadFile(blobPath(manifest.Config.Digest))
+	if err != nil {
+		return nil, fmt.Errorf("error reading image config: %s", err)
+	}
+	var config imgspecv1.Image
+	if err := json.Unmarshal(data, &config); err != nil {
+		return nil, fmt.Errorf("error decoding image config: %s", err)
+	}
+
+	paths := make([]string, 0, len(manifest.Layers))
+	digests := make([]string, 0, len(manifest.Layers))
+	for _, l := range manifest.Layers {
+		paths = append(paths, blobPath(l.Digest))
+		digests = append(digests, l.Digest.String())
+	}
+
+	layers, err := packer.NewLayers(paths)
+	if err != nil {
+		return nil, err
+	}
+	// metadata from an image built by singularity is merged with the
+	// build metadata, which requires an unpacked root filesystem
+	if layers.Exists(".singularity.d") {
+		return nil, fmt.Errorf("image contains a .singularity.d directory")
+	}
+
+	if b.Opts.FixPerms {
+		sylog.Warningf("The --fix-perms option modifies the filesystem permissions on the resulting container.")
+	}
+	layers.Arch = config.Architecture
+	layers.Digests = digests
+	layers.FixPerms = b.Opts.FixPerms
+	layers.Rootless = os.Geteuid() != 0
+
+	sylog.Debugf("Indexed %d image layers for a direct conversion", len(paths))
+	return layers, nil
+}
+
 // fixPerms will work through the rootfs of this bundle, making sure that all
 // files and directories have permissions set such that the owner can read,
 // modify, delete. This brings us to the situation of <=3.4
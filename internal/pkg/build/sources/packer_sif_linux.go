@@ -27,6 +27,28 @@ func (p *SIFPacker) Pack(context.Context) (*types.Bundle, error) {
 	return p.b, nil
 }
 
+// setBaseImage records the SIF image and the state of its extracted root
+// filesystem partition for incremental builds, only SIF images with
+// squashfs partitions are supported as base images.
+func setBaseImage(b *types.Bundle, img *image.Image) error {
+	for _, p := range img.Partitions {
+		if p.Type != image.SQUASHFS {
+			sylog.Infof("%s has non squashfs partitions, incremental build disabled", img.Path)
+			return nil
+		}
+	}
+
+	m, err := types.NewManifest(b.RootfsPath)
+	if err != nil {
+		return err
+	}
+	b.Base = &types.BaseImage{
+		Path:     img.Path,
+		Manifest: m,
+	}
+	return nil
+}
+
 // unpackSIF parses through the sif file and places each component
 // in the sandbox. First pass just assumes a single system partition,
 // later passes will handle more complex sif files.
@@ -49,6 +71,31 @@ func unpackSIF(b *types.Bundle, img *image.Image) (err error) {
 		if err := s.ExtractAll(reader, b.RootfsPath); err != nil {
 			return fmt.Errorf("root filesystem extraction failed: %s", err)
 		}
+
+		// the manifest is recorded before overlay partitions extraction,
+		// an incremental build replaces them with a single partition
+		// containing all changes since the root filesystem partition
+		if b.Opts.Incremental {
+			if err := setBaseImage(b, img); err != nil {
+				return err
+			}
+		}
+
+		// squashfs overlay partitions contain files added or changed
+		// on top of the root filesystem by incremental builds, they
+		// are extracted in order over the root filesystem
+		for i := 1; i < len(img.Partitions); i++ {
+			if img.Partitions[i].Type != image.SQUASHFS {
+				continue
+			}
+			reader, err := image.NewPartitionReader(img, "", i)
+			if err != nil {
+				return fmt.Errorf("could not extract overlay partition: %s", err)
+			}
+			if err := s.ExtractAll(reader, b.RootfsPath); err != nil {
+				return fmt.Errorf("overlay partition extraction failed: %s", err)
+			}
+		}
 	case image.EXT3:
 
 		// extract ext3 partition by mounting
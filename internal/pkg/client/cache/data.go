@@ -0,0 +1,51 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package cache
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"strconv"
+)
+
+// DataDir returns the directory name inside the cache root directory
+// holding data derived from files on the host, like image metadata or
+// GPU libraries resolutions, or an empty string if the cache is disabled
+// with DisableEnv. Unlike images, data files are small and not indexed,
+// they are used without a cache handle.
+func DataDir(name string) string {
+	if disabled, _ := strconv.ParseBool(os.Getenv(DisableEnv)); disabled {
+		return ""
+	}
+	return filepath.Join(getCacheRoot(getCacheBasedir()), name)
+}
+
+// WriteDataFile writes the data file path of a DataDir directory, which
+// is created if missing. The data is written in a temporary file renamed
+// once complete, concurrent readers always read a complete file.
+func WriteDataFile(path string, data []byte) error {
+	dir := filepath.Dir(path)
+	if err := os.MkdirAll(dir, 0700); err != nil {
+		return err
+	}
+
+	f, err := ioutil.TempFile(dir, "entry-")
+	if err != nil {
+		return err
+	}
+	_, err = f.Write(data)
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(f.Name(), path)
+	}
+	if err != nil {
+		os.Remove(f.Name())
+	}
+	return err
+}
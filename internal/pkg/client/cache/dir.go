@@ -30,6 +30,10 @@ const (
 	// DisableCacheEnv specifies whether the image should be used
 	DisableEnv = "SINGULARITY_DISABLE_CACHE"
 
+	// MaxSizeEnv specifies the maximum size of the cache in MiB,
+	// overriding the size requested by the configuration
+	MaxSizeEnv = "SINGULARITY_CACHE_MAXSIZE"
+
 	// CacheDir specifies the name of the directory relative to the
 	// singularity data directory where images are cached in by
 	// default.
@@ -46,6 +50,20 @@ type Config struct {
 
 	// Disable specifies whether the user request the cache to be disabled by default.
 	Disable bool
+
+	// MaxSize is the maximum size of the cache in bytes, entries are
+	// evicted when an image added to the cache exceeds it. The size is
+	// unlimited if zero.
+	MaxSize int64
+
+	// Eviction is the eviction policy, EvictLRU (default) or EvictSize.
+	Eviction string
+
+	// SystemDir is the base directory of the read-only system cache,
+	// populated by the administrator and shared by all users. Images
+	// missing from the user cache are referenced from the system cache
+	// when present there. There is no system cache if empty.
+	SystemDir string
 }
 
 // Handle is an structure representing a cache
@@ -87,6 +105,25 @@ type Handle struct {
 	// Oras provides the location of the ORAS cache
 	Oras string
 
+	// Layer provides the location of the converted OCI layers cache
+	Layer string
+
+	// systemRoot is the root directory of the system cache, within
+	// Config.SystemDir, empty if there is no system cache
+	systemRoot string
+
+	// dirMode is the permission of the cache directories, the system
+	// cache directories are readable by all users
+	dirMode os.FileMode
+
+	// maxSize is the maximum size of the indexed cache entries in
+	// bytes, unlimited if zero
+	maxSize int64
+
+	// eviction is the eviction policy used when the cache exceeds
+	// maxSize
+	eviction string
+
 	// disabled specifies if the test is disabled
 	disabled bool
 }
@@ -125,12 +162,35 @@ func NewHandle(cfg Config) (*Handle, error) {
 		return newCache, nil
 	}
 
+	newCache.maxSize = cfg.MaxSize
+	if env := os.Getenv(MaxSizeEnv); env != "" {
+		size, err := strconv.ParseUint(env, 10, 32)
+		if err != nil {
+			return nil, fmt.Errorf("failed to parse environment variable %s: %s", MaxSizeEnv, err)
+		}
+		newCache.maxSize = int64(size) << 20
+	}
+	switch cfg.Eviction {
+	case "", EvictLRU:
+		newCache.eviction = EvictLRU
+	case EvictSize:
+		newCache.eviction = EvictSize
+	default:
+		return nil, fmt.Errorf("unknown cache eviction policy %q", cfg.Eviction)
+	}
+
 	// cfg is what is requested so we should not change any value that it contains
 	baseDir := cfg.BaseDir
 	if baseDir == "" {
 		baseDir = getCacheBasedir()
 	}
 
+	newCache.dirMode = 0700
+	if cfg.SystemDir != "" && filepath.Clean(baseDir) == filepath.Clean(cfg.SystemDir) {
+		// the administrator is populating the system cache
+		newCache.dirMode = 0755
+	}
+
 	ep, err := fs.FirstExistingParent(baseDir)
 	if err != nil {
 		return nil, fmt.Errorf("failed to get first existing parent of cache directory: %v", err)
@@ -144,7 +204,7 @@ func NewHandle(cfg Config) (*Handle, error) {
 	}
 
 	// create basedir plus any required parent dir if cache is enabled and it does not exist
-	if err := initCacheDir(baseDir); err != nil {
+	if err := initCacheDir(baseDir, newCache.dirMode); err != nil {
 		return nil, fmt.Errorf("failed initializing cache directory: %s", err)
 	}
 
@@ -160,12 +220,15 @@ func NewHandle(cfg Config) (*Handle, error) {
 		return nil, fmt.Errorf("invalid root directory")
 	}
 
-	if err = initCacheDir(rootDir); err != nil {
+	if err = initCacheDir(rootDir, newCache.dirMode); err != nil {
 		return nil, fmt.Errorf("failed initializing caching directory: %s", err)
 	}
 
 	newCache.baseDir = baseDir
 	newCache.rootDir = rootDir
+	if cfg.SystemDir != "" {
+		newCache.systemRoot = getCacheRoot(cfg.SystemDir)
+	}
 	newCache.Library, err = getLibraryCachePath(newCache)
 	if err != nil {
 		return nil, fmt.Errorf("failed getting the path to the Library cache: %s", err)
@@ -190,6 +253,10 @@ func NewHandle(cfg Config) (*Handle, error) {
 	if err != nil {
 		return nil, fmt.Errorf("failed getting the path to the ORAS cache")
 	}
+	newCache.Layer, err = getLayerCachePath(newCache)
+	if err != nil {
+		return nil, fmt.Errorf("failed getting the path to the layer cache")
+	}
 
 	return newCache, nil
 }
@@ -260,7 +327,7 @@ func updateCacheSubdir(c *Handle, subdir string) (string, error) {
 		sylog.Fatalf("Unable to get abs filepath: %v", err)
 	}
 
-	if err := initCacheDir(absdir); err != nil {
+	if err := initCacheDir(absdir, c.dirMode); err != nil {
 		sylog.Fatalf("Unable to initialize caching directory: %v", err)
 	}
 
@@ -268,19 +335,19 @@ func updateCacheSubdir(c *Handle, subdir string) (string, error) {
 	return absdir, nil
 }
 
-func initCacheDir(dir string) error {
+func initCacheDir(dir string, mode os.FileMode) error {
 	if fi, err := os.Stat(dir); os.IsNotExist(err) {
 		sylog.Debugf("Creating cache directory: %s", dir)
-		if err := fs.MkdirAll(dir, 0700); err != nil {
+		if err := fs.MkdirAll(dir, mode); err != nil {
 			return fmt.Errorf("couldn't create cache directory %v: %v", dir, err)
 		}
 	} else if err != nil {
 		return fmt.Errorf("unable to stat %s: %s", dir, err)
-	} else if fi.Mode().Perm() != 0700 {
+	} else if fi.Mode().Perm() != mode {
 		// enforce permission on cache directory to prevent
 		// potential information leak
-		if err := os.Chmod(dir, 0700); err != nil {
-			return fmt.Errorf("couldn't enforce permission 0700 on %s: %s", dir, err)
+		if err := os.Chmod(dir, mode); err != nil {
+			return fmt.Errorf("couldn't enforce permission %#o on %s: %s", mode, dir, err)
 		}
 	}
 
@@ -301,6 +368,7 @@ func (c *Handle) cleanAllCaches() {
 		"shub":    c.Shub,
 		"oras":    c.Oras,
 		"net":     c.Net,
+		"layer":   c.Layer,
 	}
 
 	for name, dir := range cacheDirs {
@@ -308,4 +376,5 @@ func (c *Handle) cleanAllCaches() {
 			sylog.Verbosef("unable to clean %s cache, directory %s: %v", name, dir, err)
 		}
 	}
+	os.Remove(c.indexPath())
 }
@@ -0,0 +1,412 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package cache
+
+import (
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"time"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+	"github.com/sylabs/singularity/pkg/util/fs/lock"
+)
+
+const (
+	// IndexFile is the file inside cache.Dir() indexing the cached
+	// images with their size and last access time
+	IndexFile = "index.json"
+
+	// LazySuffix is appended to the path of a cache entry for the
+	// image fetched lazily, the entry is filled once all the image
+	// chunks are fetched
+	LazySuffix = ".lazy"
+
+	// EvictLRU evicts the least recently used entries first
+	EvictLRU = "lru"
+	// EvictSize evicts first the entries with the largest size
+	// weighted by the time elapsed since their last access
+	EvictSize = "size"
+
+	// accessPeriod is the period below which the last access
+	// time of an entry isn't updated, so that the many processes
+	// using the same image at once don't all rewrite the index
+	accessPeriod = time.Minute
+)
+
+// indexedDirs are the cache directories whose entries are indexed,
+// all store one image file per entry. The OCI blob cache is a layout
+// whose blobs are shared between images, it isn't indexed.
+var indexedDirs = []string{LibraryDir, OciTempDir, ShubDir, NetDir, OrasDir, LayerDir}
+
+// partialSuffixes are the suffixes of the temporary files of entries
+// being filled, never indexed.
+var partialSuffixes = []string{
+	".partial", ".partial.json", ".download", ".link",
+	LazySuffix, LazySuffix + ".lazystate", LazySuffix + ".lazychunks",
+}
+
+// Entry describes a cached image.
+type Entry struct {
+	// Path is the absolute path of the image
+	Path string
+	// Size is the size of the image in bytes
+	Size int64
+	// LastAccess is the last time the image was filled or used,
+	// with a precision of a minute
+	LastAccess time.Time
+}
+
+type indexEntry struct {
+	Size       int64 `json:"size"`
+	LastAccess int64 `json:"lastAccess"`
+}
+
+// index maps the entry paths relative to cache.Dir() to their size
+// and last access time.
+type index map[string]indexEntry
+
+// absRoot returns the absolute path of the cache root directory,
+// entry paths returned by the cache handle are absolute.
+func (c *Handle) absRoot() string {
+	root, err := filepath.Abs(c.rootDir)
+	if err != nil {
+		return c.rootDir
+	}
+	return root
+}
+
+// indexPath returns the path of the cache index.
+func (c *Handle) indexPath() string {
+	return filepath.Join(c.rootDir, IndexFile)
+}
+
+// readIndex reads the cache index, it returns a nil index if the
+// index doesn't exist yet. The index is replaced atomically, it's
+// read without lock.
+func (c *Handle) readIndex() (index, error) {
+	b, err := ioutil.ReadFile(c.indexPath())
+	if os.IsNotExist(err) {
+		return nil, nil
+	} else if err != nil {
+		return nil, fmt.Errorf("while reading cache index: %s", err)
+	}
+	idx := make(index)
+	if err := json.Unmarshal(b, &idx); err != nil {
+		sylog.Warningf("Cache index %s is corrupted, rebuilding it", c.indexPath())
+		return nil, nil
+	}
+	return idx, nil
+}
+
+// updateIndex calls fn with the cache index under the index lock and
+// writes the index updated by fn. The index is built from the cache
+// directories when it doesn't exist yet.
+func (c *Handle) updateIndex(fn func(idx index) error) error {
+	lockPath := c.indexPath() + ".lock"
+	f, err := os.OpenFile(lockPath, os.O_CREATE|os.O_RDONLY, 0600)
+	if err != nil {
+		return fmt.Errorf("while creating cache index lock file: %s", err)
+	}
+	f.Close()
+
+	fd, err := lock.Exclusive(lockPath)
+	if err != nil {
+		return fmt.Errorf("while locking cache index: %s", err)
+	}
+	defer lock.Release(fd)
+
+	idx, err := c.readIndex()
+	if err != nil {
+		return err
+	}
+	if idx == nil {
+		if idx, err = c.buildIndex(); err != nil {
+			return err
+		}
+	}
+
+	if err := fn(idx); err != nil {
+		return err
+	}
+
+	b, err := json.Marshal(idx)
+	if err != nil {
+		return fmt.Errorf("while encoding cache index: %s", err)
+	}
+	tmp, err := ioutil.TempFile(c.rootDir, IndexFile+".")
+	if err != nil {
+		return fmt.Errorf("while creating cache index: %s", err)
+	}
+	_, err = tmp.Write(b)
+	if cerr := tmp.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(tmp.Name(), c.indexPath())
+	}
+	if err != nil {
+		os.Remove(tmp.Name())
+		return fmt.Errorf("while writing cache index: %s", err)
+	}
+	return nil
+}
+
+// buildIndex indexes the entries present in the cache directories,
+// using their modification time as last access time.
+func (c *Handle) buildIndex() (index, error) {
+	sylog.Debugf("Building cache index %s", c.indexPath())
+
+	idx := make(index)
+	for _, dir := range indexedDirs {
+		sums, err := ioutil.ReadDir(filepath.Join(c.rootDir, dir))
+		if os.IsNotExist(err) {
+			continue
+		} else if err != nil {
+			return nil, fmt.Errorf("while indexing cache: %s", err)
+		}
+		for _, sum := range sums {
+			if !sum.IsDir() {
+				continue
+			}
+			files, err := ioutil.ReadDir(filepath.Join(c.rootDir, dir, sum.Name()))
+			if err != nil {
+				return nil, fmt.Errorf("while indexing cache: %s", err)
+			}
+			for _, fi := range files {
+				if !isEntry(fi) || isPartial(fi.Name()) {
+					continue
+				}
+				idx[filepath.Join(dir, sum.Name(), fi.Name())] = indexEntry{
+					Size:       fi.Size(),
+					LastAccess: fi.ModTime().Unix(),
+				}
+			}
+		}
+	}
+	return idx, nil
+}
+
+// isEntry returns whether fi describes an image entry, either a file
+// or a link to a system cache image.
+func isEntry(fi os.FileInfo) bool {
+	return fi.Mode().IsRegular() || fi.Mode()&os.ModeSymlink != 0
+}
+
+func isPartial(name string) bool {
+	for _, suffix := range partialSuffixes {
+		if strings.HasSuffix(name, suffix) {
+			return true
+		}
+	}
+	return false
+}
+
+// indexKey returns the index key of the entry path, or an empty string
+// if the entry is not in an indexed cache directory.
+func (c *Handle) indexKey(path string) string {
+	rel, err := filepath.Rel(c.absRoot(), path)
+	if err != nil || strings.HasPrefix(rel, "..") {
+		return ""
+	}
+	parts := strings.Split(rel, string(filepath.Separator))
+	if len(parts) != 3 {
+		return ""
+	}
+	for _, dir := range indexedDirs {
+		if parts[0] == dir {
+			return rel
+		}
+	}
+	return ""
+}
+
+// recordAccess updates the last access time of the entry path, called
+// when a cached image is used.
+func (c *Handle) recordAccess(path string) {
+	key := c.indexKey(path)
+	if key == "" {
+		return
+	}
+	now := time.Now()
+	if idx, err := c.readIndex(); err == nil && idx != nil {
+		if e, ok := idx[key]; ok && now.Sub(time.Unix(e.LastAccess, 0)) < accessPeriod {
+			return
+		}
+	}
+
+	err := c.updateIndex(func(idx index) error {
+		e, ok := idx[key]
+		if !ok {
+			fi, err := os.Lstat(path)
+			if err != nil {
+				return nil
+			}
+			e.Size = fi.Size()
+		}
+		e.LastAccess = now.Unix()
+		idx[key] = e
+		return nil
+	})
+	if err != nil {
+		sylog.Debugf("Could not record access to cache entry %s: %s", path, err)
+	}
+}
+
+// insert adds the entry path to the index once filled, and evicts
+// other entries if the cache exceeds its maximum size.
+func (c *Handle) insert(path string) {
+	key := c.indexKey(path)
+	if key == "" {
+		return
+	}
+	// the size of a symbolic link to a system cache image is the
+	// size used in the user cache
+	fi, err := os.Lstat(path)
+	if err != nil || !isEntry(fi) {
+		return
+	}
+
+	err = c.updateIndex(func(idx index) error {
+		idx[key] = indexEntry{
+			Size:       fi.Size(),
+			LastAccess: time.Now().Unix(),
+		}
+		if c.maxSize > 0 {
+			c.evict(idx, key)
+		}
+		return nil
+	})
+	if err != nil {
+		sylog.Warningf("Could not add %s to the cache index: %s", path, err)
+	}
+}
+
+// evict removes entries from the cache and from idx, in the order of the
+// eviction policy, until the cache size is below its maximum size. The
+// entry keep, just inserted, is never evicted, nor are the entries whose
+// lock is held by another process filling them.
+func (c *Handle) evict(idx index, keep string) {
+	var total int64
+	keys := make([]string, 0, len(idx))
+	for k, e := range idx {
+		total += e.Size
+		if k != keep {
+			keys = append(keys, k)
+		}
+	}
+	if total <= c.maxSize {
+		return
+	}
+
+	now := time.Now().Unix()
+	score := func(e indexEntry) float64 {
+		if c.eviction == EvictSize {
+			return float64(e.Size) * float64(now-e.LastAccess+1)
+		}
+		return float64(now - e.LastAccess)
+	}
+	sort.Slice(keys, func(i, j int) bool {
+		return score(idx[keys[i]]) > score(idx[keys[j]])
+	})
+
+	for _, k := range keys {
+		if total <= c.maxSize {
+			break
+		}
+		path := filepath.Join(c.rootDir, k)
+		// the lock isn't waited for, the index is locked
+		l, err := c.tryLockEntry(path)
+		if err != nil {
+			sylog.Debugf("Not evicting %s from the cache: %s", path, err)
+			continue
+		}
+		sylog.Verbosef("Evicting %s (%d bytes) from the cache", path, idx[k].Size)
+		err = os.Remove(path)
+		if err == nil || os.IsNotExist(err) {
+			// the entry directory is left if not empty
+			os.Remove(filepath.Dir(path))
+		}
+		// released without indexing the entry
+		l.release()
+		if err != nil && !os.IsNotExist(err) {
+			sylog.Warningf("Could not evict %s from the cache: %s", path, err)
+			continue
+		}
+		total -= idx[k].Size
+		delete(idx, k)
+	}
+	if total > c.maxSize {
+		sylog.Warningf("Cache size %d bytes exceeds its maximum size %d bytes", total, c.maxSize)
+	}
+}
+
+// Entries returns the entries of the cache directory dir, e.g. the
+// Library cache directory, from the cache index.
+func (c *Handle) Entries(dir string) ([]Entry, error) {
+	if c.disabled {
+		return nil, nil
+	}
+
+	idx, err := c.readIndex()
+	if err != nil {
+		return nil, err
+	}
+	if idx == nil {
+		// built on first use
+		err := c.updateIndex(func(i index) error {
+			idx = i
+			return nil
+		})
+		if err != nil {
+			return nil, err
+		}
+	}
+
+	root := c.absRoot()
+	dir, err = filepath.Abs(dir)
+	if err != nil {
+		return nil, err
+	}
+
+	var entries []Entry
+	for k, e := range idx {
+		path := filepath.Join(root, k)
+		if filepath.Dir(filepath.Dir(path)) != dir {
+			continue
+		}
+		entries = append(entries, Entry{
+			Path:       path,
+			Size:       e.Size,
+			LastAccess: time.Unix(e.LastAccess, 0),
+		})
+	}
+	sort.Slice(entries, func(i, j int) bool {
+		return entries[i].Path < entries[j].Path
+	})
+	return entries, nil
+}
+
+// SyncIndex removes the entries removed from the cache directories,
+// e.g. by a cache clean, from the cache index.
+func (c *Handle) SyncIndex() error {
+	if c.disabled {
+		return nil
+	}
+
+	return c.updateIndex(func(idx index) error {
+		for k := range idx {
+			if _, err := os.Stat(filepath.Join(c.rootDir, k)); os.IsNotExist(err) {
+				delete(idx, k)
+			}
+		}
+		return nil
+	})
+}
@@ -0,0 +1,202 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package cache
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+
+	"github.com/sylabs/singularity/internal/pkg/test"
+)
+
+// fillEntry creates the layer cache entry sum of size bytes as a cache
+// fill does, under the entry lock.
+func fillEntry(t *testing.T, c *Handle, sum string, size int) string {
+	path := c.LayerImage(sum, "layer.sqfs")
+	l, err := c.LockEntry(path)
+	if err != nil {
+		t.Fatalf("failed to lock entry: %s", err)
+	}
+	if err := ioutil.WriteFile(path, make([]byte, size), 0644); err != nil {
+		t.Fatalf("failed to fill entry: %s", err)
+	}
+	if err := l.Unlock(); err != nil {
+		t.Fatalf("failed to unlock entry: %s", err)
+	}
+	return path
+}
+
+// setLastAccess sets the last access time of the entry path in the index.
+func setLastAccess(t *testing.T, c *Handle, path string, last time.Time) {
+	err := c.updateIndex(func(idx index) error {
+		e := idx[c.indexKey(path)]
+		e.LastAccess = last.Unix()
+		idx[c.indexKey(path)] = e
+		return nil
+	})
+	if err != nil {
+		t.Fatalf("failed to update index: %s", err)
+	}
+}
+
+func newIndexTestHandle(t *testing.T, maxSize int64, eviction string) (*Handle, func()) {
+	tempImageCache, err := ioutil.TempDir("", "image-cache-")
+	if err != nil {
+		t.Fatal("failed to create temporary image cache directory:", err)
+	}
+
+	c, err := NewHandle(Config{BaseDir: tempImageCache, MaxSize: maxSize, Eviction: eviction})
+	if err != nil {
+		os.RemoveAll(tempImageCache)
+		t.Fatalf("failed to create new image cache handle: %s", err)
+	}
+	c.checkIfCacheDisabled(t)
+
+	return c, func() { os.RemoveAll(tempImageCache) }
+}
+
+func TestIndexEntries(t *testing.T) {
+	test.DropPrivilege(t)
+	defer test.ResetPrivilege(t)
+
+	c, cleanup := newIndexTestHandle(t, 0, "")
+	defer cleanup()
+
+	// entries present before the index are indexed on first use
+	old := c.LayerImage("old", "layer.sqfs")
+	if err := ioutil.WriteFile(old, make([]byte, 10), 0644); err != nil {
+		t.Fatal(err)
+	}
+	if err := ioutil.WriteFile(old+".partial", make([]byte, 10), 0644); err != nil {
+		t.Fatal(err)
+	}
+	filled := fillEntry(t, c, "new", 20)
+
+	entries, err := c.Entries(c.Layer)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if len(entries) != 2 {
+		t.Fatalf("unexpected entries %+v", entries)
+	}
+	if entries[0].Path != filled || entries[0].Size != 20 || entries[1].Path != old || entries[1].Size != 10 {
+		t.Errorf("unexpected entries %+v", entries)
+	}
+	if entries, err := c.Entries(c.Library); err != nil || len(entries) != 0 {
+		t.Errorf("unexpected library entries %+v: %v", entries, err)
+	}
+
+	// accesses are recorded by existence checks
+	last := time.Now().Add(-time.Hour)
+	setLastAccess(t, c, filled, last)
+	if exists, err := c.LayerImageExists("new", "layer.sqfs"); err != nil || !exists {
+		t.Fatalf("LayerImageExists() didn't report an existing layer: %v %v", exists, err)
+	}
+	entries, _ = c.Entries(c.Layer)
+	if !entries[0].LastAccess.After(last) {
+		t.Errorf("access not recorded")
+	}
+
+	// removed entries are dropped by SyncIndex
+	os.Remove(old)
+	if err := c.SyncIndex(); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if entries, _ := c.Entries(c.Layer); len(entries) != 1 {
+		t.Errorf("unexpected entries after sync %+v", entries)
+	}
+}
+
+func TestIndexEviction(t *testing.T) {
+	test.DropPrivilege(t)
+	defer test.ResetPrivilege(t)
+
+	tests := []struct {
+		name     string
+		eviction string
+		evicted  string
+	}{
+		// a is the least recently used, b the largest one
+		{"lru", EvictLRU, "a"},
+		{"size", EvictSize, "b"},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			c, cleanup := newIndexTestHandle(t, 100, tt.eviction)
+			defer cleanup()
+
+			now := time.Now()
+			paths := map[string]string{
+				"a": fillEntry(t, c, "a", 10),
+				"b": fillEntry(t, c, "b", 60),
+			}
+			setLastAccess(t, c, paths["a"], now.Add(-3*time.Hour))
+			setLastAccess(t, c, paths["b"], now.Add(-2*time.Hour))
+
+			// under the maximum size
+			paths["c"] = fillEntry(t, c, "c", 30)
+			for _, path := range paths {
+				if _, err := os.Stat(path); err != nil {
+					t.Fatalf("unexpected eviction of %s", path)
+				}
+			}
+
+			paths["d"] = fillEntry(t, c, "d", 5)
+			for sum, path := range paths {
+				_, err := os.Stat(path)
+				if sum == tt.evicted && !os.IsNotExist(err) {
+					t.Errorf("entry %s not evicted", sum)
+				} else if sum != tt.evicted && err != nil {
+					t.Errorf("unexpected eviction of entry %s", sum)
+				}
+			}
+			if _, err := os.Stat(filepath.Dir(paths[tt.evicted])); !os.IsNotExist(err) {
+				t.Errorf("evicted entry directory left")
+			}
+
+			entries, err := c.Entries(c.Layer)
+			if err != nil {
+				t.Fatalf("unexpected error: %s", err)
+			}
+			if len(entries) != 3 {
+				t.Errorf("unexpected entries %+v", entries)
+			}
+		})
+	}
+}
+
+func TestIndexEvictionBusy(t *testing.T) {
+	test.DropPrivilege(t)
+	defer test.ResetPrivilege(t)
+
+	c, cleanup := newIndexTestHandle(t, 100, EvictLRU)
+	defer cleanup()
+
+	now := time.Now()
+	a := fillEntry(t, c, "a", 10)
+	b := fillEntry(t, c, "b", 60)
+	setLastAccess(t, c, a, now.Add(-3*time.Hour))
+	setLastAccess(t, c, b, now.Add(-2*time.Hour))
+
+	// a is the least recently used, but locked by a fill
+	l, err := c.LockEntry(a)
+	if err != nil {
+		t.Fatalf("failed to lock entry: %s", err)
+	}
+	defer l.Unlock()
+
+	fillEntry(t, c, "c", 40)
+	if _, err := os.Stat(a); err != nil {
+		t.Errorf("locked entry evicted")
+	}
+	if _, err := os.Stat(b); !os.IsNotExist(err) {
+		t.Errorf("entry b not evicted")
+	}
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package cache
+
+import (
+	"os"
+	"path/filepath"
+)
+
+const (
+	// LayerDir is the directory inside the cache.Dir where squashfs
+	// filesystems converted from OCI image layers are cached
+	LayerDir = "layer"
+)
+
+// getLayerCachePath returns the directory inside the cache.Dir() where
+// converted layers are cached
+func getLayerCachePath(c *Handle) (string, error) {
+	if c.disabled {
+		return "", nil
+	}
+
+	// This function may act on an cache object that is not fully initialized
+	// so it is not a method on a Handle but rather an independent
+	// function
+
+	return updateCacheSubdir(c, LayerDir)
+}
+
+// LayerImage creates a directory inside cache.Dir() with the name of the
+// SHA sum identifying the converted layers and returns the abs path of
+// the squashfs filesystem
+func (c *Handle) LayerImage(sum, name string) string {
+	if c.disabled {
+		return ""
+	}
+
+	_, err := updateCacheSubdir(c, filepath.Join(LayerDir, sum))
+	if err != nil {
+		return ""
+	}
+
+	return filepath.Join(c.Layer, sum, name)
+}
+
+// LayerImageExists returns whether the converted layers with the SHA sum
+// exist in the layer cache
+func (c *Handle) LayerImageExists(sum, name string) (bool, error) {
+	if c.disabled {
+		return false, nil
+	}
+
+	imagePath := c.LayerImage(sum, name)
+	_, err := os.Stat(imagePath)
+	if os.IsNotExist(err) {
+		return c.linkSystemImage(LayerDir, sum, name, imagePath)
+	} else if err != nil {
+		return false, err
+	}
+
+	c.recordAccess(imagePath)
+
+	return true, nil
+}
@@ -0,0 +1,52 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package cache
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+
+	"github.com/sylabs/singularity/internal/pkg/test"
+	"github.com/sylabs/singularity/internal/pkg/util/fs"
+)
+
+func TestLayerImageExists(t *testing.T) {
+	test.DropPrivilege(t)
+	defer test.ResetPrivilege(t)
+
+	tempImageCache, err := ioutil.TempDir("", "image-cache-")
+	if err != nil {
+		t.Fatal("failed to create temporary image cache directory:", err)
+	}
+	defer os.RemoveAll(tempImageCache)
+
+	c, err := NewHandle(Config{BaseDir: tempImageCache})
+	if err != nil {
+		t.Fatalf("failed to create new image cache handle: %s", err)
+	}
+
+	// Before running the test we make sure that the test environment
+	// did not implicitly disable the cache.
+	c.checkIfCacheDisabled(t)
+
+	if expected := filepath.Join(tempImageCache, CacheDir, LayerDir); c.Layer != expected {
+		t.Errorf("Unexpected result: %s (expected %s)", c.Layer, expected)
+	}
+
+	const sum = "0123456789abcdef"
+
+	if exists, err := c.LayerImageExists(sum, "layer.sqfs"); err != nil || exists {
+		t.Fatalf("LayerImageExists() reported a missing layer: %v %v", exists, err)
+	}
+	if err := fs.Touch(c.LayerImage(sum, "layer.sqfs")); err != nil {
+		t.Fatalf("failed to create layer: %s", err)
+	}
+	if exists, err := c.LayerImageExists(sum, "layer.sqfs"); err != nil || !exists {
+		t.Fatalf("LayerImageExists() didn't report an existing layer: %v %v", exists, err)
+	}
+}
@@ -50,7 +50,11 @@ func (c *Handle) LibraryImageExists(sum, name string) (bool, error) {
 	imagePath := c.LibraryImage(sum, name)
 	_, err := os.Stat(imagePath)
 	if os.IsNotExist(err) {
-		return false, nil
+		// the system cache image is checked against its hash
+		// like user cache images
+		if found, err := c.linkSystemImage(LibraryDir, sum, name, imagePath); !found || err != nil {
+			return false, err
+		}
 	} else if err != nil {
 		return false, err
 	}
@@ -63,5 +67,7 @@ func (c *Handle) LibraryImageExists(sum, name string) (bool, error) {
 		return false, ErrBadChecksum
 	}
 
+	c.recordAccess(imagePath)
+
 	return true, nil
 }
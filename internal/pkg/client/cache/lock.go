@@ -0,0 +1,201 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package cache
+
+import (
+	"crypto/sha256"
+	"errors"
+	"fmt"
+	"os"
+	"path/filepath"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+	"github.com/sylabs/singularity/pkg/util/fs/lock"
+	"golang.org/x/sys/unix"
+)
+
+const (
+	// LockDir is the directory inside cache.Dir() holding the lock files
+	// of the cache entries being filled
+	LockDir = "lock"
+)
+
+// EntryLock is an exclusive lock on a cache entry, held by a process
+// while it fills the entry.
+type EntryLock struct {
+	c     *Handle
+	entry string
+	path  string
+	fd    int
+}
+
+// LockEntry acquires the lock of the cache entry path, an image path
+// returned by the cache handle, waiting while another process holds it.
+// Processes pulling the same image at the same time then fetch it once:
+// a process missing an entry locks it, checks again whether the entry
+// exists and fills it only if it's still missing, the other processes
+// waiting for the lock find the entry once they acquire it.
+// A nil lock is returned when the cache is disabled.
+func (c *Handle) LockEntry(path string) (*EntryLock, error) {
+	if c.disabled {
+		return nil, nil
+	}
+	return c.lockEntry(path, lock.Exclusive)
+}
+
+// errEntryBusy is returned by tryLockEntry when the entry lock is held
+// by another process.
+var errEntryBusy = errors.New("cache entry is busy")
+
+// tryLockEntry acquires the lock of the cache entry path like LockEntry,
+// except that it returns errEntryBusy instead of waiting if another
+// process holds it.
+func (c *Handle) tryLockEntry(path string) (*EntryLock, error) {
+	return c.lockEntry(path, lock.TryExclusive)
+}
+
+// lockEntry acquires the lock of the cache entry path with exclusive,
+// lock.Exclusive or lock.TryExclusive.
+func (c *Handle) lockEntry(path string, exclusive func(string) (int, error)) (*EntryLock, error) {
+	dir, err := updateCacheSubdir(c, LockDir)
+	if err != nil {
+		return nil, err
+	}
+	// lock files are named after the entry path, lock files of
+	// entries from all cache types are stored in the same directory
+	lockPath := filepath.Join(dir, fmt.Sprintf("%x", sha256.Sum256([]byte(path))))
+
+	for {
+		f, err := os.OpenFile(lockPath, os.O_CREATE|os.O_RDONLY, 0600)
+		if err != nil {
+			return nil, fmt.Errorf("while creating lock file for %s: %s", path, err)
+		}
+		f.Close()
+
+		sylog.Debugf("Acquiring lock on cache entry %s", path)
+
+		fd, err := exclusive(lockPath)
+		if os.IsNotExist(err) {
+			// removed by the previous holder in the meantime
+			continue
+		} else if err == unix.EWOULDBLOCK {
+			return nil, errEntryBusy
+		} else if err != nil {
+			return nil, fmt.Errorf("while locking cache entry %s: %s", path, err)
+		}
+
+		// the previous holder removes the lock file once the entry
+		// is filled, the lock is valid only if acquired on the file
+		// still present at lockPath
+		var fst, st unix.Stat_t
+		if err := unix.Fstat(fd, &fst); err != nil {
+			lock.Release(fd)
+			return nil, fmt.Errorf("while getting lock file information: %s", err)
+		}
+		if err := unix.Stat(lockPath, &st); err == nil && st.Dev == fst.Dev && st.Ino == fst.Ino {
+			return &EntryLock{c: c, entry: path, path: lockPath, fd: fd}, nil
+		} else if err != nil && err != unix.ENOENT {
+			lock.Release(fd)
+			return nil, fmt.Errorf("while getting lock file information: %s", err)
+		}
+		lock.Release(fd)
+	}
+}
+
+// Unlock adds the entry to the cache index if it was filled, then
+// removes the lock file and releases the lock. Unlock is a no-op for
+// a nil lock.
+func (l *EntryLock) Unlock() error {
+	if l == nil {
+		return nil
+	}
+	// indexed while still locked, before processes waiting for
+	// this entry use it
+	l.c.insert(l.entry)
+	return l.release()
+}
+
+// release removes the lock file and releases the lock.
+func (l *EntryLock) release() error {
+	// removed while still locked, processes waiting for this lock
+	// retry with a new lock file
+	if err := os.Remove(l.path); err != nil {
+		sylog.Debugf("Could not remove lock file %s: %s", l.path, err)
+	}
+	return lock.Release(l.fd)
+}
+
+// fillSuffix is appended to the path of a cache entry for the temporary
+// file the entry is filled in.
+const fillSuffix = ".download"
+
+// EntryFill is a missing cache entry being filled, the entry lock is
+// held until the fill is closed.
+type EntryFill struct {
+	lock *EntryLock
+	path string
+	// Temp is the path of the temporary file the entry is written to,
+	// moved to the entry path by Commit. It has a fixed name so that
+	// an interrupted download is resumed by the next fill.
+	Temp string
+}
+
+// FillEntry returns the fill of the cache entry path if exists reports
+// the entry is missing, or nil if it exists. exists is called without
+// lock first, and again once the entry lock is acquired if the entry is
+// still missing (see LockEntry). The entry is written to the temporary
+// file EntryFill.Temp and moved in place by EntryFill.Commit, so the
+// entries found by exists are always complete. A returned fill must be
+// closed.
+func (c *Handle) FillEntry(path string, exists func() (bool, error)) (*EntryFill, error) {
+	if c.disabled {
+		return nil, fmt.Errorf("cache is disabled, %s can't be filled", path)
+	}
+
+	if found, err := exists(); err != nil {
+		return nil, fmt.Errorf("unable to check if %s exists: %v", path, err)
+	} else if found {
+		return nil, nil
+	}
+
+	l, err := c.LockEntry(path)
+	if err != nil {
+		return nil, err
+	}
+	if found, err := exists(); err != nil {
+		l.Unlock()
+		return nil, fmt.Errorf("unable to check if %s exists: %v", path, err)
+	} else if found {
+		l.Unlock()
+		return nil, nil
+	}
+
+	f := &EntryFill{lock: l, path: path, Temp: path + fillSuffix}
+	// left by an interrupted fill
+	if err := os.Remove(f.Temp); err != nil && !os.IsNotExist(err) {
+		f.Close()
+		return nil, fmt.Errorf("while removing %s: %s", f.Temp, err)
+	}
+	return f, nil
+}
+
+// Commit moves the temporary file to the entry path, the entry is
+// indexed once the fill is closed.
+func (f *EntryFill) Commit() error {
+	if err := os.Rename(f.Temp, f.path); err != nil {
+		return fmt.Errorf("while adding %s to the cache: %s", f.path, err)
+	}
+	return nil
+}
+
+// Close removes the temporary file if the fill wasn't committed, and
+// releases the entry lock.
+func (f *EntryFill) Close() error {
+	if err := os.Remove(f.Temp); err != nil && !os.IsNotExist(err) {
+		sylog.Debugf("Could not remove %s: %s", f.Temp, err)
+	}
+	return f.lock.Unlock()
+}
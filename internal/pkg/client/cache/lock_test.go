@@ -0,0 +1,199 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package cache
+
+import (
+	"io/ioutil"
+	"os"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/sylabs/singularity/internal/pkg/test"
+)
+
+func TestLockEntry(t *testing.T) {
+	test.DropPrivilege(t)
+	defer test.ResetPrivilege(t)
+
+	tempImageCache, err := ioutil.TempDir("", "image-cache-")
+	if err != nil {
+		t.Fatal("failed to create temporary image cache directory:", err)
+	}
+	defer os.RemoveAll(tempImageCache)
+
+	c, err := NewHandle(Config{BaseDir: tempImageCache})
+	if err != nil {
+		t.Fatalf("failed to create new image cache handle: %s", err)
+	}
+	c.checkIfCacheDisabled(t)
+
+	entry := c.LayerImage("0123456789abcdef", "layer.sqfs")
+
+	// concurrent fills of the same entry are serialized, only the
+	// first one to acquire the lock creates the entry
+	var (
+		wg      sync.WaitGroup
+		mu      sync.Mutex
+		holders int
+		fills   int
+	)
+	for i := 0; i < 8; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+
+			l, err := c.LockEntry(entry)
+			if err != nil {
+				t.Errorf("unexpected error while locking entry: %s", err)
+				return
+			}
+			mu.Lock()
+			holders++
+			if holders > 1 {
+				t.Errorf("lock held by %d fills at the same time", holders)
+			}
+			mu.Unlock()
+
+			if _, err := os.Stat(entry); os.IsNotExist(err) {
+				time.Sleep(50 * time.Millisecond)
+				if err := ioutil.WriteFile(entry, []byte("image"), 0644); err != nil {
+					t.Errorf("failed to fill entry: %s", err)
+				}
+				mu.Lock()
+				fills++
+				mu.Unlock()
+			}
+
+			mu.Lock()
+			holders--
+			mu.Unlock()
+			if err := l.Unlock(); err != nil {
+				t.Errorf("unexpected error while unlocking entry: %s", err)
+			}
+		}()
+	}
+	wg.Wait()
+
+	if fills != 1 {
+		t.Errorf("entry filled %d times", fills)
+	}
+
+	// lock files are removed once released
+	files, err := ioutil.ReadDir(c.rootDir + "/" + LockDir)
+	if err != nil {
+		t.Fatalf("failed to read lock directory: %s", err)
+	}
+	if len(files) != 0 {
+		t.Errorf("%d lock files left", len(files))
+	}
+
+	// locks of a disabled cache are no-op
+	disabled := &Handle{disabled: true}
+	l, err := disabled.LockEntry(entry)
+	if err != nil || l != nil {
+		t.Errorf("unexpected lock for a disabled cache: %v %v", l, err)
+	}
+	if err := l.Unlock(); err != nil {
+		t.Errorf("unexpected error while unlocking a nil lock: %s", err)
+	}
+}
+
+func TestFillEntry(t *testing.T) {
+	test.DropPrivilege(t)
+	defer test.ResetPrivilege(t)
+
+	tempImageCache, err := ioutil.TempDir("", "image-cache-")
+	if err != nil {
+		t.Fatal("failed to create temporary image cache directory:", err)
+	}
+	defer os.RemoveAll(tempImageCache)
+
+	c, err := NewHandle(Config{BaseDir: tempImageCache})
+	if err != nil {
+		t.Fatalf("failed to create new image cache handle: %s", err)
+	}
+	c.checkIfCacheDisabled(t)
+
+	const sum = "0123456789abcdef"
+	entry := c.LayerImage(sum, "layer.sqfs")
+	exists := func() (bool, error) {
+		return c.LayerImageExists(sum, "layer.sqfs")
+	}
+
+	// concurrent fills of the same entry fill it once, the entry
+	// never exists partially
+	var (
+		wg    sync.WaitGroup
+		mu    sync.Mutex
+		fills int
+	)
+	for i := 0; i < 8; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+
+			f, err := c.FillEntry(entry, exists)
+			if err != nil {
+				t.Errorf("unexpected error while filling entry: %s", err)
+				return
+			}
+			if f == nil {
+				if b, err := ioutil.ReadFile(entry); err != nil || string(b) != "image" {
+					t.Errorf("unexpected entry content %q: %v", b, err)
+				}
+				return
+			}
+			defer f.Close()
+
+			if err := ioutil.WriteFile(f.Temp, []byte("ima"), 0644); err != nil {
+				t.Errorf("failed to fill entry: %s", err)
+			}
+			time.Sleep(50 * time.Millisecond)
+			if _, err := os.Stat(entry); err == nil {
+				t.Errorf("partial entry found")
+			}
+			if err := ioutil.WriteFile(f.Temp, []byte("image"), 0644); err != nil {
+				t.Errorf("failed to fill entry: %s", err)
+			}
+			if err := f.Commit(); err != nil {
+				t.Errorf("unexpected error while committing entry: %s", err)
+			}
+			mu.Lock()
+			fills++
+			mu.Unlock()
+		}()
+	}
+	wg.Wait()
+
+	if fills != 1 {
+		t.Errorf("entry filled %d times", fills)
+	}
+
+	// the temporary file of a fill not committed is removed
+	os.Remove(entry)
+	f, err := c.FillEntry(entry, exists)
+	if err != nil || f == nil {
+		t.Fatalf("unexpected fill %v: %v", f, err)
+	}
+	if err := ioutil.WriteFile(f.Temp, []byte("ima"), 0644); err != nil {
+		t.Fatalf("failed to fill entry: %s", err)
+	}
+	if err := f.Close(); err != nil {
+		t.Errorf("unexpected error while closing fill: %s", err)
+	}
+	for _, path := range []string{entry, entry + fillSuffix} {
+		if _, err := os.Stat(path); err == nil {
+			t.Errorf("unexpected file %s", path)
+		}
+	}
+
+	// a disabled cache can't be filled
+	disabled := &Handle{disabled: true}
+	if f, err := disabled.FillEntry(entry, exists); err == nil || f != nil {
+		t.Errorf("unexpected fill for a disabled cache")
+	}
+}
@@ -56,12 +56,15 @@ func (c *Handle) OciTempExists(sum, name string) (bool, error) {
 		return false, nil
 	}
 
-	_, err := os.Stat(c.OciTempImage(sum, name))
+	imagePath := c.OciTempImage(sum, name)
+	_, err := os.Stat(imagePath)
 	if os.IsNotExist(err) {
-		return false, nil
+		return c.linkSystemImage(OciTempDir, sum, name, imagePath)
 	} else if err != nil {
 		return false, err
 	}
 
+	c.recordAccess(imagePath)
+
 	return true, nil
 }
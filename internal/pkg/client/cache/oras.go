@@ -6,10 +6,11 @@
 package cache
 
 import (
+	"crypto/sha256"
+	"encoding/hex"
+	"io"
 	"os"
 	"path/filepath"
-
-	"github.com/sylabs/singularity/internal/pkg/oras"
 )
 
 const (
@@ -50,12 +51,16 @@ func (c *Handle) OrasImageExists(sum, name string) (bool, error) {
 	imagePath := c.OrasImage(sum, name)
 	_, err := os.Stat(imagePath)
 	if os.IsNotExist(err) {
-		return false, nil
+		// the system cache image is checked against its hash
+		// like user cache images
+		if found, err := c.linkSystemImage(OrasDir, sum, name, imagePath); !found || err != nil {
+			return false, err
+		}
 	} else if err != nil {
 		return false, err
 	}
 
-	cacheSum, err := oras.ImageHash(imagePath)
+	cacheSum, err := orasImageHash(imagePath)
 	if err != nil {
 		return false, err
 	}
@@ -63,5 +68,24 @@ func (c *Handle) OrasImageExists(sum, name string) (bool, error) {
 		return false, ErrBadChecksum
 	}
 
+	c.recordAccess(imagePath)
+
 	return true, nil
 }
+
+// orasImageHash returns the digest of the image path like oras.ImageHash,
+// the oras package isn't imported as it depends on the image package
+// which uses the cache.
+func orasImageHash(path string) (string, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return "", err
+	}
+	defer f.Close()
+
+	h := sha256.New()
+	if _, err := io.Copy(h, f); err != nil {
+		return "", err
+	}
+	return "sha256:" + hex.EncodeToString(h.Sum(nil)), nil
+}
@@ -11,7 +11,6 @@ import (
 	"path/filepath"
 	"testing"
 
-	"github.com/sylabs/singularity/internal/pkg/oras"
 	"github.com/sylabs/singularity/internal/pkg/test"
 	"github.com/sylabs/singularity/internal/pkg/util/fs"
 )
@@ -52,7 +51,7 @@ func TestOrasImage(t *testing.T) {
 	if err != nil {
 		t.Fatalf("failed to create temporary file: %s", err)
 	}
-	hash, err := oras.ImageHash(validImagePath)
+	hash, err := orasImageHash(validImagePath)
 	if err != nil {
 		t.Fatalf("failed to get hash for image %s: %s", validImagePath, err)
 	}
@@ -45,12 +45,15 @@ func (c *Handle) ShubImageExists(sum, name string) (bool, error) {
 		return false, nil
 	}
 
-	_, err := os.Stat(c.ShubImage(sum, name))
+	imagePath := c.ShubImage(sum, name)
+	_, err := os.Stat(imagePath)
 	if os.IsNotExist(err) {
-		return false, nil
+		return c.linkSystemImage(ShubDir, sum, name, imagePath)
 	} else if err != nil {
 		return false, err
 	}
 
+	c.recordAccess(imagePath)
+
 	return true, nil
 }
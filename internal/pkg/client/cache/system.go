@@ -0,0 +1,94 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package cache
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"syscall"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+)
+
+// systemCacheOwner is the owner required for the system cache images
+// and their directories, overridden by unit tests.
+var systemCacheOwner uint32 = 0
+
+// trustedSystemPath returns whether path is owned by the system cache
+// owner and not writable by others.
+func trustedSystemPath(path string) bool {
+	fi, err := os.Stat(path)
+	if err != nil {
+		return false
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !ok {
+		return false
+	}
+	return st.Uid == systemCacheOwner && fi.Mode().Perm()&0022 == 0
+}
+
+// systemImage returns the path of the image sum/name of the cache
+// directory dir in the system cache, or an empty string if the system
+// cache doesn't have it or if the image isn't trusted.
+func (c *Handle) systemImage(dir, sum, name string) string {
+	if c.systemRoot == "" || c.systemRoot == c.rootDir {
+		return ""
+	}
+
+	path := filepath.Join(c.systemRoot, dir, sum, name)
+	if _, err := os.Stat(path); err != nil {
+		return ""
+	}
+	for _, p := range []string{path, filepath.Dir(path), filepath.Dir(filepath.Dir(path)), c.systemRoot} {
+		if !trustedSystemPath(p) {
+			sylog.Warningf("Ignoring system cache image %s: %s is not owned by root or writable by others", path, p)
+			return ""
+		}
+	}
+	return path
+}
+
+// linkSystemImage references the image sum/name of the cache directory
+// dir from the system cache at path in the user cache, with a hard link
+// when possible or with a symbolic link otherwise, and returns whether
+// the system cache has the image. Images with a content hash are checked
+// by the caller once referenced, other images are trusted as populated by
+// the administrator.
+func (c *Handle) linkSystemImage(dir, sum, name, path string) (bool, error) {
+	systemPath := c.systemImage(dir, sum, name)
+	if systemPath == "" {
+		// a link to an image removed from the system cache is
+		// removed, the image is then filled in the user cache
+		if fi, err := os.Lstat(path); err == nil && fi.Mode()&os.ModeSymlink != 0 {
+			os.Remove(path)
+		}
+		return false, nil
+	}
+
+	sylog.Debugf("Using system cache image %s", systemPath)
+
+	// linked at a temporary location renamed in place, so that
+	// concurrent processes never see a partial link
+	tmp := fmt.Sprintf("%s.%d.link", path, os.Getpid())
+	os.Remove(tmp)
+	if err := os.Link(systemPath, tmp); err != nil {
+		// hard links to files owned by other users are usually
+		// forbidden (fs.protected_hardlinks), or across filesystems
+		if err := os.Symlink(systemPath, tmp); err != nil {
+			return false, fmt.Errorf("while referencing system cache image %s: %s", systemPath, err)
+		}
+	}
+	if err := os.Rename(tmp, path); err != nil {
+		os.Remove(tmp)
+		return false, fmt.Errorf("while referencing system cache image %s: %s", systemPath, err)
+	}
+
+	c.insert(path)
+
+	return true, nil
+}
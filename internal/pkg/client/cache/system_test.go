@@ -0,0 +1,89 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package cache
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+
+	"github.com/sylabs/singularity/internal/pkg/test"
+)
+
+func TestSystemCache(t *testing.T) {
+	test.DropPrivilege(t)
+	defer test.ResetPrivilege(t)
+
+	// the system cache is populated by the test user
+	defer func(owner uint32) { systemCacheOwner = owner }(systemCacheOwner)
+	systemCacheOwner = uint32(os.Getuid())
+
+	tempDir, err := ioutil.TempDir("", "system-cache-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(tempDir)
+
+	systemDir := filepath.Join(tempDir, "system")
+	userDir := filepath.Join(tempDir, "user")
+
+	// populated by the administrator, the directories are readable
+	// by all users
+	system, err := NewHandle(Config{BaseDir: systemDir, SystemDir: systemDir})
+	if err != nil {
+		t.Fatalf("failed to create system cache handle: %s", err)
+	}
+	system.checkIfCacheDisabled(t)
+
+	c, err := NewHandle(Config{BaseDir: userDir, SystemDir: systemDir})
+	if err != nil {
+		t.Fatalf("failed to create user cache handle: %s", err)
+	}
+
+	systemPath := system.LayerImage("shared", "layer.sqfs")
+	if err := ioutil.WriteFile(systemPath, []byte("layer"), 0644); err != nil {
+		t.Fatal(err)
+	}
+	for _, dir := range []string{systemDir, system.rootDir, system.Layer, filepath.Dir(systemPath)} {
+		if fi, err := os.Stat(dir); err != nil || fi.Mode().Perm() != 0755 {
+			t.Errorf("unexpected system cache directory %s permission", dir)
+		}
+	}
+
+	// images missing from both caches
+	if exists, err := c.LayerImageExists("missing", "layer.sqfs"); err != nil || exists {
+		t.Errorf("LayerImageExists() reported a missing layer: %v %v", exists, err)
+	}
+
+	// images from the system cache are referenced in the user cache
+	if exists, err := c.LayerImageExists("shared", "layer.sqfs"); err != nil || !exists {
+		t.Fatalf("LayerImageExists() didn't report a system cache layer: %v %v", exists, err)
+	}
+	b, err := ioutil.ReadFile(c.LayerImage("shared", "layer.sqfs"))
+	if err != nil || string(b) != "layer" {
+		t.Errorf("unexpected user cache image content %q: %v", b, err)
+	}
+	if entries, err := c.Entries(c.Layer); err != nil || len(entries) != 1 {
+		t.Errorf("system cache image not indexed: %+v %v", entries, err)
+	}
+
+	// images writable by others are ignored
+	if err := os.Remove(c.LayerImage("shared", "layer.sqfs")); err != nil {
+		t.Fatal(err)
+	}
+	if err := os.Chmod(systemPath, 0666); err != nil {
+		t.Fatal(err)
+	}
+	if exists, err := c.LayerImageExists("shared", "layer.sqfs"); err != nil || exists {
+		t.Errorf("LayerImageExists() reported an untrusted system cache layer: %v %v", exists, err)
+	}
+
+	// the system cache isn't consulted by the system cache itself
+	if system.systemImage(LayerDir, "shared", "layer.sqfs") != "" {
+		t.Errorf("system cache image referenced from itself")
+	}
+}
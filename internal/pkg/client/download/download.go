@@ -0,0 +1,626 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+// Package download implements a resumable HTTP file downloader, fetching
+// files in chunks with concurrent range requests when the server supports
+// them.
+package download
+
+import (
+	"context"
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"fmt"
+	"hash"
+	"io"
+	"io/ioutil"
+	"net/http"
+	"net/url"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+)
+
+const (
+	// DefaultConcurrency is the default number of chunks downloaded
+	// at the same time.
+	DefaultConcurrency = 4
+	// DefaultChunkSize is the default size of the chunks requested
+	// with range requests.
+	DefaultChunkSize = 32 << 20
+
+	// maxAttempts is the number of attempts to download a chunk
+	// before giving up.
+	maxAttempts = 3
+
+	// partialSuffix is appended to the destination path of a download
+	// in progress, and stateSuffix to the path of its resume state.
+	partialSuffix = ".partial"
+	stateSuffix   = ".partial.json"
+)
+
+// Progress reports the progress of a download.
+type Progress interface {
+	// Start is called once the file size is known, with the number of
+	// bytes already downloaded by a previous attempt. The size is -1 if
+	// unknown.
+	Start(size, done int64)
+	// Add is called concurrently with the number of bytes downloaded.
+	Add(n int64)
+	// Finish is called once the download is complete.
+	Finish()
+}
+
+// Options are the download options.
+type Options struct {
+	// Client is the HTTP client used for requests, http.DefaultClient
+	// if nil.
+	Client *http.Client
+	// Header is added to requests sent to the host of the download
+	// URL, only the User-Agent is sent to the host it redirects to.
+	Header http.Header
+	// Concurrency is the number of chunks downloaded at the same time,
+	// DefaultConcurrency if zero.
+	Concurrency int
+	// ChunkSize is the size of the chunks requested with range requests,
+	// DefaultChunkSize if zero.
+	ChunkSize int64
+	// SHA256 is the expected SHA256 sum of the file in hexadecimal, if
+	// known.
+	SHA256 string
+	// Progress, if not nil, reports the download progress.
+	Progress Progress
+}
+
+// StatusError is returned when the server responds with an unexpected
+// status code.
+type StatusError struct {
+	StatusCode int
+	Body       string
+}
+
+func (e *StatusError) Error() string {
+	if e.StatusCode == http.StatusNotFound {
+		return "the requested file was not found"
+	}
+	return fmt.Sprintf("download did not succeed: %d %s", e.StatusCode, e.Body)
+}
+
+// state is the resume state of a ranged download, saved alongside the
+// partial file.
+type state struct {
+	URL          string `json:"url"`
+	Size         int64  `json:"size"`
+	ETag         string `json:"etag,omitempty"`
+	LastModified string `json:"lastModified,omitempty"`
+	ChunkSize    int64  `json:"chunkSize"`
+	// Chunks maps the index of downloaded chunks to their SHA256 sum.
+	Chunks map[int]string `json:"chunks"`
+}
+
+type downloader struct {
+	opts Options
+	url  *url.URL
+	path string
+	f    *os.File
+
+	mu   sync.Mutex
+	cond *sync.Cond
+	st   *state
+	// chunkURL is the URL the download was redirected to, chunks are
+	// requested to it directly
+	chunkURL *url.URL
+	// done is set for chunks written to the partial file, a failed
+	// download sets failed to stop the file hashing
+	done   []bool
+	failed bool
+}
+
+// File downloads the file at rawurl to path and returns its SHA256 sum in
+// hexadecimal. The file is written to path with a ".partial" suffix and
+// renamed once complete. When the server supports range requests, the
+// file is downloaded in chunks by concurrent requests and a failed
+// download is resumed by the next call with the same URL: chunks already
+// downloaded are verified against their recorded SHA256 sum and the
+// server validators (ETag, Last-Modified) must match. Downloads of files
+// served without validator are restarted.
+func File(ctx context.Context, rawurl, path string, opts Options) (string, error) {
+	u, err := url.Parse(rawurl)
+	if err != nil {
+		return "", fmt.Errorf("invalid download URL %s: %s", rawurl, err)
+	}
+	if opts.Client == nil {
+		opts.Client = http.DefaultClient
+	}
+	if opts.Concurrency <= 0 {
+		opts.Concurrency = DefaultConcurrency
+	}
+	if opts.ChunkSize <= 0 {
+		opts.ChunkSize = DefaultChunkSize
+	}
+
+	d := &downloader{
+		opts: opts,
+		url:  u,
+		path: path,
+	}
+	d.cond = sync.NewCond(&d.mu)
+
+	previous := d.loadState()
+
+	res, err := d.get(ctx, u, fmt.Sprintf("bytes=0-%d", opts.ChunkSize-1), "")
+	if e, ok := err.(*StatusError); ok && e.StatusCode == http.StatusRequestedRangeNotSatisfiable {
+		// empty file
+		res, err = d.get(ctx, u, "", "")
+	}
+	if err != nil {
+		return "", err
+	}
+
+	size, ranged := contentRange(res, 0)
+	if !ranged && res.StatusCode == http.StatusPartialContent {
+		// unknown size
+		res.Body.Close()
+		res, err = d.get(ctx, u, "", "")
+		if err != nil {
+			return "", err
+		}
+	}
+
+	var sum string
+
+	if ranged {
+		d.chunkURL = res.Request.URL
+		sum, err = d.ranged(ctx, res, size, previous)
+	} else {
+		sum, err = d.single(res)
+	}
+	if err != nil {
+		return "", err
+	}
+
+	if opts.SHA256 != "" && !strings.EqualFold(sum, opts.SHA256) {
+		d.remove()
+		return "", fmt.Errorf("downloaded file SHA256 sum %s doesn't match the expected %s", sum, opts.SHA256)
+	}
+	if err := os.Rename(path+partialSuffix, path); err != nil {
+		return "", err
+	}
+	os.Remove(path + stateSuffix)
+
+	if opts.Progress != nil {
+		opts.Progress.Finish()
+	}
+	return sum, nil
+}
+
+// get sends a GET request for u with the optional range and If-Range
+// headers, a response status other than OK or Partial Content is
+// returned as a StatusError.
+func (d *downloader) get(ctx context.Context, u *url.URL, byteRange, ifRange string) (*http.Response, error) {
+	req, err := http.NewRequest(http.MethodGet, u.String(), nil)
+	if err != nil {
+		return nil, err
+	}
+	req = req.WithContext(ctx)
+
+	for k, v := range d.opts.Header {
+		if u.Host == d.url.Host || http.CanonicalHeaderKey(k) == "User-Agent" {
+			req.Header[k] = v
+		}
+	}
+	if byteRange != "" {
+		req.Header.Set("Range", byteRange)
+	}
+	if ifRange != "" {
+		req.Header.Set("If-Range", ifRange)
+	}
+
+	res, err := d.opts.Client.Do(req)
+	if err != nil {
+		return nil, err
+	}
+	if res.StatusCode != http.StatusOK && res.StatusCode != http.StatusPartialContent {
+		body, _ := ioutil.ReadAll(io.LimitReader(res.Body, 4096))
+		res.Body.Close()
+		return nil, &StatusError{StatusCode: res.StatusCode, Body: string(body)}
+	}
+	return res, nil
+}
+
+// contentRange returns the total size of a partial content response
+// starting at offset start, and whether the response is such a partial
+// content response.
+func contentRange(res *http.Response, start int64) (int64, bool) {
+	if res.StatusCode != http.StatusPartialContent {
+		return 0, false
+	}
+	// bytes <start>-<end>/<size>
+	cr := strings.TrimPrefix(res.Header.Get("Content-Range"), "bytes ")
+	slash := strings.LastIndex(cr, "/")
+	dash := strings.Index(cr, "-")
+	if slash < 0 || dash < 0 || dash > slash {
+		return 0, false
+	}
+	first, err := strconv.ParseInt(cr[:dash], 10, 64)
+	if err != nil || first != start {
+		return 0, false
+	}
+	size, err := strconv.ParseInt(cr[slash+1:], 10, 64)
+	if err != nil {
+		return 0, false
+	}
+	return size, true
+}
+
+// single downloads the file with the response of a server not
+// supporting range requests, hashing it while it's written.
+func (d *downloader) single(res *http.Response) (string, error) {
+	defer res.Body.Close()
+
+	sylog.Debugf("Range requests not supported, downloading %s with a single request", d.url)
+
+	// a previous ranged download can't be resumed
+	os.Remove(d.path + stateSuffix)
+
+	// Perms are 777 *prior* to umask
+	f, err := os.OpenFile(d.path+partialSuffix, os.O_CREATE|os.O_TRUNC|os.O_WRONLY, 0777)
+	if err != nil {
+		return "", err
+	}
+	defer f.Close()
+
+	h := sha256.New()
+	w := io.MultiWriter(f, h)
+	if d.opts.Progress != nil {
+		d.opts.Progress.Start(res.ContentLength, 0)
+		w = io.MultiWriter(w, progressWriter{d.opts.Progress})
+	}
+
+	n, err := io.Copy(w, res.Body)
+	if err == nil && res.ContentLength >= 0 && n != res.ContentLength {
+		err = io.ErrUnexpectedEOF
+	}
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err != nil {
+		os.Remove(d.path + partialSuffix)
+		return "", fmt.Errorf("while downloading %s: %s", d.url, err)
+	}
+	return hex.EncodeToString(h.Sum(nil)), nil
+}
+
+// ranged downloads the file of the given size in chunks, res being the
+// response to the request of the first chunk.
+func (d *downloader) ranged(ctx context.Context, res *http.Response, size int64, previous *state) (sum string, err error) {
+	st := &state{
+		URL:          d.url.String(),
+		Size:         size,
+		ETag:         res.Header.Get("ETag"),
+		LastModified: res.Header.Get("Last-Modified"),
+		ChunkSize:    d.opts.ChunkSize,
+		Chunks:       make(map[int]string),
+	}
+	// without validator, chunks of a changed file would be mixed, as
+	// well as chunks of another file with the same size and validators
+	resume := previous != nil && previous.URL == st.URL && previous.ChunkSize == st.ChunkSize &&
+		previous.Size == st.Size && st.ifRange() != "" &&
+		previous.ETag == st.ETag && previous.LastModified == st.LastModified
+	if resume {
+		st.Chunks = previous.Chunks
+	} else {
+		os.Remove(d.path + stateSuffix)
+	}
+	d.st = st
+
+	// Perms are 777 *prior* to umask
+	flags := os.O_CREATE | os.O_RDWR
+	if !resume {
+		flags |= os.O_TRUNC
+	}
+	d.f, err = os.OpenFile(d.path+partialSuffix, flags, 0777)
+	if err != nil {
+		res.Body.Close()
+		return "", err
+	}
+	defer d.f.Close()
+
+	if err := d.f.Truncate(size); err != nil {
+		res.Body.Close()
+		return "", err
+	}
+
+	chunks := int((size + d.opts.ChunkSize - 1) / d.opts.ChunkSize)
+	d.done = make([]bool, chunks)
+
+	var doneBytes int64
+	for i, s := range st.Chunks {
+		if i < 0 || i >= chunks || !d.verifyChunk(i, s) {
+			delete(st.Chunks, i)
+			continue
+		}
+		d.done[i] = true
+		doneBytes += d.chunkLength(i)
+	}
+	if len(st.Chunks) > 0 {
+		sylog.Infof("Resuming download of %s, %d/%d chunks already downloaded", d.url, len(st.Chunks), chunks)
+	}
+	if d.opts.Progress != nil {
+		d.opts.Progress.Start(size, doneBytes)
+	}
+
+	// the file is hashed in order as chunks are written
+	sums := make(chan string, 1)
+	go func() {
+		sums <- d.hashFile(chunks)
+	}()
+
+	ctx, cancel := context.WithCancel(ctx)
+	defer cancel()
+
+	sem := make(chan struct{}, d.opts.Concurrency)
+	errs := make(chan error, chunks)
+	pending := 0
+
+	if chunks == 0 || d.done[0] {
+		res.Body.Close()
+	}
+
+	// chunks are requested in order, the first one with the response
+	// already received
+	for i := 0; i < chunks; i++ {
+		if d.done[i] {
+			continue
+		}
+		var body io.ReadCloser
+		if i == 0 {
+			body = res.Body
+		}
+		pending++
+		sem <- struct{}{}
+		go func(i int, body io.ReadCloser) {
+			defer func() { <-sem }()
+			err := d.fetchChunk(ctx, i, body)
+			if err != nil {
+				// stop the other chunks downloads
+				cancel()
+			}
+			errs <- err
+		}(i, body)
+	}
+
+	// the first error other than the cancellation it caused is returned
+	for ; pending > 0; pending-- {
+		if e := <-errs; e != nil && (err == nil || err == context.Canceled) {
+			err = e
+		}
+	}
+
+	if err != nil {
+		d.mu.Lock()
+		d.failed = true
+		d.cond.Broadcast()
+		d.mu.Unlock()
+		<-sums
+		return "", err
+	}
+
+	sum = <-sums
+	if sum == "" {
+		return "", fmt.Errorf("while hashing %s", d.path+partialSuffix)
+	}
+	return sum, nil
+}
+
+// chunkLength returns the length of chunk i.
+func (d *downloader) chunkLength(i int) int64 {
+	start := int64(i) * d.opts.ChunkSize
+	if end := start + d.opts.ChunkSize; end < d.st.Size {
+		return d.opts.ChunkSize
+	}
+	return d.st.Size - start
+}
+
+// verifyChunk checks that chunk i of the partial file matches its sum.
+func (d *downloader) verifyChunk(i int, sum string) bool {
+	h := sha256.New()
+	r := io.NewSectionReader(d.f, int64(i)*d.opts.ChunkSize, d.chunkLength(i))
+	if _, err := io.Copy(h, r); err != nil {
+		return false
+	}
+	return hex.EncodeToString(h.Sum(nil)) == sum
+}
+
+// ifRange returns the validator sent with the If-Range header of chunk
+// requests so that the file doesn't change during the download, it's
+// empty if the server didn't send a strong validator.
+func (st *state) ifRange() string {
+	if st.ETag != "" && !strings.HasPrefix(st.ETag, "W/") {
+		return st.ETag
+	}
+	return st.LastModified
+}
+
+// getChunkURL returns the URL chunks are requested to.
+func (d *downloader) getChunkURL() *url.URL {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	return d.chunkURL
+}
+
+// fetchChunk downloads chunk i, body being the response body of a
+// request already sent for this chunk if not nil.
+func (d *downloader) fetchChunk(ctx context.Context, i int, body io.ReadCloser) (err error) {
+	start := int64(i) * d.opts.ChunkSize
+	length := d.chunkLength(i)
+	byteRange := fmt.Sprintf("bytes=%d-%d", start, start+length-1)
+	ifRange := d.st.ifRange()
+	resolved := false
+
+	for attempt := 1; attempt <= maxAttempts; attempt++ {
+		if err := ctx.Err(); err != nil {
+			return err
+		}
+		if body == nil {
+			var res *http.Response
+			chunkURL := d.getChunkURL()
+			res, err = d.get(ctx, chunkURL, byteRange, ifRange)
+			if _, ok := err.(*StatusError); ok && !resolved && chunkURL.String() != d.url.String() {
+				// the URL the download was redirected to may have
+				// expired, like presigned storage URLs, it's
+				// resolved again once from the download URL
+				sylog.Debugf("Chunk %d request to %s failed: %s, resolving %s again", i, chunkURL, err, d.url)
+				resolved = true
+				res, err = d.get(ctx, d.url, byteRange, ifRange)
+				if err == nil {
+					d.mu.Lock()
+					d.chunkURL = res.Request.URL
+					d.mu.Unlock()
+				}
+			}
+			if err != nil {
+				if _, ok := err.(*StatusError); ok {
+					return err
+				}
+				sylog.Debugf("Chunk %d download attempt %d failed: %s", i, attempt, err)
+				continue
+			}
+			if size, ok := contentRange(res, start); !ok || size != d.st.Size {
+				res.Body.Close()
+				return fmt.Errorf("%s changed during the download", d.url)
+			}
+			body = res.Body
+		}
+
+		var sum string
+		sum, err = d.writeChunk(i, body, start, length)
+		body.Close()
+		body = nil
+		if err == nil {
+			return d.chunkDone(i, sum)
+		}
+		sylog.Debugf("Chunk %d download attempt %d failed: %s", i, attempt, err)
+	}
+	return fmt.Errorf("while downloading %s: %s", d.url, err)
+}
+
+// writeChunk writes the chunk i read from r at offset start of the
+// partial file and returns its SHA256 sum.
+func (d *downloader) writeChunk(i int, r io.Reader, start, length int64) (string, error) {
+	h := sha256.New()
+	var w io.Writer = &offsetWriter{f: d.f, off: start}
+	w = io.MultiWriter(w, h)
+	if d.opts.Progress != nil {
+		w = io.MultiWriter(w, progressWriter{d.opts.Progress})
+	}
+
+	n, err := io.Copy(w, io.LimitReader(r, length))
+	if err != nil {
+		return "", err
+	}
+	if n != length {
+		return "", io.ErrUnexpectedEOF
+	}
+	return hex.EncodeToString(h.Sum(nil)), nil
+}
+
+// chunkDone records chunk i as downloaded and saves the resume state.
+func (d *downloader) chunkDone(i int, sum string) error {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+
+	d.done[i] = true
+	d.st.Chunks[i] = sum
+	d.cond.Broadcast()
+
+	return d.saveState()
+}
+
+// hashFile returns the SHA256 sum of the partial file, hashing chunks
+// in order as soon as they are written. It returns an empty string if
+// the download failed.
+func (d *downloader) hashFile(chunks int) string {
+	h := sha256.New()
+	for i := 0; i < chunks; i++ {
+		d.mu.Lock()
+		for !d.done[i] && !d.failed {
+			d.cond.Wait()
+		}
+		failed := d.failed
+		d.mu.Unlock()
+
+		if failed || !hashSection(h, d.f, int64(i)*d.opts.ChunkSize, d.chunkLength(i)) {
+			return ""
+		}
+	}
+	return hex.EncodeToString(h.Sum(nil))
+}
+
+func hashSection(h hash.Hash, f *os.File, off, n int64) bool {
+	_, err := io.Copy(h, io.NewSectionReader(f, off, n))
+	return err == nil
+}
+
+// saveState writes the resume state, d.mu must be held.
+func (d *downloader) saveState() error {
+	data, err := json.Marshal(d.st)
+	if err != nil {
+		return err
+	}
+	tmp := d.path + stateSuffix + ".tmp"
+	if err := ioutil.WriteFile(tmp, data, 0644); err != nil {
+		return err
+	}
+	return os.Rename(tmp, d.path+stateSuffix)
+}
+
+// loadState returns the resume state of a previous download of the
+// same URL with the same chunk size, or nil.
+func (d *downloader) loadState() *state {
+	data, err := ioutil.ReadFile(d.path + stateSuffix)
+	if err != nil {
+		return nil
+	}
+	st := new(state)
+	if err := json.Unmarshal(data, st); err != nil {
+		return nil
+	}
+	if st.URL != d.url.String() || st.ChunkSize != d.opts.ChunkSize || st.Chunks == nil {
+		return nil
+	}
+	return st
+}
+
+// remove removes the partial file and its resume state.
+func (d *downloader) remove() {
+	os.Remove(d.path + partialSuffix)
+	os.Remove(d.path + stateSuffix)
+}
+
+// offsetWriter writes sequentially to a file from an offset.
+type offsetWriter struct {
+	f   *os.File
+	off int64
+}
+
+func (w *offsetWriter) Write(b []byte) (int, error) {
+	n, err := w.f.WriteAt(b, w.off)
+	w.off += int64(n)
+	return n, err
+}
+
+type progressWriter struct {
+	p Progress
+}
+
+func (w progressWriter) Write(b []byte) (int, error) {
+	w.p.Add(int64(len(b)))
+	return len(b), nil
+}
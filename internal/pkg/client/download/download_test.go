@@ -0,0 +1,459 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package download
+
+import (
+	"bytes"
+	"context"
+	"crypto/sha256"
+	"encoding/hex"
+	"fmt"
+	"io/ioutil"
+	"math/rand"
+	"net/http"
+	"net/http/httptest"
+	"os"
+	"path/filepath"
+	"reflect"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// testServer serves a file with range requests support, requests for
+// the ranges listed in fail are aborted once the response headers are
+// sent.
+type testServer struct {
+	*httptest.Server
+	data   []byte
+	etag   string
+	ranges bool
+
+	mu       sync.Mutex
+	fail     map[string]int
+	requests []string
+	headers  []http.Header
+}
+
+func newTestServer(data []byte, ranges bool) *testServer {
+	s := &testServer{
+		data:   data,
+		etag:   `"v1"`,
+		ranges: ranges,
+		fail:   make(map[string]int),
+	}
+	s.Server = httptest.NewServer(s)
+	return s
+}
+
+func (s *testServer) ServeHTTP(w http.ResponseWriter, r *http.Request) {
+	rng := r.Header.Get("Range")
+
+	s.mu.Lock()
+	s.requests = append(s.requests, rng)
+	s.headers = append(s.headers, r.Header)
+	fail := s.fail[rng] > 0
+	if fail {
+		s.fail[rng]--
+	}
+	data, etag := s.data, s.etag
+	s.mu.Unlock()
+
+	if r.URL.Path == "/redirect" {
+		http.Redirect(w, r, "/file", http.StatusFound)
+		return
+	}
+	if r.URL.Path != "/file" {
+		http.NotFound(w, r)
+		return
+	}
+
+	if !s.ranges {
+		w.Write(data)
+		return
+	}
+	if fail {
+		// drop the connection in the middle of the response
+		hj, ok := w.(http.Hijacker)
+		if !ok {
+			panic("hijacking not supported")
+		}
+		conn, buf, _ := hj.Hijack()
+		fmt.Fprintf(buf, "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %s/%d\r\nConnection: close\r\n\r\nabc", strings.TrimPrefix(rng, "bytes="), len(data))
+		buf.Flush()
+		conn.Close()
+		return
+	}
+
+	if etag != "" {
+		w.Header().Set("ETag", etag)
+	}
+	http.ServeContent(w, r, "", time.Unix(0, 0), bytes.NewReader(data))
+}
+
+func (s *testServer) reset() {
+	s.mu.Lock()
+	s.requests = nil
+	s.headers = nil
+	s.mu.Unlock()
+}
+
+func randomData(size int) []byte {
+	data := make([]byte, size)
+	rand.Read(data)
+	return data
+}
+
+func sha256Hex(data []byte) string {
+	sum := sha256.Sum256(data)
+	return hex.EncodeToString(sum[:])
+}
+
+type testProgress struct {
+	size, done, added int64
+	finished          bool
+}
+
+func (p *testProgress) Start(size, done int64) {
+	p.size = size
+	p.done = done
+}
+
+func (p *testProgress) Add(n int64) {
+	atomic.AddInt64(&p.added, n)
+}
+
+func (p *testProgress) Finish() {
+	p.finished = true
+}
+
+func TestFile(t *testing.T) {
+	dir, err := ioutil.TempDir("", "download-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	data := randomData(10500)
+
+	tests := []struct {
+		name   string
+		data   []byte
+		ranges bool
+		path   string
+	}{
+		{"ranged", data, true, "/file"},
+		{"ranged redirect", data, true, "/redirect"},
+		{"single chunk", data[:700], true, "/file"},
+		{"empty", nil, true, "/file"},
+		{"no range support", data, false, "/file"},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			s := newTestServer(tt.data, tt.ranges)
+			defer s.Close()
+
+			dest := filepath.Join(dir, "file")
+			p := new(testProgress)
+
+			sum, err := File(context.Background(), s.URL+tt.path, dest, Options{
+				Header:      http.Header{"Authorization": []string{"Bearer token"}},
+				Concurrency: 3,
+				ChunkSize:   1000,
+				SHA256:      sha256Hex(tt.data),
+				Progress:    p,
+			})
+			if err != nil {
+				t.Fatalf("unexpected error: %s", err)
+			}
+			if sum != sha256Hex(tt.data) {
+				t.Errorf("unexpected SHA256 sum %s", sum)
+			}
+
+			b, err := ioutil.ReadFile(dest)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if !bytes.Equal(b, tt.data) {
+				t.Errorf("unexpected downloaded content")
+			}
+			if p.added != int64(len(tt.data)) || !p.finished {
+				t.Errorf("unexpected progress %+v", p)
+			}
+			if tt.ranges && tt.data != nil && p.size != int64(len(tt.data)) {
+				t.Errorf("unexpected progress size %d", p.size)
+			}
+			for _, suffix := range []string{partialSuffix, stateSuffix} {
+				if _, err := os.Stat(dest + suffix); err == nil {
+					t.Errorf("%s left", dest+suffix)
+				}
+			}
+		})
+	}
+}
+
+func TestFileResume(t *testing.T) {
+	dir, err := ioutil.TempDir("", "download-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	data := randomData(10500)
+	s := newTestServer(data, true)
+	defer s.Close()
+
+	dest := filepath.Join(dir, "file")
+
+	// the sixth chunk fails more times than retried
+	s.fail["bytes=5000-5999"] = maxAttempts
+	if _, err := File(context.Background(), s.URL+"/file", dest, Options{Concurrency: 1, ChunkSize: 1000}); err == nil {
+		t.Fatalf("unexpected success")
+	}
+	if _, err := os.Stat(dest + stateSuffix); err != nil {
+		t.Fatalf("resume state not saved: %s", err)
+	}
+
+	// the fourth chunk is corrupted on disk
+	f, err := os.OpenFile(dest+partialSuffix, os.O_RDWR, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, err := f.WriteAt([]byte{data[3500] ^ 0xff}, 3500); err != nil {
+		t.Fatal(err)
+	}
+	f.Close()
+
+	s.reset()
+	p := new(testProgress)
+	sum, err := File(context.Background(), s.URL+"/file", dest, Options{Concurrency: 2, ChunkSize: 1000, Progress: p})
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if sum != sha256Hex(data) {
+		t.Errorf("unexpected SHA256 sum %s", sum)
+	}
+	b, err := ioutil.ReadFile(dest)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !bytes.Equal(b, data) {
+		t.Errorf("unexpected downloaded content")
+	}
+
+	// the first chunk is always requested to check the file, then
+	// the corrupted chunk and the chunks not downloaded
+	requests := make(map[string]bool)
+	for _, r := range s.requests {
+		requests[r] = true
+	}
+	expected := map[string]bool{
+		"bytes=0-999":       true,
+		"bytes=3000-3999":   true,
+		"bytes=5000-5999":   true,
+		"bytes=6000-6999":   true,
+		"bytes=7000-7999":   true,
+		"bytes=8000-8999":   true,
+		"bytes=9000-9999":   true,
+		"bytes=10000-10499": true,
+	}
+	if !reflect.DeepEqual(requests, expected) {
+		t.Errorf("unexpected requests %v", s.requests)
+	}
+	if p.done != 4000 || p.added != int64(len(data))-4000 {
+		t.Errorf("unexpected progress %+v", p)
+	}
+
+	// a changed file isn't resumed
+	s.fail["bytes=5000-5999"] = maxAttempts
+	os.Remove(dest)
+	if _, err := File(context.Background(), s.URL+"/file", dest, Options{Concurrency: 1, ChunkSize: 1000}); err == nil {
+		t.Fatalf("unexpected success")
+	}
+	newData := randomData(10500)
+	s.mu.Lock()
+	s.data = newData
+	s.etag = `"v2"`
+	s.mu.Unlock()
+	s.reset()
+
+	sum, err = File(context.Background(), s.URL+"/file", dest, Options{Concurrency: 1, ChunkSize: 1000})
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if sum != sha256Hex(newData) {
+		t.Errorf("unexpected SHA256 sum %s", sum)
+	}
+	if len(s.requests) != 11 {
+		t.Errorf("unexpected number of requests %d", len(s.requests))
+	}
+
+	// a file served without validator isn't resumed
+	s.fail["bytes=5000-5999"] = maxAttempts
+	os.Remove(dest)
+	s.mu.Lock()
+	s.etag = ""
+	s.mu.Unlock()
+	if _, err := File(context.Background(), s.URL+"/file", dest, Options{Concurrency: 1, ChunkSize: 1000}); err == nil {
+		t.Fatalf("unexpected success")
+	}
+	s.reset()
+
+	sum, err = File(context.Background(), s.URL+"/file", dest, Options{Concurrency: 1, ChunkSize: 1000})
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if sum != sha256Hex(newData) {
+		t.Errorf("unexpected SHA256 sum %s", sum)
+	}
+	if len(s.requests) != 11 {
+		t.Errorf("download without validator resumed, %d requests", len(s.requests))
+	}
+
+	// a download of another URL isn't resumed
+	s.fail["bytes=5000-5999"] = maxAttempts
+	os.Remove(dest)
+	s.mu.Lock()
+	s.etag = `"v2"`
+	s.mu.Unlock()
+	if _, err := File(context.Background(), s.URL+"/file?a", dest, Options{Concurrency: 1, ChunkSize: 1000}); err == nil {
+		t.Fatalf("unexpected success")
+	}
+	s.reset()
+
+	if _, err := File(context.Background(), s.URL+"/file?b", dest, Options{Concurrency: 1, ChunkSize: 1000}); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if len(s.requests) != 11 {
+		t.Errorf("download of another URL resumed, %d requests", len(s.requests))
+	}
+}
+
+func TestFileErrors(t *testing.T) {
+	dir, err := ioutil.TempDir("", "download-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	data := randomData(5000)
+	s := newTestServer(data, true)
+	defer s.Close()
+
+	dest := filepath.Join(dir, "file")
+
+	_, err = File(context.Background(), s.URL+"/missing", dest, Options{})
+	if e, ok := err.(*StatusError); !ok || e.StatusCode != http.StatusNotFound {
+		t.Errorf("unexpected error for a missing file: %v", err)
+	}
+
+	_, err = File(context.Background(), s.URL+"/file", dest, Options{ChunkSize: 1000, SHA256: sha256Hex(nil)})
+	if err == nil {
+		t.Errorf("unexpected success with a wrong SHA256 sum")
+	}
+	for _, path := range []string{dest, dest + partialSuffix, dest + stateSuffix} {
+		if _, err := os.Stat(path); err == nil {
+			t.Errorf("%s left after a failed download", path)
+		}
+	}
+}
+
+func TestFileRedirectHeaders(t *testing.T) {
+	dir, err := ioutil.TempDir("", "download-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	data := randomData(3000)
+	storage := newTestServer(data, true)
+	defer storage.Close()
+
+	// the library redirects to a storage on another host
+	library := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		http.Redirect(w, r, storage.URL+"/file", http.StatusFound)
+	}))
+	defer library.Close()
+
+	_, err = File(context.Background(), library.URL+"/image", filepath.Join(dir, "file"), Options{
+		Header: http.Header{
+			"Authorization": []string{"Bearer token"},
+			"User-Agent":    []string{"singularity"},
+		},
+		ChunkSize: 1000,
+	})
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+
+	// only the first request is redirected, the next chunks are
+	// requested to the storage directly
+	if len(storage.headers) != 3 {
+		t.Errorf("unexpected number of storage requests %d", len(storage.headers))
+	}
+	for _, h := range storage.headers[1:] {
+		if h.Get("Authorization") != "" {
+			t.Errorf("authorization sent to the redirected host")
+		}
+		if h.Get("User-Agent") != "singularity" {
+			t.Errorf("user agent not sent to the redirected host")
+		}
+	}
+}
+
+func TestFileRedirectExpired(t *testing.T) {
+	dir, err := ioutil.TempDir("", "download-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	data := randomData(3000)
+
+	var mu sync.Mutex
+	resolved, served := 0, 0
+
+	// the storage URL given by the library expires after one request
+	storage := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		mu.Lock()
+		expired := r.URL.Query().Get("token") != strconv.Itoa(resolved) || served > 0
+		served++
+		mu.Unlock()
+		if expired {
+			http.Error(w, "expired", http.StatusForbidden)
+			return
+		}
+		w.Header().Set("ETag", `"v1"`)
+		http.ServeContent(w, r, "", time.Unix(0, 0), bytes.NewReader(data))
+	}))
+	defer storage.Close()
+
+	library := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		mu.Lock()
+		resolved++
+		served = 0
+		token := resolved
+		mu.Unlock()
+		http.Redirect(w, r, fmt.Sprintf("%s/file?token=%d", storage.URL, token), http.StatusFound)
+	}))
+	defer library.Close()
+
+	sum, err := File(context.Background(), library.URL+"/image", filepath.Join(dir, "file"), Options{Concurrency: 1, ChunkSize: 1000})
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if sum != sha256Hex(data) {
+		t.Errorf("unexpected SHA256 sum %s", sum)
+	}
+	// the first request and each expired chunk request
+	if resolved != 3 {
+		t.Errorf("storage URL resolved %d times instead of 3", resolved)
+	}
+}
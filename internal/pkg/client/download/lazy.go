@@ -0,0 +1,532 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package download
+
+import (
+	"context"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"net/http"
+	"net/url"
+	"os"
+	"strings"
+	"sync"
+	"syscall"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+)
+
+const (
+	// DefaultLazyChunkSize is the default size of the chunks of a lazy
+	// file fetched with range requests.
+	DefaultLazyChunkSize = 2 << 20
+	// MinLazyChunkSize and MaxLazyChunkSize bound the chunk size of lazy
+	// files, small enough to fetch little more than the data read and
+	// large enough to keep the number of requests low.
+	MinLazyChunkSize = 1 << 20
+	MaxLazyChunkSize = 4 << 20
+
+	// lazyStateSuffix is appended to the path of a lazy file for its
+	// state, and lazyChunksSuffix for the list of its fetched chunks,
+	// they must not match files found alongside regular images.
+	lazyStateSuffix  = ".lazystate"
+	lazyChunksSuffix = ".lazychunks"
+)
+
+// ErrRangeNotSupported is returned by CreateLazy when the server doesn't
+// support range requests, the file must then be downloaded with File.
+var ErrRangeNotSupported = errors.New("range requests not supported")
+
+// lazyState is the state of a lazy file, saved alongside the file.
+type lazyState struct {
+	URL string `json:"url"`
+	// ChunkURL is the URL the chunks are requested from, URL or the
+	// location it redirects to
+	ChunkURL     string `json:"chunkURL"`
+	Size         int64  `json:"size"`
+	ETag         string `json:"etag,omitempty"`
+	LastModified string `json:"lastModified,omitempty"`
+	ChunkSize    int64  `json:"chunkSize"`
+}
+
+// LazyFile is a remote file fetched on demand: chunks are fetched with
+// range requests when first read and written to a local sparse file,
+// the list of fetched chunks is kept alongside so that a lazy file is
+// reopened by other processes without fetching chunks again.
+type LazyFile struct {
+	d        *downloader
+	path     string
+	st       lazyState
+	f        *os.File
+	chunks   *os.File
+	chunkURL *url.URL
+
+	mu      sync.Mutex
+	cond    *sync.Cond
+	present []bool
+	pending []bool
+	missing int
+}
+
+// IsLazy returns whether path is a lazy file, with a valid state and
+// a list of fetched chunks.
+func IsLazy(path string) bool {
+	st, err := loadLazyState(path)
+	if err != nil || st.URL == "" || st.Size <= 0 || st.ChunkSize <= 0 {
+		return false
+	}
+	_, err = os.Stat(path + lazyChunksSuffix)
+	return err == nil
+}
+
+// lazyOptions returns opts with the default values set.
+func lazyOptions(opts Options) Options {
+	if opts.Client == nil {
+		opts.Client = http.DefaultClient
+	}
+	if opts.Concurrency <= 0 {
+		opts.Concurrency = DefaultConcurrency
+	}
+	if opts.ChunkSize <= 0 {
+		opts.ChunkSize = DefaultLazyChunkSize
+	} else if opts.ChunkSize < MinLazyChunkSize {
+		opts.ChunkSize = MinLazyChunkSize
+	} else if opts.ChunkSize > MaxLazyChunkSize {
+		opts.ChunkSize = MaxLazyChunkSize
+	}
+	return opts
+}
+
+// CreateLazy creates the lazy file path for the file at rawurl, only its
+// first chunk is fetched. An existing lazy file created for the same URL
+// is reused with the chunks already fetched if the server validators
+// (ETag, Last-Modified) still match. ErrRangeNotSupported is returned if
+// the server doesn't support range requests. SHA256 and Progress options
+// are ignored.
+func CreateLazy(ctx context.Context, rawurl, path string, opts Options) (*LazyFile, error) {
+	u, err := url.Parse(rawurl)
+	if err != nil {
+		return nil, fmt.Errorf("invalid download URL %s: %s", rawurl, err)
+	}
+	opts = lazyOptions(opts)
+
+	d := &downloader{opts: opts, url: u}
+
+	res, err := d.get(ctx, u, fmt.Sprintf("bytes=0-%d", opts.ChunkSize-1), "")
+	if err != nil {
+		return nil, err
+	}
+	size, ranged := contentRange(res, 0)
+	if !ranged || size == 0 {
+		res.Body.Close()
+		return nil, ErrRangeNotSupported
+	}
+
+	st := lazyState{
+		URL:          u.String(),
+		ChunkURL:     res.Request.URL.String(),
+		Size:         size,
+		ETag:         res.Header.Get("ETag"),
+		LastModified: res.Header.Get("Last-Modified"),
+		ChunkSize:    opts.ChunkSize,
+	}
+
+	previous, err := loadLazyState(path)
+	resume := err == nil && previous.URL == st.URL && previous.Size == st.Size &&
+		previous.ETag == st.ETag && previous.LastModified == st.LastModified &&
+		previous.ChunkSize == st.ChunkSize
+	if !resume {
+		RemoveLazy(path)
+	}
+	if err := saveLazyState(path, st); err != nil {
+		res.Body.Close()
+		return nil, fmt.Errorf("while saving lazy file state: %s", err)
+	}
+
+	l, err := openLazy(d, path, st, os.O_CREATE)
+	if err != nil {
+		res.Body.Close()
+		return nil, err
+	}
+
+	if l.present[0] {
+		res.Body.Close()
+		return l, nil
+	}
+
+	l.mu.Lock()
+	l.pending[0] = true
+	l.mu.Unlock()
+
+	err = l.writeChunk(0, res.Body)
+	res.Body.Close()
+	l.chunkDone(0, err)
+	if err != nil {
+		l.Close()
+		return nil, fmt.Errorf("while fetching %s: %s", u, err)
+	}
+	return l, nil
+}
+
+// OpenLazy opens the lazy file path created by CreateLazy. opts.Header is
+// only sent to the host of the URL the lazy file was created for.
+func OpenLazy(path string, opts Options) (*LazyFile, error) {
+	st, err := loadLazyState(path)
+	if err != nil {
+		return nil, fmt.Errorf("while reading lazy file state: %s", err)
+	}
+	u, err := url.Parse(st.URL)
+	if err != nil {
+		return nil, fmt.Errorf("invalid lazy file URL %s: %s", st.URL, err)
+	}
+	opts = lazyOptions(opts)
+	opts.ChunkSize = st.ChunkSize
+
+	return openLazy(&downloader{opts: opts, url: u}, path, st, 0)
+}
+
+// openLazy opens the lazy file path and its list of fetched chunks, which
+// are created if flag is os.O_CREATE. The files are opened without
+// following symbolic links, lazy files may be served by privileged
+// processes.
+func openLazy(d *downloader, path string, st lazyState, flag int) (*LazyFile, error) {
+	if st.Size <= 0 || st.ChunkSize <= 0 {
+		return nil, fmt.Errorf("invalid lazy file state for %s", path)
+	}
+	chunkURL, err := url.Parse(st.ChunkURL)
+	if err != nil {
+		return nil, fmt.Errorf("invalid lazy file URL %s: %s", st.ChunkURL, err)
+	}
+
+	l := &LazyFile{
+		d:        d,
+		path:     path,
+		st:       st,
+		chunkURL: chunkURL,
+	}
+	l.cond = sync.NewCond(&l.mu)
+
+	flag |= os.O_RDWR | syscall.O_NOFOLLOW
+	// Perms are 777 *prior* to umask
+	l.f, err = os.OpenFile(path, flag, 0777)
+	if err != nil {
+		return nil, err
+	}
+	n := int((st.Size + st.ChunkSize - 1) / st.ChunkSize)
+	l.chunks, err = os.OpenFile(path+lazyChunksSuffix, flag, 0644)
+	if err != nil {
+		l.f.Close()
+		return nil, err
+	}
+
+	if flag&os.O_CREATE != 0 {
+		// holes are left for the chunks not fetched yet
+		err = l.f.Truncate(st.Size)
+		if err == nil {
+			err = l.chunks.Truncate(int64(n))
+		}
+		if err != nil {
+			l.Close()
+			return nil, err
+		}
+	}
+
+	// one byte per chunk, set once the chunk is written
+	b := make([]byte, n)
+	if _, err := l.chunks.ReadAt(b, 0); err != nil {
+		l.Close()
+		return nil, fmt.Errorf("while reading %s: %s", path+lazyChunksSuffix, err)
+	}
+	l.present = make([]bool, n)
+	l.pending = make([]bool, n)
+	for i := range b {
+		l.present[i] = b[i] != 0
+		if !l.present[i] {
+			l.missing++
+		}
+	}
+	return l, nil
+}
+
+// Name returns the path of the lazy file.
+func (l *LazyFile) Name() string {
+	return l.path
+}
+
+// Size returns the size of the file.
+func (l *LazyFile) Size() int64 {
+	return l.st.Size
+}
+
+// File returns the local sparse file, only the fetched chunks have
+// the content of the remote file.
+func (l *LazyFile) File() *os.File {
+	return l.f
+}
+
+// Complete returns whether all chunks were fetched.
+func (l *LazyFile) Complete() bool {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	return l.missing == 0
+}
+
+// ReadAt implements io.ReaderAt, fetching the chunks not fetched yet.
+func (l *LazyFile) ReadAt(b []byte, off int64) (int, error) {
+	if off < 0 {
+		return 0, fmt.Errorf("negative offset")
+	}
+	if off >= l.st.Size {
+		return 0, io.EOF
+	}
+	n := int64(len(b))
+	if off+n > l.st.Size {
+		n = l.st.Size - off
+	}
+	if err := l.Fetch(context.Background(), off, n); err != nil {
+		return 0, err
+	}
+	rn, err := l.f.ReadAt(b[:n], off)
+	if err == nil && int64(rn) < int64(len(b)) {
+		err = io.EOF
+	}
+	return rn, err
+}
+
+// Fetch fetches the chunks holding the n bytes at offset off which
+// weren't fetched yet.
+func (l *LazyFile) Fetch(ctx context.Context, off, n int64) error {
+	if n <= 0 {
+		return nil
+	}
+	if off+n > l.st.Size {
+		n = l.st.Size - off
+	}
+	for i := int(off / l.st.ChunkSize); int64(i)*l.st.ChunkSize < off+n; i++ {
+		if err := l.fetchChunk(ctx, i); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// Prefetch fetches all the chunks not fetched yet in order, with
+// concurrent requests, and returns once the file is complete.
+func (l *LazyFile) Prefetch(ctx context.Context) error {
+	ctx, cancel := context.WithCancel(ctx)
+	defer cancel()
+
+	var (
+		mu   sync.Mutex
+		next int
+		err  error
+		wg   sync.WaitGroup
+	)
+	for w := 0; w < l.d.opts.Concurrency; w++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for {
+				mu.Lock()
+				i := next
+				next++
+				mu.Unlock()
+
+				if i >= len(l.present) {
+					return
+				}
+				if e := l.fetchChunk(ctx, i); e != nil {
+					mu.Lock()
+					if err == nil {
+						err = e
+					}
+					mu.Unlock()
+					// stop the other workers
+					cancel()
+					return
+				}
+			}
+		}()
+	}
+	wg.Wait()
+
+	return err
+}
+
+// fetchChunk fetches chunk i if not fetched yet, waiting for a fetch
+// of the same chunk in progress.
+func (l *LazyFile) fetchChunk(ctx context.Context, i int) error {
+	l.mu.Lock()
+	for l.pending[i] && !l.present[i] {
+		l.cond.Wait()
+	}
+	if l.present[i] {
+		l.mu.Unlock()
+		return nil
+	}
+	l.pending[i] = true
+	chunkURL := l.chunkURL
+	l.mu.Unlock()
+
+	start := int64(i) * l.st.ChunkSize
+	length := l.chunkLength(i)
+
+	// the file must not change once partially fetched
+	ifRange := l.st.ETag
+	if ifRange == "" || strings.HasPrefix(ifRange, "W/") {
+		ifRange = l.st.LastModified
+	}
+
+	var err error
+
+	for attempt := 1; attempt <= maxAttempts; attempt++ {
+		if err = ctx.Err(); err != nil {
+			break
+		}
+		var res *http.Response
+		res, err = l.d.get(ctx, chunkURL, fmt.Sprintf("bytes=%d-%d", start, start+length-1), ifRange)
+		if e, ok := err.(*StatusError); ok {
+			if chunkURL == l.d.url {
+				break
+			}
+			// the location the URL redirected to may have expired,
+			// the URL is requested again
+			sylog.Debugf("Chunk %d request to %s failed: %s", i, chunkURL.Host, e)
+			chunkURL = l.d.url
+			continue
+		} else if err != nil {
+			sylog.Debugf("Chunk %d fetch attempt %d failed: %s", i, attempt, err)
+			continue
+		}
+		if size, ok := contentRange(res, start); !ok || size != l.st.Size {
+			res.Body.Close()
+			err = fmt.Errorf("%s changed since the lazy file was created", l.d.url)
+			break
+		}
+		if res.Request.URL.String() != chunkURL.String() {
+			chunkURL = res.Request.URL
+		}
+
+		err = l.writeChunk(i, res.Body)
+		res.Body.Close()
+		if err == nil {
+			break
+		}
+		sylog.Debugf("Chunk %d fetch attempt %d failed: %s", i, attempt, err)
+	}
+
+	if err == nil {
+		l.mu.Lock()
+		l.chunkURL = chunkURL
+		l.mu.Unlock()
+	} else {
+		err = fmt.Errorf("while fetching %s: %s", l.d.url, err)
+	}
+	l.chunkDone(i, err)
+	return err
+}
+
+// chunkLength returns the length of chunk i.
+func (l *LazyFile) chunkLength(i int) int64 {
+	start := int64(i) * l.st.ChunkSize
+	if end := start + l.st.ChunkSize; end < l.st.Size {
+		return l.st.ChunkSize
+	}
+	return l.st.Size - start
+}
+
+// writeChunk writes chunk i read from r to the sparse file, and marks it
+// fetched in the list of fetched chunks.
+func (l *LazyFile) writeChunk(i int, r io.Reader) error {
+	start := int64(i) * l.st.ChunkSize
+	length := l.chunkLength(i)
+
+	n, err := io.Copy(&offsetWriter{f: l.f, off: start}, io.LimitReader(r, length))
+	if err != nil {
+		return err
+	}
+	if n != length {
+		return io.ErrUnexpectedEOF
+	}
+	_, err = l.chunks.WriteAt([]byte{1}, int64(i))
+	return err
+}
+
+// chunkDone records the result of the fetch of chunk i and wakes up
+// the readers waiting for it.
+func (l *LazyFile) chunkDone(i int, err error) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+
+	l.pending[i] = false
+	if err == nil && !l.present[i] {
+		l.present[i] = true
+		l.missing--
+	}
+	l.cond.Broadcast()
+}
+
+// Close closes the lazy file.
+func (l *LazyFile) Close() error {
+	l.chunks.Close()
+	return l.f.Close()
+}
+
+// Commit renames the complete lazy file to path and removes its state,
+// the lazy file must not be used afterwards.
+func (l *LazyFile) Commit(path string) error {
+	if !l.Complete() {
+		return fmt.Errorf("lazy file %s is not complete", l.path)
+	}
+	if err := l.f.Sync(); err != nil {
+		return err
+	}
+	if err := os.Rename(l.path, path); err != nil {
+		return err
+	}
+	os.Remove(l.path + lazyChunksSuffix)
+	os.Remove(l.path + lazyStateSuffix)
+	return nil
+}
+
+// RemoveLazy removes the lazy file path and its state.
+func RemoveLazy(path string) {
+	os.Remove(path)
+	os.Remove(path + lazyChunksSuffix)
+	os.Remove(path + lazyStateSuffix)
+}
+
+func loadLazyState(path string) (lazyState, error) {
+	var st lazyState
+
+	f, err := os.OpenFile(path+lazyStateSuffix, os.O_RDONLY|syscall.O_NOFOLLOW, 0)
+	if err != nil {
+		return st, err
+	}
+	defer f.Close()
+
+	data, err := ioutil.ReadAll(f)
+	if err != nil {
+		return st, err
+	}
+	err = json.Unmarshal(data, &st)
+	return st, err
+}
+
+func saveLazyState(path string, st lazyState) error {
+	data, err := json.Marshal(st)
+	if err != nil {
+		return err
+	}
+	tmp := path + lazyStateSuffix + ".tmp"
+	if err := ioutil.WriteFile(tmp, data, 0644); err != nil {
+		return err
+	}
+	return os.Rename(tmp, path+lazyStateSuffix)
+}
@@ -0,0 +1,185 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package download
+
+import (
+	"bytes"
+	"context"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"reflect"
+	"sync"
+	"testing"
+)
+
+func TestLazyFile(t *testing.T) {
+	const chunkSize = MinLazyChunkSize
+
+	data := randomData(5*chunkSize + 1000)
+	s := newTestServer(data, true)
+	defer s.Close()
+
+	dir, err := ioutil.TempDir("", "lazy-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+	path := filepath.Join(dir, "image.lazy")
+
+	opts := Options{ChunkSize: chunkSize}
+
+	l, err := CreateLazy(context.Background(), s.URL+"/redirect", path, opts)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if !IsLazy(path) || l.Size() != int64(len(data)) || l.Complete() {
+		t.Fatalf("unexpected lazy file state")
+	}
+
+	// only the chunks read are fetched, from the redirect location,
+	// concurrent reads of a chunk fetch it once
+	s.reset()
+	var wg sync.WaitGroup
+	for i := 0; i < 4; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			b := make([]byte, 100)
+			off := int64(3*chunkSize - 50)
+			if n, err := l.ReadAt(b, off); err != nil || n != len(b) || !bytes.Equal(b, data[off:off+100]) {
+				t.Errorf("unexpected read %d: %v", n, err)
+			}
+		}()
+	}
+	wg.Wait()
+	want := []string{
+		fmt.Sprintf("bytes=%d-%d", 2*chunkSize, 3*chunkSize-1),
+		fmt.Sprintf("bytes=%d-%d", 3*chunkSize, 4*chunkSize-1),
+	}
+	if len(s.requests) != 2 {
+		t.Errorf("unexpected requests %v", s.requests)
+	} else if s.requests[0] != want[0] && s.requests[0] != want[1] || s.requests[0] == s.requests[1] {
+		t.Errorf("unexpected requests %v, want %v", s.requests, want)
+	}
+
+	// the end of the file is read up to its size
+	b := make([]byte, 2000)
+	if n, err := l.ReadAt(b, int64(len(data)-1000)); n != 1000 || !bytes.Equal(b[:n], data[len(data)-1000:]) {
+		t.Errorf("unexpected read at the end of the file %d: %v", n, err)
+	}
+	l.Close()
+
+	// fetched chunks are kept when the lazy file is reopened
+	s.reset()
+	l, err = OpenLazy(path, Options{})
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if _, err := l.ReadAt(b[:100], int64(3*chunkSize)); err != nil || len(s.requests) != 0 {
+		t.Errorf("fetched chunk requested again %v: %v", s.requests, err)
+	}
+	if err := l.Prefetch(context.Background()); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if len(s.requests) != 2 || !l.Complete() {
+		t.Errorf("unexpected prefetch requests %v", s.requests)
+	}
+
+	dst := filepath.Join(dir, "image")
+	if err := l.Commit(dst); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if b, err := ioutil.ReadFile(dst); err != nil || !bytes.Equal(b, data) {
+		t.Errorf("unexpected committed file content: %v", err)
+	}
+	if files, _ := ioutil.ReadDir(dir); len(files) != 1 {
+		t.Errorf("lazy file state left: %v", files)
+	}
+}
+
+func TestLazyFileResume(t *testing.T) {
+	const chunkSize = MinLazyChunkSize
+
+	data := randomData(3 * chunkSize)
+	s := newTestServer(data, true)
+	defer s.Close()
+
+	dir, err := ioutil.TempDir("", "lazy-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+	path := filepath.Join(dir, "image.lazy")
+
+	l, err := CreateLazy(context.Background(), s.URL+"/file", path, Options{ChunkSize: chunkSize})
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if err := l.Fetch(context.Background(), 2*chunkSize, 1); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	l.Close()
+
+	// created again for an unchanged file, fetched chunks are kept
+	l, err = CreateLazy(context.Background(), s.URL+"/file", path, Options{ChunkSize: chunkSize})
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if !reflect.DeepEqual(l.present, []bool{true, false, true}) {
+		t.Errorf("unexpected fetched chunks %v", l.present)
+	}
+
+	// a file changed once the lazy file created can't be fetched
+	s.mu.Lock()
+	s.etag = `"v2"`
+	s.mu.Unlock()
+	if err := l.Prefetch(context.Background()); err == nil {
+		t.Errorf("unexpected success for a changed file")
+	}
+	l.Close()
+
+	// and is created from scratch
+	l, err = CreateLazy(context.Background(), s.URL+"/file", path, Options{ChunkSize: chunkSize})
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if !reflect.DeepEqual(l.present, []bool{true, false, false}) {
+		t.Errorf("unexpected fetched chunks %v", l.present)
+	}
+	l.Close()
+}
+
+func TestLazyFileNoRange(t *testing.T) {
+	s := newTestServer(randomData(1000), false)
+	defer s.Close()
+
+	dir, err := ioutil.TempDir("", "lazy-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+	path := filepath.Join(dir, "image.lazy")
+
+	if _, err := CreateLazy(context.Background(), s.URL+"/file", path, Options{}); err != ErrRangeNotSupported {
+		t.Errorf("unexpected error: %v", err)
+	}
+	if IsLazy(path) {
+		t.Errorf("lazy file created")
+	}
+
+	// regular images may have JSON files alongside
+	image := filepath.Join(dir, "image.sif")
+	for _, p := range []string{image, image + ".json"} {
+		if err := ioutil.WriteFile(p, []byte("{}"), 0644); err != nil {
+			t.Fatal(err)
+		}
+	}
+	if IsLazy(image) {
+		t.Errorf("regular image reported as lazy file")
+	}
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package download
+
+import (
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+	"gopkg.in/cheggaaa/pb.v1"
+)
+
+// progressBar displays the download progress on the terminal.
+type progressBar struct {
+	bar *pb.ProgressBar
+}
+
+// NewProgressBar returns a Progress displaying a progress bar, unless
+// the log level is below the default level.
+func NewProgressBar() Progress {
+	return new(progressBar)
+}
+
+func (p *progressBar) Start(size, done int64) {
+	if size < 0 {
+		size = 0
+	}
+	p.bar = pb.New64(size).SetUnits(pb.U_BYTES)
+	if sylog.GetLevel() < 0 {
+		p.bar.NotPrint = true
+	}
+	p.bar.ShowTimeLeft = true
+	p.bar.ShowSpeed = true
+	p.bar.Set64(done)
+	p.bar.Start()
+}
+
+func (p *progressBar) Add(n int64) {
+	p.bar.Add64(n)
+}
+
+func (p *progressBar) Finish() {
+	p.bar.Finish()
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package oci
+
+import (
+	"context"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+
+	"github.com/containers/image/image"
+	"github.com/containers/image/pkg/blobinfocache/none"
+	"github.com/containers/image/types"
+	"github.com/opencontainers/go-digest"
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+)
+
+// blobPath returns the path of the blob d in the OCI layout dir.
+func blobPath(dir string, d digest.Digest) string {
+	return filepath.Join(dir, "blobs", d.Algorithm().String(), d.Hex())
+}
+
+// fetchLayers downloads the layers of the src image missing from the OCI
+// layout dir into its blob directory, up to concurrency layers at a time.
+// Each layer is verified against its digest and renamed in place once
+// complete, so that a copy to the layout reuses them.
+func fetchLayers(ctx context.Context, src types.ImageReference, sys *types.SystemContext, dir string, concurrency int) (err error) {
+	source, err := src.NewImageSource(ctx, sys)
+	if err != nil {
+		return err
+	}
+	// the image closes the source
+	img, err := image.FromSource(ctx, sys, source)
+	if err != nil {
+		source.Close()
+		return err
+	}
+	defer img.Close()
+
+	var blobs []types.BlobInfo
+
+	seen := make(map[digest.Digest]bool)
+	for _, info := range img.LayerInfos() {
+		if seen[info.Digest] {
+			continue
+		}
+		seen[info.Digest] = true
+		if err := info.Digest.Validate(); err != nil {
+			return fmt.Errorf("invalid layer digest %q: %s", info.Digest, err)
+		}
+		if _, err := os.Stat(blobPath(dir, info.Digest)); err == nil {
+			continue
+		}
+		blobs = append(blobs, info)
+	}
+	if len(blobs) == 0 {
+		return nil
+	}
+
+	sylog.Debugf("Downloading %d layers, %d at a time", len(blobs), concurrency)
+
+	ctx, cancel := context.WithCancel(ctx)
+	defer cancel()
+
+	sem := make(chan struct{}, concurrency)
+	errs := make(chan error, len(blobs))
+
+	for _, info := range blobs {
+		go func(info types.BlobInfo) {
+			sem <- struct{}{}
+			defer func() { <-sem }()
+			errs <- fetchBlob(ctx, source, info, dir)
+		}(info)
+	}
+	// wait for all downloads, the first error cancels the others
+	for range blobs {
+		if e := <-errs; e != nil && err == nil {
+			err = e
+			cancel()
+		}
+	}
+	return err
+}
+
+// fetchBlob downloads the blob described by info into the OCI layout dir.
+func fetchBlob(ctx context.Context, source types.ImageSource, info types.BlobInfo, dir string) (err error) {
+	if err := ctx.Err(); err != nil {
+		return err
+	}
+
+	path := blobPath(dir, info.Digest)
+	if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+		return fmt.Errorf("while creating blob directory: %s", err)
+	}
+
+	rc, _, err := source.GetBlob(ctx, info, none.NoCache)
+	if err != nil {
+		return fmt.Errorf("while downloading layer %s: %s", info.Digest, err)
+	}
+	defer rc.Close()
+
+	f, err := ioutil.TempFile(filepath.Dir(path), "fetch-")
+	if err != nil {
+		return fmt.Errorf("while creating temporary file for layer %s: %s", info.Digest, err)
+	}
+	defer func() {
+		if err != nil {
+			os.Remove(f.Name())
+		}
+	}()
+
+	verifier := info.Digest.Verifier()
+	_, err = io.Copy(io.MultiWriter(f, verifier), rc)
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err != nil {
+		return fmt.Errorf("while downloading layer %s: %s", info.Digest, err)
+	}
+	if !verifier.Verified() {
+		return fmt.Errorf("layer %s doesn't match its digest", info.Digest)
+	}
+	// blobs are world readable like the blobs written by the layout
+	if err := os.Chmod(f.Name(), 0644); err != nil {
+		return err
+	}
+	return os.Rename(f.Name(), path)
+}
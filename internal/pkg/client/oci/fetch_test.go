@@ -0,0 +1,319 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package oci
+
+import (
+	"archive/tar"
+	"bytes"
+	"compress/gzip"
+	"context"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"math/rand"
+	"net/http"
+	"net/http/httptest"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/containers/image/docker"
+	"github.com/containers/image/types"
+	"github.com/opencontainers/go-digest"
+	"github.com/sylabs/singularity/internal/pkg/client/cache"
+)
+
+// testRegistry is a minimal docker registry serving a single image,
+// blobs are served at a limited rate per request to mimic a network.
+type testRegistry struct {
+	*httptest.Server
+	manifest []byte
+	blobs    map[digest.Digest][]byte
+	// rate is the number of bytes per second served per blob request,
+	// unlimited if zero
+	rate int
+
+	mu       sync.Mutex
+	requests map[digest.Digest]int
+}
+
+// createLayerBlob returns a gzip compressed layer with a single file of
+// size random bytes, along with its uncompressed digest.
+func createLayerBlob(t testing.TB, name string, size int) ([]byte, digest.Digest) {
+	data := make([]byte, size)
+	rand.Read(data)
+
+	var tarBuf bytes.Buffer
+	tw := tar.NewWriter(&tarBuf)
+	if err := tw.WriteHeader(&tar.Header{Name: name, Mode: 0644, Size: int64(size), Typeflag: tar.TypeReg}); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := tw.Write(data); err != nil {
+		t.Fatal(err)
+	}
+	if err := tw.Close(); err != nil {
+		t.Fatal(err)
+	}
+
+	var buf bytes.Buffer
+	gw := gzip.NewWriter(&buf)
+	if _, err := gw.Write(tarBuf.Bytes()); err != nil {
+		t.Fatal(err)
+	}
+	if err := gw.Close(); err != nil {
+		t.Fatal(err)
+	}
+	return buf.Bytes(), digest.FromBytes(tarBuf.Bytes())
+}
+
+func newTestRegistry(t testing.TB, layers, layerSize, rate int) *testRegistry {
+	r := &testRegistry{
+		blobs:    make(map[digest.Digest][]byte),
+		requests: make(map[digest.Digest]int),
+		rate:     rate,
+	}
+
+	type descriptor struct {
+		MediaType string        `json:"mediaType"`
+		Size      int64         `json:"size"`
+		Digest    digest.Digest `json:"digest"`
+	}
+
+	var layerDescs []descriptor
+	var diffIDs []digest.Digest
+
+	for i := 0; i < layers; i++ {
+		blob, diffID := createLayerBlob(t, fmt.Sprintf("file%d", i), layerSize)
+		d := digest.FromBytes(blob)
+		r.blobs[d] = blob
+		layerDescs = append(layerDescs, descriptor{
+			MediaType: "application/vnd.docker.image.rootfs.diff.tar.gzip",
+			Size:      int64(len(blob)),
+			Digest:    d,
+		})
+		diffIDs = append(diffIDs, diffID)
+	}
+
+	config, err := json.Marshal(map[string]interface{}{
+		"architecture": "amd64",
+		"os":           "linux",
+		"rootfs":       map[string]interface{}{"type": "layers", "diff_ids": diffIDs},
+	})
+	if err != nil {
+		t.Fatal(err)
+	}
+	configDigest := digest.FromBytes(config)
+	r.blobs[configDigest] = config
+
+	r.manifest, err = json.Marshal(map[string]interface{}{
+		"schemaVersion": 2,
+		"mediaType":     "application/vnd.docker.distribution.manifest.v2+json",
+		"config": descriptor{
+			MediaType: "application/vnd.docker.container.image.v1+json",
+			Size:      int64(len(config)),
+			Digest:    configDigest,
+		},
+		"layers": layerDescs,
+	})
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	r.Server = httptest.NewTLSServer(r)
+	return r
+}
+
+func (r *testRegistry) ServeHTTP(w http.ResponseWriter, req *http.Request) {
+	w.Header().Set("Docker-Distribution-API-Version", "registry/2.0")
+
+	switch {
+	case req.URL.Path == "/v2/":
+		w.WriteHeader(http.StatusOK)
+	case strings.HasPrefix(req.URL.Path, "/v2/test/image/manifests/"):
+		w.Header().Set("Content-Type", "application/vnd.docker.distribution.manifest.v2+json")
+		w.Header().Set("Docker-Content-Digest", digest.FromBytes(r.manifest).String())
+		w.Write(r.manifest)
+	case strings.HasPrefix(req.URL.Path, "/v2/test/image/blobs/"):
+		d := digest.Digest(strings.TrimPrefix(req.URL.Path, "/v2/test/image/blobs/"))
+		blob, ok := r.blobs[d]
+		if !ok {
+			http.NotFound(w, req)
+			return
+		}
+		r.mu.Lock()
+		r.requests[d]++
+		r.mu.Unlock()
+
+		w.Header().Set("Content-Length", fmt.Sprint(len(blob)))
+		w.Header().Set("Docker-Content-Digest", d.String())
+		if req.Method == http.MethodHead {
+			return
+		}
+		r.writeBlob(w, blob)
+	default:
+		http.NotFound(w, req)
+	}
+}
+
+func (r *testRegistry) writeBlob(w http.ResponseWriter, blob []byte) {
+	if r.rate == 0 {
+		w.Write(blob)
+		return
+	}
+	const chunk = 32 * 1024
+	for len(blob) > 0 {
+		n := chunk
+		if n > len(blob) {
+			n = len(blob)
+		}
+		if _, err := w.Write(blob[:n]); err != nil {
+			return
+		}
+		blob = blob[n:]
+		time.Sleep(time.Duration(n) * time.Second / time.Duration(r.rate))
+	}
+}
+
+func (r *testRegistry) reference(t testing.TB) types.ImageReference {
+	host := strings.TrimPrefix(r.URL, "https://")
+	ref, err := docker.ParseReference("//" + host + "/test/image:latest")
+	if err != nil {
+		t.Fatalf("failed to parse registry reference: %s", err)
+	}
+	return ref
+}
+
+func testRegistrySysCtx() *types.SystemContext {
+	return &types.SystemContext{
+		DockerInsecureSkipTLSVerify: types.OptionalBoolTrue,
+		AuthFilePath:                "/nonexistent/auth.json",
+		OSChoice:                    "linux",
+	}
+}
+
+func TestFetchLayers(t *testing.T) {
+	r := newTestRegistry(t, 3, 64*1024, 0)
+	defer r.Close()
+
+	dir, err := ioutil.TempDir("", "fetch-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	ctx := context.Background()
+
+	if err := fetchLayers(ctx, r.reference(t), testRegistrySysCtx(), dir, 2); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+
+	layers := 0
+	for d, blob := range r.blobs {
+		data, err := ioutil.ReadFile(blobPath(dir, d))
+		if r.requests[d] == 0 {
+			// the image config is not a layer
+			if err == nil {
+				t.Errorf("unexpected blob %s fetched", d)
+			}
+			continue
+		}
+		layers++
+		if err != nil {
+			t.Errorf("layer %s not fetched: %s", d, err)
+		} else if !bytes.Equal(data, blob) {
+			t.Errorf("unexpected layer %s content", d)
+		}
+	}
+	if layers != 3 {
+		t.Errorf("unexpected number of fetched layers %d", layers)
+	}
+
+	// layers already present are not downloaded again
+	r.requests = make(map[digest.Digest]int)
+	if err := fetchLayers(ctx, r.reference(t), testRegistrySysCtx(), dir, 2); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if len(r.requests) != 0 {
+		t.Errorf("unexpected layer downloads %v", r.requests)
+	}
+
+	// corrupted layers are rejected and no file is left
+	corruptedDir, err := ioutil.TempDir("", "fetch-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(corruptedDir)
+
+	for d, blob := range r.blobs {
+		// the image config is smaller than layers
+		if len(blob) > 1024 {
+			r.blobs[d] = append([]byte{}, blob...)
+			r.blobs[d][len(blob)/2] ^= 0xff
+			break
+		}
+	}
+	if err := fetchLayers(ctx, r.reference(t), testRegistrySysCtx(), corruptedDir, 2); err == nil {
+		t.Errorf("unexpected success with a corrupted layer")
+	}
+	filepath.Walk(corruptedDir, func(path string, fi os.FileInfo, err error) error {
+		if err == nil && !fi.IsDir() {
+			t.Errorf("temporary file %s left", path)
+		}
+		return nil
+	})
+}
+
+// BenchmarkNewImageSource measures the time to pull an image from a local
+// registry into an empty image cache, with layers served at a limited rate
+// per connection like a remote registry, one layer at a time or with
+// concurrent downloads.
+func BenchmarkNewImageSource(b *testing.B) {
+	const (
+		layers    = 8
+		layerSize = 4 << 20
+		rate      = 32 << 20
+	)
+
+	r := newTestRegistry(b, layers, layerSize, rate)
+	defer r.Close()
+
+	for _, concurrency := range []int{1, 4} {
+		b.Run(fmt.Sprintf("concurrency-%d", concurrency), func(b *testing.B) {
+			b.SetBytes(layers * layerSize)
+
+			for i := 0; i < b.N; i++ {
+				b.StopTimer()
+				cacheDir, err := ioutil.TempDir("", "bench-cache-")
+				if err != nil {
+					b.Fatal(err)
+				}
+				imgCache, err := cache.NewHandle(cache.Config{BaseDir: cacheDir})
+				if err != nil {
+					b.Fatalf("failed to create an image cache handle: %s", err)
+				}
+				ref, err := ConvertReference(context.Background(), imgCache, r.reference(b), testRegistrySysCtx())
+				if err != nil {
+					b.Fatalf("failed to convert image reference: %s", err)
+				}
+				ref.Concurrency = concurrency
+				b.StartTimer()
+
+				src, err := ref.newImageSource(context.Background(), testRegistrySysCtx(), ioutil.Discard)
+				if err != nil {
+					b.Fatalf("failed to pull image: %s", err)
+				}
+				src.Close()
+
+				b.StopTimer()
+				os.RemoveAll(cacheDir)
+				b.StartTimer()
+			}
+		})
+	}
+}
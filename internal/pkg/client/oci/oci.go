@@ -11,6 +11,7 @@ import (
 	"crypto/sha256"
 	"fmt"
 	"io"
+	"path/filepath"
 	"strings"
 
 	"github.com/containers/image/copy"
@@ -26,11 +27,20 @@ import (
 // ImageReference wraps containers/image ImageReference type
 type ImageReference struct {
 	source types.ImageReference
+	// dir is the cache OCI layout directory
+	dir string
+	// cache and tag identify the image cache entry locked while
+	// the image is fetched into the layout
+	cache *cache.Handle
+	tag   string
+	// Concurrency is the number of layers downloaded at the same time,
+	// layers are downloaded one after the other if lower than 2.
+	Concurrency int
 	types.ImageReference
 }
 
 // ConvertReference converts a source reference into a cache.ImageReference to cache its blobs
-func ConvertReference(ctx context.Context, imgCache *cache.Handle, src types.ImageReference, sys *types.SystemContext) (types.ImageReference, error) {
+func ConvertReference(ctx context.Context, imgCache *cache.Handle, src types.ImageReference, sys *types.SystemContext) (*ImageReference, error) {
 	if imgCache == nil {
 		return nil, fmt.Errorf("undefined image cache")
 	}
@@ -50,6 +60,9 @@ func ConvertReference(ctx context.Context, imgCache *cache.Handle, src types.Ima
 
 	return &ImageReference{
 		source:         src,
+		dir:            imgCache.OciBlob,
+		cache:          imgCache,
+		tag:            cacheTag,
 		ImageReference: c,
 	}, nil
 
@@ -67,6 +80,22 @@ func (t *ImageReference) newImageSource(ctx context.Context, sys *types.SystemCo
 		return nil, err
 	}
 
+	// Processes pulling the same image wait for the first one, and
+	// then find all blobs in the layout
+	l, err := t.cache.LockEntry(filepath.Join(t.dir, t.tag))
+	if err != nil {
+		return nil, err
+	}
+	defer l.Unlock()
+
+	// Download layers concurrently, copy.Image then finds them in
+	// the cache instead of downloading them one after the other
+	if t.Concurrency > 1 {
+		if err := fetchLayers(ctx, t.source, sys, t.dir, t.Concurrency); err != nil {
+			return nil, err
+		}
+	}
+
 	// First we are fetching into the cache
 	_, err = copy.Image(ctx, policyCtx, t.ImageReference, t.source, &copy.Options{
 		ReportWriter: w,
@@ -86,7 +115,11 @@ func ParseImageName(ctx context.Context, imgCache *cache.Handle, uri string, sys
 		return nil, fmt.Errorf("unable to parse image name %v: %v", uri, err)
 	}
 
-	return ConvertReference(ctx, imgCache, ref, sys)
+	r, err := ConvertReference(ctx, imgCache, ref, sys)
+	if err != nil {
+		return nil, err
+	}
+	return r, nil
 }
 
 func parseURI(uri string) (types.ImageReference, error) {
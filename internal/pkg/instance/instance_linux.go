@@ -47,6 +47,7 @@ type File struct {
 	Config []byte `json:"config"`
 	UserNs bool   `json:"userns"`
 	IP     string `json:"ip"`
+	Zygote string `json:"zygote,omitempty"`
 }
 
 // ProcName returns processus name based on instance name
@@ -8,17 +8,16 @@ package library
 import (
 	"context"
 	"fmt"
-	"io"
-	"os"
+	"net/http"
+	"net/url"
 	"strings"
 
 	"github.com/sylabs/scs-library-client/client"
+	"github.com/sylabs/singularity/internal/pkg/client/download"
 )
 
 const defaultTag = "latest"
 
-type progressCallback func(int64, io.Reader, io.Writer) error
-
 // NormalizeLibraryRef strips off leading "library://" prefix, if any, and
 // appends the default tag (latest) if none specified.
 func NormalizeLibraryRef(libraryRef string) string {
@@ -29,35 +28,71 @@ func NormalizeLibraryRef(libraryRef string) string {
 	return ir
 }
 
-// DownloadImage is a helper function to wrap library image download operation
-func DownloadImage(ctx context.Context, c *client.Client, imagePath, arch, libraryRef string, callback progressCallback) error {
+// ImageFileRequest returns the URL of the library image file libraryRef
+// for the architecture arch, and the download options to request it with
+// the client c.
+func ImageFileRequest(c *client.Client, arch, libraryRef string) (string, download.Options, error) {
 	// reassemble "stripped" library ref for scs-library-client
 	validLibraryRef := "library:///" + libraryRef
 
 	// parse library ref
 	r, err := client.Parse(validLibraryRef)
 	if err != nil {
-		return fmt.Errorf("error parsing library ref: %v", err)
-	}
-
-	// open destination file for writing
-	f, err := os.OpenFile(imagePath, os.O_CREATE|os.O_TRUNC|os.O_RDWR, 0777)
-	if err != nil {
-		return fmt.Errorf("error opening file %s for writing: %v", imagePath, err)
+		return "", download.Options{}, fmt.Errorf("error parsing library ref: %v", err)
 	}
-	defer f.Close()
 
-	var tag string
+	tag := defaultTag
 	if len(r.Tags) > 0 {
 		tag = r.Tags[0]
 	}
 
-	// call library client to download image
-	err = c.DownloadImage(ctx, f, arch, r.Path, tag, callback)
+	imageURL := c.BaseURL.ResolveReference(&url.URL{
+		Path:     fmt.Sprintf("v1/imagefile/%s:%s", strings.TrimPrefix(r.Path, "/"), tag),
+		RawQuery: url.Values{"arch": []string{arch}}.Encode(),
+	})
+
+	// the authorization header is only sent to the library, not to
+	// the storage the image file request is redirected to
+	header := make(http.Header)
+	if c.AuthToken != "" {
+		header.Set("Authorization", "Bearer "+c.AuthToken)
+	}
+	if c.UserAgent != "" {
+		header.Set("User-Agent", c.UserAgent)
+	}
+
+	return imageURL.String(), download.Options{
+		Client: c.HTTPClient,
+		Header: header,
+	}, nil
+}
+
+// imageSHA256 returns the SHA256 sum in hexadecimal of a library image hash
+// ("sha256.<sum>"), or an empty string if it's not a SHA256 sum.
+func imageSHA256(hash string) string {
+	if !strings.HasPrefix(hash, "sha256.") {
+		return ""
+	}
+	return strings.TrimPrefix(hash, "sha256.")
+}
+
+// DownloadImage is a helper function to wrap library image download operation.
+// The image is downloaded in parallel chunks when the library storage supports
+// range requests, an interrupted download is resumed by the next call with the
+// same image path. The downloaded image is verified against the library image
+// hash if not empty. progress may be nil.
+func DownloadImage(ctx context.Context, c *client.Client, imagePath, arch, libraryRef, hash string, progress download.Progress) error {
+	imageURL, opts, err := ImageFileRequest(c, arch, libraryRef)
 	if err != nil {
-		// delete incomplete image file in the event of failure
-		os.Remove(imagePath)
+		return err
+	}
+	opts.SHA256 = imageSHA256(hash)
+	opts.Progress = progress
 
+	_, err = download.File(ctx, imageURL, imagePath, opts)
+	if e, ok := err.(*download.StatusError); ok && e.StatusCode == http.StatusNotFound {
+		return fmt.Errorf("error downloading image: requested image was not found in the library")
+	} else if err != nil {
 		return fmt.Errorf("error downloading image: %v", err)
 	}
 
@@ -66,8 +101,8 @@ func DownloadImage(ctx context.Context, c *client.Client, imagePath, arch, libra
 
 // DownloadImageNoProgress downloads an image from the library without
 // displaying a progress bar while doing so
-func DownloadImageNoProgress(ctx context.Context, c *client.Client, imagePath, arch, libraryRef string) error {
-	return DownloadImage(ctx, c, imagePath, arch, libraryRef, nil)
+func DownloadImageNoProgress(ctx context.Context, c *client.Client, imagePath, arch, libraryRef, hash string) error {
+	return DownloadImage(ctx, c, imagePath, arch, libraryRef, hash, nil)
 }
 
 // SearchLibrary searches the library and outputs results to stdout
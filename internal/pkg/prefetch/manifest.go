@@ -0,0 +1,101 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+// Package prefetch records the files opened by a container during a
+// representative run and reads them back in the same order at the next
+// launches, to stream the image blocks they are stored in before the
+// container reads them at random. The ordered file list is a prefetch
+// manifest stored in a SIF data object.
+package prefetch
+
+import (
+	"encoding/json"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"strings"
+
+	"github.com/sylabs/singularity/pkg/image"
+)
+
+// DescriptorName is the name of the SIF data object holding the prefetch
+// manifest.
+const DescriptorName = "prefetch.json"
+
+// maxManifestSize is the maximum size of a prefetch manifest.
+const maxManifestSize = 16 << 20
+
+// Manifest is an ordered list of container files to prefetch.
+type Manifest struct {
+	// Files are the absolute paths of the files in the container, in
+	// the order they were first opened.
+	Files []string `json:"files"`
+}
+
+// Load reads the prefetch manifest stored in the file path.
+func Load(path string) (*Manifest, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+
+	m, err := decode(f)
+	if err != nil {
+		return nil, fmt.Errorf("while decoding prefetch manifest %s: %s", path, err)
+	}
+	return m, nil
+}
+
+// FromImage returns the prefetch manifest stored in the SIF image img,
+// or nil if the image has none.
+func FromImage(img *image.Image) (*Manifest, error) {
+	if img.Type != image.SIF {
+		return nil, nil
+	}
+	r, err := image.NewSectionReader(img, DescriptorName, -1)
+	if err == image.ErrNoSection {
+		return nil, nil
+	} else if err != nil {
+		return nil, err
+	}
+	m, err := decode(r)
+	if err != nil {
+		return nil, fmt.Errorf("while decoding %s prefetch manifest: %s", img.Path, err)
+	}
+	return m, nil
+}
+
+// Save writes the prefetch manifest to the file path.
+func (m *Manifest) Save(path string) error {
+	b, err := json.MarshalIndent(m, "", "\t")
+	if err != nil {
+		return err
+	}
+	return ioutil.WriteFile(path, append(b, '\n'), 0644)
+}
+
+func decode(r io.Reader) (*Manifest, error) {
+	b, err := ioutil.ReadAll(io.LimitReader(r, maxManifestSize+1))
+	if err != nil {
+		return nil, err
+	}
+	if len(b) > maxManifestSize {
+		return nil, fmt.Errorf("manifest larger than %d bytes", maxManifestSize)
+	}
+
+	m := new(Manifest)
+	if err := json.Unmarshal(b, m); err != nil {
+		return nil, err
+	}
+	for _, f := range m.Files {
+		if !filepath.IsAbs(f) || filepath.Clean(f) != f || strings.ContainsRune(f, 0) {
+			return nil, fmt.Errorf("bad file path %q", f)
+		}
+	}
+	return m, nil
+}
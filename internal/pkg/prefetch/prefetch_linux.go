@@ -0,0 +1,84 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package prefetch
+
+import (
+	"context"
+	"io"
+	"os"
+	"path/filepath"
+	"syscall"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+	"github.com/sylabs/singularity/internal/pkg/util/fs"
+	"golang.org/x/sys/unix"
+)
+
+// readSize is the size of the reads streaming a file.
+const readSize = 1 << 20
+
+// Prefetch reads the manifest files found under the directory root in
+// order, sequentially and entirely, for their data to be in the page
+// cache once accessed. Symbolic links are resolved relative to root, the
+// files which are not regular files or can't be read are skipped. It
+// returns the number of files and bytes read.
+func (m *Manifest) Prefetch(ctx context.Context, root string) (int, int64) {
+	b := make([]byte, readSize)
+
+	files := 0
+	total := int64(0)
+
+	for _, f := range m.Files {
+		if ctx.Err() != nil {
+			break
+		}
+		path := filepath.Join(root, fs.EvalRelative(f, root))
+		n, err := readFile(ctx, path, b)
+		if err != nil {
+			sylog.Debugf("Could not prefetch %s: %s", f, err)
+			continue
+		}
+		files++
+		total += n
+	}
+
+	return files, total
+}
+
+// readFile reads the regular file path with a sequential access hint,
+// which makes the kernel read ahead with a larger window.
+func readFile(ctx context.Context, path string, b []byte) (int64, error) {
+	// non-blocking opens don't wait for a FIFO writer
+	f, err := os.OpenFile(path, os.O_RDONLY|syscall.O_NOFOLLOW|syscall.O_NONBLOCK, 0)
+	if err != nil {
+		return 0, err
+	}
+	defer f.Close()
+
+	fi, err := f.Stat()
+	if err != nil {
+		return 0, err
+	}
+	if !fi.Mode().IsRegular() {
+		return 0, nil
+	}
+
+	if err := unix.Fadvise(int(f.Fd()), 0, 0, unix.FADV_SEQUENTIAL); err != nil {
+		sylog.Debugf("Could not set %s access pattern: %s", path, err)
+	}
+
+	total := int64(0)
+	for ctx.Err() == nil {
+		n, err := f.Read(b)
+		total += int64(n)
+		if err == io.EOF {
+			break
+		} else if err != nil {
+			return total, err
+		}
+	}
+	return total, nil
+}
@@ -0,0 +1,124 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package prefetch
+
+import (
+	"context"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"reflect"
+	"strings"
+	"testing"
+)
+
+func createTree(t *testing.T, files map[string]string) string {
+	dir, err := ioutil.TempDir("", "prefetch-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	for path, content := range files {
+		path = filepath.Join(dir, path)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			t.Fatal(err)
+		}
+		if err := ioutil.WriteFile(path, []byte(content), 0644); err != nil {
+			t.Fatal(err)
+		}
+	}
+	return dir
+}
+
+func TestRecord(t *testing.T) {
+	root := createTree(t, map[string]string{
+		"bin/sh":          "sh",
+		"lib/libc.so":     "libc",
+		"usr/lib/libm.so": "libm",
+		"etc/unused":      "unused",
+	})
+	defer os.RemoveAll(root)
+
+	// the tree is recorded from a symbolic link to its root like
+	// /proc/<pid>/root
+	link := root + ".link"
+	if err := os.Symlink(root, link); err != nil {
+		t.Fatal(err)
+	}
+	defer os.Remove(link)
+
+	r, err := Record(link)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+
+	// files are recorded once in the order they were first opened
+	for _, f := range []string{"bin/sh", "usr/lib/libm.so", "lib/libc.so", "bin/sh"} {
+		if _, err := ioutil.ReadFile(filepath.Join(root, f)); err != nil {
+			t.Fatal(err)
+		}
+	}
+	// directories aren't recorded
+	if _, err := ioutil.ReadDir(filepath.Join(root, "etc")); err != nil {
+		t.Fatal(err)
+	}
+
+	m := r.Stop()
+	want := []string{"/bin/sh", "/usr/lib/libm.so", "/lib/libc.so"}
+	if !reflect.DeepEqual(m.Files, want) {
+		t.Errorf("unexpected recorded files %v, want %v", m.Files, want)
+	}
+}
+
+func TestPrefetch(t *testing.T) {
+	root := createTree(t, map[string]string{
+		"bin/sh":      "sh",
+		"lib/libc.so": strings.Repeat("c", 3*readSize/2),
+	})
+	defer os.RemoveAll(root)
+
+	if err := os.Symlink("/lib", filepath.Join(root, "lib64")); err != nil {
+		t.Fatal(err)
+	}
+
+	// symbolic links are resolved relative to root, missing files
+	// are skipped
+	m := &Manifest{Files: []string{"/bin/sh", "/missing", "/lib64/libc.so"}}
+	files, n := m.Prefetch(context.Background(), root)
+	if files != 2 || n != int64(2+3*readSize/2) {
+		t.Errorf("unexpected prefetch of %d files, %d bytes", files, n)
+	}
+}
+
+func TestManifest(t *testing.T) {
+	dir, err := ioutil.TempDir("", "prefetch-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	path := filepath.Join(dir, "prefetch.json")
+	m := &Manifest{Files: []string{"/bin/sh", "/lib/libc.so"}}
+	if err := m.Save(path); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	l, err := Load(path)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if !reflect.DeepEqual(l, m) {
+		t.Errorf("unexpected manifest %v, want %v", l, m)
+	}
+
+	for _, bad := range []string{"lib/libc.so", "/lib/../etc/shadow", "/lib/"} {
+		m := &Manifest{Files: []string{bad}}
+		if err := m.Save(path); err != nil {
+			t.Fatalf("unexpected error: %s", err)
+		}
+		if _, err := Load(path); err == nil {
+			t.Errorf("unexpected success for file path %q", bad)
+		}
+	}
+}
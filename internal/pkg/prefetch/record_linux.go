@@ -0,0 +1,146 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package prefetch
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"syscall"
+	"time"
+	"unsafe"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+)
+
+// Recorder records the order in which the files of a directory tree are
+// first opened, with inotify watches on its directories.
+type Recorder struct {
+	fd   int
+	file *os.File
+	done chan struct{}
+
+	watches map[int32]string
+	seen    map[string]bool
+	files   []string
+}
+
+// Record starts recording the files opened under the directory root.
+// Only the directories on the same filesystem as root are watched, the
+// files opened under other mount points aren't recorded.
+func Record(root string) (*Recorder, error) {
+	var st syscall.Stat_t
+	if err := syscall.Stat(root, &st); err != nil {
+		return nil, fmt.Errorf("while getting %s information: %s", root, err)
+	}
+
+	fd, err := syscall.InotifyInit1(syscall.IN_CLOEXEC | syscall.IN_NONBLOCK)
+	if err != nil {
+		return nil, fmt.Errorf("while initializing inotify: %s", err)
+	}
+
+	r := &Recorder{
+		fd:      fd,
+		file:    os.NewFile(uintptr(fd), "inotify"),
+		done:    make(chan struct{}),
+		watches: make(map[int32]string),
+		seen:    make(map[string]bool),
+	}
+
+	// root may be a symbolic link like /proc/<pid>/root, walked from
+	// the directory it points to
+	root = filepath.Clean(root)
+	err = filepath.Walk(root+string(filepath.Separator), func(path string, fi os.FileInfo, err error) error {
+		if err != nil || !fi.IsDir() {
+			return nil
+		}
+		if s, ok := fi.Sys().(*syscall.Stat_t); ok && s.Dev != st.Dev {
+			return filepath.SkipDir
+		}
+		wd, err := syscall.InotifyAddWatch(fd, path, syscall.IN_OPEN|syscall.IN_ONLYDIR)
+		if err == syscall.ENOSPC {
+			return fmt.Errorf("inotify watches limit reached, see fs.inotify.max_user_watches")
+		} else if err != nil {
+			sylog.Debugf("Could not watch %s: %s", path, err)
+			return filepath.SkipDir
+		}
+		r.watches[int32(wd)] = strings.TrimPrefix(path, root)
+		return nil
+	})
+	if err != nil {
+		sylog.Warningf("Recording only part of the opened files: %s", err)
+	}
+	sylog.Debugf("Recording files opened under %s in %d directories", root, len(r.watches))
+
+	go r.run()
+
+	return r, nil
+}
+
+// run records the events until the recorder is stopped.
+func (r *Recorder) run() {
+	defer close(r.done)
+
+	b := make([]byte, 64*1024)
+	for {
+		n, err := r.file.Read(b)
+		if err != nil {
+			return
+		}
+		r.record(b[:n])
+	}
+}
+
+// record records the files opened reported by the inotify events in b.
+func (r *Recorder) record(b []byte) {
+	for len(b) >= syscall.SizeofInotifyEvent {
+		ev := (*syscall.InotifyEvent)(unsafe.Pointer(&b[0]))
+		end := syscall.SizeofInotifyEvent + int(ev.Len)
+		if end > len(b) {
+			return
+		}
+		name := strings.TrimRight(string(b[syscall.SizeofInotifyEvent:end]), "\x00")
+		b = b[end:]
+
+		if ev.Mask&syscall.IN_Q_OVERFLOW != 0 {
+			sylog.Warningf("Opened files events lost, the recorded list is incomplete")
+			continue
+		}
+		if ev.Mask&syscall.IN_OPEN == 0 || ev.Mask&syscall.IN_ISDIR != 0 || name == "" {
+			continue
+		}
+		dir, ok := r.watches[ev.Wd]
+		if !ok {
+			continue
+		}
+		path := filepath.Join(dir, name)
+		if !r.seen[path] {
+			r.seen[path] = true
+			r.files = append(r.files, path)
+		}
+	}
+}
+
+// Stop stops recording and returns the manifest listing the files opened
+// since the recorder started.
+func (r *Recorder) Stop() *Manifest {
+	// unblock the pending read, the events left are read below
+	r.file.SetReadDeadline(time.Now())
+	<-r.done
+
+	b := make([]byte, 64*1024)
+	for {
+		n, err := syscall.Read(r.fd, b)
+		if err != nil || n <= 0 {
+			break
+		}
+		r.record(b[:n])
+	}
+	r.file.Close()
+
+	return &Manifest{Files: r.files}
+}
@@ -10,6 +10,7 @@ import (
 
 	specs "github.com/opencontainers/runtime-spec/specs-go"
 	"github.com/opencontainers/runtime-tools/generate"
+	"github.com/sylabs/singularity/pkg/runtime/engine/config"
 )
 
 // Config is the OCI runtime configuration.
@@ -31,3 +32,17 @@ func (c *Config) UnmarshalJSON(b []byte) error {
 	c.Generator = generate.Generator{Config: &c.Spec}
 	return nil
 }
+
+// MarshalBinary implements encoding.BinaryMarshaler.
+func (c *Config) MarshalBinary() ([]byte, error) {
+	return config.EncodeBinary(&c.Spec)
+}
+
+// UnmarshalBinary implements encoding.BinaryUnmarshaler.
+func (c *Config) UnmarshalBinary(b []byte) error {
+	if err := config.DecodeBinary(b, &c.Spec); err != nil {
+		return err
+	}
+	c.Generator = generate.Generator{Config: &c.Spec}
+	return nil
+}
@@ -15,7 +15,6 @@ package starter
 // #cgo CFLAGS: -I../../../../../../cmd/starter/c/include
 import "C"
 import (
-	"encoding/json"
 	"fmt"
 	"os"
 	"os/exec"
@@ -26,6 +25,7 @@ import (
 	"github.com/opencontainers/runtime-spec/specs-go"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/pkg/util/capabilities"
+	"golang.org/x/sys/unix"
 )
 
 const searchPath = "/usr/bin:/usr/sbin:/bin:/sbin:/usr/local/bin:/usr/local/sbin"
@@ -144,6 +144,14 @@ func (c *Config) SetWorkingDirectoryFd(fd int) {
 	c.config.starter.workingDirectoryFd = C.int(fd)
 }
 
+// SetZygoteFd changes starter config and sets the listening socket used by
+// an instance started in zygote mode. Container process will fork a new
+// stage 2 process for each connection on this socket, the file descriptor
+// must be kept open with KeepFileDescriptor.
+func (c *Config) SetZygoteFd(fd int) {
+	c.config.starter.zygoteFd = C.int(fd)
+}
+
 // KeepFileDescriptor adds a file descriptor to an array of file
 // descriptor that starter will kept open. All files opened during
 // stage 1 will be shared with starter process, once stage 1 returns
@@ -179,31 +187,68 @@ func (c *Config) SetAllowSetgroups(allow bool) {
 	}
 }
 
-// GetJSONConfig returns pointer to the engine's JSON configuration.
+// GetJSONConfig returns the engine's configuration, JSON or binary encoded.
 // A copy of the original bytes allocated on C heap is returned.
 func (c *Config) GetJSONConfig() []byte {
-	return C.GoBytes(unsafe.Pointer(&c.config.engine.config[0]), C.int(c.config.engine.size))
+	if c.config.engine.config == nil {
+		return nil
+	}
+	return C.GoBytes(unsafe.Pointer(c.config.engine.config), C.int(c.config.engine.size))
 }
 
-// WriteConfig modifies starter config by fully updating engine json
-// configuration stored there. If json config is too big the error
-// will be returned.
-func (c *Config) Write(payload interface{}) error {
-	jsonConf, err := json.Marshal(payload)
-	if err != nil {
-		return fmt.Errorf("failed to marshal payload: %s", err)
+// Write modifies starter config by fully updating engine configuration
+// stored there with data, encoded with config.Marshal. The configuration
+// is written into a new sealed memfd which is mapped by starter once stage 1
+// exits, the current configuration is not accessible anymore after this call.
+func (c *Config) Write(data []byte) error {
+	fd, err := unix.MemfdCreate("engine-config", unix.MFD_CLOEXEC|unix.MFD_ALLOW_SEALING)
+	if err == unix.ENOSYS || err == unix.EINVAL {
+		return c.writeShared(data)
+	} else if err != nil {
+		return fmt.Errorf("failed to create engine configuration memfd: %s", err)
 	}
 
-	size := len(jsonConf)
-	maxSize := C.MAX_JSON_SIZE - 1
-	if size >= maxSize {
-		return fmt.Errorf("json configuration too big %d > %d", size, maxSize)
+	for b := data; len(b) > 0; {
+		n, err := unix.Write(fd, b)
+		if err == unix.EINTR {
+			continue
+		} else if err != nil {
+			unix.Close(fd)
+			return fmt.Errorf("failed to write engine configuration: %s", err)
+		}
+		b = b[n:]
 	}
 
-	c.config.engine.size = C.size_t(size)
-	engineConfig := C.CBytes(jsonConf)
-	C.memcpy(unsafe.Pointer(&c.config.engine.config[0]), engineConfig, c.config.engine.size)
+	seals := unix.F_SEAL_SHRINK | unix.F_SEAL_GROW | unix.F_SEAL_WRITE | unix.F_SEAL_SEAL
+	if _, err := unix.FcntlInt(uintptr(fd), unix.F_ADD_SEALS, seals); err != nil {
+		unix.Close(fd)
+		return fmt.Errorf("failed to seal engine configuration: %s", err)
+	}
+
+	if c.config.engine.config != nil {
+		C.munmap(unsafe.Pointer(c.config.engine.config), c.config.engine.mapSize)
+	}
+	c.config.engine.fd = C.int(fd)
+	c.config.engine.size = C.size_t(len(data))
+	c.config.engine.mapSize = 0
+	c.config.engine.config = nil
+
+	return nil
+}
+
+// writeShared updates engine configuration in place for kernels
+// without memfd support, starter stored it in an anonymous shared
+// mapping with some room left for stage 1.
+func (c *Config) writeShared(data []byte) error {
+	size := len(data)
+	if c.config.engine.config == nil || size > int(c.config.engine.mapSize) {
+		return fmt.Errorf("engine configuration too big %d > %d", size, c.config.engine.mapSize)
+	}
+
+	engineConfig := C.CBytes(data)
+	C.memcpy(unsafe.Pointer(c.config.engine.config), engineConfig, C.size_t(size))
 	C.free(engineConfig)
+	c.config.engine.size = C.size_t(size)
 
 	return nil
 }
@@ -449,6 +494,11 @@ func (c *Config) SetTargetGID(gids []int) {
 // the underlying starter configuration. Attempt to modify the underlying config after
 // call to Release will result in a segmentation fault.
 func (c *Config) Release() error {
+	if c.config.engine.config != nil {
+		if C.munmap(unsafe.Pointer(c.config.engine.config), c.config.engine.mapSize) != 0 {
+			return fmt.Errorf("failed to release engine configuration memory")
+		}
+	}
 	if C.munmap(unsafe.Pointer(c.config), C.sizeof_struct_starterConfig) != 0 {
 		return fmt.Errorf("failed to release starter memory")
 	}
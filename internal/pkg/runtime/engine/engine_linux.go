@@ -7,7 +7,6 @@ package engine
 
 import (
 	"context"
-	"encoding/json"
 	"fmt"
 	"net"
 	"net/rpc"
@@ -23,6 +22,11 @@ import (
 type Engine struct {
 	Operations
 	*config.Common
+
+	// Encoding is the encoding of the configuration
+	// received by the engine, it's used to forward
+	// the configuration to next stages.
+	Encoding config.Encoding
 }
 
 // Operations is an interface describing necessary operations to launch
@@ -90,20 +94,13 @@ type Operations interface {
 	CleanupContainer(context.Context, error, syscall.WaitStatus) error
 }
 
-// getName returns the engine name set in JSON []byte configuration.
-func getName(b []byte) string {
-	engineName := struct {
-		EngineName string `json:"engineName"`
-	}{}
-	if err := json.Unmarshal(b, &engineName); err != nil {
-		return ""
-	}
-	return engineName.EngineName
-}
-
-// Get returns the engine described by the JSON []byte configuration.
+// Get returns the engine described by the []byte configuration
+// encoded with config.Marshal.
 func Get(b []byte) (*Engine, error) {
-	engineName := getName(b)
+	engineName, err := config.EngineName(b)
+	if err != nil {
+		return nil, fmt.Errorf("could not get engine name: %s", err)
+	}
 
 	// ensure engine with given name is registered
 	eOp, ok := registeredOperations[engineName]
@@ -117,11 +114,12 @@ func Get(b []byte) (*Engine, error) {
 		Common: &config.Common{
 			EngineConfig: eOp.Config(),
 		},
+		Encoding: config.EncodingOf(b),
 	}
 
-	// parse received JSON configuration to specific EngineConfig
-	if err := json.Unmarshal(b, e.Common); err != nil {
-		return nil, fmt.Errorf("could not parse JSON configuration: %s", err)
+	// parse received configuration to specific EngineConfig
+	if err := config.Unmarshal(b, e.Common); err != nil {
+		return nil, fmt.Errorf("could not parse configuration: %s", err)
 	}
 	e.InitConfig(e.Common)
 	return e, nil
@@ -19,6 +19,7 @@ import (
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/internal/pkg/util/priv"
 	"github.com/sylabs/singularity/internal/pkg/util/starter"
+	"github.com/sylabs/singularity/internal/pkg/zygote"
 	"github.com/sylabs/singularity/pkg/runtime/engine/config"
 	"github.com/sylabs/singularity/pkg/util/crypt"
 )
@@ -35,6 +36,16 @@ import (
 // https://github.com/opencontainers/runtime-spec/blob/master/runtime.md#lifecycle.
 // CleanupContainer is performing step 8/9 here.
 func (e *EngineOperations) CleanupContainer(ctx context.Context, fatal error, status syscall.WaitStatus) error {
+	if e.prefetchRecorder != nil {
+		path := e.EngineConfig.GetPrefetchRecord()
+		m := e.prefetchRecorder.Stop()
+		if err := m.Save(path); err != nil {
+			sylog.Errorf("could not write prefetch manifest %s: %v", path, err)
+		} else {
+			sylog.Infof("Recorded %d files opened by the container in %s", len(m.Files), path)
+		}
+	}
+
 	if e.EngineConfig.GetDeleteImage() {
 		image := e.EngineConfig.GetImage()
 		sylog.Verbosef("Removing image %s", image)
@@ -75,12 +86,32 @@ func (e *EngineOperations) CleanupContainer(ctx context.Context, fatal error, st
 		}
 	}
 
+	if e.lazyDevice != nil {
+		// the container mount namespace holding the root
+		// filesystem mounted from the device is gone
+		if err := e.lazyDevice.Detach(); err != nil {
+			sylog.Errorf("could not detach %s: %v", e.lazyDevice.Path, err)
+		}
+	}
+
 	if e.EngineConfig.CryptDev != "" {
 		if err := cleanupCrypt(e.EngineConfig.CryptDev); err != nil {
 			sylog.Errorf("could not cleanup crypt: %v", err)
 		}
 	}
 
+	if e.EngineConfig.GetZygote() {
+		// removed along with the instance file, but the instance
+		// file may not have been written
+		path, err := zygote.SocketPath(e.CommonConfig.ContainerID)
+		if err == nil {
+			err = os.Remove(path)
+		}
+		if err != nil && !os.IsNotExist(err) {
+			sylog.Errorf("could not remove zygote socket: %v", err)
+		}
+	}
+
 	if e.EngineConfig.GetInstance() {
 		file, err := instance.Get(e.CommonConfig.ContainerID, instance.SingSubDir)
 		if err != nil {
@@ -8,16 +8,21 @@ package singularity
 import (
 	"context"
 	"fmt"
+	"io"
 	"io/ioutil"
 	"os"
 	"path/filepath"
 	"strconv"
 	"strings"
 	"syscall"
+	"time"
 
 	specs "github.com/opencontainers/runtime-spec/specs-go"
 	"github.com/sylabs/singularity/internal/pkg/buildcfg"
 	"github.com/sylabs/singularity/internal/pkg/cgroups"
+	"github.com/sylabs/singularity/internal/pkg/client/download"
+	"github.com/sylabs/singularity/internal/pkg/prefetch"
+	args "github.com/sylabs/singularity/internal/pkg/runtime/engine/singularity/rpc"
 	"github.com/sylabs/singularity/internal/pkg/runtime/engine/singularity/rpc/client"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/internal/pkg/util/fs"
@@ -27,8 +32,11 @@ import (
 	"github.com/sylabs/singularity/internal/pkg/util/fs/layout/layer/underlay"
 	"github.com/sylabs/singularity/internal/pkg/util/fs/mount"
 	fsoverlay "github.com/sylabs/singularity/internal/pkg/util/fs/overlay"
+	"github.com/sylabs/singularity/internal/pkg/util/fs/squashfs"
 	"github.com/sylabs/singularity/internal/pkg/util/mainthread"
+	"github.com/sylabs/singularity/internal/pkg/util/nbd"
 	"github.com/sylabs/singularity/internal/pkg/util/priv"
+	"github.com/sylabs/singularity/internal/pkg/util/trace"
 	"github.com/sylabs/singularity/internal/pkg/util/user"
 	"github.com/sylabs/singularity/pkg/image"
 	"github.com/sylabs/singularity/pkg/network"
@@ -48,8 +56,9 @@ var defaultCNIConfPath = filepath.Join(buildcfg.SYSCONFDIR, "singularity", "netw
 var defaultCNIPluginPath = filepath.Join(buildcfg.LIBEXECDIR, "singularity", "cni")
 
 type lastMount struct {
-	dest  string
-	flags uintptr
+	dest     string
+	flags    uintptr
+	detached bool
 }
 
 type container struct {
@@ -68,6 +77,36 @@ type container struct {
 	skippedMount  []string
 	suidFlag      uintptr
 	devSourcePath string
+	// imageFuse is the root filesystem image served by squashfuse
+	// once mounted, nil when mounted with a loop device
+	imageFuse *image.Image
+	// imageLazy is the network block device serving the root
+	// filesystem of a lazily fetched image, nil otherwise
+	imageLazy *nbd.Device
+	// prefetchManifest lists the root filesystem image files read
+	// in background once the container root filesystem is mounted
+	prefetchManifest *prefetch.Manifest
+	// mountPlan holds the mount operations queued until the mount
+	// system flushes them
+	mountPlan []mountOp
+	// detachedMount holds the destinations of bind mounts created
+	// detached with their mount flags applied, noMountAPI is set
+	// once the kernel reported no support for the new mount API
+	detachedMount map[string]bool
+	noMountAPI    bool
+	// identity holds the user and group entries looked up on the
+	// host, created on first use
+	identity *user.Snapshot
+}
+
+// mountOp is a queued mount operation of the mount plan.
+type mountOp struct {
+	arguments args.MountArgs
+	// skip reports if the operation must be skipped, it's evaluated
+	// when the operation is sent
+	skip func() bool
+	// done handles the operation result
+	done func(error) error
 }
 
 func create(ctx context.Context, engine *EngineOperations, rpcOps *client.RPC, pid int) error {
@@ -79,6 +118,7 @@ func create(ctx context.Context, engine *EngineOperations, rpcOps *client.RPC, p
 		sessionFsType: engine.EngineConfig.File.MemoryFSType,
 		mountInfoPath: fmt.Sprintf("/proc/%d/mountinfo", pid),
 		skippedMount:  make([]string, 0),
+		detachedMount: make(map[string]bool),
 		suidFlag:      syscall.MS_NOSUID,
 	}
 
@@ -119,7 +159,7 @@ func create(ctx context.Context, engine *EngineOperations, rpcOps *client.RPC, p
 	}
 
 	p := &mount.Points{}
-	system := &mount.System{Points: p, Mount: c.mount}
+	system := &mount.System{Points: p, Mount: c.mount, Flush: c.flushMounts}
 
 	if err := c.setupSessionLayout(system); err != nil {
 		return err
@@ -142,50 +182,32 @@ func create(ctx context.Context, engine *EngineOperations, rpcOps *client.RPC, p
 		return err
 	}
 
-	if err := c.addRootfsMount(system); err != nil {
-		return err
-	}
-	if err := c.addKernelMount(system); err != nil {
-		return err
-	}
-	if err := c.addDevMount(system); err != nil {
-		return err
-	}
-	if err := c.addHostMount(system); err != nil {
-		return err
-	}
-	if err := c.addBindsMount(system); err != nil {
-		return err
-	}
-	if err := c.addHomeMount(system); err != nil {
-		return err
-	}
-	if err := c.addUserbindsMount(system); err != nil {
-		return err
-	}
-	if err := c.addTmpMount(system); err != nil {
-		return err
-	}
-	if err := c.addScratchMount(system); err != nil {
-		return err
-	}
-	if err := c.addLibsMount(system); err != nil {
-		return err
-	}
-	if err := c.addFilesMount(system); err != nil {
-		return err
-	}
-	if err := c.addResolvConfMount(system); err != nil {
-		return err
-	}
-	if err := c.addHostnameMount(system); err != nil {
-		return err
-	}
-	if err := c.addFuseMount(system); err != nil {
-		return err
-	}
-	if err := c.addCwdMount(system); err != nil {
-		return err
+	mounts := []struct {
+		name string
+		fn   func(*mount.System) error
+	}{
+		{"add_rootfs_mount", c.addRootfsMount},
+		{"add_kernel_mount", c.addKernelMount},
+		{"add_dev_mount", c.addDevMount},
+		{"add_host_mount", c.addHostMount},
+		{"add_binds_mount", c.addBindsMount},
+		{"add_home_mount", c.addHomeMount},
+		{"add_userbinds_mount", c.addUserbindsMount},
+		{"add_tmp_mount", c.addTmpMount},
+		{"add_scratch_mount", c.addScratchMount},
+		{"add_libs_mount", c.addLibsMount},
+		{"add_files_mount", c.addFilesMount},
+		{"add_resolvconf_mount", c.addResolvConfMount},
+		{"add_hostname_mount", c.addHostnameMount},
+		{"add_fuse_mount", c.addFuseMount},
+		{"add_cwd_mount", c.addCwdMount},
+	}
+
+	for _, m := range mounts {
+		if err := m.fn(system); err != nil {
+			return err
+		}
+		trace.Event(m.name)
 	}
 
 	networkSetup, err := c.prepareNetworkSetup(system, pid)
@@ -197,6 +219,7 @@ func create(ctx context.Context, engine *EngineOperations, rpcOps *client.RPC, p
 	if err := system.MountAll(); err != nil {
 		return err
 	}
+	trace.Event("mount_all")
 
 	// chroot from RPC server current working directory since
 	// it's already in final directory after chdirFinal call
@@ -209,6 +232,11 @@ func create(ctx context.Context, engine *EngineOperations, rpcOps *client.RPC, p
 			return fmt.Errorf("chroot failed: %s", err)
 		}
 	}
+	trace.Event("chroot")
+
+	if err := c.startPrefetch(pid); err != nil {
+		sylog.Warningf("Could not prefetch container files: %s", err)
+	}
 
 	if networkSetup != nil {
 		if err := networkSetup(ctx); err != nil {
@@ -303,18 +331,124 @@ func (c *container) isLayerEnabled() bool {
 
 func (c *container) mount(point *mount.Point, system *mount.System) error {
 	if _, err := mount.GetOffset(point.InternalOptions); err == nil {
+		// image mounts are not queued, execute the mount plan first
+		// to preserve the mount order
+		if err := c.flushMounts(system); err != nil {
+			return err
+		}
 		if err := c.mountImage(point); err != nil {
 			return fmt.Errorf("while mounting image %s: %s", point.Source, err)
 		}
 	} else {
 		tag := system.CurrentTag()
-		if err := c.mountGeneric(point, tag); err != nil {
+		if err := c.mountGeneric(point, system); err != nil {
 			return fmt.Errorf("while mounting %s: %s", point.Source, err)
 		}
+		if tag == mount.RootfsTag && point.Type == "fuse" && c.imageFuse != nil {
+			if err := c.flushMounts(system); err != nil {
+				return err
+			}
+			if err := c.serveImageFuse(); err != nil {
+				return fmt.Errorf("while mounting image %s: %s", point.Source, err)
+			}
+		}
 	}
 	return nil
 }
 
+// queueMount adds a mount operation to the mount plan, it's executed
+// along with the other queued operations once the mount plan is flushed,
+// the operation is skipped if skip is not nil and returns true.
+func (c *container) queueMount(arguments args.MountArgs, skip func() bool, done func(error) error) {
+	c.mountPlan = append(c.mountPlan, mountOp{
+		arguments: arguments,
+		skip:      skip,
+		done:      done,
+	})
+}
+
+// hasRemount returns if a remount point of destination dest follows
+// the bind mount point of the tag being mounted.
+func (c *container) hasRemount(system *mount.System, dest string) bool {
+	for _, point := range system.Points.GetByTag(system.CurrentTag()) {
+		flags, _ := mount.ConvertOptions(point.Options)
+		if point.Destination == dest && mount.HasRemountFlag(flags) {
+			return true
+		}
+	}
+	return false
+}
+
+// flushMounts executes the operations of the mount plan with a single
+// RPC call. Execution stops at the first failing operation, if the
+// error is not fatal the remaining operations are sent again.
+func (c *container) flushMounts(system *mount.System) error {
+	defer func() {
+		c.mountPlan = nil
+	}()
+
+	for len(c.mountPlan) > 0 {
+		plan := make([]mountOp, 0, len(c.mountPlan))
+		ops := make([]args.MountArgs, 0, len(c.mountPlan))
+		for _, op := range c.mountPlan {
+			if op.arguments.Detached && c.noMountAPI {
+				// fall back to a bind mount followed by a remount
+				op.arguments.Detached = false
+				delete(c.detachedMount, op.arguments.Target)
+			}
+			if op.skip != nil && op.skip() {
+				continue
+			}
+			plan = append(plan, op)
+			ops = append(ops, op.arguments)
+		}
+		if len(plan) == 0 {
+			break
+		}
+
+		errs, err := c.rpcOps.MountBatch(ops)
+		if err != nil {
+			return fmt.Errorf("while mounting batch: %s", err)
+		}
+		for i, err := range errs {
+			if err := plan[i].done(err); err != nil {
+				return fmt.Errorf("while mounting %s: %s", plan[i].arguments.Source, err)
+			}
+		}
+		c.mountPlan = plan[len(errs):]
+	}
+
+	return nil
+}
+
+// serveImageFuse starts squashfuse to serve the root filesystem
+// image through the FUSE connection mounted as root filesystem. The
+// driver runs with the user privileges and exits once the container
+// mount namespace is released.
+func (c *container) serveImageFuse() error {
+	program, err := squashfs.GetFusePath(c.engine.EngineConfig.File)
+	if err != nil {
+		return err
+	}
+
+	fd := c.engine.EngineConfig.GetImageFuseFd()
+	fuse := os.NewFile(uintptr(fd), "/dev/fuse")
+	// the master process doesn't need it once the driver started
+	defer fuse.Close()
+
+	// the image file descriptor is still used by the RPC server
+	imageFd, err := syscall.Dup(int(c.imageFuse.Fd))
+	if err != nil {
+		return fmt.Errorf("failed to duplicate image file descriptor: %s", err)
+	}
+	img := os.NewFile(uintptr(imageFd), c.imageFuse.Path)
+	defer img.Close()
+
+	sylog.Debugf("Serving %s with %s", c.imageFuse.Path, program)
+
+	return squashfs.FuseServe(program, fuse, img, c.imageFuse.Partitions[0].Offset)
+}
+
 // setPropagationMount will apply propagation flag set by
 // configuration directive, when applied master process
 // won't see mount done by RPC server anymore. Typically
@@ -392,23 +526,19 @@ func (c *container) isMounted(dest string) bool {
 		return false
 	}
 
-	entries, err := proc.GetMountInfoEntry(c.mountInfoPath)
+	info, err := proc.GetMountInfo(c.mountInfoPath)
 	if err != nil {
 		sylog.Debugf("Could not get %s entries: %s", c.mountInfoPath, err)
 		return false
 	}
 
-	for _, e := range entries {
-		if e.Point == dest {
-			return true
-		}
-	}
-
-	return false
+	return info.IsMounted(dest)
 }
 
-// mount any generic mount (not loop dev)
-func (c *container) mountGeneric(mnt *mount.Point, tag mount.AuthorizedTag) (err error) {
+// mount any generic mount (not loop dev), the mount operation is queued
+// in the mount plan unless it depends on the previous mount operations
+func (c *container) mountGeneric(mnt *mount.Point, system *mount.System) (err error) {
+	tag := system.CurrentTag()
 	flags, opts := mount.ConvertOptions(mnt.Options)
 	optsString := strings.Join(opts, ",")
 	sessionPath := c.session.Path()
@@ -417,6 +547,12 @@ func (c *container) mountGeneric(mnt *mount.Point, tag mount.AuthorizedTag) (err
 	propagation := mount.HasPropagationFlag(flags)
 	source := mnt.Source
 	dest := ""
+	// bind mounts followed by a remount are created detached with
+	// the new mount API applying the remount flags in one step
+	detached := false
+	// applied is set for remounts whose flags are already applied
+	// by a detached bind mount
+	applied := false
 
 	if bindMount {
 		if !remount {
@@ -432,15 +568,17 @@ func (c *container) mountGeneric(mnt *mount.Point, tag mount.AuthorizedTag) (err
 			if err != nil {
 				return fmt.Errorf("while getting mount flags for %s: %s", source, err)
 			}
+			detached = !c.noMountAPI && c.hasRemount(system, mnt.Destination)
 			// save them for the remount step
 			c.lastMount = lastMount{
-				dest:  mnt.Destination,
-				flags: flags,
+				dest:     mnt.Destination,
+				flags:    flags,
+				detached: detached,
 			}
 		} else if c.lastMount.dest == mnt.Destination {
+			applied = c.lastMount.detached && flags&^(c.lastMount.flags|syscall.MS_REMOUNT) == 0
 			flags = c.lastMount.flags | flags
-			c.lastMount.dest = ""
-			c.lastMount.flags = 0
+			c.lastMount = lastMount{}
 		}
 	}
 
@@ -451,15 +589,33 @@ func (c *container) mountGeneric(mnt *mount.Point, tag mount.AuthorizedTag) (err
 		dest = mnt.Destination
 	}
 
+	// the mount point is referenced by the mount operation
+	// handlers executed once the mount plan is flushed
+	point := *mnt
+	mnt = &point
+
+	var skip func() bool
+	queue := true
+
 	if remount || propagation {
-		for _, skipped := range c.skippedMount {
-			if skipped == mnt.Destination {
-				return nil
+		// the mount point may be skipped once the mount
+		// operations queued before are executed
+		skip = func() bool {
+			for _, skipped := range c.skippedMount {
+				if skipped == mnt.Destination {
+					return true
+				}
 			}
+			return applied && c.detachedMount[dest]
 		}
 		sylog.Debugf("Remounting %s\n", dest)
 	} else {
 		if tag == mount.CwdTag {
+			// checks below require the previous mounts
+			if err := c.flushMounts(system); err != nil {
+				return err
+			}
+
 			hostCwd := c.engine.EngineConfig.GetCwd()
 			containerCwd := filepath.Join(c.session.FinalPath(), mnt.Destination)
 
@@ -481,69 +637,100 @@ func (c *container) mountGeneric(mnt *mount.Point, tag mount.AuthorizedTag) (err
 		// overlay requires root filesystem UID/GID since upper/work
 		// directories are owned by root
 		if tag == mount.LayerTag && mnt.Type == "overlay" {
+			if err := c.flushMounts(system); err != nil {
+				return err
+			}
+			queue = false
+
 			c.rpcOps.SetFsID(0, 0)
 			defer c.rpcOps.SetFsID(os.Getuid(), os.Getgid())
 		}
 	}
 
-mount:
-	err = c.rpcOps.Mount(source, dest, mnt.Type, flags, optsString)
-	if os.IsNotExist(err) {
-		switch tag {
-		case mount.KernelTag,
-			mount.HostfsTag,
-			mount.BindsTag,
-			mount.CwdTag,
-			mount.FilesTag,
-			mount.TmpTag:
-			c.skippedMount = append(c.skippedMount, mnt.Destination)
-			sylog.Warningf("Skipping mount %s [%s]: %s doesn't exist in container", source, tag, mnt.Destination)
-			return nil
-		default:
-			if c.engine.EngineConfig.GetWritableImage() {
-				sylog.Warningf(
-					"By using --writable, Singularity can't create %s destination automatically without overlay or underlay",
-					mnt.Destination,
-				)
-			} else if !c.isLayerEnabled() {
-				sylog.Warningf("No layer in use (overlay or underlay), check your configuration, "+
-					"Singularity can't create %s destination automatically without overlay or underlay", mnt.Destination)
-			}
-			return fmt.Errorf("destination %s doesn't exist in container", mnt.Destination)
-		}
-	} else if err != nil {
-		if !bindMount {
-			if mnt.Type == "devpts" {
-				sylog.Verbosef("Couldn't mount devpts filesystem, continuing with PTY allocation functionality disabled")
+	// done handles the mount operation result
+	var done func(error) error
+
+	done = func(err error) error {
+		if err == syscall.ENOSYS && detached {
+			sylog.Debugf("New mount API not supported, falling back to bind mount and remount")
+			c.noMountAPI = true
+			delete(c.detachedMount, dest)
+			detached = false
+			return done(c.rpcOps.Mount(source, dest, mnt.Type, flags, optsString))
+		}
+		if os.IsNotExist(err) {
+			switch tag {
+			case mount.KernelTag,
+				mount.HostfsTag,
+				mount.BindsTag,
+				mount.CwdTag,
+				mount.FilesTag,
+				mount.TmpTag:
+				c.skippedMount = append(c.skippedMount, mnt.Destination)
+				sylog.Warningf("Skipping mount %s [%s]: %s doesn't exist in container", source, tag, mnt.Destination)
 				return nil
-			} else if mnt.Type == "overlay" && err == syscall.ESTALE {
-				// overlay mount can return this error when a previous mount was
-				// done with an upper layer and overlay inodes index is enabled
-				// by default, see https://github.com/sylabs/singularity/issues/4539
-				sylog.Verbosef("Overlay mount failed with %s, mounting with index=off", err)
-				optsString = fmt.Sprintf("%s,index=off", optsString)
-				goto mount
-			}
-			// mount error for other filesystems is considered fatal
-			return fmt.Errorf("can't mount %s filesystem to %s: %s", mnt.Type, mnt.Destination, err)
-		}
-		if remount {
-			if os.IsPermission(err) && c.userNS {
-				// when using user namespace we always try to apply mount flags with
-				// remount, then if we get a permission denied error, we continue
-				// execution by ignoring the error and warn user if the bind mount
-				// need to be mounted read-only
-				if flags&syscall.MS_RDONLY != 0 {
-					sylog.Warningf("Could not remount %s read-only: %s", mnt.Destination, err)
-				} else {
-					sylog.Verbosef("Could not remount %s: %s", mnt.Destination, err)
+			default:
+				if c.engine.EngineConfig.GetWritableImage() {
+					sylog.Warningf(
+						"By using --writable, Singularity can't create %s destination automatically without overlay or underlay",
+						mnt.Destination,
+					)
+				} else if !c.isLayerEnabled() {
+					sylog.Warningf("No layer in use (overlay or underlay), check your configuration, "+
+						"Singularity can't create %s destination automatically without overlay or underlay", mnt.Destination)
 				}
-				return nil
+				return fmt.Errorf("destination %s doesn't exist in container", mnt.Destination)
+			}
+		} else if err != nil {
+			if !bindMount {
+				if mnt.Type == "devpts" {
+					sylog.Verbosef("Couldn't mount devpts filesystem, continuing with PTY allocation functionality disabled")
+					return nil
+				} else if mnt.Type == "overlay" && err == syscall.ESTALE {
+					// overlay mount can return this error when a previous mount was
+					// done with an upper layer and overlay inodes index is enabled
+					// by default, see https://github.com/sylabs/singularity/issues/4539
+					sylog.Verbosef("Overlay mount failed with %s, mounting with index=off", err)
+					optsString = fmt.Sprintf("%s,index=off", optsString)
+					return done(c.rpcOps.Mount(source, dest, mnt.Type, flags, optsString))
+				}
+				// mount error for other filesystems is considered fatal
+				return fmt.Errorf("can't mount %s filesystem to %s: %s", mnt.Type, mnt.Destination, err)
+			}
+			if remount {
+				if os.IsPermission(err) && c.userNS {
+					// when using user namespace we always try to apply mount flags with
+					// remount, then if we get a permission denied error, we continue
+					// execution by ignoring the error and warn user if the bind mount
+					// need to be mounted read-only
+					if flags&syscall.MS_RDONLY != 0 {
+						sylog.Warningf("Could not remount %s read-only: %s", mnt.Destination, err)
+					} else {
+						sylog.Verbosef("Could not remount %s: %s", mnt.Destination, err)
+					}
+					return nil
+				}
+				return fmt.Errorf("could not remount %s: %s", mnt.Destination, err)
 			}
-			return fmt.Errorf("could not remount %s: %s", mnt.Destination, err)
+			return fmt.Errorf("could not mount %s: %s", mnt.Source, err)
 		}
-		return fmt.Errorf("could not mount %s: %s", mnt.Source, err)
+		return nil
+	}
+
+	if !queue {
+		return done(c.rpcOps.Mount(source, dest, mnt.Type, flags, optsString))
+	}
+	if detached {
+		c.detachedMount[dest] = true
 	}
+	c.queueMount(args.MountArgs{
+		Source:     source,
+		Target:     dest,
+		Filesystem: mnt.Type,
+		Mountflags: flags,
+		Data:       optsString,
+		Detached:   detached,
+	}, skip, done)
 
 	return nil
 }
@@ -578,13 +765,21 @@ func (c *container) mountImage(mnt *mount.Point) error {
 		Flags:     loopFlags,
 	}
 
-	shared := c.engine.EngineConfig.File.SharedLoopDevices
-	number, err := c.rpcOps.LoopDevice(mnt.Source, attachFlag, *info, maxDevices, shared)
-	if err != nil {
-		return fmt.Errorf("failed to find loop device: %s", err)
-	}
+	var path string
 
-	path := fmt.Sprintf("/dev/loop%d", number)
+	if c.imageLazy != nil && mnt.Destination == c.session.RootFsPath() {
+		// the root filesystem partition of a lazily fetched image
+		// is served by a network block device
+		path = c.imageLazy.Path
+	} else {
+		shared := c.engine.EngineConfig.File.SharedLoopDevices
+		number, err := c.rpcOps.LoopDevice(mnt.Source, attachFlag, *info, maxDevices, shared)
+		if err != nil {
+			return fmt.Errorf("failed to find loop device: %s", err)
+		}
+
+		path = fmt.Sprintf("/dev/loop%d", number)
+	}
 
 	sylog.Debugf("Mounting loop device %s to %s of type %s\n", path, mnt.Destination, mnt.Type)
 
@@ -640,7 +835,10 @@ func (c *container) mountImage(mnt *mount.Point) error {
 	return nil
 }
 
-func (c *container) loadImage(path string, rootfs bool) (*image.Image, error) {
+// loadImage returns the root filesystem image or the nth overlay image
+// with the given path, a SIF image being listed once for each of its
+// overlay partitions.
+func (c *container) loadImage(path string, rootfs bool, nth int) (*image.Image, error) {
 	list := c.engine.EngineConfig.GetImageList()
 
 	if len(list) == 0 {
@@ -658,21 +856,26 @@ func (c *container) loadImage(path string, rootfs bool) (*image.Image, error) {
 		}
 		return &img, nil
 	}
+	p, err := image.ResolvePath(path)
+	if err != nil {
+		return nil, err
+	}
 	for _, img := range list[1:] {
-		p, err := image.ResolvePath(path)
-		if err != nil {
-			return nil, err
+		if p != img.Path {
+			continue
 		}
-		if p == img.Path {
-			if img.File == nil {
-				return &img, nil
-			}
-			img.File = os.NewFile(img.Fd, img.Path)
-			if img.File == nil {
-				return nil, fmt.Errorf("can't find image %s", path)
-			}
+		if nth > 0 {
+			nth--
+			continue
+		}
+		if img.File == nil {
 			return &img, nil
 		}
+		img.File = os.NewFile(img.Fd, img.Path)
+		if img.File == nil {
+			return nil, fmt.Errorf("can't find image %s", path)
+		}
+		return &img, nil
 	}
 
 	return nil, fmt.Errorf("no image found with path %s", path)
@@ -682,11 +885,13 @@ func (c *container) addRootfsMount(system *mount.System) error {
 	flags := uintptr(c.suidFlag | syscall.MS_NODEV)
 	rootfs := c.engine.EngineConfig.GetImage()
 
-	imageObject, err := c.loadImage(rootfs, true)
+	imageObject, err := c.loadImage(rootfs, true, 0)
 	if err != nil {
 		return err
 	}
 
+	c.loadPrefetchManifest(imageObject)
+
 	if !imageObject.Writable {
 		sylog.Debugf("Mount rootfs in read-only mode")
 		flags |= syscall.MS_RDONLY
@@ -701,9 +906,44 @@ func (c *container) addRootfsMount(system *mount.System) error {
 
 	sylog.Debugf("Image type is %v", imageObject.Partitions[0].Type)
 
+	lazy := download.IsLazy(imageObject.Path)
+
 	switch imageObject.Partitions[0].Type {
 	case image.SQUASHFS:
 		mountType = "squashfs"
+
+		if lazy && !imageObject.Writable {
+			err := c.attachLazyImage(imageObject)
+			if err == nil {
+				// mounted from the network block device
+				sylog.Debugf("Mounting lazily fetched squashfs image from %s: %v\n", c.imageLazy.Path, rootfs)
+				lazy = false
+				break
+			}
+			sylog.Verbosef("Could not serve lazily fetched image, fetching it entirely: %s", err)
+		}
+		if lazy {
+			if err := c.fetchLazyImage(imageObject); err != nil {
+				return err
+			}
+			lazy = false
+		}
+
+		if fd := c.engine.EngineConfig.GetImageFuseFd(); fd > 0 && !imageObject.Writable {
+			sylog.Debugf("Mounting squashfs image with squashfuse: %v\n", rootfs)
+			c.imageFuse = imageObject
+			// we assume that the /dev/fuse file descriptor opened in
+			// stage 1 is valid in the RPC server where the mount occurs
+			opts := squashfs.FuseMountOptions(fd, os.Getuid(), os.Getgid())
+			return system.Points.AddFSWithSource(
+				mount.RootfsTag,
+				imageObject.Source,
+				c.session.RootFsPath(),
+				"fuse",
+				flags|syscall.MS_NOSUID|syscall.MS_NODEV,
+				opts,
+			)
+		}
 	case image.EXT3:
 		mountType = "ext3"
 	case image.ENCRYPTSQUASHFS:
@@ -727,6 +967,12 @@ func (c *container) addRootfsMount(system *mount.System) error {
 		return system.Points.AddPropagation(mount.RootfsTag, c.session.RootFsPath(), flags)
 	}
 
+	if lazy {
+		if err := c.fetchLazyImage(imageObject); err != nil {
+			return err
+		}
+	}
+
 	sylog.Debugf("Mounting block [%v] image: %v\n", mountType, rootfs)
 	if err := system.Points.AddImage(
 		mount.RootfsTag,
@@ -748,6 +994,140 @@ func (c *container) addRootfsMount(system *mount.System) error {
 	return nil
 }
 
+// openLazyImage opens the lazily fetched image img, which must be the
+// image file opened in stage 1.
+func (c *container) openLazyImage(img *image.Image) (*download.LazyFile, error) {
+	// prefetch leaves bandwidth to the chunks read by the container
+	l, err := download.OpenLazy(img.Path, download.Options{Concurrency: 2})
+	if err != nil {
+		return nil, err
+	}
+	fi, err := l.File().Stat()
+	if err != nil {
+		l.Close()
+		return nil, err
+	}
+	ifi, err := img.File.Stat()
+	if err != nil {
+		l.Close()
+		return nil, err
+	}
+	if !os.SameFile(fi, ifi) {
+		l.Close()
+		return nil, fmt.Errorf("%s changed since opened", img.Path)
+	}
+	return l, nil
+}
+
+// attachLazyImage attaches a network block device serving the root
+// filesystem partition of the lazily fetched image img, mounted instead
+// of a loop device. The partition chunks are fetched as the container reads them and,
+// if enabled, in background until the image is complete. The device is
+// served by the master process until the container exits, it's detached
+// by CleanupContainer.
+func (c *container) attachLazyImage(img *image.Image) error {
+	l, err := c.openLazyImage(img)
+	if err != nil {
+		return err
+	}
+
+	part := img.Partitions[0]
+	device, err := nbd.Attach(io.NewSectionReader(l, int64(part.Offset), int64(part.Size)), int64(part.Size))
+	if err != nil {
+		l.Close()
+		return err
+	}
+	c.imageLazy = device
+	c.engine.lazyDevice = device
+
+	if c.engine.EngineConfig.File.LazyImagePrefetch {
+		go func() {
+			if err := l.Prefetch(context.Background()); err != nil {
+				sylog.Debugf("Could not prefetch %s: %s", img.Path, err)
+				return
+			}
+			sylog.Debugf("Lazily fetched image %s complete", img.Path)
+		}()
+	}
+
+	return nil
+}
+
+// fetchLazyImage fetches entirely the lazily fetched image img, when it
+// can't be served as a network block device.
+func (c *container) fetchLazyImage(img *image.Image) error {
+	l, err := c.openLazyImage(img)
+	if err != nil {
+		return fmt.Errorf("while opening lazily fetched image: %s", err)
+	}
+	defer l.Close()
+
+	if !l.Complete() {
+		sylog.Infof("Fetching image")
+	}
+	if err := l.Prefetch(context.Background()); err != nil {
+		return fmt.Errorf("while fetching image: %s", err)
+	}
+	return nil
+}
+
+// loadPrefetchManifest loads the prefetch manifest of the root filesystem
+// image img, if any, unless prefetch is disabled or the files opened by
+// the container are recorded.
+func (c *container) loadPrefetchManifest(img *image.Image) {
+	if !c.engine.EngineConfig.File.ImagePrefetch || c.engine.EngineConfig.GetPrefetchRecord() != "" {
+		return
+	}
+	m, err := prefetch.FromImage(img)
+	if err != nil {
+		sylog.Warningf("Could not load image prefetch manifest: %s", err)
+		return
+	}
+	c.prefetchManifest = m
+}
+
+// startPrefetch starts recording the files opened by the container, or
+// reading in background the files listed by the image prefetch manifest.
+// The master process accesses the container root filesystem through the
+// root directory of the container process, with its own privileges once
+// the directory opened.
+func (c *container) startPrefetch(pid int) error {
+	record := c.engine.EngineConfig.GetPrefetchRecord()
+	if record == "" && c.prefetchManifest == nil {
+		return nil
+	}
+
+	// the container process isn't dumpable in setuid workflow
+	priv.Escalate()
+	root, err := os.Open(fmt.Sprintf("/proc/%d/root", pid))
+	priv.Drop()
+	if err != nil {
+		return err
+	}
+	rootPath := fmt.Sprintf("/proc/self/fd/%d", root.Fd())
+
+	if record != "" {
+		defer root.Close()
+
+		r, err := prefetch.Record(rootPath)
+		if err != nil {
+			return err
+		}
+		c.engine.prefetchRecorder = r
+		sylog.Infof("Recording files opened by the container in %s", record)
+		return nil
+	}
+
+	go func() {
+		defer root.Close()
+
+		files, n := c.prefetchManifest.Prefetch(context.Background(), rootPath)
+		sylog.Debugf("Prefetched %d container files (%d bytes)", files, n)
+	}()
+
+	return nil
+}
+
 func (c *container) overlayUpperWork(system *mount.System) error {
 	ov := c.session.Layer.(*overlay.Overlay)
 
@@ -818,10 +1198,14 @@ func (c *container) addOverlayMount(system *mount.System) error {
 		hasUpper = true
 	}
 
+	// number of overlay images already loaded by path
+	loaded := make(map[string]int)
+
 	for _, img := range c.engine.EngineConfig.GetOverlayImage() {
 		splitted := strings.SplitN(img, ":", 2)
 
-		imageObject, err := c.loadImage(splitted[0], false)
+		imageObject, err := c.loadImage(splitted[0], false, loaded[splitted[0]])
+		loaded[splitted[0]]++
 		if err != nil {
 			return fmt.Errorf("failed to open overlay image %s: %s", splitted[0], err)
 		}
@@ -1308,12 +1692,25 @@ func (c *container) addBindsMount(system *mount.System) error {
 	return nil
 }
 
+// identityLookup returns the lookup of the user and group entries, backed
+// by the identity snapshot of the user.
+func (c *container) identityLookup() user.Lookup {
+	if c.identity == nil {
+		ttl := time.Duration(c.engine.EngineConfig.File.IdentityCacheTTL) * time.Second
+		dir := c.engine.EngineConfig.GetIdentityCacheDir()
+		c.identity = user.NewSnapshot(dir, uint32(os.Getuid()), ttl, user.NSS)
+	}
+	return c.identity
+}
+
 // getHomePaths returns the source and destination path of the requested home mount
 func (c *container) getHomePaths() (source string, dest string, err error) {
 	if c.engine.EngineConfig.GetCustomHome() {
 		dest = filepath.Clean(c.engine.EngineConfig.GetHomeDest())
 		source, err = filepath.Abs(filepath.Clean(c.engine.EngineConfig.GetHomeSource()))
 	} else {
+		// the home directory is bind mounted with privileges, it's always
+		// looked up with NSS and never from the user identity snapshot
 		pw, err := user.Current()
 		if err == nil {
 			dest = pw.Dir
@@ -1812,6 +2209,9 @@ func (c *container) addIdentityMount(system *mount.System) error {
 	rootfs := c.session.RootFsPath()
 	defer c.session.Update()
 
+	lookup := c.identityLookup()
+	defer c.identity.Store()
+
 	uid := os.Getuid()
 	if uid == 0 && c.engine.EngineConfig.GetTargetUID() != 0 {
 		uid = c.engine.EngineConfig.GetTargetUID()
@@ -1823,7 +2223,7 @@ func (c *container) addIdentityMount(system *mount.System) error {
 		if err != nil {
 			sylog.Warningf("%s", err)
 		} else {
-			content, err := files.Passwd(passwd, home, uid)
+			content, err := files.Passwd(passwd, home, uid, lookup)
 			if err != nil {
 				sylog.Warningf("%s", err)
 			} else {
@@ -1846,7 +2246,7 @@ func (c *container) addIdentityMount(system *mount.System) error {
 
 	if c.engine.EngineConfig.File.ConfigGroup {
 		group := filepath.Join(rootfs, "/etc/group")
-		content, err := files.Group(group, uid, c.engine.EngineConfig.GetTargetGID())
+		content, err := files.Group(group, uid, c.engine.EngineConfig.GetTargetGID(), lookup)
 		if err != nil {
 			sylog.Warningf("%s", err)
 		} else {
@@ -2143,12 +2543,12 @@ func (c *container) getBindFlags(source string, defaultFlags uintptr) (uintptr,
 	// use statfs to retrieve mount options or fallback to /proc/self/mountinfo
 	// in case of failure
 	if err := unix.Statfs(source, &stfs); err != nil {
-		entries, err := proc.GetMountInfoEntry(c.mountInfoPath)
+		info, err := proc.GetMountInfo(c.mountInfoPath)
 		if err != nil {
 			return 0, fmt.Errorf("error while reading %s: %s", c.mountInfoPath, err)
 		}
 
-		e, err := proc.FindParentMountEntry(source, entries)
+		e, err := info.FindParentMountEntry(source)
 		if err != nil {
 			return 0, fmt.Errorf("while searching parent mount point entry for %s: %s", source, err)
 		}
@@ -6,8 +6,10 @@
 package singularity
 
 import (
+	"github.com/sylabs/singularity/internal/pkg/prefetch"
 	"github.com/sylabs/singularity/internal/pkg/runtime/engine"
 	"github.com/sylabs/singularity/internal/pkg/runtime/engine/singularity/rpc/server"
+	"github.com/sylabs/singularity/internal/pkg/util/nbd"
 	"github.com/sylabs/singularity/pkg/runtime/engine/config"
 	singularityConfig "github.com/sylabs/singularity/pkg/runtime/engine/singularity/config"
 )
@@ -17,6 +19,14 @@ import (
 type EngineOperations struct {
 	CommonConfig *config.Common                  `json:"-"`
 	EngineConfig *singularityConfig.EngineConfig `json:"engineConfig"`
+
+	// prefetchRecorder records the files opened by the container
+	// in master process when requested
+	prefetchRecorder *prefetch.Recorder
+	// lazyDevice is the network block device served by master
+	// process for a lazily fetched image, detached once the
+	// container exited
+	lazyDevice *nbd.Device
 }
 
 // InitConfig stores the parsed config.Common inside the engine.
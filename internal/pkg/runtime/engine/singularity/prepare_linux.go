@@ -28,6 +28,7 @@ import (
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/internal/pkg/util/fs"
 	"github.com/sylabs/singularity/internal/pkg/util/fs/overlay"
+	"github.com/sylabs/singularity/internal/pkg/util/fs/squashfs"
 	"github.com/sylabs/singularity/internal/pkg/util/mainthread"
 	"github.com/sylabs/singularity/internal/pkg/util/user"
 	"github.com/sylabs/singularity/pkg/image"
@@ -160,6 +161,9 @@ func (e *EngineOperations) PrepareConfig(starterConfig *starter.Config) error {
 	if err := openDevFuse(e, starterConfig); err != nil {
 		return err
 	}
+	if err := openImageFuse(e, starterConfig); err != nil {
+		return err
+	}
 
 	return nil
 }
@@ -561,6 +565,12 @@ func (e *EngineOperations) prepareContainerConfig(starterConfig *starter.Config)
 
 	starterConfig.SetInstance(e.EngineConfig.GetInstance())
 
+	if e.EngineConfig.GetInstance() && e.EngineConfig.GetZygote() {
+		if err := e.prepareZygote(starterConfig); err != nil {
+			return err
+		}
+	}
+
 	starterConfig.SetNsFlagsFromSpec(e.EngineConfig.OciConfig.Linux.Namespaces)
 
 	// user namespace ID mappings
@@ -898,6 +908,46 @@ func openDevFuse(e *EngineOperations, starterConfig *starter.Config) error {
 	return nil
 }
 
+// openImageFuse opens /dev/fuse to mount the root filesystem image
+// with squashfuse when the FUSE image backend is selected, the image
+// is mounted with a loop device if squashfuse or /dev/fuse are not
+// available. The driver runs with the user privileges and could serve
+// another content than the image checked by the ECL, images are always
+// mounted with a loop device when the ECL is activated.
+func openImageFuse(e *EngineOperations, starterConfig *starter.Config) error {
+	// the file descriptor is part of the configuration passed by the
+	// user, only the one opened below can be used
+	e.EngineConfig.SetImageFuseFd(0)
+
+	if e.EngineConfig.File.ImageBackend != "fuse" {
+		return nil
+	}
+
+	if ecl, err := syecl.LoadConfig(buildcfg.ECL_FILE); err == nil && ecl.Activated {
+		sylog.Verbosef("ECL activated, fallback to loop device")
+		return nil
+	}
+
+	list := e.EngineConfig.GetImageList()
+	if len(list) == 0 || len(list[0].Partitions) == 0 || list[0].Partitions[0].Type != image.SQUASHFS {
+		return nil
+	}
+
+	if _, err := squashfs.GetFusePath(e.EngineConfig.File); err != nil {
+		sylog.Verbosef("squashfuse not found, fallback to loop device: %s", err)
+		return nil
+	}
+
+	fd, err := syscall.Open("/dev/fuse", syscall.O_RDWR, 0)
+	if err != nil {
+		sylog.Verbosef("Could not open /dev/fuse, fallback to loop device: %s", err)
+		return nil
+	}
+	e.EngineConfig.SetImageFuseFd(fd)
+
+	return starterConfig.KeepFileDescriptor(fd)
+}
+
 func (e *EngineOperations) checkSignalPropagation() {
 	// obtain the process group ID of the associated controlling
 	// terminal (if there's one).
@@ -1114,6 +1164,15 @@ func (e *EngineOperations) loadImages(starterConfig *starter.Config) error {
 					}
 				}
 			}
+		} else {
+			// squashfs overlay partitions hold files changed by
+			// incremental builds, the root filesystem is incomplete
+			// without them
+			for _, p := range img.Partitions[1:] {
+				if p.Overlay && p.Type == image.SQUASHFS {
+					return fmt.Errorf("%s has squashfs overlay partitions which require overlay support: overlay is disabled or not supported", img.Path)
+				}
+			}
 		}
 		// SIF image open for writing without writable
 		// overlay partition, assuming that the root
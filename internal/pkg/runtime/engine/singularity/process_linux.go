@@ -27,7 +27,9 @@ import (
 	"github.com/sylabs/singularity/internal/pkg/security"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/internal/pkg/util/machine"
+	"github.com/sylabs/singularity/internal/pkg/util/trace"
 	"github.com/sylabs/singularity/internal/pkg/util/user"
+	"github.com/sylabs/singularity/internal/pkg/zygote"
 	singularity "github.com/sylabs/singularity/pkg/runtime/engine/singularity/config"
 	"github.com/sylabs/singularity/pkg/util/rlimit"
 	"golang.org/x/crypto/ssh/terminal"
@@ -145,6 +147,11 @@ func (e *EngineOperations) StartProcess(masterConn net.Conn) error {
 		return fmt.Errorf("failed to apply security configuration: %s", err)
 	}
 
+	trace.Event("exec")
+	if err := trace.Flush(); err != nil {
+		sylog.Warningf("%s", err)
+	}
+
 	if (!isInstance && !shimProcess) || bootInstance || e.EngineConfig.GetInstanceJoin() {
 		err := syscall.Exec(args[0], args, env)
 		if err != nil {
@@ -321,6 +328,13 @@ func (e *EngineOperations) PostStartProcess(ctx context.Context, pid int) error
 		}
 		file.IP = ip
 
+		if e.EngineConfig.GetZygote() {
+			file.Zygote, err = zygote.SocketPath(name)
+			if err != nil {
+				return err
+			}
+		}
+
 		// by default we add all namespaces except the user namespace which
 		// is added conditionally. This delegates checks to the C starter code
 		// which will determine if a namespace needs to be joined by
@@ -34,6 +34,20 @@ type MountArgs struct {
 	Filesystem string
 	Mountflags uintptr
 	Data       string
+	// Detached requests a bind mount created as a detached mount
+	// with the mount flags applied before it's attached to target
+	Detached bool
+}
+
+// MountBatchArgs defines the arguments to mount a batch of mount points.
+type MountBatchArgs struct {
+	Ops []MountArgs
+}
+
+// MountBatchReply defines the reply of a batch of mount operations,
+// with the error of each operation executed.
+type MountBatchReply struct {
+	Errs []error
 }
 
 // CryptArgs defines the arguments to mount.
@@ -42,6 +42,21 @@ func (t *RPC) Mount(source string, target string, filesystem string, flags uintp
 	return err
 }
 
+// MountBatch calls the mount batch RPC with the supplied mount operations.
+// The operations are executed in order until one fails, it returns the
+// result of each operation executed.
+func (t *RPC) MountBatch(ops []args.MountArgs) ([]error, error) {
+	arguments := &args.MountBatchArgs{
+		Ops: ops,
+	}
+
+	var reply args.MountBatchReply
+
+	err := t.Client.Call(t.Name+".MountBatch", arguments, &reply)
+
+	return reply.Errs, err
+}
+
 // Decrypt calls the DeCrypt RPC using the supplied arguments.
 func (t *RPC) Decrypt(offset uint64, path string, key []byte, masterPid int) (string, error) {
 	arguments := &args.CryptArgs{
@@ -15,6 +15,7 @@ import (
 
 	args "github.com/sylabs/singularity/internal/pkg/runtime/engine/singularity/rpc"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
+	"github.com/sylabs/singularity/internal/pkg/util/fs/mount"
 	"github.com/sylabs/singularity/internal/pkg/util/mainthread"
 	"github.com/sylabs/singularity/internal/pkg/util/user"
 	"github.com/sylabs/singularity/pkg/util/crypt"
@@ -27,10 +28,36 @@ var diskGID = -1
 // Methods is a receiver type.
 type Methods int
 
+// doMount performs a mount with the specified arguments, detached bind
+// mounts return ENOSYS when the kernel doesn't support them.
+func doMount(arguments *args.MountArgs) error {
+	if arguments.Detached {
+		return mount.BindDetached(arguments.Source, arguments.Target, arguments.Mountflags)
+	}
+	return syscall.Mount(arguments.Source, arguments.Target, arguments.Filesystem, arguments.Mountflags, arguments.Data)
+}
+
 // Mount performs a mount with the specified arguments.
 func (t *Methods) Mount(arguments *args.MountArgs, mountErr *error) (err error) {
 	mainthread.Execute(func() {
-		*mountErr = syscall.Mount(arguments.Source, arguments.Target, arguments.Filesystem, arguments.Mountflags, arguments.Data)
+		*mountErr = doMount(arguments)
+	})
+	return nil
+}
+
+// MountBatch performs the mount operations with the specified arguments in
+// order, within a single main thread execution. It stops at the first
+// failing operation, the reply contains the result of each operation
+// executed.
+func (t *Methods) MountBatch(arguments *args.MountBatchArgs, reply *args.MountBatchReply) (err error) {
+	mainthread.Execute(func() {
+		for i := range arguments.Ops {
+			err := doMount(&arguments.Ops[i])
+			reply.Errs = append(reply.Errs, err)
+			if err != nil {
+				break
+			}
+		}
 	})
 	return nil
 }
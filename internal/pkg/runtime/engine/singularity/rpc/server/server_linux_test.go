@@ -0,0 +1,104 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package server
+
+import (
+	"io/ioutil"
+	"net"
+	"net/rpc"
+	"os"
+	"syscall"
+	"testing"
+
+	args "github.com/sylabs/singularity/internal/pkg/runtime/engine/singularity/rpc"
+	"github.com/sylabs/singularity/internal/pkg/runtime/engine/singularity/rpc/client"
+	"github.com/sylabs/singularity/internal/pkg/util/mainthread"
+)
+
+// planSize is the number of mount operations of the benchmarked mount
+// plan, close to the number of mount points of a container launch.
+const planSize = 32
+
+// BenchmarkMountPlan compares the execution of a mount plan with one RPC
+// call per mount operation, as done before the mount batch RPC, and with
+// a single batched RPC call. The mount plan remounts a temporary
+// filesystem read-only and read-write alternately.
+func BenchmarkMountPlan(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("root privileges required")
+	}
+
+	dir, err := ioutil.TempDir("", "mount-plan-")
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	if err := syscall.Mount("tmpfs", dir, "tmpfs", 0, ""); err != nil {
+		b.Skipf("could not mount tmpfs: %s", err)
+	}
+	defer syscall.Unmount(dir, syscall.MNT_DETACH)
+
+	// functions are executed in the main thread by the
+	// engine, serve them from a goroutine
+	go func() {
+		for f := range mainthread.FuncChannel {
+			f()
+		}
+	}()
+
+	server := rpc.NewServer()
+	if err := server.RegisterName("singularity", new(Methods)); err != nil {
+		b.Fatal(err)
+	}
+	serverConn, clientConn := net.Pipe()
+	go server.ServeConn(serverConn)
+
+	rpcOps := &client.RPC{
+		Client: rpc.NewClient(clientConn),
+		Name:   "singularity",
+	}
+	defer rpcOps.Client.Close()
+
+	ops := make([]args.MountArgs, planSize)
+	for i := range ops {
+		flags := uintptr(syscall.MS_BIND | syscall.MS_REMOUNT)
+		if i%2 == 0 {
+			flags |= syscall.MS_RDONLY
+		}
+		ops[i] = args.MountArgs{
+			Target:     dir,
+			Mountflags: flags,
+		}
+	}
+
+	b.Run("per-op", func(b *testing.B) {
+		for i := 0; i < b.N; i++ {
+			for _, op := range ops {
+				if err := rpcOps.Mount(op.Source, op.Target, op.Filesystem, op.Mountflags, op.Data); err != nil {
+					b.Fatal(err)
+				}
+			}
+		}
+	})
+
+	b.Run("batch", func(b *testing.B) {
+		for i := 0; i < b.N; i++ {
+			errs, err := rpcOps.MountBatch(ops)
+			if err != nil {
+				b.Fatal(err)
+			}
+			if len(errs) != len(ops) {
+				b.Fatalf("%d mount operations executed instead of %d", len(errs), len(ops))
+			}
+			for _, err := range errs {
+				if err != nil {
+					b.Fatal(err)
+				}
+			}
+		}
+	})
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package singularity
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"syscall"
+
+	"github.com/sylabs/singularity/internal/pkg/instance"
+	"github.com/sylabs/singularity/internal/pkg/runtime/engine/config/starter"
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+	"github.com/sylabs/singularity/internal/pkg/zygote"
+)
+
+// prepareZygote creates the zygote socket in the instance directory and
+// passes it to starter, the container process will then serve launch
+// requests received on this socket once the instance process is started.
+func (e *EngineOperations) prepareZygote(starterConfig *starter.Config) error {
+	name := e.CommonConfig.ContainerID
+
+	// the socket of a running instance must not be replaced
+	if _, err := instance.Get(name, instance.SingSubDir); err == nil {
+		return fmt.Errorf("instance %s already exists", name)
+	}
+
+	path, err := zygote.SocketPath(name)
+	if err != nil {
+		return fmt.Errorf("while getting zygote socket path: %s", err)
+	}
+
+	oldumask := syscall.Umask(0077)
+	defer syscall.Umask(oldumask)
+
+	if err := os.MkdirAll(filepath.Dir(path), 0700); err != nil {
+		return fmt.Errorf("while creating instance directory: %s", err)
+	}
+	// remove socket left by an instance which didn't exit properly
+	if err := os.Remove(path); err != nil && !os.IsNotExist(err) {
+		return fmt.Errorf("while removing stale zygote socket: %s", err)
+	}
+
+	fd, err := zygote.Listen(path)
+	if err != nil {
+		return err
+	}
+	if err := starterConfig.KeepFileDescriptor(fd); err != nil {
+		return err
+	}
+	starterConfig.SetZygoteFd(fd)
+
+	sylog.Debugf("Zygote socket created at %s", path)
+
+	return nil
+}
+
+// ZygoteRequest is called in stage 2 processes forked by the container
+// process of an instance running in zygote mode. The instance engine
+// configuration is inherited, only the container process arguments,
+// environment and working directory are taken from the request, the
+// security configuration remains the instance one.
+func (e *EngineOperations) ZygoteRequest(r *zygote.Request) error {
+	if len(r.Args) == 0 {
+		return fmt.Errorf("container process arguments not found")
+	}
+
+	e.EngineConfig.OciConfig.Process.Args = r.Args
+	e.EngineConfig.OciConfig.Process.Env = r.Env
+	if r.Cwd != "" {
+		e.EngineConfig.OciConfig.Process.Cwd = r.Cwd
+	}
+
+	// restore HOME environment variable to match the
+	// one set during instance start
+	e.EngineConfig.OciConfig.AddProcessEnv("HOME", e.EngineConfig.GetHomeDest())
+
+	// execute container process directly like a process
+	// joining the instance
+	e.EngineConfig.SetInstanceJoin(true)
+
+	// FUSE drivers are already running for the instance
+	e.EngineConfig.Plugin = nil
+
+	return nil
+}
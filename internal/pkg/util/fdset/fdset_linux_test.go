@@ -0,0 +1,112 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+// Package fdset tests and benchmarks the starter file descriptor keep-set
+// implementation (see cmd/starter/c/fdset.c). As closing file descriptors
+// would break the Go runtime, cleanups are run by a helper program built
+// from testdata/cleanup.c.
+package fdset
+
+import (
+	"errors"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+)
+
+// helper exit statuses, see testdata/cleanup.c
+const (
+	childErrRlimit = 1
+	childErrOpen   = 2
+	childErrLeak   = 3
+)
+
+// errLimit is returned when the file descriptor limit is too low.
+var errLimit = errors.New("open file descriptors limit too low")
+
+// buildHelper builds the cleanup helper program in a temporary directory
+// and returns its path along with a function removing it.
+func buildHelper(tb testing.TB) (string, func()) {
+	cc, err := exec.LookPath("cc")
+	if err != nil {
+		tb.Skipf("C compiler not found: %s", err)
+	}
+
+	dir, err := ioutil.TempDir("", "fdset-")
+	if err != nil {
+		tb.Fatal(err)
+	}
+	helper := filepath.Join(dir, "cleanup")
+
+	starter := filepath.Join("..", "..", "..", "..", "cmd", "starter", "c")
+	cmd := exec.Command(cc, "-O2",
+		"-I", starter, "-I", filepath.Join(starter, "include"),
+		"-o", helper, filepath.Join("testdata", "cleanup.c"),
+	)
+	if out, err := cmd.CombinedOutput(); err != nil {
+		os.RemoveAll(dir)
+		tb.Fatalf("failed to build cleanup helper: %s\n%s", err, out)
+	}
+	return helper, func() { os.RemoveAll(dir) }
+}
+
+// cleanup runs starter file descriptor cleanup iterations times with
+// inherited file descriptors opened and returns the total time spent in
+// the cleanup.
+func cleanup(helper string, inherited, iterations int) (time.Duration, error) {
+	out, err := exec.Command(helper, strconv.Itoa(inherited), strconv.Itoa(iterations)).Output()
+	if ee, ok := err.(*exec.ExitError); ok {
+		switch ee.ExitCode() {
+		case childErrRlimit:
+			return 0, errLimit
+		case childErrOpen:
+			return 0, fmt.Errorf("failed to open file descriptors")
+		case childErrLeak:
+			return 0, fmt.Errorf("wrong set of file descriptors closed")
+		}
+	}
+	if err != nil {
+		return 0, err
+	}
+	elapsed, err := strconv.ParseInt(strings.TrimSpace(string(out)), 10, 64)
+	if err != nil {
+		return 0, fmt.Errorf("bad cleanup helper output %q: %s", out, err)
+	}
+	return time.Duration(elapsed), nil
+}
+
+func TestCleanup(t *testing.T) {
+	helper, remove := buildHelper(t)
+	defer remove()
+
+	for _, inherited := range []int{0, 10, 100} {
+		if _, err := cleanup(helper, inherited, 2); err != nil {
+			t.Errorf("unexpected error with %d inherited file descriptors: %s", inherited, err)
+		}
+	}
+}
+
+func BenchmarkCleanup(b *testing.B) {
+	helper, remove := buildHelper(b)
+	defer remove()
+
+	for _, inherited := range []int{10, 1024, 65536} {
+		b.Run(fmt.Sprintf("%d-fds", inherited), func(b *testing.B) {
+			elapsed, err := cleanup(helper, inherited, b.N)
+			if err == errLimit {
+				b.Skipf("can't open %d file descriptors: %s", inherited, err)
+			} else if err != nil {
+				b.Fatalf("unexpected error: %s", err)
+			}
+			b.ReportMetric(float64(elapsed.Nanoseconds())/float64(b.N), "ns/cleanup")
+		})
+	}
+}
@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2019, Sylabs, Inc. All rights reserved.
+
+  This software is licensed under a 3-clause BSD license.  Please
+  consult LICENSE.md file distributed with the sources of this project regarding
+  your rights to use or distribute this software.
+*/
+
+/*
+ * cleanup mimics starter file descriptor cleanup after stage 1 with
+ * inherited file descriptors opened, including an O_PATH one. It's
+ * called with the number of inherited file descriptors and the number
+ * of cleanup iterations, prints the total elapsed time of cleanups in
+ * nanoseconds and exits with a CHILD_* status.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "message.c"
+#include "fdset.c"
+
+enum {
+    CHILD_OK,
+    CHILD_ERR_RLIMIT,
+    CHILD_ERR_OPEN,
+    CHILD_ERR_LEAK,
+    CHILD_ERR_USAGE,
+};
+
+/*
+ * stage1Fds is the number of file descriptors opened between the snapshot
+ * and the cleanup, keepFds of them are kept like with KeepFileDescriptor
+ */
+#define stage1Fds   8
+#define keepFds     2
+
+static unsigned long long now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    struct rlimit rlim;
+    unsigned long long elapsed = 0;
+    int i, j, nullfd, pathfd, inherited, iterations;
+
+    if ( argc != 3 ) {
+        return CHILD_ERR_USAGE;
+    }
+    inherited = atoi(argv[1]);
+    iterations = atoi(argv[2]);
+
+    messagelevel = 1;
+
+    if ( getrlimit(RLIMIT_NOFILE, &rlim) < 0 ) {
+        return CHILD_ERR_RLIMIT;
+    }
+    rlim.rlim_cur = rlim.rlim_max;
+    if ( rlim.rlim_cur < (rlim_t)inherited + stage1Fds + 16 || setrlimit(RLIMIT_NOFILE, &rlim) < 0 ) {
+        return CHILD_ERR_RLIMIT;
+    }
+
+    nullfd = open("/dev/null", O_RDONLY);
+    if ( nullfd < 0 ) {
+        return CHILD_ERR_OPEN;
+    }
+    for ( i = 0; i < inherited; i++ ) {
+        if ( dup(nullfd) < 0 ) {
+            return CHILD_ERR_OPEN;
+        }
+    }
+    /* poll reports O_PATH file descriptors with POLLNVAL */
+    pathfd = open("/", O_PATH);
+    if ( pathfd < 0 ) {
+        return CHILD_ERR_OPEN;
+    }
+
+    for ( i = 0; i < iterations; i++ ) {
+        int fds[stage1Fds];
+        fdset_t *master;
+        unsigned long long start = now();
+
+        master = fdset_open();
+        for ( j = 0; j < stage1Fds; j++ ) {
+            if ( ( fds[j] = dup(nullfd) ) < 0 ) {
+                return CHILD_ERR_OPEN;
+            }
+        }
+        for ( j = 0; j < keepFds; j++ ) {
+            fdset_add(master, fds[j]);
+        }
+        fdset_close_others(master);
+        fdset_free(master);
+
+        elapsed += now() - start;
+
+        for ( j = keepFds; j < stage1Fds; j++ ) {
+            if ( fcntl(fds[j], F_GETFD) >= 0 ) {
+                return CHILD_ERR_LEAK;
+            }
+        }
+        if ( fcntl(pathfd, F_GETFD) < 0 || fcntl(STDOUT_FILENO, F_GETFD) < 0 ) {
+            return CHILD_ERR_LEAK;
+        }
+        for ( j = 0; j < keepFds; j++ ) {
+            if ( fcntl(fds[j], F_GETFD) < 0 ) {
+                return CHILD_ERR_LEAK;
+            }
+            close(fds[j]);
+        }
+    }
+
+    printf("%llu\n", elapsed);
+    return CHILD_OK;
+}
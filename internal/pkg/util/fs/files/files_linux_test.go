@@ -7,11 +7,14 @@ package files
 
 import (
 	"bytes"
+	"fmt"
 	"io/ioutil"
 	"os"
 	"testing"
+	"time"
 
 	"github.com/sylabs/singularity/internal/pkg/test"
+	"github.com/sylabs/singularity/internal/pkg/util/user"
 )
 
 func TestGroup(t *testing.T) {
@@ -21,11 +24,11 @@ func TestGroup(t *testing.T) {
 	var gids []int
 	uid := os.Getuid()
 
-	_, err := Group("/fake", uid, gids)
+	_, err := Group("/fake", uid, gids, user.NSS)
 	if err == nil {
 		t.Errorf("should have failed with bad group file")
 	}
-	_, err = Group("/etc/group", uid, gids)
+	_, err = Group("/etc/group", uid, gids, user.NSS)
 	if err != nil {
 		t.Errorf("should have passed with correct group file")
 	}
@@ -38,7 +41,7 @@ func TestGroup(t *testing.T) {
 	defer os.Remove(emptyGroup)
 	f.Close()
 
-	_, err = Group(emptyGroup, uid, gids)
+	_, err = Group(emptyGroup, uid, gids, user.NSS)
 	if err != nil {
 		t.Error(err)
 	}
@@ -50,11 +53,11 @@ func TestPasswd(t *testing.T) {
 
 	uid := os.Getuid()
 
-	_, err := Passwd("/fake", "/fake", uid)
+	_, err := Passwd("/fake", "/fake", uid, user.NSS)
 	if err == nil {
 		t.Errorf("should have failed with bad passwd file")
 	}
-	_, err = Passwd("/etc/passwd", "/home", uid)
+	_, err = Passwd("/etc/passwd", "/home", uid, user.NSS)
 	if err != nil {
 		t.Errorf("should have passed with correct passwd file")
 	}
@@ -67,7 +70,7 @@ func TestPasswd(t *testing.T) {
 	defer os.Remove(emptyPasswd)
 	f.Close()
 
-	_, err = Passwd(emptyPasswd, "/home", uid)
+	_, err = Passwd(emptyPasswd, "/home", uid, user.NSS)
 	if err != nil {
 		t.Error(err)
 	}
@@ -114,3 +117,55 @@ func TestResolvConf(t *testing.T) {
 		t.Errorf("ResolvConf returns a bad content")
 	}
 }
+
+// slowLookup stands in for a name service switch querying a directory
+// server, each lookup takes delay.
+type slowLookup struct {
+	delay time.Duration
+}
+
+func (l slowLookup) GetPwUID(uid uint32) (*user.User, error) {
+	time.Sleep(l.delay)
+	return &user.User{Name: "user", UID: uid, GID: uid, Dir: "/home/user", Shell: "/bin/sh"}, nil
+}
+
+func (l slowLookup) GetGrGID(gid uint32) (*user.Group, error) {
+	time.Sleep(l.delay)
+	return &user.Group{Name: fmt.Sprintf("group%d", gid), GID: gid}, nil
+}
+
+// BenchmarkIdentity measures the generation of the passwd and group files
+// of a container launch with 8 groups, looking up entries with a 2ms name
+// service for each launch or through a stored identity snapshot.
+func BenchmarkIdentity(b *testing.B) {
+	dir, err := ioutil.TempDir("", "identity-")
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	gids := []int{1000, 1001, 1002, 1003, 1004, 1005, 1006, 1007}
+	nss := slowLookup{delay: 2 * time.Millisecond}
+
+	identity := func(b *testing.B, lookup user.Lookup) {
+		if _, err := Passwd("/etc/passwd", "", 1000, lookup); err != nil {
+			b.Fatal(err)
+		}
+		if _, err := Group("/etc/group", 1000, gids, lookup); err != nil {
+			b.Fatal(err)
+		}
+	}
+
+	b.Run("nss", func(b *testing.B) {
+		for i := 0; i < b.N; i++ {
+			identity(b, nss)
+		}
+	})
+	b.Run("snapshot", func(b *testing.B) {
+		for i := 0; i < b.N; i++ {
+			s := user.NewSnapshot(dir, 1000, time.Hour, nss)
+			identity(b, s)
+			s.Store()
+		}
+	})
+}
@@ -16,8 +16,9 @@ import (
 )
 
 // Group creates a group template based on content of file provided in path,
-// updates content with current user information and returns content
-func Group(path string, uid int, gids []int) (content []byte, err error) {
+// updates content with current user information looked up with lookup and
+// returns content
+func Group(path string, uid int, gids []int, lookup user.Lookup) (content []byte, err error) {
 	duplicate := false
 	var groups []int
 
@@ -33,12 +34,12 @@ func Group(path string, uid int, gids []int) (content []byte, err error) {
 	}
 	defer groupFile.Close()
 
-	pwInfo, err := user.GetPwUID(uint32(uid))
+	pwInfo, err := lookup.GetPwUID(uint32(uid))
 	if err != nil || pwInfo == nil {
 		return content, err
 	}
 	if len(gids) == 0 {
-		grInfo, err := user.GetGrGID(pwInfo.GID)
+		grInfo, err := lookup.GetGrGID(pwInfo.GID)
 		if err != nil || grInfo == nil {
 			return content, err
 		}
@@ -70,7 +71,7 @@ func Group(path string, uid int, gids []int) (content []byte, err error) {
 	}
 
 	for _, gid := range groups {
-		grInfo, err := user.GetGrGID(uint32(gid))
+		grInfo, err := lookup.GetGrGID(uint32(gid))
 		if err != nil || grInfo == nil {
 			sylog.Verbosef("Skipping GID %d as group entry doesn't exist.\n", gid)
 			continue
@@ -15,8 +15,9 @@ import (
 )
 
 // Passwd creates a passwd template based on content of file provided in path,
-// updates content with current user information and returns content.
-func Passwd(path string, home string, uid int) (content []byte, err error) {
+// updates content with current user information looked up with lookup and
+// returns content.
+func Passwd(path string, home string, uid int, lookup user.Lookup) (content []byte, err error) {
 	sylog.Verbosef("Checking for template passwd file: %s", path)
 	if !fs.IsFile(path) {
 		return content, fmt.Errorf("passwd file doesn't exist in container, not updating")
@@ -28,7 +29,7 @@ func Passwd(path string, home string, uid int) (content []byte, err error) {
 		return content, fmt.Errorf("failed to read passwd file content in container: %s", err)
 	}
 
-	pwInfo, err := user.GetPwUID(uint32(uid))
+	pwInfo, err := lookup.GetPwUID(uint32(uid))
 	if err != nil {
 		return content, err
 	}
@@ -0,0 +1,137 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package mount
+
+import (
+	"syscall"
+	"unsafe"
+
+	"golang.org/x/sys/unix"
+)
+
+// system call numbers of the new mount API, allocated in the range shared
+// by all architectures since Linux 5.1 which is offset by the ABI base on
+// MIPS (see sysBase)
+const (
+	sysOpenTree     = sysBase + 428
+	sysMoveMount    = sysBase + 429
+	sysMountSetattr = sysBase + 442
+)
+
+const (
+	openTreeClone       = 0x1
+	atEmptyPath         = 0x1000
+	atRecursive         = 0x8000
+	moveMountFEmptyPath = 0x4
+)
+
+// mount attributes set by mount_setattr
+const (
+	mountAttrRdonly      = 0x1
+	mountAttrNosuid      = 0x2
+	mountAttrNodev       = 0x4
+	mountAttrNoexec      = 0x8
+	mountAttrAtime       = 0x70
+	mountAttrNoatime     = 0x10
+	mountAttrStrictatime = 0x20
+	mountAttrNodiratime  = 0x80
+)
+
+// mountAttr is the mount_setattr structure mount_attr.
+type mountAttr struct {
+	attrSet     uint64
+	attrClr     uint64
+	propagation uint64
+	usernsFd    uint64
+}
+
+// mountAttributes returns the mount attributes corresponding to the
+// mount flags.
+func mountAttributes(flags uintptr) *mountAttr {
+	attr := &mountAttr{}
+
+	if flags&syscall.MS_RDONLY != 0 {
+		attr.attrSet |= mountAttrRdonly
+	}
+	if flags&syscall.MS_NOSUID != 0 {
+		attr.attrSet |= mountAttrNosuid
+	}
+	if flags&syscall.MS_NODEV != 0 {
+		attr.attrSet |= mountAttrNodev
+	}
+	if flags&syscall.MS_NOEXEC != 0 {
+		attr.attrSet |= mountAttrNoexec
+	}
+	if flags&syscall.MS_NODIRATIME != 0 {
+		attr.attrSet |= mountAttrNodiratime
+	}
+	if flags&syscall.MS_NOATIME != 0 {
+		attr.attrClr |= mountAttrAtime
+		attr.attrSet |= mountAttrNoatime
+	} else if flags&syscall.MS_STRICTATIME != 0 {
+		attr.attrClr |= mountAttrAtime
+		attr.attrSet |= mountAttrStrictatime
+	}
+
+	return attr
+}
+
+// BindDetached bind mounts source to target with the new mount API: the
+// source mount tree is cloned as a detached mount with open_tree, the
+// mount flags are applied to it with a single mount_setattr call and it's
+// attached to target with move_mount, no remount is required to apply the
+// flags. Like a remount, flags are applied to the top mount only, MS_REC
+// clones the whole source mount tree. It returns ENOSYS if the kernel
+// doesn't support the new mount API (open_tree and move_mount since Linux
+// 5.2, mount_setattr since Linux 5.12) or if its system calls are filtered,
+// callers then fall back to a bind mount followed by a remount.
+func BindDetached(source string, target string, flags uintptr) error {
+	src, err := syscall.BytePtrFromString(source)
+	if err != nil {
+		return err
+	}
+	dst, err := syscall.BytePtrFromString(target)
+	if err != nil {
+		return err
+	}
+	empty, _ := syscall.BytePtrFromString("")
+	// paths are resolved relative to the current working directory
+	atFdcwd := unix.AT_FDCWD
+
+	treeFlags := uintptr(openTreeClone | syscall.O_CLOEXEC)
+	if flags&syscall.MS_REC != 0 {
+		treeFlags |= atRecursive
+	}
+
+	fd, _, esys := syscall.Syscall(sysOpenTree, uintptr(atFdcwd), uintptr(unsafe.Pointer(src)), treeFlags)
+	if esys == syscall.ENOSYS || esys == syscall.EPERM {
+		// EPERM is returned by seccomp filters unaware of
+		// the new mount API, a legitimate permission error
+		// is reported by the fallback bind mount
+		return syscall.ENOSYS
+	} else if esys != 0 {
+		return esys
+	}
+	// the detached mount is released if not attached
+	defer syscall.Close(int(fd))
+
+	attr := mountAttributes(flags)
+	if attr.attrSet != 0 || attr.attrClr != 0 {
+		_, _, esys := syscall.Syscall6(sysMountSetattr, fd, uintptr(unsafe.Pointer(empty)), atEmptyPath, uintptr(unsafe.Pointer(attr)), unsafe.Sizeof(*attr), 0)
+		if esys == syscall.ENOSYS || esys == syscall.EPERM {
+			return syscall.ENOSYS
+		} else if esys != 0 {
+			return esys
+		}
+	}
+
+	_, _, esys = syscall.Syscall6(sysMoveMount, fd, uintptr(unsafe.Pointer(empty)), uintptr(atFdcwd), uintptr(unsafe.Pointer(dst)), moveMountFEmptyPath, 0)
+	if esys != 0 {
+		return esys
+	}
+
+	return nil
+}
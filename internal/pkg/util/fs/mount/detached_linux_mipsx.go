@@ -0,0 +1,11 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+// +build linux,mips linux,mipsle
+
+package mount
+
+// sysBase is the base of o32 ABI system call numbers.
+const sysBase = 4000
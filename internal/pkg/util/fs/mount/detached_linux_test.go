@@ -0,0 +1,64 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package mount
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"syscall"
+	"testing"
+
+	"github.com/sylabs/singularity/internal/pkg/test"
+)
+
+func TestBindDetached(t *testing.T) {
+	test.EnsurePrivilege(t)
+
+	source, err := ioutil.TempDir("", "bind-source-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(source)
+
+	target, err := ioutil.TempDir("", "bind-target-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(target)
+
+	if err := ioutil.WriteFile(filepath.Join(source, "file"), []byte("bind"), 0644); err != nil {
+		t.Fatal(err)
+	}
+
+	err = BindDetached(source, target, syscall.MS_BIND|syscall.MS_RDONLY|syscall.MS_NOSUID)
+	if err == syscall.ENOSYS {
+		t.Skip("new mount API not supported")
+	} else if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	defer syscall.Unmount(target, syscall.MNT_DETACH)
+
+	if _, err := os.Stat(filepath.Join(target, "file")); err != nil {
+		t.Errorf("bind mounted file not found: %s", err)
+	}
+
+	var st syscall.Statfs_t
+	if err := syscall.Statfs(target, &st); err != nil {
+		t.Fatal(err)
+	}
+	flags := st.Flags & (syscall.MS_RDONLY | syscall.MS_NOSUID)
+	if flags != syscall.MS_RDONLY|syscall.MS_NOSUID {
+		t.Errorf("mount flags not applied: %#x", st.Flags)
+	}
+	if err := ioutil.WriteFile(filepath.Join(target, "file"), []byte("rw"), 0644); err == nil {
+		t.Errorf("unexpected write on read-only bind mount")
+	}
+
+	if err := BindDetached("/nonexistent", target, syscall.MS_BIND); err != syscall.ENOENT {
+		t.Errorf("unexpected error for missing source: %v", err)
+	}
+}
@@ -20,8 +20,13 @@ type mountFn func(*Point, *System) error
 // System defines a mount system allowing to register before/after
 // hook functions for specific tag during mount phase
 type System struct {
-	Points         *Points
-	Mount          mountFn
+	Points *Points
+	Mount  mountFn
+	// Flush is called once the points of a tag are processed by
+	// Mount and before the after hook functions of the tag, it allows
+	// Mount to queue the operations of the mount plan and to execute
+	// them at once
+	Flush          hookFn
 	currentTag     AuthorizedTag
 	beforeTagHooks map[AuthorizedTag][]hookFn
 	afterTagHooks  map[AuthorizedTag][]hookFn
@@ -81,6 +86,11 @@ func (b *System) MountAll() error {
 				}
 			}
 		}
+		if b.Flush != nil {
+			if err := b.Flush(b); err != nil {
+				return fmt.Errorf("mount of tag %s error: %s", tag, err)
+			}
+		}
 		for _, fn := range b.afterTagHooks[tag] {
 			if err := fn(b); err != nil {
 				return fmt.Errorf("hook function for tag %s returns error: %s", tag, err)
@@ -21,13 +21,18 @@ func TestSystem(t *testing.T) {
 
 	points.AddBind(BindsTag, "/etc/hosts", "/etc/hosts", syscall.MS_BIND|syscall.MS_REC)
 
-	system := &System{
-		Points: points,
-	}
-
 	before := false
 	after := false
 	mnt := false
+	flushed := false
+
+	system := &System{
+		Points: points,
+		Flush: func(system *System) error {
+			flushed = true
+			return nil
+		},
+	}
 
 	mountFn := func(point *Point, system *System) error {
 		mnt = true
@@ -43,6 +48,9 @@ func TestSystem(t *testing.T) {
 	}
 	afterHook := func(system *System) error {
 		after = true
+		if !flushed {
+			return fmt.Errorf("flush function wasn't executed before afterHook")
+		}
 		if system.Mount == nil {
 			system.Mount = mountFn
 		}
@@ -0,0 +1,61 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package squashfs
+
+import (
+	"fmt"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strings"
+	"syscall"
+
+	"github.com/sylabs/singularity/pkg/runtime/engine/config"
+)
+
+// GetFusePath figures out where the squashfuse binary is
+// and return an error is not available or not usable.
+func GetFusePath(c *config.FileConfig) (string, error) {
+	p := c.SquashfusePath
+
+	// If the path contains the binary name use it as is, otherwise add squashfuse via filepath.Join
+	if !strings.HasSuffix(c.SquashfusePath, "squashfuse") {
+		p = filepath.Join(c.SquashfusePath, "squashfuse")
+	}
+
+	// exec.LookPath functions on absolute paths (ignoring $PATH) as well
+	return exec.LookPath(p)
+}
+
+// FuseMountOptions returns the FUSE mount options to mount a
+// squashfs filesystem served through the /dev/fuse file descriptor
+// fuseFd, the filesystem is accessible to all users with the kernel
+// checking file permissions.
+func FuseMountOptions(fuseFd int, uid int, gid int) string {
+	return fmt.Sprintf(
+		"fd=%d,rootmode=%o,user_id=%d,group_id=%d,allow_other,default_permissions",
+		fuseFd, syscall.S_IFDIR, uid, gid,
+	)
+}
+
+// FuseServe runs the squashfuse program to serve the squashfs filesystem
+// located at offset in image through fuse, the /dev/fuse file descriptor
+// which must be already mounted. It returns once the driver is ready to
+// serve requests, the driver runs in background until the filesystem is
+// unmounted.
+func FuseServe(program string, fuse *os.File, image *os.File, offset uint64) error {
+	// fuse and image are passed as file descriptors 3 and 4,
+	// squashfuse recognizes /dev/fd/N as an already mounted
+	// FUSE connection (libfuse 3.3+)
+	cmd := exec.Command(program, "-o", fmt.Sprintf("offset=%d", offset), "/dev/fd/4", "/dev/fd/3")
+	cmd.ExtraFiles = []*os.File{fuse, image}
+
+	// the driver daemonizes once initialized
+	if out, err := cmd.CombinedOutput(); err != nil {
+		return fmt.Errorf("%s failed: %s: %s", program, err, strings.TrimSpace(string(out)))
+	}
+	return nil
+}
@@ -0,0 +1,195 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package squashfs
+
+import (
+	"crypto/rand"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"syscall"
+	"testing"
+
+	"github.com/sylabs/singularity/pkg/util/loop"
+)
+
+// createImage creates a squashfs image with files of various sizes.
+func createImage(b *testing.B, mksquashfs string) string {
+	dir, err := ioutil.TempDir("", "squashfs-bench-")
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	for i := 0; i < 256; i++ {
+		data := make([]byte, 1024*(i%64+1))
+		rand.Read(data)
+		path := filepath.Join(dir, fmt.Sprintf("dir%d", i%16), fmt.Sprintf("file%d", i))
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			b.Fatal(err)
+		}
+		if err := ioutil.WriteFile(path, data, 0644); err != nil {
+			b.Fatal(err)
+		}
+	}
+
+	image := dir + ".sqfs"
+	if out, err := exec.Command(mksquashfs, dir, image, "-noappend").CombinedOutput(); err != nil {
+		b.Fatalf("mksquashfs failed: %s: %s", err, out)
+	}
+	return image
+}
+
+// readAll reads all files of the mounted image like a container
+// startup would do with libraries and configuration files.
+func readAll(dir string) error {
+	return filepath.Walk(dir, func(path string, info os.FileInfo, err error) error {
+		if err != nil || !info.Mode().IsRegular() {
+			return err
+		}
+		f, err := os.Open(path)
+		if err != nil {
+			return err
+		}
+		defer f.Close()
+		_, err = io.Copy(ioutil.Discard, f)
+		return err
+	})
+}
+
+func dropCaches(b *testing.B) {
+	syscall.Sync()
+	if err := ioutil.WriteFile("/proc/sys/vm/drop_caches", []byte("3"), 0); err != nil {
+		b.Skipf("can't drop page cache: %s", err)
+	}
+}
+
+func mountLoop(image *os.File, dir string) (func(), error) {
+	var number int
+
+	loopDev := &loop.Device{
+		MaxLoopDevices: 256,
+		Info: &loop.Info64{
+			Flags: loop.FlagsAutoClear | loop.FlagsReadOnly,
+		},
+	}
+	if err := loopDev.AttachFromFile(image, os.O_RDONLY, &number); err != nil {
+		return nil, err
+	}
+	path := fmt.Sprintf("/dev/loop%d", number)
+
+	// AttachFromFile keeps the loop device file descriptor open
+	// until the mount, close it to let autoclear release the loop
+	// device once unmounted
+	closeLoopFd := func() {
+		fds, _ := ioutil.ReadDir("/proc/self/fd")
+		for _, fd := range fds {
+			if link, _ := os.Readlink(filepath.Join("/proc/self/fd", fd.Name())); link == path {
+				var n int
+				fmt.Sscanf(fd.Name(), "%d", &n)
+				syscall.Close(n)
+			}
+		}
+	}
+
+	err := syscall.Mount(path, dir, "squashfs", syscall.MS_RDONLY|syscall.MS_NOSUID|syscall.MS_NODEV, "")
+	closeLoopFd()
+	if err != nil {
+		return nil, err
+	}
+	return func() { syscall.Unmount(dir, 0) }, nil
+}
+
+func mountFuse(program string) func(*os.File, string) (func(), error) {
+	return func(image *os.File, dir string) (func(), error) {
+		fuse, err := os.OpenFile("/dev/fuse", os.O_RDWR, 0)
+		if err != nil {
+			return nil, err
+		}
+		defer fuse.Close()
+
+		opts := FuseMountOptions(int(fuse.Fd()), os.Getuid(), os.Getgid())
+		if err := syscall.Mount(image.Name(), dir, "fuse", syscall.MS_RDONLY|syscall.MS_NOSUID|syscall.MS_NODEV, opts); err != nil {
+			return nil, err
+		}
+		if err := FuseServe(program, fuse, image, 0); err != nil {
+			syscall.Unmount(dir, syscall.MNT_DETACH)
+			return nil, err
+		}
+		return func() { syscall.Unmount(dir, 0) }, nil
+	}
+}
+
+// BenchmarkMount compares image mounts with a loop device and with
+// squashfuse, with a cold page cache and a warm one.
+func BenchmarkMount(b *testing.B) {
+	if os.Geteuid() != 0 {
+		b.Skip("root privileges required")
+	}
+	mksquashfs, err := exec.LookPath("mksquashfs")
+	if err != nil {
+		b.Skip("mksquashfs not found")
+	}
+	squashfuse, err := exec.LookPath("squashfuse")
+	if err != nil {
+		b.Skip("squashfuse not found")
+	}
+
+	path := createImage(b, mksquashfs)
+	defer os.Remove(path)
+
+	image, err := os.Open(path)
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer image.Close()
+
+	dir, err := ioutil.TempDir("", "squashfs-mnt-")
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer os.Remove(dir)
+
+	backends := []struct {
+		name  string
+		mount func(*os.File, string) (func(), error)
+	}{
+		{"loop", mountLoop},
+		{"fuse", mountFuse(squashfuse)},
+	}
+
+	for _, backend := range backends {
+		for _, cold := range []bool{true, false} {
+			name := backend.name + "/warm"
+			if cold {
+				name = backend.name + "/cold"
+			}
+			mount := backend.mount
+
+			b.Run(name, func(b *testing.B) {
+				for i := 0; i < b.N; i++ {
+					if cold {
+						b.StopTimer()
+						dropCaches(b)
+						b.StartTimer()
+					}
+					umount, err := mount(image, dir)
+					if err != nil {
+						b.Fatal(err)
+					}
+					err = readAll(dir)
+					umount()
+					if err != nil {
+						b.Fatal(err)
+					}
+				}
+			})
+		}
+	}
+}
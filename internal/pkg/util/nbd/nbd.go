@@ -0,0 +1,154 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+// Package nbd implements a read-only network block device server serving
+// an io.ReaderAt, attached to the kernel NBD driver to get a block device
+// whose reads are served by the process.
+package nbd
+
+import (
+	"encoding/binary"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"sync"
+	"syscall"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+)
+
+const (
+	requestMagic = 0x25609513
+	replyMagic   = 0x67446698
+
+	cmdRead  = 0
+	cmdWrite = 1
+	cmdDisc  = 2
+	cmdFlush = 3
+
+	requestSize = 28
+	replySize   = 16
+
+	// maxRequests is the number of read requests served at the
+	// same time, reads of a lazily fetched image may wait for the
+	// network.
+	maxRequests = 8
+	// maxLength is the maximum length of a request, the kernel
+	// splits reads in requests of at most 128 KiB by default.
+	maxLength = 32 << 20
+)
+
+// request is the header of a request in the NBD transmission phase.
+type request struct {
+	Magic  uint32
+	Flags  uint16
+	Type   uint16
+	Handle [8]byte
+	Offset uint64
+	Length uint32
+}
+
+// reply is the header of a reply, followed by the data for reads.
+type reply struct {
+	Magic  uint32
+	Error  uint32
+	Handle [8]byte
+}
+
+type server struct {
+	conn io.ReadWriter
+	r    io.ReaderAt
+	size int64
+
+	mu sync.Mutex
+}
+
+// Serve serves the requests of the NBD transmission phase read from conn
+// with the size bytes of r, until the client disconnects. Write requests
+// are refused, reads are served concurrently.
+func Serve(conn io.ReadWriter, r io.ReaderAt, size int64) error {
+	s := &server{conn: conn, r: r, size: size}
+
+	var wg sync.WaitGroup
+	defer wg.Wait()
+
+	sem := make(chan struct{}, maxRequests)
+
+	for {
+		var req request
+		if err := binary.Read(conn, binary.BigEndian, &req); err != nil {
+			if err == io.EOF {
+				return nil
+			}
+			return fmt.Errorf("while reading request: %s", err)
+		}
+		if req.Magic != requestMagic {
+			return fmt.Errorf("bad request magic 0x%x", req.Magic)
+		}
+
+		switch req.Type {
+		case cmdRead:
+			if req.Length > maxLength {
+				return fmt.Errorf("request length %d too large", req.Length)
+			}
+			sem <- struct{}{}
+			wg.Add(1)
+			go func(req request) {
+				defer func() { <-sem; wg.Done() }()
+				s.read(req)
+			}(req)
+		case cmdWrite:
+			// the payload is discarded
+			if _, err := io.CopyN(ioutil.Discard, conn, int64(req.Length)); err != nil {
+				return fmt.Errorf("while reading request: %s", err)
+			}
+			s.reply(req, syscall.EPERM, nil)
+		case cmdFlush:
+			s.reply(req, 0, nil)
+		case cmdDisc:
+			return nil
+		default:
+			s.reply(req, syscall.EINVAL, nil)
+		}
+	}
+}
+
+// read replies to the read request req, the bytes beyond the size of the
+// device are zeroes.
+func (s *server) read(req request) {
+	b := make([]byte, req.Length)
+
+	off := int64(req.Offset)
+	n := int64(req.Length)
+	if off+n > s.size {
+		n = s.size - off
+	}
+	if n > 0 {
+		if _, err := s.r.ReadAt(b[:n], off); err != nil && err != io.EOF {
+			sylog.Debugf("Could not read %d bytes at offset %d: %s", n, off, err)
+			s.reply(req, syscall.EIO, nil)
+			return
+		}
+	}
+	s.reply(req, 0, b)
+}
+
+// reply sends the reply to req, with data for successful reads.
+func (s *server) reply(req request, errno syscall.Errno, data []byte) {
+	b := make([]byte, replySize, replySize+len(data))
+	binary.BigEndian.PutUint32(b[0:], replyMagic)
+	binary.BigEndian.PutUint32(b[4:], uint32(errno))
+	copy(b[8:], req.Handle[:])
+	if errno == 0 {
+		b = append(b, data...)
+	}
+
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	if _, err := s.conn.Write(b); err != nil {
+		sylog.Debugf("Could not send reply: %s", err)
+	}
+}
@@ -0,0 +1,201 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package nbd
+
+import (
+	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
+	"strings"
+	"syscall"
+	"time"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+	"github.com/sylabs/singularity/internal/pkg/util/priv"
+)
+
+// NBD ioctl commands (linux/nbd.h).
+const (
+	CmdSetSock       = 0xAB00
+	CmdSetBlockSize  = 0xAB01
+	CmdDoIt          = 0xAB03
+	CmdClearSock     = 0xAB04
+	CmdClearQueue    = 0xAB05
+	CmdSetSizeBlocks = 0xAB07
+	CmdDisconnect    = 0xAB08
+	CmdSetFlags      = 0xAB0A
+)
+
+// NBD device flags.
+const (
+	FlagHasFlags = 1 << 0
+	FlagReadOnly = 1 << 1
+)
+
+const (
+	blockSize = 4096
+	// maxDevices is the number of NBD devices looked up for a free
+	// one, the nbd module creates 16 devices by default.
+	maxDevices = 256
+)
+
+// Device is an NBD device served by the process.
+type Device struct {
+	// Path is the path of the block device, e.g. /dev/nbd0.
+	Path string
+
+	dev  *os.File
+	sock *os.File
+	done chan error
+}
+
+// Attach attaches a free NBD device serving the size bytes of r in
+// read-only mode. The device is served until Detach is called or until
+// the process exits. The nbd kernel module must be loaded and the process
+// must have the CAP_SYS_ADMIN capability, privileges are escalated for
+// the device setup in setuid workflow while r is read with the process
+// privileges.
+func Attach(r io.ReaderAt, size int64) (*Device, error) {
+	d, err := attach(size)
+	if err != nil {
+		return nil, err
+	}
+
+	go func() {
+		if err := Serve(d.sock, r, size); err != nil {
+			sylog.Debugf("NBD device %s server stopped: %s", d.Path, err)
+		}
+	}()
+	go func() {
+		// the ioctl returns once the device is disconnected, the
+		// thread keeps the privileges until then
+		priv.Escalate()
+		defer priv.Drop()
+		d.done <- ioctl(d.dev, CmdDoIt, 0)
+	}()
+
+	if err := d.waitReady(); err != nil {
+		d.Detach()
+		return nil, err
+	}
+
+	sylog.Debugf("Attached NBD device %s (%d bytes)", d.Path, size)
+
+	return d, nil
+}
+
+// attach finds a free NBD device and configures it with a socket to
+// serve size bytes.
+func attach(size int64) (*Device, error) {
+	priv.Escalate()
+	defer priv.Drop()
+
+	fds, err := syscall.Socketpair(syscall.AF_UNIX, syscall.SOCK_STREAM|syscall.SOCK_CLOEXEC, 0)
+	if err != nil {
+		return nil, fmt.Errorf("could not create socket pair: %s", err)
+	}
+	client := os.NewFile(uintptr(fds[0]), "nbd-client")
+	sock := os.NewFile(uintptr(fds[1]), "nbd-server")
+
+	d := &Device{sock: sock, done: make(chan error, 1)}
+
+	// a concurrent process may take the same free device first, in
+	// which case setting the socket fails with EBUSY
+	for i := 0; i < maxDevices && d.dev == nil; i++ {
+		path := fmt.Sprintf("/dev/nbd%d", i)
+		dev, err := os.OpenFile(path, os.O_RDWR|syscall.O_CLOEXEC, 0)
+		if os.IsNotExist(err) {
+			break
+		} else if err != nil {
+			client.Close()
+			sock.Close()
+			return nil, fmt.Errorf("could not open %s: %s", path, err)
+		}
+		if err := ioctl(dev, CmdSetSock, client.Fd()); err == syscall.EBUSY {
+			dev.Close()
+			continue
+		} else if err != nil {
+			dev.Close()
+			client.Close()
+			sock.Close()
+			return nil, fmt.Errorf("could not set %s socket: %s", path, err)
+		}
+		d.Path = path
+		d.dev = dev
+	}
+	// the kernel holds a reference to the client socket
+	client.Close()
+	if d.dev == nil {
+		sock.Close()
+		return nil, fmt.Errorf("no free NBD device found, is the nbd module loaded?")
+	}
+
+	blocks := (size + blockSize - 1) / blockSize
+	for _, c := range []struct {
+		cmd uintptr
+		arg uintptr
+	}{
+		{CmdSetBlockSize, blockSize},
+		{CmdSetSizeBlocks, uintptr(blocks)},
+		{CmdSetFlags, FlagHasFlags | FlagReadOnly},
+	} {
+		if err := ioctl(d.dev, c.cmd, c.arg); err != nil {
+			d.release()
+			return nil, fmt.Errorf("could not configure %s: %s", d.Path, err)
+		}
+	}
+
+	return d, nil
+}
+
+// waitReady waits for the device to be ready once connected, the kernel
+// reports the PID of the process serving it.
+func (d *Device) waitReady() error {
+	pid := fmt.Sprintf("/sys/block/%s/pid", strings.TrimPrefix(d.Path, "/dev/"))
+	for i := 0; i < 100; i++ {
+		select {
+		case err := <-d.done:
+			d.done <- err
+			return fmt.Errorf("%s disconnected: %v", d.Path, err)
+		default:
+		}
+		if b, err := ioutil.ReadFile(pid); err == nil && len(b) > 0 {
+			return nil
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+	return fmt.Errorf("timeout while waiting for %s", d.Path)
+}
+
+// Detach disconnects the device, the filesystems mounted from the device
+// must be unmounted.
+func (d *Device) Detach() error {
+	priv.Escalate()
+	defer priv.Drop()
+
+	err := ioctl(d.dev, CmdDisconnect, 0)
+	if err == nil {
+		<-d.done
+	}
+	d.release()
+	return err
+}
+
+// release clears the device socket and closes the files.
+func (d *Device) release() {
+	ioctl(d.dev, CmdClearQueue, 0)
+	ioctl(d.dev, CmdClearSock, 0)
+	d.dev.Close()
+	d.sock.Close()
+}
+
+func ioctl(f *os.File, cmd, arg uintptr) error {
+	if _, _, err := syscall.Syscall(syscall.SYS_IOCTL, f.Fd(), cmd, arg); err != 0 {
+		return err
+	}
+	return nil
+}
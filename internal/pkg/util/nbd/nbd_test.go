@@ -0,0 +1,90 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package nbd
+
+import (
+	"bytes"
+	"encoding/binary"
+	"io"
+	"net"
+	"syscall"
+	"testing"
+)
+
+func sendRequest(t *testing.T, conn net.Conn, typ uint16, handle byte, off uint64, length uint32, payload []byte) {
+	req := request{
+		Magic:  requestMagic,
+		Type:   typ,
+		Handle: [8]byte{handle},
+		Offset: off,
+		Length: length,
+	}
+	if err := binary.Write(conn, binary.BigEndian, &req); err != nil {
+		t.Fatalf("failed to send request: %s", err)
+	}
+	if payload != nil {
+		if _, err := conn.Write(payload); err != nil {
+			t.Fatalf("failed to send request payload: %s", err)
+		}
+	}
+}
+
+func readReply(t *testing.T, conn net.Conn) reply {
+	var rep reply
+	if err := binary.Read(conn, binary.BigEndian, &rep); err != nil {
+		t.Fatalf("failed to read reply: %s", err)
+	}
+	if rep.Magic != replyMagic {
+		t.Fatalf("bad reply magic 0x%x", rep.Magic)
+	}
+	return rep
+}
+
+func TestServe(t *testing.T) {
+	data := make([]byte, 10000)
+	for i := range data {
+		data[i] = byte(i)
+	}
+
+	client, server := net.Pipe()
+	defer client.Close()
+
+	done := make(chan error, 1)
+	go func() {
+		done <- Serve(server, bytes.NewReader(data), int64(len(data)))
+		server.Close()
+	}()
+
+	// reads beyond the device size are zeroes
+	sendRequest(t, client, cmdRead, 1, 9000, 2000, nil)
+	rep := readReply(t, client)
+	if rep.Error != 0 || rep.Handle[0] != 1 {
+		t.Fatalf("unexpected reply %+v", rep)
+	}
+	b := make([]byte, 2000)
+	if _, err := io.ReadFull(client, b); err != nil {
+		t.Fatalf("failed to read reply data: %s", err)
+	}
+	if !bytes.Equal(b[:1000], data[9000:]) || !bytes.Equal(b[1000:], make([]byte, 1000)) {
+		t.Errorf("unexpected read data")
+	}
+
+	// writes are refused
+	sendRequest(t, client, cmdWrite, 2, 0, 512, make([]byte, 512))
+	if rep := readReply(t, client); rep.Error != uint32(syscall.EPERM) || rep.Handle[0] != 2 {
+		t.Errorf("unexpected write reply %+v", rep)
+	}
+
+	sendRequest(t, client, cmdFlush, 3, 0, 0, nil)
+	if rep := readReply(t, client); rep.Error != 0 || rep.Handle[0] != 3 {
+		t.Errorf("unexpected flush reply %+v", rep)
+	}
+
+	sendRequest(t, client, cmdDisc, 4, 0, 0, nil)
+	if err := <-done; err != nil {
+		t.Errorf("unexpected error: %s", err)
+	}
+}
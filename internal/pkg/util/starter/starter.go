@@ -6,7 +6,6 @@
 package starter
 
 import (
-	"encoding/json"
 	"fmt"
 	"io"
 	"os"
@@ -19,6 +18,15 @@ import (
 	"golang.org/x/sys/unix"
 )
 
+// traceEnv is the environment variable enabling starter
+// startup tracing (see cmd/starter/c/include/trace.h).
+const traceEnv = "SINGULARITY_STARTUP_TRACE"
+
+// encodingEnv is the environment variable selecting the engine
+// configuration encoding, either "binary" (default) or "json".
+// The binary encoding is only used by engines supporting it.
+const encodingEnv = "SINGULARITY_ENGINE_CONFIG_ENCODING"
+
 // CommandOp represents a function type passed to Exec/Run allowing
 // to customize the starter command execution.
 type CommandOp func(*Command)
@@ -114,7 +122,7 @@ func Run(name string, config *config.Common, ops ...CommandOp) error {
 	return nil
 }
 
-func (c *Command) init(config *config.Common, ops ...CommandOp) error {
+func (c *Command) init(cfg *config.Common, ops ...CommandOp) error {
 	c.path = filepath.Join(buildcfg.LIBEXECDIR, "singularity/bin/starter")
 
 	for _, op := range ops {
@@ -127,7 +135,16 @@ func (c *Command) init(config *config.Common, ops ...CommandOp) error {
 		return fmt.Errorf("%s not found, please check your installation", c.path)
 	}
 
-	data, err := json.Marshal(config)
+	encoding := config.BinaryEncoding
+	if name := os.Getenv(encodingEnv); name != "" {
+		enc, err := config.ParseEncoding(name)
+		if err != nil {
+			return err
+		}
+		encoding = enc
+	}
+
+	data, err := config.Marshal(cfg, encoding)
 	if err != nil {
 		return fmt.Errorf("while marshaling config: %s", err)
 	}
@@ -140,5 +157,10 @@ func (c *Command) init(config *config.Common, ops ...CommandOp) error {
 	env := []string{sylog.GetEnvVar(), fmt.Sprintf("PIPE_EXEC_FD=%d", pipeFd)}
 	c.env = append(c.env, env...)
 
+	// forward startup trace output to starter if requested
+	if output := os.Getenv(traceEnv); output != "" {
+		c.env = append(c.env, fmt.Sprintf("%s=%s", traceEnv, output))
+	}
+
 	return nil
 }
@@ -6,15 +6,69 @@
 package starter
 
 import (
+	"encoding/binary"
 	"fmt"
 
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"golang.org/x/sys/unix"
 )
 
-// sendData sets a socket communication channel between caller and starter
-// binary in order to pass engine JSON configuration data to starter.
+// frame returns engine JSON configuration data preceded by its
+// size as expected by starter (see read_engine_config in
+// cmd/starter/c/starter.c).
+func frame(data []byte) []byte {
+	b := make([]byte, 8+len(data))
+	binary.BigEndian.PutUint64(b, uint64(len(data)))
+	copy(b[8:], data)
+	return b
+}
+
+// writeAll writes b to fd and retries on short writes.
+func writeAll(fd int, b []byte) error {
+	for len(b) > 0 {
+		n, err := unix.Write(fd, b)
+		if err == unix.EINTR {
+			continue
+		} else if err != nil {
+			return err
+		}
+		b = b[n:]
+	}
+	return nil
+}
+
+// sendData returns a file descriptor from which starter binary
+// reads engine JSON configuration data. Data are stored in a memfd
+// so there is no size limit and no need to keep a writer around
+// while starter reads them, which is required by Exec.
 func sendData(data []byte) (int, error) {
+	fd, err := unix.MemfdCreate("engine-config", unix.MFD_CLOEXEC)
+	if err == unix.ENOSYS {
+		return sendSocketData(data)
+	} else if err != nil {
+		return -1, fmt.Errorf("failed to create configuration memfd: %s", err)
+	}
+	defer unix.Close(fd)
+
+	if err := writeAll(fd, frame(data)); err != nil {
+		return -1, fmt.Errorf("failed to write data to memfd: %s", err)
+	}
+	if _, err := unix.Seek(fd, 0, 0); err != nil {
+		return -1, fmt.Errorf("failed to rewind memfd: %s", err)
+	}
+
+	pipeFd, err := unix.Dup(fd)
+	if err != nil {
+		return -1, fmt.Errorf("failed to duplicate memfd file descriptor: %s", err)
+	}
+
+	return pipeFd, nil
+}
+
+// sendSocketData sets a socket communication channel between caller
+// and starter binary for kernels without memfd support, data must fit
+// in the socket buffer.
+func sendSocketData(data []byte) (int, error) {
 	fd, err := unix.Socketpair(unix.AF_UNIX, unix.SOCK_STREAM|unix.SOCK_CLOEXEC, 0)
 	if err != nil {
 		return -1, fmt.Errorf("failed to create socket communication pipe: %s", err)
@@ -35,7 +89,14 @@ func sendData(data []byte) (int, error) {
 		return -1, fmt.Errorf("failed to duplicate socket file descriptor: %s", err)
 	}
 
-	if n, err := unix.Write(fd[0], data); err != nil || n != len(data) {
+	// nobody reads the socket until starter is executed,
+	// fail instead of blocking forever if data don't fit
+	if err := unix.SetNonblock(fd[0], true); err != nil {
+		return -1, fmt.Errorf("failed to set socket non-blocking: %s", err)
+	}
+	if err := writeAll(fd[0], frame(data)); err == unix.EAGAIN {
+		return -1, fmt.Errorf("configuration data too big for socket buffer")
+	} else if err != nil {
 		return -1, fmt.Errorf("failed to write data to socket: %s", err)
 	}
 
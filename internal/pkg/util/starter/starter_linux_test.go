@@ -0,0 +1,42 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package starter
+
+import (
+	"bytes"
+	"encoding/binary"
+	"io/ioutil"
+	"os"
+	"testing"
+)
+
+func TestSendData(t *testing.T) {
+	// sizes below and above the former 128 KiB limit
+	for _, size := range []int{1, 4096, 128 * 1024, 4 * 1024 * 1024} {
+		data := bytes.Repeat([]byte("x"), size)
+
+		fd, err := sendData(data)
+		if err != nil {
+			t.Fatalf("unexpected error for %d bytes: %s", size, err)
+		}
+		f := os.NewFile(uintptr(fd), "config")
+		b, err := ioutil.ReadAll(f)
+		f.Close()
+		if err != nil {
+			t.Fatalf("unexpected error while reading %d bytes: %s", size, err)
+		}
+
+		if len(b) < 8 {
+			t.Fatalf("missing size header for %d bytes", size)
+		}
+		if n := binary.BigEndian.Uint64(b); n != uint64(size) {
+			t.Errorf("wrong size header: got %d instead of %d", n, size)
+		}
+		if !bytes.Equal(b[8:], data) {
+			t.Errorf("wrong data returned for %d bytes", size)
+		}
+	}
+}
@@ -11,8 +11,8 @@ import (
 	"fmt"
 )
 
-// sendData sets a socket communication channel between caller and starter
-// binary in order to pass engine JSON configuration data to starter.
+// sendData returns a file descriptor from which starter binary
+// reads engine JSON configuration data.
 func sendData(data []byte) (int, error) {
 	return -1, fmt.Errorf("not supported on this platform")
 }
@@ -0,0 +1,176 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+// Package trace records starter startup phase timestamps in the
+// memory area shared by all starter processes (see
+// cmd/starter/c/include/trace.h) and emits them as a single JSON
+// record per container launch.
+package trace
+
+/*
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+*/
+// #cgo CFLAGS: -I../../../../cmd/starter/c/include
+import "C"
+
+import (
+	"encoding/json"
+	"fmt"
+	"os"
+	"sort"
+	"sync/atomic"
+	"time"
+	"unsafe"
+
+	"golang.org/x/sys/unix"
+)
+
+// EnvVar is the environment variable enabling startup tracing, its
+// value is either a file path or a file descriptor number.
+const EnvVar = C.TRACE_ENV
+
+// Phase is a startup phase timestamp.
+type Phase struct {
+	// Name of the startup phase.
+	Name string `json:"name"`
+	// Pid of the process which reached the phase boundary.
+	Pid int `json:"pid"`
+	// Ns is the elapsed time in nanoseconds since starter started.
+	Ns uint64 `json:"ns"`
+}
+
+// Record is the structured record written once per launch.
+type Record struct {
+	// Pid of the initial starter process.
+	Pid int `json:"pid"`
+	// Time is the wall clock time when the record was emitted.
+	Time int64 `json:"time"`
+	// TotalNs is the elapsed time in nanoseconds between starter
+	// initialization and the last recorded phase.
+	TotalNs uint64 `json:"total_ns"`
+	// Dropped is the number of events which didn't fit in the trace area.
+	Dropped int `json:"dropped,omitempty"`
+	// Events ordered by timestamp.
+	Events []Phase `json:"events"`
+}
+
+var area *C.struct_trace
+
+// Init sets the shared trace area allocated by starter, a nil
+// pointer means that tracing is disabled and all functions of
+// this package are no-op.
+func Init(ptr unsafe.Pointer) {
+	area = (*C.struct_trace)(ptr)
+}
+
+// Enabled returns whether startup tracing is enabled or not.
+func Enabled() bool {
+	return area != nil
+}
+
+// Now returns the current monotonic clock value in nanoseconds,
+// this is the same clock used by starter C code.
+func Now() uint64 {
+	var ts unix.Timespec
+
+	if err := unix.ClockGettime(unix.CLOCK_MONOTONIC, &ts); err != nil {
+		return 0
+	}
+	return uint64(ts.Nano())
+}
+
+// Event records the timestamp of the startup phase identified by name.
+func Event(name string) {
+	if area == nil {
+		return
+	}
+
+	slot := atomic.AddUint32((*uint32)(unsafe.Pointer(&area.numEvents)), 1) - 1
+	if slot >= C.MAX_TRACE_EVENTS {
+		return
+	}
+
+	event := &area.events[slot]
+	event.ns = C.ulonglong(Now())
+	event.pid = C.pid_t(os.Getpid())
+
+	cname := C.CString(name)
+	C.strncpy(&event.name[0], cname, C.MAX_TRACE_NAME-1)
+	C.free(unsafe.Pointer(cname))
+}
+
+// Flush writes the trace record to the trace output and disables
+// tracing for the current process. It's called once by the process
+// executing the container process, right before the final exec.
+func Flush() error {
+	if area == nil {
+		return nil
+	}
+	defer func() {
+		area = nil
+	}()
+
+	num := int(atomic.LoadUint32((*uint32)(unsafe.Pointer(&area.numEvents))))
+	dropped := 0
+	if num > C.MAX_TRACE_EVENTS {
+		dropped = num - C.MAX_TRACE_EVENTS
+		num = C.MAX_TRACE_EVENTS
+	}
+
+	events := make([]Phase, 0, num)
+	for i := 0; i < num; i++ {
+		e := &area.events[i]
+		if e.ns == 0 {
+			// slot allocated but not filled yet
+			continue
+		}
+		events = append(events, Phase{
+			Name: C.GoString(&e.name[0]),
+			Pid:  int(e.pid),
+			Ns:   uint64(e.ns),
+		})
+	}
+
+	r := newRecord(int(area.pid), events)
+	r.Dropped = dropped
+
+	b, err := json.Marshal(r)
+	if err != nil {
+		return fmt.Errorf("while marshaling startup trace record: %s", err)
+	}
+	// a single write call to not interleave records of
+	// concurrent launches sharing the same output
+	if _, err := unix.Write(int(area.fd), append(b, '\n')); err != nil {
+		return fmt.Errorf("while writing startup trace record: %s", err)
+	}
+	return nil
+}
+
+// newRecord returns a record with events ordered by time and
+// timestamps relative to the first event.
+func newRecord(pid int, events []Phase) *Record {
+	r := &Record{
+		Pid:    pid,
+		Time:   time.Now().Unix(),
+		Events: events,
+	}
+	if len(events) == 0 {
+		return r
+	}
+
+	sort.SliceStable(events, func(i, j int) bool {
+		return events[i].Ns < events[j].Ns
+	})
+
+	start := events[0].Ns
+	for i := range events {
+		events[i].Ns -= start
+	}
+	r.TotalNs = events[len(events)-1].Ns
+
+	return r
+}
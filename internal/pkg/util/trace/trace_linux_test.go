@@ -0,0 +1,55 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package trace
+
+import (
+	"testing"
+)
+
+func TestNewRecord(t *testing.T) {
+	events := []Phase{
+		{Name: "stage1_go_runtime", Pid: 2, Ns: 1500},
+		{Name: "starter_init", Pid: 1, Ns: 1000},
+		{Name: "exec", Pid: 3, Ns: 9000},
+		{Name: "wait_stage1", Pid: 1, Ns: 2000},
+	}
+
+	r := newRecord(1, events)
+	if r.Pid != 1 {
+		t.Errorf("unexpected pid %d", r.Pid)
+	}
+	if r.TotalNs != 8000 {
+		t.Errorf("unexpected total time %d", r.TotalNs)
+	}
+
+	expected := []string{"starter_init", "stage1_go_runtime", "wait_stage1", "exec"}
+	for i, e := range r.Events {
+		if e.Name != expected[i] {
+			t.Errorf("unexpected event %s at position %d, expected %s", e.Name, i, expected[i])
+		}
+	}
+	if r.Events[0].Ns != 0 {
+		t.Errorf("first event should start at 0, got %d", r.Events[0].Ns)
+	}
+
+	r = newRecord(1, nil)
+	if r.TotalNs != 0 || len(r.Events) != 0 {
+		t.Errorf("unexpected record for empty event list: %+v", r)
+	}
+}
+
+func TestDisabled(t *testing.T) {
+	Init(nil)
+
+	if Enabled() {
+		t.Fatalf("tracing should be disabled")
+	}
+	// must be no-op
+	Event("test")
+	if err := Flush(); err != nil {
+		t.Errorf("unexpected error: %s", err)
+	}
+}
@@ -0,0 +1,208 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package user
+
+import (
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"strings"
+	"syscall"
+	"time"
+
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+)
+
+// Lookup looks up user and group entries.
+type Lookup interface {
+	GetPwUID(uid uint32) (*User, error)
+	GetGrGID(gid uint32) (*Group, error)
+}
+
+type nssLookup struct{}
+
+func (nssLookup) GetPwUID(uid uint32) (*User, error) {
+	return GetPwUID(uid)
+}
+
+func (nssLookup) GetGrGID(gid uint32) (*Group, error) {
+	return GetGrGID(gid)
+}
+
+// NSS looks up user and group entries with the host name service switch.
+var NSS Lookup = nssLookup{}
+
+// snapshotData is the persisted content of a snapshot.
+type snapshotData struct {
+	Created int64             `json:"created"`
+	Users   map[uint32]*User  `json:"users"`
+	Groups  map[uint32]*Group `json:"groups"`
+}
+
+// Snapshot is a Lookup keeping the user and group entries looked up with
+// another Lookup. A snapshot is stored per user in a directory and reused
+// by the following snapshots of the user until it expires, so launches
+// don't query the name service again, entries missing from a snapshot
+// are looked up and added to it.
+type Snapshot struct {
+	lookup Lookup
+	path   string
+	dirty  bool
+	data   snapshotData
+}
+
+// validField returns whether s can be written in a passwd or group
+// file field.
+func validField(s string) bool {
+	return !strings.ContainsAny(s, ":\n")
+}
+
+func (u *User) valid(uid uint32) bool {
+	return u != nil && u.UID == uid && u.Name != "" &&
+		validField(u.Name) && validField(u.Gecos) && validField(u.Dir) && validField(u.Shell)
+}
+
+func (g *Group) valid(gid uint32) bool {
+	return g != nil && g.GID == gid && g.Name != "" && validField(g.Name)
+}
+
+// NewSnapshot returns the snapshot of the user uid stored in dir, or an
+// empty snapshot if there is none, if it's older than ttl or if it's not
+// owned by the current user. With an empty dir or a zero ttl, entries
+// are only kept by the returned snapshot.
+func NewSnapshot(dir string, uid uint32, ttl time.Duration, lookup Lookup) *Snapshot {
+	s := &Snapshot{
+		lookup: lookup,
+		data: snapshotData{
+			Created: time.Now().UnixNano(),
+			Users:   make(map[uint32]*User),
+			Groups:  make(map[uint32]*Group),
+		},
+	}
+	if dir == "" || ttl <= 0 {
+		return s
+	}
+	s.path = filepath.Join(dir, fmt.Sprintf("%d.json", uid))
+
+	if err := s.load(ttl); err != nil {
+		sylog.Debugf("Not using identity snapshot %s: %s", s.path, err)
+	}
+	return s
+}
+
+// load reads the stored snapshot, it's ignored if any entry is invalid.
+func (s *Snapshot) load(ttl time.Duration) error {
+	f, err := os.Open(s.path)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+
+	// a snapshot written by another user could inject entries
+	fi, err := f.Stat()
+	if err != nil {
+		return err
+	} else if st, ok := fi.Sys().(*syscall.Stat_t); !ok || int(st.Uid) != os.Geteuid() {
+		return fmt.Errorf("not owned by the current user")
+	}
+
+	var data snapshotData
+	if err := json.NewDecoder(f).Decode(&data); err != nil {
+		return err
+	}
+	age := time.Duration(time.Now().UnixNano() - data.Created)
+	if age < 0 || age >= ttl {
+		return fmt.Errorf("expired")
+	}
+	for uid, u := range data.Users {
+		if !u.valid(uid) {
+			return fmt.Errorf("invalid user entry for UID %d", uid)
+		}
+	}
+	for gid, g := range data.Groups {
+		if !g.valid(gid) {
+			return fmt.Errorf("invalid group entry for GID %d", gid)
+		}
+	}
+	if data.Users == nil {
+		data.Users = make(map[uint32]*User)
+	}
+	if data.Groups == nil {
+		data.Groups = make(map[uint32]*Group)
+	}
+
+	s.data = data
+	return nil
+}
+
+// GetPwUID returns a pointer to User structure associated with user uid.
+func (s *Snapshot) GetPwUID(uid uint32) (*User, error) {
+	if u, ok := s.data.Users[uid]; ok {
+		return u, nil
+	}
+	u, err := s.lookup.GetPwUID(uid)
+	if err != nil || !u.valid(uid) {
+		return u, err
+	}
+	s.data.Users[uid] = u
+	s.dirty = true
+	return u, nil
+}
+
+// GetGrGID returns a pointer to Group structure associated with group gid.
+func (s *Snapshot) GetGrGID(gid uint32) (*Group, error) {
+	if g, ok := s.data.Groups[gid]; ok {
+		return g, nil
+	}
+	g, err := s.lookup.GetGrGID(gid)
+	if err != nil || !g.valid(gid) {
+		return g, err
+	}
+	s.data.Groups[gid] = g
+	s.dirty = true
+	return g, nil
+}
+
+// Store stores the snapshot if entries were added to it, this is
+// best-effort.
+func (s *Snapshot) Store() {
+	if s.path == "" || !s.dirty {
+		return
+	}
+
+	b, err := json.Marshal(&s.data)
+	if err != nil {
+		return
+	}
+	dir := filepath.Dir(s.path)
+	if err := os.MkdirAll(dir, 0700); err != nil {
+		sylog.Debugf("Could not create identity snapshot directory: %s", err)
+		return
+	}
+
+	// write in a temporary file renamed once complete, concurrent
+	// launches always read a complete snapshot
+	f, err := ioutil.TempFile(dir, "snapshot-")
+	if err != nil {
+		sylog.Debugf("Could not create identity snapshot: %s", err)
+		return
+	}
+	_, err = f.Write(b)
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(f.Name(), s.path)
+	}
+	if err != nil {
+		sylog.Debugf("Could not store identity snapshot: %s", err)
+		os.Remove(f.Name())
+		return
+	}
+	s.dirty = false
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package user
+
+import (
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+// countLookup returns entries generated from the requested IDs and
+// counts the lookups.
+type countLookup struct {
+	lookups int
+}
+
+func (l *countLookup) GetPwUID(uid uint32) (*User, error) {
+	l.lookups++
+	if uid == 0 {
+		return nil, fmt.Errorf("unknown user")
+	}
+	return &User{Name: fmt.Sprintf("user%d", uid), UID: uid, GID: uid, Dir: "/home", Shell: "/bin/sh"}, nil
+}
+
+func (l *countLookup) GetGrGID(gid uint32) (*Group, error) {
+	l.lookups++
+	return &Group{Name: fmt.Sprintf("group%d", gid), GID: gid}, nil
+}
+
+func TestSnapshot(t *testing.T) {
+	dir, err := ioutil.TempDir("", "identity-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	lookup := new(countLookup)
+
+	s := NewSnapshot(dir, 1000, time.Minute, lookup)
+	if _, err := s.GetPwUID(0); err == nil {
+		t.Errorf("unexpected success for unknown user")
+	}
+	for i := 0; i < 2; i++ {
+		if u, err := s.GetPwUID(1000); err != nil || u.Name != "user1000" {
+			t.Fatalf("unexpected user %v: %v", u, err)
+		}
+		if g, err := s.GetGrGID(100); err != nil || g.Name != "group100" {
+			t.Fatalf("unexpected group %v: %v", g, err)
+		}
+	}
+	if lookup.lookups != 3 {
+		t.Errorf("got %d lookups instead of 3", lookup.lookups)
+	}
+	s.Store()
+
+	// entries are reused by the next snapshots
+	lookup.lookups = 0
+	s = NewSnapshot(dir, 1000, time.Minute, lookup)
+	if _, err := s.GetPwUID(1000); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := s.GetGrGID(100); err != nil {
+		t.Fatal(err)
+	}
+	if lookup.lookups != 0 {
+		t.Errorf("got %d lookups with a stored snapshot", lookup.lookups)
+	}
+
+	// other users have their own snapshot
+	NewSnapshot(dir, 1001, time.Minute, lookup).GetPwUID(1000)
+	if lookup.lookups != 1 {
+		t.Errorf("snapshot of another user reused")
+	}
+
+	// expired snapshots are ignored
+	lookup.lookups = 0
+	time.Sleep(10 * time.Millisecond)
+	NewSnapshot(dir, 1000, 5*time.Millisecond, lookup).GetPwUID(1000)
+	if lookup.lookups != 1 {
+		t.Errorf("expired snapshot reused")
+	}
+
+	// invalid entries discard the snapshot
+	lookup.lookups = 0
+	path := filepath.Join(dir, "1000.json")
+	data := fmt.Sprintf(`{"created":%d,"users":{"1000":{"Name":"root","UID":0}}}`, time.Now().UnixNano())
+	if err := ioutil.WriteFile(path, []byte(data), 0600); err != nil {
+		t.Fatal(err)
+	}
+	if u, err := NewSnapshot(dir, 1000, time.Minute, lookup).GetPwUID(1000); err != nil || u.UID != 1000 {
+		t.Errorf("unexpected user %v: %v", u, err)
+	}
+	if lookup.lookups != 1 {
+		t.Errorf("invalid snapshot reused")
+	}
+
+	// snapshots are not stored without a directory or a TTL
+	for _, s := range []*Snapshot{
+		NewSnapshot("", 1002, time.Minute, lookup),
+		NewSnapshot(dir, 1002, 0, lookup),
+	} {
+		s.GetPwUID(1002)
+		s.Store()
+	}
+	if _, err := os.Stat(filepath.Join(dir, "1002.json")); err == nil {
+		t.Errorf("unexpected stored snapshot")
+	}
+}
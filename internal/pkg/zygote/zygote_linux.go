@@ -0,0 +1,139 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+// Package zygote implements the client side of instances started in
+// zygote mode. The container process of such instances keeps serving
+// launch requests on a unix socket once the container is set up, each
+// request forks a new container process skipping starter initialization
+// and container creation (see cmd/starter/c/zygote.c).
+package zygote
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"os/signal"
+	"path/filepath"
+	"syscall"
+
+	"github.com/sylabs/singularity/internal/pkg/instance"
+)
+
+// MaxRequestSize is the maximum size of a JSON encoded request,
+// it must match MAX_ZYGOTE_REQUEST in cmd/starter/c/include/zygote.h.
+const MaxRequestSize = 128 * 1024
+
+// forwardSignals is the list of signals forwarded to the container process.
+var forwardSignals = []os.Signal{
+	syscall.SIGHUP,
+	syscall.SIGINT,
+	syscall.SIGQUIT,
+	syscall.SIGTERM,
+	syscall.SIGUSR1,
+	syscall.SIGUSR2,
+	syscall.SIGWINCH,
+}
+
+// Request is a launch request sent to the zygote.
+type Request struct {
+	// Args is the container process arguments.
+	Args []string `json:"args"`
+	// Env is the container process environment.
+	Env []string `json:"env"`
+	// Cwd is the container process working directory.
+	Cwd string `json:"cwd"`
+}
+
+// SocketPath returns the zygote socket path of the named instance.
+func SocketPath(name string) (string, error) {
+	dir, err := instance.GetDir(name, instance.SingSubDir)
+	if err != nil {
+		return "", err
+	}
+	return filepath.Join(dir, name+".sock"), nil
+}
+
+// Listen creates the zygote socket at path and returns the
+// close-on-exec listening socket file descriptor.
+func Listen(path string) (int, error) {
+	fd, err := syscall.Socket(syscall.AF_UNIX, syscall.SOCK_STREAM|syscall.SOCK_CLOEXEC, 0)
+	if err != nil {
+		return -1, fmt.Errorf("while creating zygote socket: %s", err)
+	}
+	if err := syscall.Bind(fd, &syscall.SockaddrUnix{Name: path}); err != nil {
+		syscall.Close(fd)
+		return -1, fmt.Errorf("while binding zygote socket %s: %s", path, err)
+	}
+	if err := syscall.Listen(fd, syscall.SOMAXCONN); err != nil {
+		syscall.Close(fd)
+		return -1, fmt.Errorf("while listening on zygote socket %s: %s", path, err)
+	}
+	return fd, nil
+}
+
+// Exec sends the launch request to the zygote listening at path along
+// with the current standard I/O streams. Signals received in the meantime
+// are forwarded to the container process, the container process wait
+// status is returned once it exits.
+func Exec(path string, r *Request) (syscall.WaitStatus, error) {
+	conn, err := net.DialUnix("unix", nil, &net.UnixAddr{Name: path, Net: "unix"})
+	if err != nil {
+		return 0, fmt.Errorf("while connecting to zygote: %s", err)
+	}
+	defer conn.Close()
+
+	signals := make(chan os.Signal, 1)
+	signal.Notify(signals, forwardSignals...)
+	defer signal.Stop(signals)
+
+	return launch(conn, r, []int{0, 1, 2}, signals)
+}
+
+func launch(conn *net.UnixConn, r *Request, fds []int, signals chan os.Signal) (syscall.WaitStatus, error) {
+	b, err := json.Marshal(r)
+	if err != nil {
+		return 0, fmt.Errorf("while encoding zygote request: %s", err)
+	}
+	if len(b) > MaxRequestSize {
+		return 0, fmt.Errorf("zygote request too big %d > %d", len(b), MaxRequestSize)
+	}
+
+	hdr := make([]byte, 4)
+	binary.BigEndian.PutUint32(hdr, uint32(len(b)))
+
+	if _, _, err := conn.WriteMsgUnix(hdr, syscall.UnixRights(fds...), nil); err != nil {
+		return 0, fmt.Errorf("while sending zygote request: %s", err)
+	}
+	if _, err := conn.Write(b); err != nil {
+		return 0, fmt.Errorf("while sending zygote request: %s", err)
+	}
+
+	errChan := make(chan error, 1)
+	status := make([]byte, 4)
+
+	go func() {
+		_, err := io.ReadFull(conn, status)
+		errChan <- err
+	}()
+
+	for {
+		select {
+		case s := <-signals:
+			data := make([]byte, 4)
+			binary.BigEndian.PutUint32(data, uint32(s.(syscall.Signal)))
+			if _, err := conn.Write(data); err != nil {
+				return 0, fmt.Errorf("while forwarding signal %s: %s", s, err)
+			}
+		case err := <-errChan:
+			if err != nil {
+				return 0, fmt.Errorf("while waiting container process status: %s", err)
+			}
+			return syscall.WaitStatus(binary.BigEndian.Uint32(status)), nil
+		}
+	}
+}
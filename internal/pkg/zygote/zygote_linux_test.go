@@ -0,0 +1,184 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package zygote
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"io"
+	"io/ioutil"
+	"net"
+	"os"
+	"path/filepath"
+	"reflect"
+	"syscall"
+	"testing"
+)
+
+// fakeZygote accepts one connection, decodes the request like starter
+// does and replies with the status returned by reply.
+func fakeZygote(t *testing.T, l *net.UnixListener, reqChan chan *Request, reply func(*net.UnixConn) uint32) {
+	conn, err := l.AcceptUnix()
+	if err != nil {
+		t.Errorf("unexpected accept error: %s", err)
+		close(reqChan)
+		return
+	}
+	defer conn.Close()
+
+	hdr := make([]byte, 4)
+	oob := make([]byte, syscall.CmsgSpace(3*4))
+
+	_, oobn, _, _, err := conn.ReadMsgUnix(hdr, oob)
+	if err != nil {
+		t.Errorf("unexpected read error: %s", err)
+		close(reqChan)
+		return
+	}
+	msgs, err := syscall.ParseSocketControlMessage(oob[:oobn])
+	if err != nil || len(msgs) != 1 {
+		t.Errorf("unexpected control message: %v", err)
+		close(reqChan)
+		return
+	}
+	fds, err := syscall.ParseUnixRights(&msgs[0])
+	if err != nil || len(fds) != 3 {
+		t.Errorf("expected 3 file descriptors, got %d: %v", len(fds), err)
+	}
+	for _, fd := range fds {
+		syscall.Close(fd)
+	}
+
+	b := make([]byte, binary.BigEndian.Uint32(hdr))
+	if _, err := io.ReadFull(conn, b); err != nil {
+		t.Errorf("unexpected read error: %s", err)
+		close(reqChan)
+		return
+	}
+	r := new(Request)
+	if err := json.Unmarshal(b, r); err != nil {
+		t.Errorf("unexpected decoding error: %s", err)
+	}
+	reqChan <- r
+
+	binary.BigEndian.PutUint32(hdr, reply(conn))
+	conn.Write(hdr)
+}
+
+func TestExec(t *testing.T) {
+	dir, err := ioutil.TempDir("", "zygote-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	path := filepath.Join(dir, "test.sock")
+	fd, err := Listen(path)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	f := os.NewFile(uintptr(fd), path)
+	ln, err := net.FileListener(f)
+	f.Close()
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	defer ln.Close()
+	l := ln.(*net.UnixListener)
+
+	tests := []struct {
+		name    string
+		request *Request
+		signal  syscall.Signal
+		status  uint32
+	}{
+		{
+			name: "exit status",
+			request: &Request{
+				Args: []string{"/bin/true"},
+				Env:  []string{"PATH=/bin"},
+				Cwd:  "/",
+			},
+			status: 2 << 8,
+		},
+		{
+			name: "forwarded signal",
+			request: &Request{
+				Args: []string{"/bin/sleep", "60"},
+			},
+			signal: syscall.SIGTERM,
+			status: uint32(syscall.SIGTERM),
+		},
+	}
+
+	for _, tt := range tests {
+		reqChan := make(chan *Request, 1)
+		signals := make(chan os.Signal, 1)
+
+		go fakeZygote(t, l, reqChan, func(conn *net.UnixConn) uint32 {
+			if tt.signal == 0 {
+				return tt.status
+			}
+			signals <- tt.signal
+			b := make([]byte, 4)
+			if _, err := io.ReadFull(conn, b); err != nil {
+				t.Errorf("%s: unexpected read error: %s", tt.name, err)
+			} else if s := syscall.Signal(binary.BigEndian.Uint32(b)); s != tt.signal {
+				t.Errorf("%s: unexpected signal %s forwarded", tt.name, s)
+			}
+			return tt.status
+		})
+
+		conn, err := net.DialUnix("unix", nil, &net.UnixAddr{Name: path, Net: "unix"})
+		if err != nil {
+			t.Fatalf("%s: unexpected error: %s", tt.name, err)
+		}
+		status, err := launch(conn, tt.request, []int{0, 1, 2}, signals)
+		conn.Close()
+		if err != nil {
+			t.Fatalf("%s: unexpected error: %s", tt.name, err)
+		}
+
+		if r := <-reqChan; !reflect.DeepEqual(r, tt.request) {
+			t.Errorf("%s: unexpected request %+v", tt.name, r)
+		}
+		if uint32(status) != tt.status {
+			t.Errorf("%s: unexpected status %d instead of %d", tt.name, status, tt.status)
+		}
+	}
+}
+
+func TestRequestTooBig(t *testing.T) {
+	c1, c2, err := socketPair()
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer c1.Close()
+	defer c2.Close()
+
+	r := &Request{Args: []string{string(make([]byte, MaxRequestSize))}}
+	if _, err := launch(c1, r, []int{0, 1, 2}, nil); err == nil {
+		t.Errorf("unexpected success with a request too big")
+	}
+}
+
+func socketPair() (*net.UnixConn, *net.UnixConn, error) {
+	fds, err := syscall.Socketpair(syscall.AF_UNIX, syscall.SOCK_STREAM, 0)
+	if err != nil {
+		return nil, nil, err
+	}
+	conns := make([]*net.UnixConn, 2)
+	for i, fd := range fds {
+		f := os.NewFile(uintptr(fd), "socketpair")
+		c, err := net.FileConn(f)
+		f.Close()
+		if err != nil {
+			return nil, nil, err
+		}
+		conns[i] = c.(*net.UnixConn)
+	}
+	return conns[0], conns[1], nil
+}
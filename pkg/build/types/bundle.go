@@ -16,6 +16,7 @@ import (
 	"github.com/sylabs/singularity/internal/pkg/client/cache"
 	"github.com/sylabs/singularity/internal/pkg/sylog"
 	"github.com/sylabs/singularity/internal/pkg/util/fs"
+	"github.com/sylabs/singularity/pkg/image/packer"
 	"github.com/sylabs/singularity/pkg/util/crypt"
 	"golang.org/x/sys/unix"
 )
@@ -30,6 +31,24 @@ type Bundle struct {
 
 	RootfsPath string `json:"rootfsPath"` // where actual fs to chroot will appear
 	TmpDir     string `json:"tmpPath"`    // where temp files required during build will appear
+
+	// Base is the SIF image the root filesystem was extracted from
+	// for incremental builds, nil otherwise.
+	Base *BaseImage `json:"-"`
+	// Layers are the image layers kept packed when they can be
+	// converted directly to the image filesystem, nil otherwise.
+	// The root filesystem then only holds the files added by the
+	// build, written over the layers.
+	Layers *packer.Layers `json:"-"`
+}
+
+// BaseImage describes the SIF image a bundle root filesystem was
+// extracted from.
+type BaseImage struct {
+	// Path is the SIF image path.
+	Path string
+	// Manifest is the state of the root filesystem once extracted.
+	Manifest Manifest
 }
 
 // Options defines build time behavior to be executed on the bundle.
@@ -56,6 +75,16 @@ type Options struct {
 	Force bool `json:"force"`
 	// Update detects and builds using an existing sandbox container at build destination.
 	Update bool `json:"update"`
+	// Incremental packs only the files added or changed since the base
+	// SIF image when building a SIF image from another SIF image.
+	Incremental bool `json:"incremental"`
+	// Layered packs OCI image layers in separate overlay partitions,
+	// converted layers being cached and reused across builds.
+	Layered bool `json:"layered"`
+	// DownloadConcurrency is the number of OCI image layers downloaded
+	// at the same time into the image cache, set from singularity.conf
+	// by the build when zero.
+	DownloadConcurrency uint `json:"downloadConcurrency"`
 	// NoHTTPS instructs builder not to use secure connection.
 	NoHTTPS bool `json:"noHTTPS"`
 	// NoCleanUp allows a user to prevent a bundle from being cleaned up after a failed build.
@@ -70,6 +99,18 @@ type Options struct {
 	// To warn when the above is needed, we need to know if the target of this
 	// bundle will be a sandbox
 	SandboxTarget bool
+	// PrefetchManifest is the path of a prefetch manifest recorded
+	// with --prefetch-record, stored in the SIF image to read the
+	// files it lists in background at the container start.
+	PrefetchManifest string
+	// StartupOrder orders the SIF root filesystem data to place first
+	// the files read at container startup, listed by the prefetch
+	// manifest at this path, or guessed when set to "auto".
+	StartupOrder string
+	// StreamLayers lets OCI sources keep image layers packed for a
+	// direct conversion to the image filesystem, when no build step
+	// needs the unpacked root filesystem.
+	StreamLayers bool
 }
 
 // NewEncryptedBundle creates an Encrypted Bundle environment.
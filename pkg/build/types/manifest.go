@@ -0,0 +1,111 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package types
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"syscall"
+)
+
+// ManifestEntry is the state of a root filesystem entry.
+type ManifestEntry struct {
+	Mode  os.FileMode
+	UID   uint32
+	GID   uint32
+	Size  int64
+	Inode uint64
+	Mtime int64
+	Ctime int64
+}
+
+// Manifest records the state of root filesystem entries indexed by
+// their path relative to the root filesystem.
+type Manifest map[string]ManifestEntry
+
+// ManifestDiff reports the differences between a manifest and the
+// current state of a root filesystem.
+type ManifestDiff struct {
+	// Changed lists the paths of entries added or changed since
+	// the manifest, directories before their entries.
+	Changed []string
+	// Removed is the number of entries removed since the manifest.
+	Removed int
+}
+
+func manifestEntry(path string, fi os.FileInfo) (ManifestEntry, error) {
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !ok {
+		return ManifestEntry{}, fmt.Errorf("could not get %s file status", path)
+	}
+	return ManifestEntry{
+		Mode:  fi.Mode(),
+		UID:   st.Uid,
+		GID:   st.Gid,
+		Size:  st.Size,
+		Inode: st.Ino,
+		Mtime: st.Mtim.Nano(),
+		Ctime: st.Ctim.Nano(),
+	}, nil
+}
+
+// walkRootfs calls fn for each entry of rootfs, the root directory
+// included, with the entry path relative to rootfs.
+func walkRootfs(rootfs string, fn func(string, ManifestEntry) error) error {
+	return filepath.Walk(rootfs, func(path string, fi os.FileInfo, err error) error {
+		if err != nil {
+			return err
+		}
+		rel, err := filepath.Rel(rootfs, path)
+		if err != nil {
+			return err
+		}
+		e, err := manifestEntry(path, fi)
+		if err != nil {
+			return err
+		}
+		return fn(rel, e)
+	})
+}
+
+// NewManifest returns the manifest of the root filesystem rootfs.
+func NewManifest(rootfs string) (Manifest, error) {
+	m := make(Manifest)
+	err := walkRootfs(rootfs, func(path string, e ManifestEntry) error {
+		m[path] = e
+		return nil
+	})
+	if err != nil {
+		return nil, fmt.Errorf("while creating manifest of %s: %s", rootfs, err)
+	}
+	return m, nil
+}
+
+// Diff compares the manifest with the current state of rootfs. A
+// replaced file has a new inode and a file modified in place a new
+// change time, any metadata change is also reported as a change.
+func (m Manifest) Diff(rootfs string) (*ManifestDiff, error) {
+	d := new(ManifestDiff)
+	seen := 0
+
+	err := walkRootfs(rootfs, func(path string, e ManifestEntry) error {
+		old, ok := m[path]
+		if ok {
+			seen++
+		}
+		if !ok || old != e {
+			d.Changed = append(d.Changed, path)
+		}
+		return nil
+	})
+	if err != nil {
+		return nil, fmt.Errorf("while comparing %s with its manifest: %s", rootfs, err)
+	}
+	d.Removed = len(m) - seen
+
+	return d, nil
+}
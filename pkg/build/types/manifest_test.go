@@ -0,0 +1,82 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package types
+
+import (
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"reflect"
+	"testing"
+)
+
+func TestManifestDiff(t *testing.T) {
+	rootfs, err := ioutil.TempDir("", "manifest-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(rootfs)
+
+	for _, f := range []string{"bin/sh", "etc/hosts", "etc/passwd", "lib/libc.so", "tmp/file"} {
+		path := filepath.Join(rootfs, f)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			t.Fatal(err)
+		}
+		if err := ioutil.WriteFile(path, []byte(f), 0644); err != nil {
+			t.Fatal(err)
+		}
+	}
+	if err := os.Symlink("libc.so", filepath.Join(rootfs, "lib/libc.so.6")); err != nil {
+		t.Fatal(err)
+	}
+
+	m, err := NewManifest(rootfs)
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	d, err := m.Diff(rootfs)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(d.Changed) != 0 || d.Removed != 0 {
+		t.Fatalf("unexpected diff of an unchanged root filesystem: %+v", d)
+	}
+
+	// replaced file
+	if err := ioutil.WriteFile(filepath.Join(rootfs, "etc/hosts.new"), []byte("hosts"), 0644); err != nil {
+		t.Fatal(err)
+	}
+	if err := os.Rename(filepath.Join(rootfs, "etc/hosts.new"), filepath.Join(rootfs, "etc/hosts")); err != nil {
+		t.Fatal(err)
+	}
+	// metadata change
+	if err := os.Chmod(filepath.Join(rootfs, "bin/sh"), 0755); err != nil {
+		t.Fatal(err)
+	}
+	// hard link to an unchanged file
+	if err := os.Link(filepath.Join(rootfs, "etc/passwd"), filepath.Join(rootfs, "etc/passwd-")); err != nil {
+		t.Fatal(err)
+	}
+	// removed file
+	if err := os.Remove(filepath.Join(rootfs, "tmp/file")); err != nil {
+		t.Fatal(err)
+	}
+
+	d, err = m.Diff(rootfs)
+	if err != nil {
+		t.Fatal(err)
+	}
+	// etc/passwd has a new link count and so a new change time,
+	// parent directories have new modification times
+	changed := []string{"bin/sh", "etc", "etc/hosts", "etc/passwd", "etc/passwd-", "tmp"}
+	if !reflect.DeepEqual(d.Changed, changed) {
+		t.Errorf("unexpected changed files %v instead of %v", d.Changed, changed)
+	}
+	if d.Removed != 1 {
+		t.Errorf("unexpected number of removed files %d instead of 1", d.Removed)
+	}
+}
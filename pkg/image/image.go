@@ -77,6 +77,8 @@ type Section struct {
 	Offset uint64 `json:"offset"`
 	Type   uint32 `json:"type"`
 	Name   string `json:"name"`
+	// Overlay is set for SIF overlay partitions
+	Overlay bool `json:"overlay,omitempty"`
 }
 
 // Image describes an image object, an image is composed of one
@@ -93,6 +95,9 @@ type Image struct {
 	Writable   bool      `json:"writable"`
 	Partitions []Section `json:"partitions"`
 	Sections   []Section `json:"sections"`
+	// arch is the SIF image architecture, stored in the
+	// metadata cache to check it on cache hit
+	arch string
 }
 
 // AuthorizedPath checks if image is in a path supplied in paths
@@ -230,6 +235,23 @@ func Init(path string, writable bool) (*Image, error) {
 		Name: filepath.Base(resolvedPath),
 	}
 
+	// read-only images are first looked up in the metadata cache
+	// to skip format detection
+	if !writable {
+		img.File, err = os.OpenFile(resolvedPath, os.O_RDONLY, 0)
+		if err == nil {
+			found, err := initFromMetadata(img)
+			if err != nil {
+				_ = img.File.Close()
+				return nil, err
+			} else if found {
+				sylog.Debugf("Image format found in metadata cache")
+				return initFile(img), nil
+			}
+			_ = img.File.Close()
+		}
+	}
+
 	for _, rf := range registeredFormats {
 		sylog.Debugf("Check for %s image format", rf.name)
 
@@ -267,14 +289,24 @@ func Init(path string, writable bool) (*Image, error) {
 
 		sylog.Debugf("%s image format detected", rf.name)
 
-		if _, _, err := syscall.Syscall(syscall.SYS_FCNTL, img.File.Fd(), syscall.F_SETFD, syscall.O_CLOEXEC); err != 0 {
-			sylog.Warningf("failed to set O_CLOEXEC flags on image")
+		if !img.Writable {
+			storeMetadata(img, fileinfo)
 		}
 
-		img.Source = fmt.Sprintf("/proc/self/fd/%d", img.File.Fd())
-		img.Fd = img.File.Fd()
-
-		return img, nil
+		return initFile(img), nil
 	}
 	return nil, ErrUnknownFormat
 }
+
+// initFile sets the image file descriptor fields once the image
+// format has been detected.
+func initFile(img *Image) *Image {
+	if _, _, err := syscall.Syscall(syscall.SYS_FCNTL, img.File.Fd(), syscall.F_SETFD, syscall.O_CLOEXEC); err != 0 {
+		sylog.Warningf("failed to set O_CLOEXEC flags on image")
+	}
+
+	img.Source = fmt.Sprintf("/proc/self/fd/%d", img.File.Fd())
+	img.Fd = img.File.Fd()
+
+	return img
+}
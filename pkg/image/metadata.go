@@ -0,0 +1,183 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package image
+
+import (
+	"bufio"
+	"encoding/json"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"syscall"
+
+	"github.com/sylabs/singularity/internal/pkg/client/cache"
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+)
+
+// metadataDir is the metadata cache directory inside the cache root
+// directory.
+const metadataDir = "metadata"
+
+// metadataVersion is the version of the cache entries format, entries
+// with another version are ignored.
+const metadataVersion = 1
+
+// metadata is the cached result of an image format detection, it's
+// valid as long as the image file identity and times don't change.
+type metadata struct {
+	Version    int       `json:"version"`
+	Device     uint64    `json:"device"`
+	Inode      uint64    `json:"inode"`
+	Size       int64     `json:"size"`
+	Mtime      int64     `json:"mtime"`
+	Ctime      int64     `json:"ctime"`
+	Type       int       `json:"type"`
+	Arch       string    `json:"arch,omitempty"`
+	Partitions []Section `json:"partitions"`
+	Sections   []Section `json:"sections,omitempty"`
+}
+
+// setuidCredentials returns whether the process runs with user IDs
+// differing from its real user ID, like starter stage 1 in the setuid
+// workflow which keeps root as saved user ID. It returns true if the
+// user IDs can't be read.
+func setuidCredentials() bool {
+	f, err := os.Open("/proc/self/status")
+	if err != nil {
+		return true
+	}
+	defer f.Close()
+
+	scanner := bufio.NewScanner(f)
+	for scanner.Scan() {
+		var ruid, euid, suid, fsuid uint32
+		if n, _ := fmt.Sscanf(scanner.Text(), "Uid:\t%d\t%d\t%d\t%d", &ruid, &euid, &suid, &fsuid); n == 4 {
+			return euid != ruid || suid != ruid || fsuid != ruid
+		}
+	}
+	return true
+}
+
+// metadataCacheDir returns the metadata cache directory, or an
+// empty string if the cache is disabled. The cache is writable by
+// the user, it's disabled with setuid credentials as the image
+// format and partitions are then checked against the configured
+// restrictions and must be read from the image itself. As a result
+// only unprivileged and root launches use it, not the setuid stage 1
+// of the default workflow.
+func metadataCacheDir() string {
+	if setuidCredentials() {
+		return ""
+	}
+	return cache.DataDir(metadataDir)
+}
+
+// metadataPath returns the cache entry path of an image, there is a
+// single entry per image file, updated when the image changes.
+func metadataPath(dir string, st *syscall.Stat_t) string {
+	// cast to uint64 as st.Dev is uint32 on MIPS
+	return filepath.Join(dir, fmt.Sprintf("%x-%x.json", uint64(st.Dev), st.Ino))
+}
+
+// matches returns if the cache entry has the current format and
+// corresponds to the image file identity and times.
+func (m *metadata) matches(st *syscall.Stat_t) bool {
+	return m.Version == metadataVersion &&
+		m.Device == uint64(st.Dev) && m.Inode == st.Ino && m.Size == st.Size &&
+		m.Mtime == st.Mtim.Nano() && m.Ctime == st.Ctim.Nano()
+}
+
+// valid checks that the cached partitions and sections are located
+// within the image file.
+func (m *metadata) valid() bool {
+	if len(m.Partitions) == 0 {
+		return false
+	}
+	for _, sections := range [][]Section{m.Partitions, m.Sections} {
+		for _, s := range sections {
+			if s.Offset+s.Size < s.Offset || s.Offset+s.Size > uint64(m.Size) {
+				return false
+			}
+		}
+	}
+	return true
+}
+
+// initFromMetadata initializes img from the metadata cache, it returns
+// false if no valid cache entry was found for the image in which case
+// img.File must be closed by the caller. Only read-only file images
+// are looked up.
+func initFromMetadata(img *Image) (bool, error) {
+	dir := metadataCacheDir()
+	if dir == "" {
+		return false, nil
+	}
+
+	fi, err := img.File.Stat()
+	if err != nil {
+		return false, err
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !ok || !fi.Mode().IsRegular() {
+		return false, nil
+	}
+
+	b, err := ioutil.ReadFile(metadataPath(dir, st))
+	if err != nil {
+		return false, nil
+	}
+	m := new(metadata)
+	if err := json.Unmarshal(b, m); err != nil || !m.matches(st) || !m.valid() {
+		return false, nil
+	}
+
+	if m.Type == SIF {
+		if err := checkArch(m.Arch); err != nil {
+			return false, err
+		}
+	}
+
+	img.Type = m.Type
+	img.Partitions = m.Partitions
+	img.Sections = m.Sections
+
+	return true, nil
+}
+
+// storeMetadata stores the format detection result of img in the
+// metadata cache, this is best-effort.
+func storeMetadata(img *Image, fi os.FileInfo) {
+	dir := metadataCacheDir()
+	if dir == "" {
+		return
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !ok || !fi.Mode().IsRegular() {
+		return
+	}
+
+	m := &metadata{
+		Version:    metadataVersion,
+		Device:     uint64(st.Dev),
+		Inode:      st.Ino,
+		Size:       st.Size,
+		Mtime:      st.Mtim.Nano(),
+		Ctime:      st.Ctim.Nano(),
+		Type:       img.Type,
+		Arch:       img.arch,
+		Partitions: img.Partitions,
+		Sections:   img.Sections,
+	}
+	b, err := json.Marshal(m)
+	if err != nil {
+		return
+	}
+
+	if err := cache.WriteDataFile(metadataPath(dir, st), b); err != nil {
+		sylog.Debugf("Could not store image metadata cache entry: %s", err)
+	}
+}
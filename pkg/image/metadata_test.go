@@ -0,0 +1,142 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package image
+
+import (
+	"encoding/json"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"syscall"
+	"testing"
+	"time"
+
+	"github.com/sylabs/singularity/internal/pkg/client/cache"
+)
+
+func TestMetadataCache(t *testing.T) {
+	dir, err := ioutil.TempDir("", "metadata-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	defer os.Setenv(cache.DirEnv, os.Getenv(cache.DirEnv))
+	os.Setenv(cache.DirEnv, dir)
+
+	data, err := ioutil.ReadFile(testSquash)
+	if err != nil {
+		t.Fatal(err)
+	}
+	path := filepath.Join(dir, "image.sqfs")
+	if err := ioutil.WriteFile(path, data, 0644); err != nil {
+		t.Fatal(err)
+	}
+
+	img, err := Init(path, false)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	img.File.Close()
+
+	fi, err := os.Stat(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	entry := metadataPath(filepath.Join(dir, cache.CacheDir, metadataDir), fi.Sys().(*syscall.Stat_t))
+
+	b, err := ioutil.ReadFile(entry)
+	if err != nil {
+		t.Fatalf("image metadata not cached: %s", err)
+	}
+	m := new(metadata)
+	if err := json.Unmarshal(b, m); err != nil {
+		t.Fatal(err)
+	}
+	if m.Type != SQUASHFS || len(m.Partitions) != 1 || m.Partitions[0] != img.Partitions[0] {
+		t.Fatalf("unexpected cached metadata: %+v", m)
+	}
+
+	// mark the cache entry to check that it's used
+	m.Partitions[0].Name = "cached"
+	b, _ = json.Marshal(m)
+	if err := ioutil.WriteFile(entry, b, 0600); err != nil {
+		t.Fatal(err)
+	}
+
+	img, err = Init(path, false)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	img.File.Close()
+	if img.Partitions[0].Name != "cached" || img.Type != SQUASHFS || img.Fd == 0 {
+		t.Errorf("metadata cache not used: %+v", img)
+	}
+
+	// writable images don't use the cache and go through the
+	// squashfs format check
+	if _, err := Init(path, true); err == nil {
+		t.Errorf("metadata cache used for writable image")
+	}
+
+	// a modified image invalidates the cache entry
+	mtime := time.Now().Add(time.Hour)
+	if err := os.Chtimes(path, mtime, mtime); err != nil {
+		t.Fatal(err)
+	}
+	img, err = Init(path, false)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	img.File.Close()
+	if img.Partitions[0].Name != RootFs {
+		t.Errorf("stale metadata cache entry used")
+	}
+
+	// partitions outside of the image are ignored
+	if b, err = ioutil.ReadFile(entry); err != nil {
+		t.Fatal(err)
+	}
+	if err := json.Unmarshal(b, m); err != nil {
+		t.Fatal(err)
+	}
+	m.Partitions[0].Name = "cached"
+	m.Partitions[0].Offset = uint64(len(data))
+	b, _ = json.Marshal(m)
+	if err := ioutil.WriteFile(entry, b, 0600); err != nil {
+		t.Fatal(err)
+	}
+	img, err = Init(path, false)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	img.File.Close()
+	if img.Partitions[0].Name != RootFs {
+		t.Errorf("invalid metadata cache entry used")
+	}
+
+	// entries with another format version are ignored
+	if b, err = ioutil.ReadFile(entry); err != nil {
+		t.Fatal(err)
+	}
+	if err := json.Unmarshal(b, m); err != nil {
+		t.Fatal(err)
+	}
+	m.Version = 0
+	m.Partitions[0].Name = "cached"
+	b, _ = json.Marshal(m)
+	if err := ioutil.WriteFile(entry, b, 0600); err != nil {
+		t.Fatal(err)
+	}
+	img, err = Init(path, false)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	img.File.Close()
+	if img.Partitions[0].Name != RootFs {
+		t.Errorf("metadata cache entry of another version used")
+	}
+}
@@ -0,0 +1,827 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package packer
+
+import (
+	"archive/tar"
+	"bufio"
+	"bytes"
+	"compress/gzip"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
+	"path"
+	"path/filepath"
+	"runtime"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+)
+
+const (
+	// whiteoutPrefix marks an entry removed from lower layers.
+	whiteoutPrefix = ".wh."
+	// opaqueWhiteout marks a directory whose lower layers content
+	// is hidden.
+	opaqueWhiteout = ".wh..wh..opq"
+)
+
+const (
+	// prefetchChunkSize is the size of the uncompressed layer chunks
+	// read ahead of the tar stream consumer.
+	prefetchChunkSize = 1 << 20
+	// prefetchChunks is the number of chunks read ahead per layer.
+	prefetchChunks = 16
+)
+
+var (
+	gzipMagic = []byte{0x1f, 0x8b}
+	zstdMagic = []byte{0x28, 0xb5, 0x2f, 0xfd}
+)
+
+// layerNode is an entry of the merged layers tree, it references the
+// layer entry providing it.
+type layerNode struct {
+	// hdr is the layer entry header, nil for directories
+	// implicitly created by their entries.
+	hdr *tar.Header
+	// layer and index identify the providing layer entry.
+	layer int
+	index int
+	// src is the path of entries provided by the root filesystem.
+	src      string
+	children map[string]*layerNode
+}
+
+func (n *layerNode) isDir() bool {
+	return n.hdr == nil || n.hdr.Typeflag == tar.TypeDir
+}
+
+// before returns if n is provided by an entry preceding m in the
+// layer streams.
+func (n *layerNode) before(m *layerNode) bool {
+	return n.layer < m.layer || (n.layer == m.layer && n.index < m.index)
+}
+
+// treeEntry is a node of the merged layers tree and its path.
+type treeEntry struct {
+	path string
+	node *layerNode
+}
+
+// Layers is a merged view of OCI image layers, indexed in memory
+// without extracting them. Entries removed by whiteouts or replaced by
+// upper layers are left out, so that the layers can be converted to a
+// squashfs image by streaming the remaining entries to mksquashfs.
+type Layers struct {
+	// Arch is the image architecture, as the image root filesystem
+	// isn't available to detect it.
+	Arch string
+	// FixPerms gives owner rwX permissions to directories and rw
+	// permissions to files, like the build --fix-perms option.
+	FixPerms bool
+	// Rootless replaces device nodes by empty files, like layers
+	// unpacked as a user.
+	Rootless bool
+	// Digests are the layer digests, bottom layer first.
+	Digests []string
+
+	paths []string
+	root  *layerNode
+	links []treeEntry
+	local []treeEntry
+	// deps is the lowest layer each layer removes, replaces with
+	// another type or hard links entries from, the layer itself if
+	// none.
+	deps []int
+}
+
+// cleanName returns a layer entry name relative to the image root,
+// the root itself being an empty string.
+func cleanName(name string) string {
+	return path.Clean("/" + name)[1:]
+}
+
+// layerReader returns a reader of the uncompressed layer tar stream.
+func layerReader(r io.Reader) (io.Reader, error) {
+	br := bufio.NewReader(r)
+	magic, err := br.Peek(4)
+	if err != nil && err != io.EOF {
+		return nil, err
+	}
+	switch {
+	case bytes.HasPrefix(magic, gzipMagic):
+		return gzip.NewReader(br)
+	case bytes.HasPrefix(magic, zstdMagic):
+		return nil, fmt.Errorf("zstd compressed layers are not supported")
+	}
+	return br, nil
+}
+
+// prefetchReader reads ahead from r in its own goroutine, so that the
+// layer decompression runs concurrently with the processing of its tar
+// entries, up to a bounded number of chunks ahead.
+type prefetchReader struct {
+	chunks chan []byte
+	done   chan struct{}
+	once   sync.Once
+	cur    []byte
+	// err is set before chunks is closed
+	err error
+}
+
+func newPrefetchReader(r io.Reader, chunks int) *prefetchReader {
+	p := &prefetchReader{
+		chunks: make(chan []byte, chunks),
+		done:   make(chan struct{}),
+	}
+	go func() {
+		defer close(p.chunks)
+		for {
+			buf := make([]byte, prefetchChunkSize)
+			n, err := readChunk(r, buf)
+			if n > 0 {
+				select {
+				case p.chunks <- buf[:n]:
+				case <-p.done:
+					p.err = io.ErrClosedPipe
+					return
+				}
+			}
+			if err != nil {
+				p.err = err
+				return
+			}
+		}
+	}()
+	return p
+}
+
+// readChunk fills buf from r unless an error occurs, unlike io.ReadFull
+// the error returned by r is kept as is.
+func readChunk(r io.Reader, buf []byte) (int, error) {
+	n := 0
+	for n < len(buf) {
+		nn, err := r.Read(buf[n:])
+		n += nn
+		if err != nil {
+			return n, err
+		}
+	}
+	return n, nil
+}
+
+func (p *prefetchReader) Read(b []byte) (int, error) {
+	for len(p.cur) == 0 {
+		c, ok := <-p.chunks
+		if !ok {
+			return 0, p.err
+		}
+		p.cur = c
+	}
+	n := copy(b, p.cur)
+	p.cur = p.cur[n:]
+	return n, nil
+}
+
+// Close stops reading ahead, it doesn't close the underlying reader.
+func (p *prefetchReader) Close() error {
+	p.once.Do(func() { close(p.done) })
+	return nil
+}
+
+// layerStream is an uncompressed layer tar stream read ahead.
+type layerStream struct {
+	*prefetchReader
+	f *os.File
+}
+
+// openLayer starts reading ahead the uncompressed tar stream of the
+// layer at path.
+func openLayer(path string) (*layerStream, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	r, err := layerReader(f)
+	if err != nil {
+		f.Close()
+		return nil, fmt.Errorf("while reading layer %s: %s", path, err)
+	}
+	return &layerStream{newPrefetchReader(r, prefetchChunks), f}, nil
+}
+
+func (s *layerStream) Close() error {
+	s.prefetchReader.Close()
+	return s.f.Close()
+}
+
+// readHeaders returns the entry headers of the layer at path.
+func readHeaders(path string) ([]*tar.Header, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+
+	r, err := layerReader(f)
+	if err != nil {
+		return nil, fmt.Errorf("while reading layer %s: %s", path, err)
+	}
+
+	var hdrs []*tar.Header
+
+	tr := tar.NewReader(r)
+	for {
+		hdr, err := tr.Next()
+		if err == io.EOF {
+			return hdrs, nil
+		} else if err != nil {
+			return nil, fmt.Errorf("while reading layer %s: %s", path, err)
+		}
+		hdrs = append(hdrs, hdr)
+	}
+}
+
+// NewLayers indexes the layers at paths, bottom layer first. The
+// layers are read in parallel and applied in order. An error is
+// returned for layers which can't be streamed, the caller is expected
+// to unpack them instead.
+func NewLayers(paths []string) (*Layers, error) {
+	hdrs := make([][]*tar.Header, len(paths))
+	errs := make([]error, len(paths))
+
+	var wg sync.WaitGroup
+	sem := make(chan struct{}, runtime.NumCPU())
+
+	for i, p := range paths {
+		wg.Add(1)
+		go func(i int, p string) {
+			defer wg.Done()
+			sem <- struct{}{}
+			hdrs[i], errs[i] = readHeaders(p)
+			<-sem
+		}(i, p)
+	}
+	wg.Wait()
+
+	l := &Layers{
+		paths: paths,
+		root:  &layerNode{layer: -1, children: make(map[string]*layerNode)},
+		deps:  make([]int, len(paths)),
+	}
+
+	for i := range paths {
+		if errs[i] != nil {
+			return nil, errs[i]
+		}
+		l.deps[i] = i
+		for j, hdr := range hdrs[i] {
+			if err := l.apply(i, j, hdr); err != nil {
+				return nil, fmt.Errorf("while applying layer %s: %s", paths[i], err)
+			}
+		}
+		// release headers as they are applied
+		hdrs[i] = nil
+	}
+
+	if err := l.checkLinks(); err != nil {
+		return nil, err
+	}
+	return l, nil
+}
+
+// lookup returns the node of the entry name, or nil if there is none.
+func (l *Layers) lookup(name string) *layerNode {
+	n := l.root
+	if name == "" {
+		return n
+	}
+	for _, c := range strings.Split(name, "/") {
+		if !n.isDir() {
+			return nil
+		}
+		if n = n.children[c]; n == nil {
+			return nil
+		}
+	}
+	return n
+}
+
+// Exists returns if the merged layers contain an entry at path,
+// relative to the image root.
+func (l *Layers) Exists(path string) bool {
+	return l.lookup(cleanName(path)) != nil
+}
+
+// mkdirAll returns the directory node dir, creating the missing
+// directories as implicit directories of layer.
+func (l *Layers) mkdirAll(dir string, layer int) (*layerNode, error) {
+	n := l.root
+	if dir == "" {
+		return n, nil
+	}
+	for _, c := range strings.Split(dir, "/") {
+		child := n.children[c]
+		if child == nil {
+			child = &layerNode{layer: layer, children: make(map[string]*layerNode)}
+			n.children[c] = child
+		} else if !child.isDir() {
+			return nil, fmt.Errorf("%s is not a directory", dir)
+		}
+		n = child
+	}
+	return n, nil
+}
+
+// lowest returns the lowest layer providing n or its entries.
+func lowest(n *layerNode) int {
+	layer := n.layer
+	for _, child := range n.children {
+		if l := lowest(child); l < layer {
+			layer = l
+		}
+	}
+	return layer
+}
+
+// hideLower removes the entries below n provided by layers lower
+// than layer, and returns the lowest layer of removed entries.
+func hideLower(n *layerNode, layer int) int {
+	dep := layer
+	for c, child := range n.children {
+		if child.layer < layer {
+			if l := lowest(child); l < dep {
+				dep = l
+			}
+			delete(n.children, c)
+		} else if child.isDir() {
+			if l := hideLower(child, layer); l < dep {
+				dep = l
+			}
+		}
+	}
+	return dep
+}
+
+// depend records that layer depends on entries of layer dep.
+func (l *Layers) depend(layer, dep int) {
+	if dep < l.deps[layer] {
+		l.deps[layer] = dep
+	}
+}
+
+// apply applies the entry index of layer to the merged layers tree.
+func (l *Layers) apply(layer, index int, hdr *tar.Header) error {
+	name := cleanName(hdr.Name)
+	if name == "" {
+		return nil
+	}
+	dir, base := path.Split(name)
+	dir = strings.TrimSuffix(dir, "/")
+
+	if base == opaqueWhiteout {
+		if n := l.lookup(dir); n != nil && n.isDir() {
+			l.depend(layer, hideLower(n, layer))
+		}
+		return nil
+	} else if strings.HasPrefix(base, whiteoutPrefix) {
+		if n := l.lookup(dir); n != nil && n.isDir() {
+			name := strings.TrimPrefix(base, whiteoutPrefix)
+			if child := n.children[name]; child != nil {
+				l.depend(layer, lowest(child))
+				delete(n.children, name)
+			}
+		}
+		return nil
+	}
+
+	switch hdr.Typeflag {
+	case tar.TypeReg, tar.TypeRegA, tar.TypeLink, tar.TypeSymlink,
+		tar.TypeChar, tar.TypeBlock, tar.TypeFifo, tar.TypeDir:
+	default:
+		return fmt.Errorf("unsupported type %q for entry %s", hdr.Typeflag, hdr.Name)
+	}
+
+	parent, err := l.mkdirAll(dir, layer)
+	if err != nil {
+		return err
+	}
+
+	n := parent.children[base]
+	if hdr.Typeflag == tar.TypeDir && n != nil && n.isDir() {
+		// directory attributes are updated, content is kept
+		n.hdr, n.layer, n.index = hdr, layer, index
+		return nil
+	}
+
+	if n != nil && (n.isDir() || hdr.Typeflag == tar.TypeDir) {
+		// a directory replaced by or replacing another type
+		l.depend(layer, lowest(n))
+	}
+
+	n = &layerNode{hdr: hdr, layer: layer, index: index}
+	if hdr.Typeflag == tar.TypeDir {
+		n.children = make(map[string]*layerNode)
+	} else if hdr.Typeflag == tar.TypeLink {
+		hdr.Linkname = cleanName(hdr.Linkname)
+		l.links = append(l.links, treeEntry{path: name, node: n})
+		if target := l.lookup(hdr.Linkname); target != nil {
+			l.depend(layer, target.layer)
+		}
+	}
+	parent.children[base] = n
+
+	return nil
+}
+
+// Len returns the number of layers.
+func (l *Layers) Len() int {
+	return len(l.paths)
+}
+
+// Groups splits the layers into groups of consecutive layers which can
+// be stacked as overlay lower directories, each group being converted
+// on its own. A layer removing entries of lower layers, replacing them
+// with another type or hard linking them is grouped with those layers.
+// Groups are returned as the index of their first layer.
+func (l *Layers) Groups() []int {
+	var starts []int
+	for i, dep := range l.deps {
+		// merge the groups holding the entries the layer depends on
+		for len(starts) > 0 && starts[len(starts)-1] > dep {
+			starts = starts[:len(starts)-1]
+		}
+		if dep == i {
+			starts = append(starts, i)
+		}
+	}
+	return starts
+}
+
+// Group returns the merged layers from start to end excluded.
+func (l *Layers) Group(start, end int) (*Layers, error) {
+	g, err := NewLayers(l.paths[start:end])
+	if err != nil {
+		return nil, err
+	}
+	g.Arch = l.Arch
+	g.FixPerms = l.FixPerms
+	g.Rootless = l.Rootless
+	if len(l.Digests) == len(l.paths) {
+		g.Digests = l.Digests[start:end]
+	}
+	return g, nil
+}
+
+// checkLinks checks that hard link targets are streamed before their
+// links. Targets removed or replaced by an upper layer are not
+// supported.
+func (l *Layers) checkLinks() error {
+	for _, link := range l.links {
+		if l.lookup(link.path) != link.node {
+			continue
+		}
+		target := l.lookup(link.node.hdr.Linkname)
+		if target == nil || target.isDir() || !target.before(link.node) {
+			return fmt.Errorf("hard link %s target %s replaced by an upper layer", link.path, link.node.hdr.Linkname)
+		}
+	}
+	return nil
+}
+
+// addRootfs adds the entries of the root filesystem directory rootfs
+// over the layers, like files written in the unpacked layers. Files
+// replace layer entries, directories and symbolic links are only added
+// when missing, as done by the base environment setup.
+func (l *Layers) addRootfs(rootfs string) error {
+	layer := len(l.paths)
+	index := 0
+
+	err := filepath.Walk(rootfs, func(p string, fi os.FileInfo, err error) error {
+		if err != nil {
+			return err
+		}
+		rel, err := filepath.Rel(rootfs, p)
+		if err != nil {
+			return err
+		}
+		name := cleanName(filepath.ToSlash(rel))
+		if name == "" {
+			return nil
+		}
+		index++
+
+		link := ""
+		if fi.Mode()&os.ModeSymlink != 0 {
+			if link, err = os.Readlink(p); err != nil {
+				return err
+			}
+		}
+		hdr, err := tar.FileInfoHeader(fi, link)
+		if err != nil {
+			return err
+		}
+
+		dir, base := path.Split(name)
+		parent, err := l.mkdirAll(strings.TrimSuffix(dir, "/"), layer)
+		if err != nil {
+			return err
+		}
+		n := parent.children[base]
+
+		switch {
+		case n == nil:
+		case hdr.Typeflag == tar.TypeSymlink:
+			return nil
+		case fi.IsDir() && n.isDir():
+			return nil
+		case fi.IsDir():
+			// an empty directory is skipped like an existing
+			// path when created
+			if entries, _ := ioutil.ReadDir(p); len(entries) == 0 {
+				return filepath.SkipDir
+			}
+			return fmt.Errorf("%s conflicts with an image entry of a different type", name)
+		case n.isDir():
+			return fmt.Errorf("%s conflicts with an image directory", name)
+		}
+
+		n = &layerNode{hdr: hdr, layer: layer, index: index, src: p}
+		if fi.IsDir() {
+			n.children = make(map[string]*layerNode)
+		}
+		l.local = append(l.local, treeEntry{path: name, node: n})
+		parent.children[base] = n
+		return nil
+	})
+	if err != nil {
+		return fmt.Errorf("while adding %s to image layers: %s", rootfs, err)
+	}
+
+	return l.checkLinks()
+}
+
+// header returns the header written for node n at name.
+func (l *Layers) header(name string, n *layerNode, now time.Time) *tar.Header {
+	if n.hdr == nil {
+		return &tar.Header{
+			Typeflag: tar.TypeDir,
+			Name:     name + "/",
+			Mode:     0755,
+			ModTime:  now,
+		}
+	}
+
+	hdr := *n.hdr
+	hdr.Name = name
+	// let the writer choose the format of the modified header, and
+	// force numeric ownership
+	hdr.Format = tar.FormatUnknown
+	hdr.Uname, hdr.Gname = "", ""
+
+	switch hdr.Typeflag {
+	case tar.TypeDir:
+		hdr.Name += "/"
+		if l.FixPerms {
+			hdr.Mode |= 0700
+		}
+	case tar.TypeReg, tar.TypeRegA:
+		if l.FixPerms {
+			hdr.Mode |= 0600
+		}
+	case tar.TypeChar, tar.TypeBlock:
+		if l.Rootless {
+			hdr.Typeflag = tar.TypeReg
+			hdr.Devmajor, hdr.Devminor = 0, 0
+			hdr.Size = 0
+			if l.FixPerms {
+				hdr.Mode |= 0600
+			}
+		}
+	}
+	return &hdr
+}
+
+// writeDirs writes the directory entries of the merged layers tree
+// below n, parents first.
+func (l *Layers) writeDirs(tw *tar.Writer, dir string, n *layerNode, now time.Time) error {
+	names := make([]string, 0, len(n.children))
+	for c, child := range n.children {
+		if child.isDir() {
+			names = append(names, c)
+		}
+	}
+	sort.Strings(names)
+
+	for _, c := range names {
+		name := path.Join(dir, c)
+		child := n.children[c]
+		if err := tw.WriteHeader(l.header(name, child, now)); err != nil {
+			return err
+		}
+		if err := l.writeDirs(tw, name, child, now); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// writeLayer writes the entries of layer remaining in the merged
+// layers, except directories already written, r being the layer
+// uncompressed tar stream.
+func (l *Layers) writeLayer(tw *tar.Writer, layer int, r io.Reader) error {
+	tr := tar.NewReader(r)
+	for index := 0; ; index++ {
+		hdr, err := tr.Next()
+		if err == io.EOF {
+			return nil
+		} else if err != nil {
+			return fmt.Errorf("while reading layer %s: %s", l.paths[layer], err)
+		}
+
+		name := cleanName(hdr.Name)
+		n := l.lookup(name)
+		if n == nil || n.isDir() || n.layer != layer || n.index != index {
+			continue
+		}
+
+		h := l.header(name, n, time.Time{})
+		if err := tw.WriteHeader(h); err != nil {
+			return err
+		}
+		if h.Typeflag == tar.TypeReg || h.Typeflag == tar.TypeRegA {
+			if _, err := io.CopyN(tw, tr, h.Size); err != nil {
+				return fmt.Errorf("while copying %s from layer %s: %s", name, l.paths[layer], err)
+			}
+		}
+	}
+}
+
+// writeLocal writes the root filesystem entry e.
+func (l *Layers) writeLocal(tw *tar.Writer, e treeEntry, now time.Time) error {
+	h := l.header(e.path, e.node, now)
+	if err := tw.WriteHeader(h); err != nil {
+		return err
+	}
+	if h.Typeflag != tar.TypeReg {
+		return nil
+	}
+	f, err := os.Open(e.node.src)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+
+	if _, err := io.CopyN(tw, f, h.Size); err != nil {
+		return fmt.Errorf("while copying %s: %s", e.node.src, err)
+	}
+	return nil
+}
+
+// writeTar writes the merged layers as a single tar stream. All
+// directories are written first, so that entries are never written
+// below a directory before its final attributes are known, then each
+// layer is read again in order to write its remaining entries. Layers
+// are decompressed ahead, the next one while the current one is written.
+func (l *Layers) writeTar(w io.Writer) error {
+	tw := tar.NewWriter(w)
+	now := time.Now()
+
+	if err := l.writeDirs(tw, "", l.root, now); err != nil {
+		return err
+	}
+
+	streams := make([]*layerStream, len(l.paths))
+	defer func() {
+		for _, s := range streams {
+			if s != nil {
+				s.Close()
+			}
+		}
+	}()
+
+	for i := range l.paths {
+		for j := i; j < len(l.paths) && j <= i+1; j++ {
+			if streams[j] != nil {
+				continue
+			}
+			s, err := openLayer(l.paths[j])
+			if err != nil {
+				return err
+			}
+			streams[j] = s
+		}
+		if err := l.writeLayer(tw, i, streams[i]); err != nil {
+			return err
+		}
+		streams[i].Close()
+		streams[i] = nil
+	}
+
+	for _, e := range l.local {
+		if e.node.isDir() || l.lookup(e.path) != e.node {
+			continue
+		}
+		if err := l.writeLocal(tw, e, now); err != nil {
+			return err
+		}
+	}
+
+	return tw.Close()
+}
+
+// writeRootfsTar writes the root filesystem entries remaining over the
+// layers as a tar stream, along with their parent directories which
+// keep the attributes of the layers directories.
+func (l *Layers) writeRootfsTar(w io.Writer) error {
+	tw := tar.NewWriter(w)
+	now := time.Now()
+
+	dirs := make(map[string]bool)
+	var entries []treeEntry
+
+	for _, e := range l.local {
+		if l.lookup(e.path) != e.node {
+			continue
+		}
+		for d := path.Dir(e.path); d != "."; d = path.Dir(d) {
+			dirs[d] = true
+		}
+		if e.node.isDir() {
+			dirs[e.path] = true
+		} else {
+			entries = append(entries, e)
+		}
+	}
+
+	names := make([]string, 0, len(dirs))
+	for d := range dirs {
+		names = append(names, d)
+	}
+	// parent directories sort first
+	sort.Strings(names)
+
+	for _, name := range names {
+		if err := tw.WriteHeader(l.header(name, l.lookup(name), now)); err != nil {
+			return err
+		}
+	}
+	for _, e := range entries {
+		if err := l.writeLocal(tw, e, now); err != nil {
+			return err
+		}
+	}
+
+	return tw.Close()
+}
+
+// createFromTar pipes the tar stream written by write to mksquashfs,
+// which must support the -tar option.
+func (s Squashfs) createFromTar(write func(io.Writer) error, dest string, opts []string) error {
+	pr, pw := io.Pipe()
+	errc := make(chan error, 1)
+
+	go func() {
+		err := write(pw)
+		pw.CloseWithError(err)
+		errc <- err
+	}()
+
+	// mksquashfs takes args of the form: - destination [options] -tar
+	err := s.create([]string{"-"}, dest, append(opts, "-tar"), pr)
+	// unblock the writer if mksquashfs exited early
+	pr.Close()
+
+	if werr := <-errc; werr != nil && werr != io.ErrClosedPipe {
+		return fmt.Errorf("while streaming image layers: %s", werr)
+	}
+	return err
+}
+
+// CreateFromLayers makes a squashfs filesystem from the merged image
+// layers and the entries of the root filesystem directory rootfs, if
+// any, the resulting tar stream is piped to mksquashfs.
+func (s Squashfs) CreateFromLayers(l *Layers, rootfs string, dest string, opts []string) error {
+	if rootfs != "" {
+		if err := l.addRootfs(rootfs); err != nil {
+			return err
+		}
+	}
+	return s.createFromTar(l.writeTar, dest, opts)
+}
+
+// CreateRootfsLayer makes a squashfs filesystem from the entries of the
+// root filesystem directory rootfs added over the image layers, to be
+// stacked over the squashfs filesystems of the layer groups.
+func (s Squashfs) CreateRootfsLayer(l *Layers, rootfs string, dest string, opts []string) error {
+	if err := l.addRootfs(rootfs); err != nil {
+		return err
+	}
+	return s.createFromTar(l.writeRootfsTar, dest, opts)
+}
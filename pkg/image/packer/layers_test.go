@@ -0,0 +1,377 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package packer
+
+import (
+	"archive/tar"
+	"bytes"
+	"compress/gzip"
+	"errors"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"reflect"
+	"testing"
+)
+
+type layerEntry struct {
+	name     string
+	typeflag byte
+	mode     int64
+	content  string
+	linkname string
+}
+
+func createLayer(t *testing.T, path string, compressed bool, entries []layerEntry) {
+	f, err := os.Create(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer f.Close()
+
+	var w io.Writer = f
+	if compressed {
+		gw := gzip.NewWriter(f)
+		defer gw.Close()
+		w = gw
+	}
+
+	tw := tar.NewWriter(w)
+	defer tw.Close()
+
+	for _, e := range entries {
+		hdr := &tar.Header{
+			Name:     e.name,
+			Typeflag: e.typeflag,
+			Mode:     e.mode,
+			Linkname: e.linkname,
+			Size:     int64(len(e.content)),
+		}
+		if err := tw.WriteHeader(hdr); err != nil {
+			t.Fatal(err)
+		}
+		if _, err := tw.Write([]byte(e.content)); err != nil {
+			t.Fatal(err)
+		}
+	}
+}
+
+func TestLayers(t *testing.T) {
+	dir, err := ioutil.TempDir("", "layers-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	layers := []string{filepath.Join(dir, "layer0"), filepath.Join(dir, "layer1")}
+
+	createLayer(t, layers[0], true, []layerEntry{
+		{name: "./", typeflag: tar.TypeDir, mode: 0755},
+		{name: "./etc/", typeflag: tar.TypeDir, mode: 0755},
+		{name: "./etc/hosts", typeflag: tar.TypeReg, mode: 0644, content: "layer0"},
+		{name: "./opt/", typeflag: tar.TypeDir, mode: 0755},
+		{name: "./opt/a", typeflag: tar.TypeReg, mode: 0644, content: "a"},
+		{name: "./opt/b/", typeflag: tar.TypeDir, mode: 0755},
+		{name: "./opt/b/c", typeflag: tar.TypeReg, mode: 0644, content: "c"},
+		{name: "./usr/", typeflag: tar.TypeDir, mode: 0755},
+		{name: "./usr/bin/", typeflag: tar.TypeDir, mode: 0555},
+		{name: "./usr/bin/sh", typeflag: tar.TypeReg, mode: 0755, content: "sh"},
+		{name: "./usr/bin/bash", typeflag: tar.TypeLink, linkname: "./usr/bin/sh"},
+		{name: "var/log/x", typeflag: tar.TypeReg, mode: 0400, content: "x"},
+	})
+	createLayer(t, layers[1], false, []layerEntry{
+		{name: "etc/passwd", typeflag: tar.TypeReg, mode: 0644, content: "passwd"},
+		{name: "opt/", typeflag: tar.TypeDir, mode: 0700},
+		{name: "opt/.wh..wh..opq", typeflag: tar.TypeReg},
+		{name: "opt/d", typeflag: tar.TypeReg, mode: 0644, content: "d"},
+		{name: "var/log/.wh.x", typeflag: tar.TypeReg},
+		{name: "etc/hosts", typeflag: tar.TypeReg, mode: 0644, content: "layer1"},
+	})
+
+	l, err := NewLayers(layers)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	l.FixPerms = true
+
+	for path, exists := range map[string]bool{"opt/d": true, "/opt/a": false, "opt/b/c": false, "var/log": true, "var/log/x": false} {
+		if l.Exists(path) != exists {
+			t.Errorf("unexpected %s existence", path)
+		}
+	}
+
+	// files written in the bundle root filesystem
+	rootfs := filepath.Join(dir, "rootfs")
+	for _, d := range []string{".singularity.d", "etc", "var/log"} {
+		if err := os.MkdirAll(filepath.Join(rootfs, d), 0755); err != nil {
+			t.Fatal(err)
+		}
+	}
+	for _, f := range []string{".singularity.d/runscript", "etc/hosts"} {
+		if err := ioutil.WriteFile(filepath.Join(rootfs, f), []byte("rootfs"), 0644); err != nil {
+			t.Fatal(err)
+		}
+	}
+	if err := os.Symlink(".singularity.d/runscript", filepath.Join(rootfs, "singularity")); err != nil {
+		t.Fatal(err)
+	}
+
+	if err := l.addRootfs(rootfs); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+
+	var buf bytes.Buffer
+	if err := l.writeTar(&buf); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+
+	var names []string
+	contents := make(map[string]string)
+	modes := make(map[string]int64)
+
+	tr := tar.NewReader(&buf)
+	for {
+		hdr, err := tr.Next()
+		if err == io.EOF {
+			break
+		} else if err != nil {
+			t.Fatal(err)
+		}
+		names = append(names, hdr.Name)
+		b, _ := ioutil.ReadAll(tr)
+		contents[hdr.Name] = string(b)
+		modes[hdr.Name] = hdr.Mode
+		if hdr.Typeflag == tar.TypeLink && hdr.Linkname != "usr/bin/sh" {
+			t.Errorf("unexpected hard link target %s", hdr.Linkname)
+		}
+	}
+
+	expected := []string{
+		".singularity.d/", "etc/", "opt/", "usr/", "usr/bin/", "var/", "var/log/",
+		"usr/bin/sh", "usr/bin/bash",
+		"etc/passwd", "opt/d",
+		".singularity.d/runscript", "etc/hosts", "singularity",
+	}
+	if !reflect.DeepEqual(names, expected) {
+		t.Errorf("unexpected entries %v instead of %v", names, expected)
+	}
+	if contents["etc/hosts"] != "rootfs" || contents["usr/bin/sh"] != "sh" {
+		t.Errorf("unexpected entry content")
+	}
+	if modes["usr/bin/"] != 0755 || modes["opt/"] != 0700 {
+		t.Errorf("unexpected directory permissions")
+	}
+
+	s := NewSquashfs()
+	if !s.HasMksquashfs() {
+		return
+	}
+	if c, err := s.Capabilities(); err != nil || !c.Tar {
+		return
+	}
+
+	l, err = NewLayers(layers)
+	if err != nil {
+		t.Fatal(err)
+	}
+	dest := filepath.Join(dir, "image.sqfs")
+	if err := s.CreateFromLayers(l, rootfs, dest, []string{"-noappend"}); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	checkArchive(t, dest, []string{"etc/hosts", "etc/passwd", "opt/d", "usr/bin/bash", "singularity"})
+}
+
+func TestLayersReplacedLinkTarget(t *testing.T) {
+	dir, err := ioutil.TempDir("", "layers-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	layers := []string{filepath.Join(dir, "layer0"), filepath.Join(dir, "layer1")}
+
+	createLayer(t, layers[0], true, []layerEntry{
+		{name: "bin/sh", typeflag: tar.TypeReg, mode: 0755, content: "sh"},
+		{name: "bin/bash", typeflag: tar.TypeLink, linkname: "bin/sh"},
+	})
+	createLayer(t, layers[1], true, []layerEntry{
+		{name: "bin/sh", typeflag: tar.TypeSymlink, linkname: "bash"},
+	})
+
+	if _, err := NewLayers(layers); err == nil {
+		t.Errorf("unexpected success with a replaced hard link target")
+	}
+}
+
+func TestLayersGroups(t *testing.T) {
+	dir, err := ioutil.TempDir("", "layers-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	entries := [][]layerEntry{
+		// base layer
+		{
+			{name: "bin/sh", typeflag: tar.TypeReg, mode: 0755, content: "sh"},
+			{name: "etc/hosts", typeflag: tar.TypeReg, mode: 0644},
+		},
+		// only adds or replaces files
+		{
+			{name: "etc/hosts", typeflag: tar.TypeReg, mode: 0644, content: "hosts"},
+			{name: "opt/tool/bin", typeflag: tar.TypeReg, mode: 0755},
+		},
+		// adds a directory
+		{
+			{name: "usr/lib/libc.so", typeflag: tar.TypeReg, mode: 0644},
+		},
+		// removes a file of the second layer
+		{
+			{name: "opt/tool/.wh.bin", typeflag: tar.TypeReg},
+		},
+		// only adds files
+		{
+			{name: "usr/lib/libm.so", typeflag: tar.TypeReg, mode: 0644},
+		},
+		// replaces the directory of the third and fifth layers
+		// with a symbolic link
+		{
+			{name: "usr/lib", typeflag: tar.TypeSymlink, linkname: "lib64"},
+		},
+		// hard links a file of the base layer
+		{
+			{name: "bin/bash", typeflag: tar.TypeLink, linkname: "bin/sh"},
+		},
+	}
+
+	layers := make([]string, len(entries))
+	for i, e := range entries {
+		layers[i] = filepath.Join(dir, fmt.Sprintf("layer%d", i))
+		createLayer(t, layers[i], true, e)
+	}
+
+	l, err := NewLayers(layers[:6])
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	// the fourth layer is grouped with the second and the third one,
+	// the sixth layer removes usr/lib from the third layer
+	if groups := l.Groups(); !reflect.DeepEqual(groups, []int{0, 1}) {
+		t.Errorf("unexpected groups %v", groups)
+	}
+
+	l, err = NewLayers(layers[:5])
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if groups := l.Groups(); !reflect.DeepEqual(groups, []int{0, 1, 4}) {
+		t.Errorf("unexpected groups %v", groups)
+	}
+
+	l, err = NewLayers(append(layers[:3:3], layers[6]))
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if groups := l.Groups(); !reflect.DeepEqual(groups, []int{0}) {
+		t.Errorf("unexpected groups %v", groups)
+	}
+
+	g, err := l.Group(1, 3)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if !g.Exists("opt/tool/bin") || g.Exists("bin/sh") {
+		t.Errorf("unexpected group content")
+	}
+
+	// root filesystem entries stacked over the layers keep the
+	// layers directories attributes
+	rootfs := filepath.Join(dir, "rootfs")
+	if err := os.MkdirAll(filepath.Join(rootfs, "etc"), 0700); err != nil {
+		t.Fatal(err)
+	}
+	if err := ioutil.WriteFile(filepath.Join(rootfs, "etc/resolv.conf"), nil, 0644); err != nil {
+		t.Fatal(err)
+	}
+	if err := l.addRootfs(rootfs); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+
+	var buf bytes.Buffer
+	if err := l.writeRootfsTar(&buf); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+
+	var names []string
+	tr := tar.NewReader(&buf)
+	for {
+		hdr, err := tr.Next()
+		if err == io.EOF {
+			break
+		} else if err != nil {
+			t.Fatal(err)
+		}
+		names = append(names, hdr.Name)
+		if hdr.Name == "etc/" && hdr.Mode != 0755 {
+			t.Errorf("unexpected etc directory permissions %o", hdr.Mode)
+		}
+	}
+	if expected := []string{"etc/", "etc/resolv.conf"}; !reflect.DeepEqual(names, expected) {
+		t.Errorf("unexpected entries %v instead of %v", names, expected)
+	}
+}
+
+var errRead = errors.New("read error")
+
+type failingReader struct {
+	r io.Reader
+}
+
+func (f *failingReader) Read(b []byte) (int, error) {
+	n, err := f.r.Read(b)
+	if err == io.EOF {
+		return n, errRead
+	}
+	return n, err
+}
+
+func TestPrefetchReader(t *testing.T) {
+	data := make([]byte, 3*prefetchChunkSize+12345)
+	for i := range data {
+		data[i] = byte(i * 7)
+	}
+
+	p := newPrefetchReader(bytes.NewReader(data), 2)
+	b, err := ioutil.ReadAll(p)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if !bytes.Equal(b, data) {
+		t.Errorf("unexpected prefetched data")
+	}
+
+	// read errors are returned once the data read before is consumed
+	p = newPrefetchReader(&failingReader{io.LimitReader(bytes.NewReader(data), 100)}, 2)
+	b, err = ioutil.ReadAll(p)
+	if err != errRead {
+		t.Errorf("unexpected error: %v", err)
+	}
+	if len(b) != 100 {
+		t.Errorf("unexpected prefetched data length %d", len(b))
+	}
+
+	// closing stops the goroutine blocked on a full buffer
+	p = newPrefetchReader(bytes.NewReader(data), 1)
+	p.Close()
+	p.Close()
+	for range p.chunks {
+	}
+	if p.err != io.ErrClosedPipe && p.err != io.EOF {
+		t.Errorf("unexpected error after close: %v", p.err)
+	}
+}
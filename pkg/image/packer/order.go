@@ -0,0 +1,226 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package packer
+
+import (
+	"bufio"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"strings"
+
+	"github.com/sylabs/singularity/internal/pkg/util/fs"
+)
+
+// maxSortPriority is the highest mksquashfs sort priority, files are
+// written by decreasing priority, the files not listed in the sort file
+// having priority 0.
+const maxSortPriority = 32767
+
+// libDirs are the shared libraries directories looked up for startup
+// files, along with their multiarch subdirectories.
+var libDirs = []string{
+	"/lib",
+	"/lib64",
+	"/usr/lib",
+	"/usr/lib64",
+	"/usr/local/lib",
+	"/usr/local/lib64",
+}
+
+// pythonSkipDirs are the Python standard library directories not
+// imported by the interpreter startup.
+var pythonSkipDirs = map[string]bool{
+	"dist-packages": true,
+	"ensurepip":     true,
+	"idlelib":       true,
+	"lib2to3":       true,
+	"site-packages": true,
+	"test":          true,
+	"tests":         true,
+	"tkinter":       true,
+	"turtledemo":    true,
+}
+
+type startupFiles struct {
+	rootfs string
+	seen   map[string]bool
+	files  []string
+}
+
+// add adds the file path of the container, resolved relative to the root
+// filesystem, if it's a regular file not added yet.
+func (s *startupFiles) add(path string) {
+	path = fs.EvalRelative(path, s.rootfs)
+	if s.seen[path] {
+		return
+	}
+	fi, err := os.Lstat(filepath.Join(s.rootfs, path))
+	if err != nil || !fi.Mode().IsRegular() {
+		return
+	}
+	s.seen[path] = true
+	s.files = append(s.files, path)
+}
+
+// walk adds the regular files found under the container directory dir
+// and accepted by match, directories are skipped when skip returns true.
+func (s *startupFiles) walk(dir string, match func(string) bool, skip func(string) bool) {
+	root := filepath.Join(s.rootfs, fs.EvalRelative(dir, s.rootfs))
+	filepath.Walk(root, func(path string, fi os.FileInfo, err error) error {
+		if err != nil {
+			return nil
+		}
+		if fi.IsDir() {
+			if path != root && skip != nil && skip(fi.Name()) {
+				return filepath.SkipDir
+			}
+			return nil
+		}
+		if match == nil || match(fi.Name()) {
+			s.add(strings.TrimPrefix(path, s.rootfs))
+		}
+		return nil
+	})
+}
+
+// libDirs returns the shared libraries directories of the container,
+// resolved relative to the root filesystem.
+func (s *startupFiles) libDirs() []string {
+	var dirs []string
+	seen := make(map[string]bool)
+	for _, d := range libDirs {
+		d = fs.EvalRelative(d, s.rootfs)
+		if seen[d] {
+			continue
+		}
+		seen[d] = true
+		dirs = append(dirs, d)
+
+		entries, _ := ioutil.ReadDir(filepath.Join(s.rootfs, d))
+		for _, e := range entries {
+			// multiarch directories like x86_64-linux-gnu
+			if e.IsDir() && strings.Contains(e.Name(), "-linux-") {
+				dirs = append(dirs, filepath.Join(d, e.Name()))
+			}
+		}
+	}
+	return dirs
+}
+
+// interpreter returns the interpreter of the script path of the container.
+func (s *startupFiles) interpreter(path string) string {
+	f, err := os.Open(filepath.Join(s.rootfs, fs.EvalRelative(path, s.rootfs)))
+	if err != nil {
+		return ""
+	}
+	defer f.Close()
+
+	line, _ := bufio.NewReader(f).ReadString('\n')
+	if !strings.HasPrefix(line, "#!") {
+		return ""
+	}
+	fields := strings.Fields(line[2:])
+	if len(fields) == 0 {
+		return ""
+	}
+	return fields[0]
+}
+
+func isELFInterpreter(name string) bool {
+	return strings.HasPrefix(name, "ld-linux") || strings.HasPrefix(name, "ld-musl") || strings.HasPrefix(name, "ld64.so")
+}
+
+func isSharedLibrary(name string) bool {
+	return strings.HasSuffix(name, ".so") || strings.Contains(name, ".so.")
+}
+
+func isPythonModule(name string) bool {
+	return strings.HasSuffix(name, ".py") || strings.HasSuffix(name, ".pyc") || strings.HasSuffix(name, ".so")
+}
+
+// StartupFiles returns the files of the root filesystem rootfs most likely
+// read when a container starts, in the order they are expected to be read:
+// the container metadata directory including the runscript, the runscript
+// interpreter and the shell, the ELF interpreters, the shared libraries of
+// the standard libraries directories and the Python standard library.
+// Paths are returned as absolute container paths.
+func StartupFiles(rootfs string) []string {
+	s := &startupFiles{
+		rootfs: rootfs,
+		seen:   make(map[string]bool),
+	}
+
+	s.walk("/.singularity.d", nil, nil)
+	if interp := s.interpreter("/.singularity.d/runscript"); interp != "" {
+		s.add(interp)
+	}
+	s.add("/bin/sh")
+
+	dirs := s.libDirs()
+	for _, d := range dirs {
+		s.walk(d, isELFInterpreter, func(string) bool { return true })
+	}
+	for _, d := range dirs {
+		s.walk(d, isSharedLibrary, func(string) bool { return true })
+	}
+	for _, d := range dirs {
+		matches, _ := filepath.Glob(filepath.Join(s.rootfs, d, "python[23]*"))
+		for _, m := range matches {
+			s.walk(strings.TrimPrefix(m, s.rootfs), isPythonModule, func(name string) bool {
+				return pythonSkipDirs[name]
+			})
+		}
+	}
+
+	return s.files
+}
+
+// CreateSortFile creates the mksquashfs sort file path, ordering the data
+// of files at the start of the filesystem created from the root filesystem
+// rootfs, in the order of files. Files are absolute container paths
+// resolved relative to rootfs, they are listed by host path as mksquashfs
+// matches them by inode. Files which are not regular files, or whose name
+// can't be parsed by mksquashfs, are skipped. It returns the number of
+// files listed.
+func CreateSortFile(path string, rootfs string, files []string) (int, error) {
+	f, err := os.Create(path)
+	if err != nil {
+		return 0, fmt.Errorf("while creating sort file: %s", err)
+	}
+	w := bufio.NewWriter(f)
+
+	n := 0
+	seen := make(map[string]bool)
+	for _, file := range files {
+		host := filepath.Join(rootfs, fs.EvalRelative(file, rootfs))
+		if seen[host] || strings.ContainsAny(host, " \t\n\\") {
+			continue
+		}
+		fi, err := os.Lstat(host)
+		if err != nil || !fi.Mode().IsRegular() {
+			continue
+		}
+		seen[host] = true
+
+		priority := maxSortPriority - n
+		if priority < 1 {
+			priority = 1
+		}
+		fmt.Fprintf(w, "%s %d\n", host, priority)
+		n++
+	}
+
+	if err := w.Flush(); err != nil {
+		f.Close()
+		return 0, fmt.Errorf("while writing sort file: %s", err)
+	}
+	if err := f.Close(); err != nil {
+		return 0, fmt.Errorf("while writing sort file: %s", err)
+	}
+	return n, nil
+}
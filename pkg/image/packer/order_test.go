@@ -0,0 +1,236 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package packer
+
+import (
+	"bytes"
+	"fmt"
+	"io/ioutil"
+	"math/rand"
+	"os"
+	"path/filepath"
+	"reflect"
+	"strings"
+	"testing"
+
+	"golang.org/x/sys/unix"
+)
+
+// createRootfs creates a root filesystem with the files of sizes given
+// by files, filled with random data, and the symbolic links links.
+func createRootfs(t testing.TB, files map[string]int, links map[string]string) string {
+	rootfs, err := ioutil.TempDir("", "rootfs-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	for path, size := range files {
+		path = filepath.Join(rootfs, path)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			t.Fatal(err)
+		}
+		b := make([]byte, size)
+		rand.Read(b)
+		if strings.HasSuffix(path, "runscript") {
+			b = append([]byte("#!/bin/bash\n"), b...)
+		}
+		if err := ioutil.WriteFile(path, b, 0755); err != nil {
+			t.Fatal(err)
+		}
+	}
+	for link, target := range links {
+		link = filepath.Join(rootfs, link)
+		if err := os.MkdirAll(filepath.Dir(link), 0755); err != nil {
+			t.Fatal(err)
+		}
+		if err := os.Symlink(target, link); err != nil {
+			t.Fatal(err)
+		}
+	}
+	return rootfs
+}
+
+func TestStartupFiles(t *testing.T) {
+	rootfs := createRootfs(t, map[string]int{
+		"/.singularity.d/runscript":             10,
+		"/.singularity.d/env/90-environment.sh": 10,
+		"/bin/bash":                             10,
+		"/bin/dash":                             10,
+		"/bin/ls":                               10,
+		"/usr/lib/x86_64-linux-gnu/ld-linux-x86-64.so.2": 10,
+		"/usr/lib/x86_64-linux-gnu/libc.so.6":            10,
+		"/usr/lib/x86_64-linux-gnu/gconv/UTF-16.so":      10,
+		"/usr/lib/libz.so.1.2":                           10,
+		"/usr/lib/python3.8/os.py":                       10,
+		"/usr/lib/python3.8/encodings/utf_8.py":          10,
+		"/usr/lib/python3.8/site-packages/numpy.py":      10,
+		"/usr/lib/python3.8/README.txt":                  10,
+	}, map[string]string{
+		"/bin/sh":          "dash",
+		"/lib":             "usr/lib",
+		"/lib64/ld.so":     "/usr/lib/x86_64-linux-gnu/ld-linux-x86-64.so.2",
+		"/usr/lib/libz.so": "libz.so.1.2",
+	})
+	defer os.RemoveAll(rootfs)
+
+	files := StartupFiles(rootfs)
+	want := []string{
+		"/.singularity.d/env/90-environment.sh",
+		"/.singularity.d/runscript",
+		"/bin/bash",
+		"/bin/dash",
+		"/usr/lib/x86_64-linux-gnu/ld-linux-x86-64.so.2",
+		"/usr/lib/libz.so.1.2",
+		"/usr/lib/x86_64-linux-gnu/libc.so.6",
+		"/usr/lib/python3.8/encodings/utf_8.py",
+		"/usr/lib/python3.8/os.py",
+	}
+	if !reflect.DeepEqual(files, want) {
+		t.Errorf("unexpected startup files %v, want %v", files, want)
+	}
+}
+
+func TestCreateSortFile(t *testing.T) {
+	rootfs := createRootfs(t, map[string]int{
+		"/bin/sh":         10,
+		"/lib/libc.so":    10,
+		"/lib/with space": 10,
+	}, map[string]string{
+		"/lib64": "/lib",
+	})
+	defer os.RemoveAll(rootfs)
+
+	path := filepath.Join(rootfs, "sort")
+	files := []string{"/lib64/libc.so", "/missing", "/lib", "/lib/with space", "/bin/sh", "/lib/libc.so"}
+	n, err := CreateSortFile(path, rootfs, files)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	b, err := ioutil.ReadFile(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	want := fmt.Sprintf("%s/lib/libc.so 32767\n%s/bin/sh 32766\n", rootfs, rootfs)
+	if n != 2 || string(b) != want {
+		t.Errorf("unexpected sort file with %d files:\n%s\nwant:\n%s", n, b, want)
+	}
+}
+
+// extents returns the byte ranges of the image file content of files
+// of the root filesystem rootfs. The image must be created with
+// uncompressed data and without fragments, file data being stored
+// contiguously as is.
+func extents(b *testing.B, image string, rootfs string, files []string) [][2]int64 {
+	data, err := ioutil.ReadFile(image)
+	if err != nil {
+		b.Fatal(err)
+	}
+	var ext [][2]int64
+	for _, f := range files {
+		content, err := ioutil.ReadFile(filepath.Join(rootfs, f))
+		if err != nil {
+			b.Fatal(err)
+		}
+		off := bytes.Index(data, content[:64])
+		if off < 0 {
+			b.Fatalf("%s data not found in image", f)
+		}
+		ext = append(ext, [2]int64{int64(off), int64(off + len(content))})
+	}
+	return ext
+}
+
+// BenchmarkStartupOrder measures the cold reads of the files read at
+// startup from a squashfs image created in directory order and one
+// created in startup order. The image page cache is dropped before each
+// run, the image should be created on the storage to measure with TMPDIR.
+// The seeks metric counts the non contiguous reads.
+func BenchmarkStartupOrder(b *testing.B) {
+	s := NewSquashfs()
+	if !s.HasMksquashfs() {
+		b.Skip("mksquashfs not found")
+	}
+
+	// shared libraries and Python modules interleaved with data
+	// files in directory order
+	files := map[string]int{
+		"/.singularity.d/runscript":   1024,
+		"/bin/bash":                   1 << 20,
+		"/lib64/ld-linux-x86-64.so.2": 192 << 10,
+	}
+	for i := 0; i < 64; i++ {
+		files[fmt.Sprintf("/usr/lib/lib%02d.so", i)] = 256 << 10
+		files[fmt.Sprintf("/usr/lib/lib%02d.dat", i)] = 2 << 20
+		files[fmt.Sprintf("/usr/lib/python3.8/mod%02d.py", i)] = 24 << 10
+		files[fmt.Sprintf("/usr/lib/python3.8/mod%02d.txt", i)] = 512 << 10
+	}
+	rootfs := createRootfs(b, files, nil)
+	defer os.RemoveAll(rootfs)
+
+	startup := StartupFiles(rootfs)
+	sortFile := filepath.Join(rootfs, "..", filepath.Base(rootfs)+".sort")
+	if _, err := CreateSortFile(sortFile, rootfs, startup); err != nil {
+		b.Fatal(err)
+	}
+	defer os.Remove(sortFile)
+
+	// uncompressed data without fragments, to locate file data
+	flags := []string{"-noappend", "-noI", "-noD", "-noF", "-noX", "-no-fragments", "-no-duplicates"}
+
+	for _, bc := range []struct {
+		name  string
+		flags []string
+	}{
+		{"directory-order", flags},
+		{"startup-order", append(flags, "-sort", sortFile)},
+	} {
+		b.Run(bc.name, func(b *testing.B) {
+			f, err := ioutil.TempFile("", "order-")
+			if err != nil {
+				b.Fatal(err)
+			}
+			f.Close()
+			image := f.Name()
+			defer os.Remove(image)
+
+			if err := s.Create([]string{rootfs}, image, bc.flags); err != nil {
+				b.Fatal(err)
+			}
+
+			ext := extents(b, image, rootfs, startup)
+			seeks := 0
+			for i := 1; i < len(ext); i++ {
+				if ext[i][0] != ext[i-1][1] {
+					seeks++
+				}
+			}
+			b.ReportMetric(float64(seeks), "seeks")
+
+			img, err := os.Open(image)
+			if err != nil {
+				b.Fatal(err)
+			}
+			defer img.Close()
+
+			buf := make([]byte, 128<<10)
+			b.ResetTimer()
+			for i := 0; i < b.N; i++ {
+				b.StopTimer()
+				if err := unix.Fadvise(int(img.Fd()), 0, 0, unix.FADV_DONTNEED); err != nil {
+					b.Fatal(err)
+				}
+				b.StartTimer()
+
+				for _, e := range ext {
+					for off := e[0]; off < e[1]; off += int64(len(buf)) {
+						if _, err := img.ReadAt(buf, off); err != nil && off+int64(len(buf)) < e[1] {
+							b.Fatal(err)
+						}
+					}
+				}
+			}
+		})
+	}
+}
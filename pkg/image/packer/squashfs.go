@@ -7,10 +7,33 @@ package packer
 
 import (
 	"bytes"
+	"encoding/json"
 	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
 	"os/exec"
+	"path/filepath"
+	"regexp"
+	"strings"
+	"syscall"
+
+	"github.com/sylabs/singularity/internal/pkg/client/cache"
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+	"github.com/sylabs/singularity/pkg/image"
 )
 
+// capabilitiesDir is the capabilities cache directory inside the cache
+// root directory.
+const capabilitiesDir = "mksquashfs"
+
+// compressorRegexp matches compressor lines of the mksquashfs usage,
+// the compressor options lines being further indented.
+var compressorRegexp = regexp.MustCompile(`^\t([a-z0-9]+)( \(default\))?$`)
+
+// tarRegexp matches the -tar option line of the mksquashfs usage.
+var tarRegexp = regexp.MustCompile(`^-tar\s`)
+
 // Squashfs represents a squashfs packer
 type Squashfs struct {
 	MksquashfsPath string
@@ -28,7 +51,7 @@ func (s Squashfs) HasMksquashfs() bool {
 	return s.MksquashfsPath != ""
 }
 
-func (s Squashfs) create(files []string, dest string, opts []string) error {
+func (s Squashfs) create(files []string, dest string, opts []string, stdin io.Reader) error {
 	var stderr bytes.Buffer
 
 	if !s.HasMksquashfs() {
@@ -41,6 +64,7 @@ func (s Squashfs) create(files []string, dest string, opts []string) error {
 	args = append(args, opts...)
 
 	cmd := exec.Command(s.MksquashfsPath, args...)
+	cmd.Stdin = stdin
 	cmd.Stderr = &stderr
 	if err := cmd.Run(); err != nil {
 		return fmt.Errorf("create command failed: %v: %s", err, stderr.String())
@@ -51,5 +75,170 @@ func (s Squashfs) create(files []string, dest string, opts []string) error {
 // Create makes a squashfs filesystem from a list of source files/directories to a
 // destination file
 func (s Squashfs) Create(src []string, dest string, opts []string) error {
-	return s.create(src, dest, opts)
+	return s.create(src, dest, opts, nil)
+}
+
+// Capabilities describes the compressors and input formats supported
+// by mksquashfs.
+type Capabilities struct {
+	// Compressors lists the supported compressors, empty if unknown.
+	Compressors []string `json:"compressors"`
+	// DefaultComp is the compressor used without -comp option.
+	DefaultComp string `json:"defaultComp"`
+	// Tar reports if a tar stream can be read from standard input
+	// with the -tar option.
+	Tar bool `json:"tar"`
+}
+
+// HasCompressor returns if mksquashfs supports the compressor comp,
+// it's assumed when the supported compressors are unknown.
+func (c *Capabilities) HasCompressor(comp string) bool {
+	if len(c.Compressors) == 0 {
+		return true
+	}
+	for _, supported := range c.Compressors {
+		if supported == comp {
+			return true
+		}
+	}
+	return false
+}
+
+// capabilitiesEntry is a capabilities cache entry, valid as long as
+// the mksquashfs binary doesn't change.
+type capabilitiesEntry struct {
+	Path         string       `json:"path"`
+	Size         int64        `json:"size"`
+	Mtime        int64        `json:"mtime"`
+	Ctime        int64        `json:"ctime"`
+	Capabilities Capabilities `json:"capabilities"`
+}
+
+func (e *capabilitiesEntry) matches(path string, st *syscall.Stat_t) bool {
+	return e.Path == path && e.Size == st.Size && e.Mtime == st.Mtim.Nano() && e.Ctime == st.Ctim.Nano()
+}
+
+// Capabilities returns the mksquashfs capabilities. They are detected
+// once per mksquashfs binary and cached across builds.
+func (s Squashfs) Capabilities() (*Capabilities, error) {
+	if !s.HasMksquashfs() {
+		return nil, fmt.Errorf("could not get mksquashfs capabilities, mksquashfs not found")
+	}
+
+	fi, err := os.Stat(s.MksquashfsPath)
+	if err != nil {
+		return nil, err
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !ok {
+		return nil, fmt.Errorf("could not get %s file status", s.MksquashfsPath)
+	}
+
+	dir := cache.DataDir(capabilitiesDir)
+	// cast to uint64 as st.Dev is uint32 on MIPS
+	entry := filepath.Join(dir, fmt.Sprintf("%x-%x.json", uint64(st.Dev), st.Ino))
+
+	if dir != "" {
+		e := new(capabilitiesEntry)
+		if b, err := ioutil.ReadFile(entry); err == nil {
+			if err := json.Unmarshal(b, e); err == nil && e.matches(s.MksquashfsPath, st) {
+				sylog.Debugf("Using cached mksquashfs capabilities")
+				return &e.Capabilities, nil
+			}
+		}
+	}
+
+	c, err := s.detectCapabilities()
+	if err != nil {
+		return nil, err
+	}
+
+	if dir != "" {
+		e := &capabilitiesEntry{
+			Path:         s.MksquashfsPath,
+			Size:         st.Size,
+			Mtime:        st.Mtim.Nano(),
+			Ctime:        st.Ctim.Nano(),
+			Capabilities: *c,
+		}
+		b, err := json.Marshal(e)
+		if err == nil {
+			err = cache.WriteDataFile(entry, b)
+		}
+		if err != nil {
+			sylog.Debugf("Could not cache mksquashfs capabilities: %s", err)
+		}
+	}
+
+	return c, nil
+}
+
+// detectCapabilities gets the supported compressors and options from the
+// mksquashfs usage, and falls back to build a test image to find the default
+// compressor if the usage doesn't list them.
+func (s Squashfs) detectCapabilities() (*Capabilities, error) {
+	sylog.Debugf("Detecting mksquashfs capabilities")
+
+	// old versions don't have -help but display the usage for
+	// unknown options, the exit status is ignored for that reason
+	out, _ := exec.Command(s.MksquashfsPath, "-help").CombinedOutput()
+	if c := parseUsage(out); c.DefaultComp != "" {
+		return c, nil
+	}
+
+	sylog.Debugf("Compressors not found in mksquashfs usage, building a test image")
+
+	dir, err := ioutil.TempDir("", "squashfs-comp-test-")
+	if err != nil {
+		return nil, fmt.Errorf("while creating temporary directory for squashfs: %v", err)
+	}
+	defer os.RemoveAll(dir)
+
+	src := filepath.Join(dir, "src")
+	if err := ioutil.WriteFile(src, []byte("Test File Content"), 0644); err != nil {
+		return nil, fmt.Errorf("while creating squashfs source: %v", err)
+	}
+	dest := filepath.Join(dir, "test.sqfs")
+	if err := s.Create([]string{src}, dest, []string{"-noappend"}); err != nil {
+		return nil, fmt.Errorf("while creating squashfs: %v", err)
+	}
+	content, err := ioutil.ReadFile(dest)
+	if err != nil {
+		return nil, fmt.Errorf("while reading test squashfs: %v", err)
+	}
+	comp, err := image.GetSquashfsComp(content)
+	if err != nil {
+		return nil, fmt.Errorf("could not verify squashfs compression type: %v", err)
+	}
+
+	return &Capabilities{DefaultComp: comp}, nil
+}
+
+// parseUsage parses the options and the compressors section of the
+// mksquashfs usage.
+func parseUsage(usage []byte) *Capabilities {
+	c := new(Capabilities)
+	section := false
+
+	for _, line := range strings.Split(string(usage), "\n") {
+		if tarRegexp.MatchString(line) {
+			c.Tar = true
+		}
+		if strings.HasPrefix(line, "Compressors available") {
+			section = true
+			continue
+		} else if !section {
+			continue
+		}
+		m := compressorRegexp.FindStringSubmatch(strings.TrimRight(line, " \r"))
+		if m == nil {
+			continue
+		}
+		c.Compressors = append(c.Compressors, m[1])
+		if m[2] != "" {
+			c.DefaultComp = m[1]
+		}
+	}
+
+	return c
 }
@@ -10,7 +10,10 @@ import (
 	"os"
 	"os/exec"
 	"path/filepath"
+	"reflect"
 	"testing"
+
+	"github.com/sylabs/singularity/internal/pkg/client/cache"
 )
 
 func checkArchive(t *testing.T, path string, files []string) {
@@ -118,3 +121,94 @@ func TestSquashfs(t *testing.T) {
 	t.Run("non-zero exit code", testNonZeroExitCode)
 	t.Run("happy path", testHappyPath)
 }
+
+const mksquashfsUsage = `SYNTAX:mksquashfs source1 source2 ...  dest [options]
+
+Filesystem build options:
+-comp <comp>		select <comp> compression
+			Compressors available:
+				gzip (default)
+				xz
+-b <block_size>		set data block to <block_size>.  Default 128 Kbytes
+-tar			read uncompressed tar file from standard in (stdin)
+
+Compressors available and compressor specific options:
+	gzip (default)
+	  -Xcompression-level <compression-level>
+		<compression-level> should be 1 .. 9 (default 9)
+	lzo
+	lz4
+	  -Xhc
+		Compress using LZ4 High Compression
+	xz
+	  -Xbcj filter1,filter2,...,filterN
+	zstd
+	  -Xcompression-level <compression-level>
+`
+
+func TestParseUsage(t *testing.T) {
+	c := parseUsage([]byte(mksquashfsUsage))
+
+	expected := []string{"gzip", "lzo", "lz4", "xz", "zstd"}
+	if !reflect.DeepEqual(c.Compressors, expected) {
+		t.Errorf("unexpected compressors %v instead of %v", c.Compressors, expected)
+	}
+	if c.DefaultComp != "gzip" {
+		t.Errorf("unexpected default compressor %q", c.DefaultComp)
+	}
+	if c.HasCompressor("lzma") || !c.HasCompressor("zstd") {
+		t.Errorf("wrong compressor support reported")
+	}
+	if !c.Tar {
+		t.Errorf("tar input support not reported")
+	}
+
+	if c := parseUsage([]byte("mksquashfs: invalid option")); c.DefaultComp != "" || !c.HasCompressor("xz") || c.Tar {
+		t.Errorf("unexpected capabilities without compressors in usage: %+v", c)
+	}
+}
+
+func TestCapabilitiesCache(t *testing.T) {
+	dir, err := ioutil.TempDir("", "capabilities-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	defer os.Setenv(cache.DirEnv, os.Getenv(cache.DirEnv))
+	os.Setenv(cache.DirEnv, dir)
+
+	// fake mksquashfs counting its executions
+	count := filepath.Join(dir, "count")
+	script := "#!/bin/sh\necho x >> " + count + "\ncat <<EOF\n" + mksquashfsUsage + "EOF\n"
+
+	s := NewSquashfs()
+	s.MksquashfsPath = filepath.Join(dir, "mksquashfs")
+	if err := ioutil.WriteFile(s.MksquashfsPath, []byte(script), 0755); err != nil {
+		t.Fatal(err)
+	}
+
+	for i := 0; i < 2; i++ {
+		c, err := s.Capabilities()
+		if err != nil {
+			t.Fatalf("unexpected error: %s", err)
+		}
+		if c.DefaultComp != "gzip" || len(c.Compressors) != 5 {
+			t.Fatalf("unexpected capabilities: %+v", c)
+		}
+	}
+	if b, _ := ioutil.ReadFile(count); len(b) != 2 {
+		t.Errorf("mksquashfs executed %d times instead of once", len(b)/2)
+	}
+
+	// a modified mksquashfs invalidates the cache entry
+	if err := ioutil.WriteFile(s.MksquashfsPath, []byte(script+"\n"), 0755); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := s.Capabilities(); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if b, _ := ioutil.ReadFile(count); len(b) != 4 {
+		t.Errorf("stale mksquashfs capabilities used")
+	}
+}
@@ -7,6 +7,7 @@ package image
 
 import (
 	"bytes"
+	"context"
 	"fmt"
 	"os"
 	"runtime"
@@ -43,6 +44,18 @@ func checkPartitionType(img *Image, fstype sif.Fstype, offset int64) (uint32, er
 	return 0, fmt.Errorf("unknown filesystem type %v", fstype)
 }
 
+// checkArch checks the compatibility of the image's target architecture,
+// the CompatibleWith call will also check that the current machine
+// has persistent emulation enabled in /proc/sys/fs/binfmt_misc to
+// be able to execute container process correctly
+func checkArch(sifArch string) error {
+	goArch := sif.GetGoArch(sifArch)
+	if sifArch != sif.HdrArchUnknown && !machine.CompatibleWith(goArch) {
+		return fmt.Errorf("the image's architecture (%s) could not run on the host's (%s)", goArch, runtime.GOARCH)
+	}
+	return nil
+}
+
 func (f *sifFormat) initializer(img *Image, fi os.FileInfo) error {
 	if fi.IsDir() {
 		return debugError("not a sif file image")
@@ -91,15 +104,11 @@ func (f *sifFormat) initializer(img *Image, fi os.FileInfo) error {
 			return fmt.Errorf("while checking system partition header: %s", err)
 		}
 
-		// Check the compatibility of the image's target architecture, the
-		// CompatibleWith call will also check that the current machine
-		// has persistent emulation enabled in /proc/sys/fs/binfmt_misc to
-		// be able to execute container process correctly
 		sifArch := string(fimg.Header.Arch[:sif.HdrArchLen-1])
-		goArch := sif.GetGoArch(sifArch)
-		if sifArch != sif.HdrArchUnknown && !machine.CompatibleWith(goArch) {
-			return fmt.Errorf("the image's architecture (%s) could not run on the host's (%s)", goArch, runtime.GOARCH)
+		if err := checkArch(sifArch); err != nil {
+			return err
 		}
+		img.arch = sifArch
 
 		img.Partitions = []Section{
 			{
@@ -143,10 +152,11 @@ func (f *sifFormat) initializer(img *Image, fi os.FileInfo) error {
 			}
 
 			partition := Section{
-				Offset: uint64(desc.Fileoff),
-				Size:   uint64(desc.Filelen),
-				Name:   desc.GetName(),
-				Type:   htype,
+				Offset:  uint64(desc.Fileoff),
+				Size:    uint64(desc.Filelen),
+				Name:    desc.GetName(),
+				Type:    htype,
+				Overlay: ptype == sif.PartOverlay,
 			}
 			img.Partitions = append(img.Partitions, partition)
 		} else if desc.Datatype != 0 {
@@ -173,6 +183,49 @@ func (f *sifFormat) initializer(img *Image, fi os.FileInfo) error {
 	return nil
 }
 
+// Fetcher fetches byte ranges of an image file fetched lazily.
+type Fetcher interface {
+	Fetch(ctx context.Context, off, n int64) error
+}
+
+// FetchSIFMetadata fetches with f the parts of the lazily fetched SIF
+// image path read before its root filesystem is mounted: the SIF header
+// and descriptors, the header of the system partition and the other data
+// objects (signatures, definition file, overlay partitions...). The system
+// partition content is left to be fetched on demand once mounted.
+func FetchSIFMetadata(ctx context.Context, f Fetcher, path string) error {
+	fimg, err := sif.LoadContainer(path, true)
+	if err != nil {
+		return fmt.Errorf("while loading SIF header: %s", err)
+	}
+	dataOff := fimg.Header.Dataoff
+	fimg.UnloadContainer()
+
+	// descriptors are loaded again once fetched
+	if err := f.Fetch(ctx, 0, dataOff); err != nil {
+		return err
+	}
+	fimg, err = sif.LoadContainer(path, true)
+	if err != nil {
+		return fmt.Errorf("while loading SIF descriptors: %s", err)
+	}
+	defer fimg.UnloadContainer()
+
+	for _, desc := range fimg.DescrArr {
+		if !desc.Used {
+			continue
+		}
+		n := desc.Filelen
+		if ptype, err := desc.GetPartType(); err == nil && ptype == sif.PartPrimSys {
+			n = bufferSize
+		}
+		if err := f.Fetch(ctx, desc.Fileoff, n); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
 func (f *sifFormat) openMode(writable bool) int {
 	if writable {
 		return os.O_RDWR
@@ -7,7 +7,9 @@ package image
 
 import (
 	"bytes"
+	"context"
 	"os"
+	"reflect"
 	"runtime"
 	"testing"
 
@@ -256,3 +258,74 @@ func TestSIFOpenMode(t *testing.T) {
 		t.Fatal("openMode(false) returned the wrong value")
 	}
 }
+
+// rangeFetcher records the ranges fetched.
+type rangeFetcher [][2]int64
+
+func (f *rangeFetcher) Fetch(ctx context.Context, off, n int64) error {
+	*f = append(*f, [2]int64{off, n})
+	return nil
+}
+
+func TestFetchSIFMetadata(t *testing.T) {
+	var fps []*os.File
+	for i := 0; i < 2; i++ {
+		fp, err := os.Open(testSquash)
+		if err != nil {
+			t.Fatalf("failed to open %s: %s", testSquash, err)
+		}
+		defer fp.Close()
+		fps = append(fps, fp)
+	}
+
+	primPart := sif.DescriptorInput{
+		Datatype: sif.DataPartition,
+		Groupid:  sif.DescrDefaultGroup,
+		Link:     sif.DescrUnusedLink,
+		Fname:    "primPart",
+		Fp:       fps[0],
+		Extra: *bytes.NewBuffer([]byte{
+			0x01, 0x00, 0x00, 0x00, // fstype
+			0x02, 0x00, 0x00, 0x00, // part type
+		}),
+	}
+	primPart.Extra.WriteString(sif.GetSIFArch(runtime.GOARCH))
+
+	oneSection := sif.DescriptorInput{
+		Datatype: sif.DataGeneric,
+		Groupid:  sif.DescrDefaultGroup,
+		Link:     sif.DescrUnusedLink,
+		Fname:    "oneSection",
+		Fp:       fps[1],
+	}
+
+	path := createSIF(t, []sif.DescriptorInput{primPart, oneSection}, false)
+	defer os.Remove(path)
+
+	fimg, err := sif.LoadContainer(path, true)
+	if err != nil {
+		t.Fatalf("failed to load %s: %s", path, err)
+	}
+	defer fimg.UnloadContainer()
+
+	// the header, the system partition header and the whole section
+	want := [][2]int64{{0, fimg.Header.Dataoff}}
+	for _, desc := range fimg.DescrArr {
+		if !desc.Used {
+			continue
+		}
+		if desc.Datatype == sif.DataPartition {
+			want = append(want, [2]int64{desc.Fileoff, bufferSize})
+		} else {
+			want = append(want, [2]int64{desc.Fileoff, desc.Filelen})
+		}
+	}
+
+	var f rangeFetcher
+	if err := FetchSIFMetadata(context.Background(), &f, path); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if !reflect.DeepEqual([][2]int64(f), want) {
+		t.Errorf("unexpected ranges fetched %v, want %v", f, want)
+	}
+}
@@ -0,0 +1,544 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package config
+
+import (
+	"encoding"
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"hash/fnv"
+	"math"
+	"reflect"
+	"strings"
+	"sync"
+	"unsafe"
+)
+
+// The binary encoding walks values with reflection and stores them in
+// fields declaration order without any field name:
+//
+//   - booleans are stored as a single byte
+//   - signed integers are stored as zig-zag varints
+//   - unsigned integers are stored as varints
+//   - floats are stored as 8 bytes little endian IEEE 754 numbers
+//   - strings and byte slices are stored as a varint length followed
+//     by the bytes
+//   - pointers and nil interfaces are stored as a presence byte
+//     followed by the pointed value
+//   - slices and maps are stored as a varint length plus one, zero
+//     meaning nil, followed by their elements
+//   - arrays and structs are stored as their elements
+//
+// Struct fields are selected like with JSON encoding: unexported fields
+// and fields tagged with `json:"-"` are ignored. Types implementing
+// encoding.BinaryMarshaler, json.Marshaler or encoding.TextMarshaler are
+// stored as a byte slice returned by the corresponding method.
+//
+// As there is no field name, a fingerprint of the encoded type is stored
+// along the value so that a configuration encoded by a different version
+// of a type is rejected.
+
+// maxBinaryDepth is the maximum nesting depth of encoded values.
+const maxBinaryDepth = 256
+
+var (
+	errBinaryUnsupported = errors.New("type not supported by binary encoding")
+	errBinaryShort       = errors.New("unexpected end of binary configuration")
+	errBinaryDepth       = errors.New("binary configuration nested too deeply")
+
+	binaryMarshalerType   = reflect.TypeOf((*encoding.BinaryMarshaler)(nil)).Elem()
+	binaryUnmarshalerType = reflect.TypeOf((*encoding.BinaryUnmarshaler)(nil)).Elem()
+	jsonMarshalerType     = reflect.TypeOf((*json.Marshaler)(nil)).Elem()
+	jsonUnmarshalerType   = reflect.TypeOf((*json.Unmarshaler)(nil)).Elem()
+	textMarshalerType     = reflect.TypeOf((*encoding.TextMarshaler)(nil)).Elem()
+	textUnmarshalerType   = reflect.TypeOf((*encoding.TextUnmarshaler)(nil)).Elem()
+
+	// structFields caches encoded fields index for struct types
+	structFields sync.Map
+	// marshalers caches marshaler methods used by types
+	marshalers sync.Map
+	// fingerprints caches type fingerprints
+	fingerprints sync.Map
+)
+
+// EncodeBinary returns the binary encoding of the value pointed by v.
+func EncodeBinary(v interface{}) ([]byte, error) {
+	rv := reflect.ValueOf(v)
+	if rv.Kind() != reflect.Ptr || rv.IsNil() {
+		return nil, fmt.Errorf("non-nil pointer required to encode binary configuration")
+	}
+	e := &binaryEncoder{buf: make([]byte, 0, 4096)}
+	if err := e.encode(rv.Elem(), 0); err != nil {
+		return nil, err
+	}
+	return e.buf, nil
+}
+
+// DecodeBinary decodes b, returned by EncodeBinary, into the value
+// pointed by v. Decoded strings and byte slices reference b memory,
+// b must not be modified afterwards.
+func DecodeBinary(b []byte, v interface{}) error {
+	rv := reflect.ValueOf(v)
+	if rv.Kind() != reflect.Ptr || rv.IsNil() {
+		return fmt.Errorf("non-nil pointer required to decode binary configuration")
+	}
+	d := &binaryDecoder{buf: b}
+	if err := d.decode(rv.Elem(), 0); err != nil {
+		return err
+	}
+	if len(d.buf) != 0 {
+		return fmt.Errorf("%d trailing bytes in binary configuration", len(d.buf))
+	}
+	return nil
+}
+
+// fieldsOf returns the index of encoded fields of the struct type t.
+func fieldsOf(t reflect.Type) []int {
+	if fields, ok := structFields.Load(t); ok {
+		return fields.([]int)
+	}
+	fields := make([]int, 0, t.NumField())
+	for i := 0; i < t.NumField(); i++ {
+		f := t.Field(i)
+		if f.PkgPath != "" || f.Tag.Get("json") == "-" {
+			continue
+		}
+		fields = append(fields, i)
+	}
+	structFields.Store(t, fields)
+	return fields
+}
+
+const (
+	notMarshaled = iota
+	binaryMarshaled
+	jsonMarshaled
+	textMarshaled
+)
+
+// marshalerOf returns which pair of marshaler methods of type t
+// is used to store its values, methods are looked up on *t.
+func marshalerOf(t reflect.Type) int {
+	if t.Kind() == reflect.Ptr {
+		return notMarshaled
+	}
+	if m, ok := marshalers.Load(t); ok {
+		return m.(int)
+	}
+
+	m := notMarshaled
+	p := reflect.PtrTo(t)
+	switch {
+	case p.Implements(binaryMarshalerType) && p.Implements(binaryUnmarshalerType):
+		m = binaryMarshaled
+	case p.Implements(jsonMarshalerType) && p.Implements(jsonUnmarshalerType):
+		m = jsonMarshaled
+	case p.Implements(textMarshalerType) && p.Implements(textUnmarshalerType):
+		m = textMarshaled
+	}
+	marshalers.Store(t, m)
+	return m
+}
+
+func marshaled(t reflect.Type) bool {
+	return marshalerOf(t) != notMarshaled
+}
+
+// isEmpty returns whether values of type t are stored without any byte.
+func isEmpty(t reflect.Type) bool {
+	if marshaled(t) {
+		return false
+	}
+	switch t.Kind() {
+	case reflect.Array:
+		return t.Len() == 0 || isEmpty(t.Elem())
+	case reflect.Struct:
+		for _, i := range fieldsOf(t) {
+			if !isEmpty(t.Field(i).Type) {
+				return false
+			}
+		}
+		return true
+	}
+	return false
+}
+
+// fingerprint returns a hash of the binary layout of type t.
+func fingerprint(t reflect.Type) uint64 {
+	if fp, ok := fingerprints.Load(t); ok {
+		return fp.(uint64)
+	}
+	var sb strings.Builder
+	writeLayout(&sb, t, make(map[reflect.Type]bool))
+	h := fnv.New64a()
+	h.Write([]byte(sb.String()))
+	fp := h.Sum64()
+	fingerprints.Store(t, fp)
+	return fp
+}
+
+func writeLayout(sb *strings.Builder, t reflect.Type, seen map[reflect.Type]bool) {
+	if marshaled(t) {
+		fmt.Fprintf(sb, "m(%s)", t)
+		return
+	}
+	if seen[t] {
+		fmt.Fprintf(sb, "r(%s)", t)
+		return
+	}
+	sb.WriteString(t.Kind().String())
+	switch t.Kind() {
+	case reflect.Ptr, reflect.Slice:
+		seen[t] = true
+		sb.WriteByte('(')
+		writeLayout(sb, t.Elem(), seen)
+		sb.WriteByte(')')
+		delete(seen, t)
+	case reflect.Array:
+		fmt.Fprintf(sb, "[%d]", t.Len())
+		writeLayout(sb, t.Elem(), seen)
+	case reflect.Map:
+		sb.WriteByte('(')
+		writeLayout(sb, t.Key(), seen)
+		sb.WriteByte(',')
+		writeLayout(sb, t.Elem(), seen)
+		sb.WriteByte(')')
+	case reflect.Struct:
+		seen[t] = true
+		sb.WriteByte('{')
+		for _, i := range fieldsOf(t) {
+			f := t.Field(i)
+			sb.WriteString(f.Name)
+			sb.WriteByte(':')
+			writeLayout(sb, f.Type, seen)
+			sb.WriteByte(';')
+		}
+		sb.WriteByte('}')
+		delete(seen, t)
+	}
+}
+
+type binaryEncoder struct {
+	buf []byte
+	tmp [binary.MaxVarintLen64]byte
+}
+
+func (e *binaryEncoder) uvarint(v uint64) {
+	n := binary.PutUvarint(e.tmp[:], v)
+	e.buf = append(e.buf, e.tmp[:n]...)
+}
+
+func (e *binaryEncoder) bytes(b []byte) {
+	e.uvarint(uint64(len(b)))
+	e.buf = append(e.buf, b...)
+}
+
+// marshal stores v with its marshaler method if any.
+func (e *binaryEncoder) marshal(v reflect.Value) (bool, error) {
+	m := marshalerOf(v.Type())
+	if m == notMarshaled {
+		return false, nil
+	}
+	if !v.CanAddr() {
+		tmp := reflect.New(v.Type()).Elem()
+		tmp.Set(v)
+		v = tmp
+	}
+
+	var b []byte
+	var err error
+
+	switch m {
+	case binaryMarshaled:
+		b, err = v.Addr().Interface().(encoding.BinaryMarshaler).MarshalBinary()
+	case jsonMarshaled:
+		b, err = v.Addr().Interface().(json.Marshaler).MarshalJSON()
+	case textMarshaled:
+		b, err = v.Addr().Interface().(encoding.TextMarshaler).MarshalText()
+	}
+	if err != nil {
+		return true, err
+	}
+	e.bytes(b)
+	return true, nil
+}
+
+func (e *binaryEncoder) encode(v reflect.Value, depth int) error {
+	if depth > maxBinaryDepth {
+		return errBinaryDepth
+	}
+	if ok, err := e.marshal(v); ok {
+		return err
+	}
+
+	switch v.Kind() {
+	case reflect.Bool:
+		if v.Bool() {
+			e.buf = append(e.buf, 1)
+		} else {
+			e.buf = append(e.buf, 0)
+		}
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		n := binary.PutVarint(e.tmp[:], v.Int())
+		e.buf = append(e.buf, e.tmp[:n]...)
+	case reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64, reflect.Uintptr:
+		e.uvarint(v.Uint())
+	case reflect.Float32, reflect.Float64:
+		var b [8]byte
+		binary.LittleEndian.PutUint64(b[:], math.Float64bits(v.Float()))
+		e.buf = append(e.buf, b[:]...)
+	case reflect.String:
+		e.uvarint(uint64(v.Len()))
+		e.buf = append(e.buf, v.String()...)
+	case reflect.Ptr:
+		if v.IsNil() {
+			e.buf = append(e.buf, 0)
+			return nil
+		}
+		e.buf = append(e.buf, 1)
+		return e.encode(v.Elem(), depth+1)
+	case reflect.Interface:
+		if !v.IsNil() {
+			return fmt.Errorf("%s: %s", v.Type(), errBinaryUnsupported)
+		}
+		e.buf = append(e.buf, 0)
+	case reflect.Slice:
+		if v.IsNil() {
+			e.buf = append(e.buf, 0)
+			return nil
+		}
+		if isEmpty(v.Type().Elem()) {
+			return fmt.Errorf("%s: %s", v.Type(), errBinaryUnsupported)
+		}
+		e.uvarint(uint64(v.Len()) + 1)
+		if v.Type().Elem().Kind() == reflect.Uint8 && !marshaled(v.Type().Elem()) {
+			e.buf = append(e.buf, v.Bytes()...)
+			return nil
+		}
+		fallthrough
+	case reflect.Array:
+		for i := 0; i < v.Len(); i++ {
+			if err := e.encode(v.Index(i), depth+1); err != nil {
+				return err
+			}
+		}
+	case reflect.Map:
+		if v.IsNil() {
+			e.buf = append(e.buf, 0)
+			return nil
+		}
+		if isEmpty(v.Type().Key()) && isEmpty(v.Type().Elem()) {
+			return fmt.Errorf("%s: %s", v.Type(), errBinaryUnsupported)
+		}
+		e.uvarint(uint64(v.Len()) + 1)
+		// map values are copied to be addressable
+		// in order to call marshaler methods
+		key := reflect.New(v.Type().Key()).Elem()
+		elem := reflect.New(v.Type().Elem()).Elem()
+		for iter := v.MapRange(); iter.Next(); {
+			key.Set(iter.Key())
+			elem.Set(iter.Value())
+			if err := e.encode(key, depth+1); err != nil {
+				return err
+			}
+			if err := e.encode(elem, depth+1); err != nil {
+				return err
+			}
+		}
+	case reflect.Struct:
+		for _, i := range fieldsOf(v.Type()) {
+			if err := e.encode(v.Field(i), depth+1); err != nil {
+				return err
+			}
+		}
+	default:
+		return fmt.Errorf("%s: %s", v.Type(), errBinaryUnsupported)
+	}
+	return nil
+}
+
+type binaryDecoder struct {
+	buf []byte
+}
+
+func (d *binaryDecoder) uvarint() (uint64, error) {
+	v, n := binary.Uvarint(d.buf)
+	if n <= 0 {
+		return 0, errBinaryShort
+	}
+	d.buf = d.buf[n:]
+	return v, nil
+}
+
+// count returns the number of elements of a slice or a map, plus
+// one, checked against remaining bytes as each element is stored
+// with at least one byte.
+func (d *binaryDecoder) count() (int, error) {
+	n, err := d.uvarint()
+	if err != nil {
+		return 0, err
+	}
+	if n > uint64(len(d.buf))+1 {
+		return 0, errBinaryShort
+	}
+	return int(n), nil
+}
+
+// bytes returns the next length prefixed bytes, the returned slice
+// references the decoder buffer.
+func (d *binaryDecoder) bytes() ([]byte, error) {
+	n, err := d.uvarint()
+	if err != nil {
+		return nil, err
+	}
+	if n > uint64(len(d.buf)) {
+		return nil, errBinaryShort
+	}
+	b := d.buf[:n:n]
+	d.buf = d.buf[n:]
+	return b, nil
+}
+
+// unmarshal decodes v with its unmarshaler method if any.
+func (d *binaryDecoder) unmarshal(v reflect.Value) (bool, error) {
+	m := marshalerOf(v.Type())
+	if m == notMarshaled {
+		return false, nil
+	}
+
+	b, err := d.bytes()
+	if err != nil {
+		return true, err
+	}
+
+	switch m {
+	case binaryMarshaled:
+		err = v.Addr().Interface().(encoding.BinaryUnmarshaler).UnmarshalBinary(b)
+	case jsonMarshaled:
+		err = v.Addr().Interface().(json.Unmarshaler).UnmarshalJSON(b)
+	case textMarshaled:
+		err = v.Addr().Interface().(encoding.TextUnmarshaler).UnmarshalText(b)
+	}
+	return true, err
+}
+
+func (d *binaryDecoder) decode(v reflect.Value, depth int) error {
+	if depth > maxBinaryDepth {
+		return errBinaryDepth
+	}
+	if ok, err := d.unmarshal(v); ok {
+		return err
+	}
+
+	switch v.Kind() {
+	case reflect.Bool:
+		if len(d.buf) == 0 {
+			return errBinaryShort
+		}
+		v.SetBool(d.buf[0] != 0)
+		d.buf = d.buf[1:]
+	case reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64:
+		i, n := binary.Varint(d.buf)
+		if n <= 0 || v.OverflowInt(i) {
+			return fmt.Errorf("bad %s value in binary configuration", v.Type())
+		}
+		d.buf = d.buf[n:]
+		v.SetInt(i)
+	case reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64, reflect.Uintptr:
+		u, err := d.uvarint()
+		if err != nil || v.OverflowUint(u) {
+			return fmt.Errorf("bad %s value in binary configuration", v.Type())
+		}
+		v.SetUint(u)
+	case reflect.Float32, reflect.Float64:
+		if len(d.buf) < 8 {
+			return errBinaryShort
+		}
+		v.SetFloat(math.Float64frombits(binary.LittleEndian.Uint64(d.buf)))
+		d.buf = d.buf[8:]
+	case reflect.String:
+		b, err := d.bytes()
+		if err != nil {
+			return err
+		}
+		// the string references the decoder buffer
+		v.SetString(*(*string)(unsafe.Pointer(&b)))
+	case reflect.Ptr, reflect.Interface:
+		if len(d.buf) == 0 {
+			return errBinaryShort
+		}
+		present := d.buf[0] != 0
+		d.buf = d.buf[1:]
+		if !present {
+			v.Set(reflect.Zero(v.Type()))
+			return nil
+		} else if v.Kind() == reflect.Interface {
+			return fmt.Errorf("%s: %s", v.Type(), errBinaryUnsupported)
+		}
+		if v.IsNil() {
+			v.Set(reflect.New(v.Type().Elem()))
+		}
+		return d.decode(v.Elem(), depth+1)
+	case reflect.Slice:
+		n, err := d.count()
+		if err != nil {
+			return err
+		}
+		if n == 0 {
+			v.Set(reflect.Zero(v.Type()))
+			return nil
+		}
+		n--
+		if v.Type().Elem().Kind() == reflect.Uint8 && !marshaled(v.Type().Elem()) {
+			// the slice references the decoder buffer
+			v.SetBytes(d.buf[:n:n])
+			d.buf = d.buf[n:]
+			return nil
+		}
+		v.Set(reflect.MakeSlice(v.Type(), n, n))
+		fallthrough
+	case reflect.Array:
+		for i := 0; i < v.Len(); i++ {
+			if err := d.decode(v.Index(i), depth+1); err != nil {
+				return err
+			}
+		}
+	case reflect.Map:
+		n, err := d.count()
+		if err != nil {
+			return err
+		}
+		if n == 0 {
+			v.Set(reflect.Zero(v.Type()))
+			return nil
+		}
+		n--
+		m := reflect.MakeMapWithSize(v.Type(), n)
+		for i := 0; i < n; i++ {
+			key := reflect.New(v.Type().Key()).Elem()
+			elem := reflect.New(v.Type().Elem()).Elem()
+			if err := d.decode(key, depth+1); err != nil {
+				return err
+			}
+			if err := d.decode(elem, depth+1); err != nil {
+				return err
+			}
+			m.SetMapIndex(key, elem)
+		}
+		v.Set(m)
+	case reflect.Struct:
+		for _, i := range fieldsOf(v.Type()) {
+			if err := d.decode(v.Field(i), depth+1); err != nil {
+				return err
+			}
+		}
+	default:
+		return fmt.Errorf("%s: %s", v.Type(), errBinaryUnsupported)
+	}
+	return nil
+}
@@ -41,8 +41,17 @@ type FileConfig struct {
 	AlwaysUseNv             bool     `default:"no" authorized:"yes,no" directive:"always use nv"`
 	AlwaysUseRocm           bool     `default:"no" authorized:"yes,no" directive:"always use rocm"`
 	SharedLoopDevices       bool     `default:"no" authorized:"yes,no" directive:"shared loop devices"`
+	LazyImageFetch          bool     `default:"no" authorized:"yes,no" directive:"lazy image fetch"`
+	LazyImagePrefetch       bool     `default:"yes" authorized:"yes,no" directive:"lazy image prefetch"`
+	ImagePrefetch           bool     `default:"yes" authorized:"yes,no" directive:"image prefetch"`
 	MaxLoopDevices          uint     `default:"256" directive:"max loop devices"`
 	SessiondirMaxSize       uint     `default:"16" directive:"sessiondir max size"`
+	MksquashfsProcs         uint     `default:"0" directive:"mksquashfs procs"`
+	MksquashfsBlockSize     uint     `default:"0" directive:"mksquashfs block size"`
+	DownloadConcurrency     uint     `default:"3" directive:"download concurrency"`
+	CacheMaxSize            uint     `default:"0" directive:"cache max size"`
+	LazyImageChunkSize      uint     `default:"2" directive:"lazy image chunk size"`
+	IdentityCacheTTL        uint     `default:"300" directive:"identity cache ttl"`
 	MountDev                string   `default:"yes" authorized:"yes,no,minimal" directive:"mount dev"`
 	EnableOverlay           string   `default:"try" authorized:"yes,no,try" directive:"enable overlay"`
 	BindPath                []string `default:"/etc/localtime,/etc/hosts" directive:"bind path"`
@@ -51,10 +60,15 @@ type FileConfig struct {
 	LimitContainerPaths     []string `directive:"limit container paths"`
 	RootDefaultCapabilities string   `default:"full" authorized:"full,file,no" directive:"root default capabilities"`
 	MemoryFSType            string   `default:"tmpfs" authorized:"tmpfs,ramfs" directive:"memory fs type"`
+	ImageBackend            string   `default:"loop" authorized:"loop,fuse" directive:"image backend"`
+	MksquashfsComp          string   `default:"gzip" authorized:"gzip,lzo,lz4,xz,zstd" directive:"mksquashfs comp"`
+	CacheEviction           string   `default:"lru" authorized:"lru,size" directive:"cache eviction"`
 	CniConfPath             string   `directive:"cni configuration path"`
 	CniPluginPath           string   `directive:"cni plugin path"`
 	MksquashfsPath          string   `directive:"mksquashfs path"`
 	CryptsetupPath          string   `directive:"cryptsetup path"`
+	SquashfusePath          string   `directive:"squashfuse path"`
+	SystemCacheDir          string   `directive:"system cache dir"`
 }
 
 const TemplateAsset = `# SINGULARITY.CONF
@@ -100,6 +114,14 @@ config passwd = {{ if eq .ConfigPasswd true }}yes{{ else }}no{{ end }}
 # group entries for the calling user.
 config group = {{ if eq .ConfigGroup true }}yes{{ else }}no{{ end }}
 
+# IDENTITY CACHE TTL: [UINT]
+# DEFAULT: 300
+# Time in seconds during which the user and group entries looked up on the
+# host to update the container passwd and group files are reused by the
+# following containers of the user, they are stored in the user cache
+# directory. Set to 0 to look them up for each container.
+identity cache ttl = {{ .IdentityCacheTTL }}
+
 # CONFIG RESOLV_CONF: [BOOL]
 # DEFAULT: yes
 # If there is a bind point within the container, use the host's
@@ -301,6 +323,60 @@ memory fs type = {{ .MemoryFSType }}
 # installed in a standard system location
 # mksquashfs path =
 {{ if ne .MksquashfsPath "" }}mksquashfs path = {{ .MksquashfsPath }}{{ end }}
+# MKSQUASHFS PROCS: [UINT]
+# DEFAULT: 0 (All CPUs)
+# This allows the administrator to specify the number of CPUs for mksquashfs
+# to use when building an image
+mksquashfs procs = {{ .MksquashfsProcs }}
+
+# MKSQUASHFS BLOCK SIZE: [UINT]
+# DEFAULT: 0 (mksquashfs default, 128)
+# Block size in KiB of squashfs filesystems created during builds, it must be
+# a power of two between 4 and 1024. Larger blocks compress better, smaller
+# blocks reduce the amount of data read for random accesses at runtime
+mksquashfs block size = {{ .MksquashfsBlockSize }}
+
+# MKSQUASHFS COMP: [gzip/lzo/lz4/xz/zstd]
+# DEFAULT: gzip
+# Compressor used for squashfs filesystems created during builds. Images
+# compressed with something else than gzip may not run on hosts whose kernel
+# lacks the corresponding squashfs decompressor (zstd requires Linux 4.14+)
+mksquashfs comp = {{ .MksquashfsComp }}
+
+# DOWNLOAD CONCURRENCY: [UINT]
+# DEFAULT: 3
+# Number of image layers of OCI sources (docker:// ...) downloaded at the same
+# time into the image cache during builds and pulls, layers are downloaded
+# one after the other with a value of 0 or 1
+download concurrency = {{ .DownloadConcurrency }}
+
+# CACHE MAX SIZE: [UINT]
+# DEFAULT: 0 (unlimited)
+# Maximum size in MiB of the user image caches, cached images are evicted
+# when an image added to a cache exceeds it. Users can set another size
+# with the SINGULARITY_CACHE_MAXSIZE environment variable. OCI blobs are
+# not accounted
+cache max size = {{ .CacheMaxSize }}
+
+# CACHE EVICTION: [lru/size]
+# DEFAULT: lru
+# Order in which cached images are evicted: lru evicts the least recently
+# used images first, size evicts first the largest images weighted by the
+# time since their last use
+cache eviction = {{ .CacheEviction }}
+
+# SYSTEM CACHE DIR: [STRING]
+# DEFAULT: Undefined
+# Read-only image cache shared by all users, images missing from a user
+# cache are linked from this cache instead of being downloaded. It is
+# populated by the administrator with 'SINGULARITY_CACHEDIR=<dir> singularity
+# pull ...' run as root, which creates cache directories readable by all users.
+# Images and directories must be owned by root and not writable by others,
+# images must be readable by all users. Library and ORAS images are verified
+# against their hash
+# system cache dir =
+{{ if ne .SystemCacheDir "" }}system cache dir = {{ .SystemCacheDir }}{{ end }}
+
 # CRYPTSETUP PATH: [STRING]
 # DEFAULT: Undefined
 # This allows the administrator to specify the location of cryptsetup if
@@ -309,9 +385,58 @@ memory fs type = {{ .MemoryFSType }}
 # recorded at build time.
 # cryptsetup path =
 {{ if ne .CryptsetupPath "" }}cryptsetup path = {{ .CryptsetupPath }}{{ end }}
+# SQUASHFUSE PATH: [STRING]
+# DEFAULT: Undefined
+# This allows the administrator to specify the location for squashfuse if it is
+# not installed in a standard system location
+# squashfuse path =
+{{ if ne .SquashfusePath "" }}squashfuse path = {{ .SquashfusePath }}{{ end }}
 # SHARED LOOP DEVICES: [BOOL]
 # DEFAULT: no
 # Allow to share same images associated with loop devices to minimize loop
 # usage and optimize kernel cache (useful for MPI)
 shared loop devices = {{ if eq .SharedLoopDevices true }}yes{{ else }}no{{ end }}
+
+# IMAGE BACKEND: [loop/fuse]
+# DEFAULT: loop
+# Defines how SIF squashfs root filesystems are mounted. With 'loop' the image
+# is attached to a loop device and mounted by the kernel. With 'fuse' the image
+# is served by squashfuse (requires a squashfuse version built with libfuse 3.3
+# or later) without using loop devices, and SIF images are no longer converted
+# to sandbox when running with user namespace. Singularity falls back to loop
+# devices if squashfuse or /dev/fuse are not available. Encrypted and ext3
+# images are always mounted with loop devices, as well as all images when the
+# execution control list is activated since squashfuse runs with the user
+# privileges.
+image backend = {{ .ImageBackend }}
+
+# LAZY IMAGE FETCH: [BOOL]
+# DEFAULT: no
+# Run library:// and http(s):// SIF images without downloading them first.
+# The image header and metadata are fetched when the image is added to the
+# cache, the squashfs root filesystem is then fetched in chunks with range
+# requests as the container reads it, and served to the kernel as a network
+# block device by Singularity. It requires the setuid workflow, the nbd kernel
+# module and a server supporting range requests, otherwise images are fully
+# downloaded before running. The image is added to the cache once all its
+# chunks are fetched.
+lazy image fetch = {{ if eq .LazyImageFetch true }}yes{{ else }}no{{ end }}
+
+# LAZY IMAGE PREFETCH: [BOOL]
+# DEFAULT: yes
+# Fetch in background the chunks of a lazily fetched image not read yet,
+# while the container runs.
+lazy image prefetch = {{ if eq .LazyImagePrefetch true }}yes{{ else }}no{{ end }}
+
+# LAZY IMAGE CHUNK SIZE: [UINT]
+# DEFAULT: 2
+# Size in MiB of the chunks of lazily fetched images, between 1 and 4.
+lazy image chunk size = {{ .LazyImageChunkSize }}
+
+# IMAGE PREFETCH: [BOOL]
+# DEFAULT: yes
+# Read in background the files listed by the prefetch manifest of a SIF
+# image, in the order recorded with --prefetch-record, while the container
+# starts.
+image prefetch = {{ if eq .ImagePrefetch true }}yes{{ else }}no{{ end }}
 `
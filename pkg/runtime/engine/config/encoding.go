@@ -0,0 +1,156 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package config
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"reflect"
+)
+
+// Encoding is the encoding of the engine configuration passed to
+// starter and decoded by each starter stage.
+type Encoding int
+
+const (
+	// JSONEncoding is the JSON encoding.
+	JSONEncoding Encoding = iota
+	// BinaryEncoding is a compact encoding far cheaper to decode
+	// than JSON, decoded strings reference the configuration buffer
+	// instead of being copied (see binary.go).
+	BinaryEncoding
+)
+
+// binaryVersion is the version of the binary encoding format.
+const binaryVersion = 1
+
+// binaryMagic prefixes binary encoded configurations, it can't be
+// confused with a JSON object.
+var binaryMagic = []byte("\x00SCFG")
+
+// binaryHeader precedes the binary encoded engine configuration.
+type binaryHeader struct {
+	EngineName  string
+	ContainerID string
+	// Fingerprint is the fingerprint of the engine configuration type
+	Fingerprint uint64
+}
+
+// ParseEncoding returns the encoding corresponding to name.
+func ParseEncoding(name string) (Encoding, error) {
+	switch name {
+	case "json":
+		return JSONEncoding, nil
+	case "binary":
+		return BinaryEncoding, nil
+	}
+	return JSONEncoding, fmt.Errorf("unknown engine configuration encoding %q", name)
+}
+
+// EncodingOf returns the encoding of the configuration b.
+func EncodingOf(b []byte) Encoding {
+	if bytes.HasPrefix(b, binaryMagic) {
+		return BinaryEncoding
+	}
+	return JSONEncoding
+}
+
+// Marshal returns the configuration c encoded with enc. JSON is used
+// if the engine configuration contains values which can't be binary
+// encoded.
+func Marshal(c *Common, enc Encoding) ([]byte, error) {
+	if enc != BinaryEncoding || reflect.ValueOf(c.EngineConfig).Kind() != reflect.Ptr {
+		return json.Marshal(c)
+	}
+
+	data, err := EncodeBinary(c.EngineConfig)
+	if err != nil {
+		return json.Marshal(c)
+	}
+
+	h := binaryHeader{
+		EngineName:  c.EngineName,
+		ContainerID: c.ContainerID,
+		Fingerprint: fingerprint(reflect.TypeOf(c.EngineConfig).Elem()),
+	}
+	header, err := EncodeBinary(&h)
+	if err != nil {
+		return nil, err
+	}
+
+	b := make([]byte, 0, len(binaryMagic)+1+len(header)+len(data))
+	b = append(b, binaryMagic...)
+	b = append(b, binaryVersion)
+	b = append(b, header...)
+	return append(b, data...), nil
+}
+
+// decodeHeader decodes the binary header of b and returns
+// the remaining encoded engine configuration.
+func decodeHeader(b []byte) (*binaryHeader, []byte, error) {
+	b = b[len(binaryMagic):]
+	if len(b) == 0 || b[0] != binaryVersion {
+		return nil, nil, fmt.Errorf("unsupported binary configuration version")
+	}
+
+	h := new(binaryHeader)
+	d := &binaryDecoder{buf: b[1:]}
+	if err := d.decode(reflect.ValueOf(h).Elem(), 0); err != nil {
+		return nil, nil, fmt.Errorf("while decoding configuration header: %s", err)
+	}
+	return h, d.buf, nil
+}
+
+// EngineName returns the engine name of the configuration b.
+func EngineName(b []byte) (string, error) {
+	if EncodingOf(b) == BinaryEncoding {
+		h, _, err := decodeHeader(b)
+		if err != nil {
+			return "", err
+		}
+		return h.EngineName, nil
+	}
+
+	engineName := struct {
+		EngineName string `json:"engineName"`
+	}{}
+	if err := json.Unmarshal(b, &engineName); err != nil {
+		return "", err
+	}
+	return engineName.EngineName, nil
+}
+
+// Unmarshal decodes the configuration b returned by Marshal into c,
+// c.EngineConfig must be set with a pointer to the engine configuration.
+// With binary encoding, decoded strings reference b memory, b must not
+// be modified afterwards.
+func Unmarshal(b []byte, c *Common) error {
+	if EncodingOf(b) == JSONEncoding {
+		return json.Unmarshal(b, c)
+	}
+
+	h, data, err := decodeHeader(b)
+	if err != nil {
+		return err
+	}
+
+	t := reflect.TypeOf(c.EngineConfig)
+	if t == nil || t.Kind() != reflect.Ptr {
+		return fmt.Errorf("engine configuration must be a pointer")
+	}
+	if h.Fingerprint != fingerprint(t.Elem()) {
+		return fmt.Errorf("%s engine configuration was encoded by an incompatible version", h.EngineName)
+	}
+
+	c.EngineName = h.EngineName
+	c.ContainerID = h.ContainerID
+
+	if err := DecodeBinary(data, c.EngineConfig); err != nil {
+		return fmt.Errorf("while decoding %s engine configuration: %s", c.EngineName, err)
+	}
+	return nil
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package config
+
+import (
+	"encoding/json"
+	"reflect"
+	"testing"
+	"time"
+)
+
+type testMount struct {
+	Source  string   `json:"source"`
+	Options []string `json:"options,omitempty"`
+}
+
+type testLimits struct {
+	Memory *int64 `json:"memory,omitempty"`
+}
+
+type testEngineConfig struct {
+	Image     string            `json:"image"`
+	Env       []string          `json:"env"`
+	Empty     []string          `json:"empty"`
+	Mounts    []testMount       `json:"mounts"`
+	Limits    *testLimits       `json:"limits"`
+	Missing   *testLimits       `json:"missing"`
+	Labels    map[string]string `json:"labels"`
+	Key       []byte            `json:"key"`
+	Raw       json.RawMessage   `json:"raw"`
+	UID       int               `json:"uid"`
+	GID       uint32            `json:"gid"`
+	Ratio     float64           `json:"ratio"`
+	Fds       [2]int            `json:"fds"`
+	Writable  bool              `json:"writable"`
+	Created   time.Time         `json:"created"`
+	Any       interface{}       `json:"any"`
+	Ignored   string            `json:"-"`
+	unexposed string
+}
+
+func newTestConfig() *testEngineConfig {
+	return &testEngineConfig{
+		Image:   "/tmp/image.sif",
+		Env:     []string{"PATH=/bin", "HOME=/home/user"},
+		Empty:   []string{},
+		Mounts:  []testMount{{Source: "/tmp", Options: []string{"bind"}}, {Source: "/var/tmp"}},
+		Limits:  &testLimits{},
+		Labels:  map[string]string{"a": "b", "c": ""},
+		Key:     []byte{0, 1, 2},
+		Raw:     json.RawMessage(`{"plugin":true}`),
+		UID:     -1,
+		GID:     1000,
+		Ratio:   0.5,
+		Fds:     [2]int{3, 4},
+		Created: time.Date(2019, 12, 1, 10, 0, 0, 0, time.UTC),
+	}
+}
+
+func TestBinaryEncoding(t *testing.T) {
+	cfg := newTestConfig()
+	cfg.Ignored = "ignored"
+	cfg.unexposed = "unexposed"
+
+	c := &Common{EngineName: "test", ContainerID: "id", EngineConfig: cfg}
+	b, err := Marshal(c, BinaryEncoding)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if EncodingOf(b) != BinaryEncoding {
+		t.Fatalf("configuration is not binary encoded")
+	}
+
+	if name, err := EngineName(b); err != nil || name != "test" {
+		t.Errorf("unexpected engine name %q: %v", name, err)
+	}
+
+	decoded := &Common{EngineConfig: &testEngineConfig{Ignored: "kept"}}
+	if err := Unmarshal(b, decoded); err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	if decoded.EngineName != "test" || decoded.ContainerID != "id" {
+		t.Errorf("unexpected header %q/%q", decoded.EngineName, decoded.ContainerID)
+	}
+
+	expected := newTestConfig()
+	expected.Ignored = "kept"
+	if !reflect.DeepEqual(decoded.EngineConfig, expected) {
+		t.Errorf("unexpected decoded configuration:\n%+v\n%+v", decoded.EngineConfig, expected)
+	}
+
+	// truncated configurations must be rejected without panic
+	for i := 0; i < len(b); i++ {
+		decoded := &Common{EngineConfig: new(testEngineConfig)}
+		if err := Unmarshal(b[:i], decoded); err == nil {
+			t.Errorf("unexpected success with configuration truncated to %d bytes", i)
+		}
+	}
+}
+
+func TestBinaryEncodingFallback(t *testing.T) {
+	cfg := newTestConfig()
+	cfg.Any = "not nil"
+
+	c := &Common{EngineName: "test", EngineConfig: cfg}
+	for _, enc := range []Encoding{JSONEncoding, BinaryEncoding} {
+		b, err := Marshal(c, enc)
+		if err != nil {
+			t.Fatalf("unexpected error: %s", err)
+		}
+		if EncodingOf(b) != JSONEncoding {
+			t.Errorf("configuration with non-nil interface should be JSON encoded")
+		}
+		decoded := &Common{EngineConfig: new(testEngineConfig)}
+		if err := Unmarshal(b, decoded); err != nil {
+			t.Fatalf("unexpected error: %s", err)
+		}
+		if name, err := EngineName(b); err != nil || name != "test" {
+			t.Errorf("unexpected engine name %q: %v", name, err)
+		}
+	}
+}
+
+func TestBinaryEncodingFingerprint(t *testing.T) {
+	c := &Common{EngineName: "test", EngineConfig: &testMount{Source: "/tmp"}}
+	b, err := Marshal(c, BinaryEncoding)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	decoded := &Common{EngineConfig: new(testLimits)}
+	if err := Unmarshal(b, decoded); err == nil {
+		t.Errorf("unexpected success with a different configuration type")
+	}
+}
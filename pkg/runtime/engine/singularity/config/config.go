@@ -48,8 +48,11 @@ type JSONConfig struct {
 	DNS               string        `json:"dns,omitempty"`
 	Cwd               string        `json:"cwd,omitempty"`
 	SessionLayer      string        `json:"sessionLayer,omitempty"`
+	PrefetchRecord    string        `json:"prefetchRecord,omitempty"`
+	IdentityCacheDir  string        `json:"identityCacheDir,omitempty"`
 	EncryptionKey     []byte        `json:"encryptionKey,omitempty"`
 	TargetUID         int           `json:"targetUID,omitempty"`
+	ImageFuseFd       int           `json:"imageFuseFd,omitempty"`
 	WritableImage     bool          `json:"writableImage,omitempty"`
 	WritableTmpfs     bool          `json:"writableTmpfs,omitempty"`
 	Contain           bool          `json:"container,omitempty"`
@@ -68,6 +71,7 @@ type JSONConfig struct {
 	DeleteImage       bool          `json:"deleteImage,omitempty"`
 	Fakeroot          bool          `json:"fakeroot,omitempty"`
 	SignalPropagation bool          `json:"signalPropagation,omitempty"`
+	Zygote            bool          `json:"zygote,omitempty"`
 }
 
 // SetImage sets the container image path to be used by EngineConfig.JSON.
@@ -250,6 +254,17 @@ func (e *EngineConfig) GetInstanceJoin() bool {
 	return e.JSON.InstanceJoin
 }
 
+// SetZygote sets if instance runs in zygote mode, serving exec
+// requests from its container process.
+func (e *EngineConfig) SetZygote(zygote bool) {
+	e.JSON.Zygote = zygote
+}
+
+// GetZygote returns if instance runs in zygote mode or not.
+func (e *EngineConfig) GetZygote() bool {
+	return e.JSON.Zygote
+}
+
 // SetBootInstance sets boot flag to execute /sbin/init as main instance process.
 func (e *EngineConfig) SetBootInstance(boot bool) {
 	e.JSON.BootInstance = boot
@@ -528,3 +543,41 @@ func (e *EngineConfig) GetSessionLayer() string {
 func (e *EngineConfig) SetSessionLayer(sessionLayer string) {
 	e.JSON.SessionLayer = sessionLayer
 }
+
+// SetImageFuseFd sets the /dev/fuse file descriptor used to mount
+// the root filesystem image with a FUSE driver instead of a loop
+// device.
+func (e *EngineConfig) SetImageFuseFd(fd int) {
+	e.JSON.ImageFuseFd = fd
+}
+
+// GetImageFuseFd returns the /dev/fuse file descriptor used to mount
+// the root filesystem image, zero means that the root filesystem image
+// is mounted with a loop device.
+func (e *EngineConfig) GetImageFuseFd() int {
+	return e.JSON.ImageFuseFd
+}
+
+// SetPrefetchRecord sets the path of the prefetch manifest listing the
+// image files opened by the container, written once the container exits.
+func (e *EngineConfig) SetPrefetchRecord(path string) {
+	e.JSON.PrefetchRecord = path
+}
+
+// GetPrefetchRecord returns the path of the prefetch manifest recorded
+// for the container, an empty path means no recording.
+func (e *EngineConfig) GetPrefetchRecord() string {
+	return e.JSON.PrefetchRecord
+}
+
+// SetIdentityCacheDir sets the directory where the user and group entries
+// looked up for the container passwd and group files are stored.
+func (e *EngineConfig) SetIdentityCacheDir(dir string) {
+	e.JSON.IdentityCacheDir = dir
+}
+
+// GetIdentityCacheDir returns the directory where the user and group
+// entries are stored, an empty directory means they are not stored.
+func (e *EngineConfig) GetIdentityCacheDir() string {
+	return e.JSON.IdentityCacheDir
+}
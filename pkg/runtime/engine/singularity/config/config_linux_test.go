@@ -0,0 +1,143 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package singularity
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"strings"
+	"testing"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+	"github.com/sylabs/singularity/pkg/image"
+	"github.com/sylabs/singularity/pkg/runtime/engine/config"
+)
+
+// stages is the number of times the engine configuration is
+// decoded during a container launch: stage 1, RPC server, master
+// and stage 2.
+const stages = 4
+
+// launchConfig returns a configuration with 200 bind mounts and a
+// 50KB environment.
+func launchConfig() *config.Common {
+	e := NewConfig()
+
+	e.JSON.Image = "/home/user/images/lolcow.sif"
+	e.JSON.ImageList = []image.Image{
+		{
+			Path:       "/home/user/images/lolcow.sif",
+			Name:       "lolcow.sif",
+			Type:       image.SIF,
+			Fd:         3,
+			Partitions: []image.Section{{Size: 75100160, Offset: 40960, Type: image.SQUASHFS, Name: "!__rootfs__!"}},
+		},
+	}
+	e.JSON.HomeSource = "/home/user"
+	e.JSON.HomeDest = "/home/user"
+	e.JSON.TargetUID = 1000
+	e.JSON.TargetGID = []int{1000, 10}
+
+	e.OciConfig.Process = &specs.Process{
+		Args:         []string{"/.singularity.d/actions/run"},
+		Cwd:          "/home/user",
+		Capabilities: &specs.LinuxCapabilities{},
+	}
+	e.OciConfig.Linux = &specs.Linux{
+		Namespaces: []specs.LinuxNamespace{{Type: specs.MountNamespace}},
+	}
+
+	for i := 0; i < 200; i++ {
+		source := fmt.Sprintf("/scratch/user/project/dataset%d", i)
+		destination := fmt.Sprintf("/data/dataset%d", i)
+		e.JSON.BindPath = append(e.JSON.BindPath, source+":"+destination)
+		e.OciConfig.Mounts = append(e.OciConfig.Mounts, specs.Mount{
+			Source:      source,
+			Destination: destination,
+			Type:        "none",
+			Options:     []string{"bind", "nosuid", "nodev"},
+		})
+	}
+
+	for size := 0; size < 50*1024; {
+		env := fmt.Sprintf("SINGULARITYENV_VAR%d=%s", len(e.OciConfig.Process.Env), strings.Repeat("x", 96))
+		e.OciConfig.Process.Env = append(e.OciConfig.Process.Env, env)
+		size += len(env)
+	}
+
+	return &config.Common{
+		EngineName:   Name,
+		ContainerID:  "lolcow",
+		EngineConfig: e,
+	}
+}
+
+func TestEncoding(t *testing.T) {
+	c := launchConfig()
+
+	expected, err := json.Marshal(c)
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+
+	for _, enc := range []config.Encoding{config.JSONEncoding, config.BinaryEncoding} {
+		b, err := config.Marshal(c, enc)
+		if err != nil {
+			t.Fatalf("unexpected error: %s", err)
+		}
+		if config.EncodingOf(b) != enc {
+			t.Fatalf("configuration not encoded with encoding %d", enc)
+		}
+
+		decoded := &config.Common{EngineConfig: NewConfig()}
+		if err := config.Unmarshal(b, decoded); err != nil {
+			t.Fatalf("unexpected error: %s", err)
+		}
+		if decoded.EngineConfig.(*EngineConfig).OciConfig.Generator.Config == nil {
+			t.Errorf("OCI generator not initialized")
+		}
+
+		// both encodings must result in the same configuration
+		got, err := json.Marshal(decoded)
+		if err != nil {
+			t.Fatalf("unexpected error: %s", err)
+		}
+		if !bytes.Equal(got, expected) {
+			t.Errorf("decoded configuration with encoding %d differs from original", enc)
+		}
+	}
+}
+
+func BenchmarkDecode(b *testing.B) {
+	c := launchConfig()
+
+	for _, enc := range []config.Encoding{config.JSONEncoding, config.BinaryEncoding} {
+		data, err := config.Marshal(c, enc)
+		if err != nil {
+			b.Fatalf("unexpected error: %s", err)
+		}
+
+		name := "json"
+		if enc == config.BinaryEncoding {
+			name = "binary"
+		}
+
+		b.Run(name, func(b *testing.B) {
+			b.ReportAllocs()
+			b.ReportMetric(float64(len(data)), "bytes")
+
+			for i := 0; i < b.N; i++ {
+				for s := 0; s < stages; s++ {
+					decoded := &config.Common{EngineConfig: NewConfig()}
+					if err := config.Unmarshal(data, decoded); err != nil {
+						b.Fatalf("unexpected error: %s", err)
+					}
+				}
+			}
+		})
+	}
+}
@@ -15,11 +15,22 @@ import (
 
 // Exclusive applies an exclusive lock on path
 func Exclusive(path string) (fd int, err error) {
+	return flock(path, unix.LOCK_EX)
+}
+
+// TryExclusive applies an exclusive lock on path like Exclusive, except
+// that it returns unix.EWOULDBLOCK instead of waiting if path is already
+// locked.
+func TryExclusive(path string) (fd int, err error) {
+	return flock(path, unix.LOCK_EX|unix.LOCK_NB)
+}
+
+func flock(path string, how int) (fd int, err error) {
 	fd, err = unix.Open(path, os.O_RDONLY, 0)
 	if err != nil {
 		return fd, err
 	}
-	err = unix.Flock(fd, unix.LOCK_EX)
+	err = unix.Flock(fd, how)
 	if err != nil {
 		unix.Close(fd)
 		return fd, err
@@ -12,6 +12,7 @@ import (
 	"time"
 
 	"github.com/sylabs/singularity/internal/pkg/test"
+	"golang.org/x/sys/unix"
 )
 
 func TestExclusive(t *testing.T) {
@@ -45,6 +46,26 @@ func TestExclusive(t *testing.T) {
 	}
 }
 
+func TestTryExclusive(t *testing.T) {
+	test.DropPrivilege(t)
+	defer test.ResetPrivilege(t)
+
+	fd, err := TryExclusive("/dev")
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, err := TryExclusive("/dev"); err != unix.EWOULDBLOCK {
+		t.Errorf("unexpected error with a locked path: %v", err)
+	}
+	Release(fd)
+
+	fd, err = TryExclusive("/dev")
+	if err != nil {
+		t.Errorf("unexpected error with a released path: %s", err)
+	}
+	Release(fd)
+}
+
 func TestByteRange(t *testing.T) {
 	test.DropPrivilege(t)
 	defer test.ResetPrivilege(t)
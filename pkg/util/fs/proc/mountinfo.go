@@ -0,0 +1,196 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package proc
+
+import (
+	"bufio"
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"syscall"
+
+	"golang.org/x/sys/unix"
+)
+
+// procSuperMagic is the procfs filesystem type.
+const procSuperMagic = 0x9fa0
+
+// MountInfo is a parsed snapshot of a mountinfo file, indexed by mount
+// point and by device. Snapshots are shared and must not be modified.
+type MountInfo struct {
+	entries []MountInfoEntry
+	points  map[string][]int
+	devs    map[string][]int
+}
+
+// parseMountInfo parses the mountinfo content read from r.
+func parseMountInfo(r io.Reader) (*MountInfo, error) {
+	m := &MountInfo{
+		entries: make([]MountInfoEntry, 0),
+		points:  make(map[string][]int),
+		devs:    make(map[string][]int),
+	}
+
+	scanner := bufio.NewScanner(r)
+	for scanner.Scan() {
+		entry := parseMountInfoLine(scanner.Text())
+		m.points[entry.Point] = append(m.points[entry.Point], len(m.entries))
+		m.devs[entry.Dev] = append(m.devs[entry.Dev], len(m.entries))
+		m.entries = append(m.entries, entry)
+	}
+	if err := scanner.Err(); err != nil {
+		return nil, err
+	}
+
+	return m, nil
+}
+
+// Entries returns the mountinfo entries in the mountinfo file order.
+func (m *MountInfo) Entries() []MountInfoEntry {
+	return m.entries
+}
+
+// IsMounted returns whether a filesystem is mounted on point.
+func (m *MountInfo) IsMounted(point string) bool {
+	return len(m.points[point]) > 0
+}
+
+// PointMap returns a map of parent mount points with associated child
+// mount points.
+func (m *MountInfo) PointMap() map[string][]string {
+	mp := make(map[string][]string)
+	ids := make(map[string]int, len(m.entries))
+
+	// the last entry of a mount ID takes precedence
+	for i, e := range m.entries {
+		ids[e.ID] = i
+	}
+	for _, i := range ids {
+		e := m.entries[i]
+		if p, ok := ids[e.ParentID]; ok {
+			point := m.entries[p].Point
+			if e.Point != point {
+				mp[point] = append(mp[point], e.Point)
+			}
+		}
+	}
+	return mp
+}
+
+// FindParentMountEntry finds the parent mount point entry associated
+// to the provided path, looking up the entries of the path device only.
+func (m *MountInfo) FindParentMountEntry(path string) (*MountInfoEntry, error) {
+	p, dev, err := pathDevice(path)
+	if err != nil {
+		return nil, err
+	}
+
+	var entry *MountInfoEntry
+	matchLen := 0
+
+	for _, i := range m.devs[dev] {
+		// find the longest mount point for the provided path
+		if e := &m.entries[i]; strings.HasPrefix(p, e.Point) && len(e.Point) > matchLen {
+			matchLen = len(e.Point)
+			entry = e
+		}
+	}
+
+	if entry == nil {
+		return nil, fmt.Errorf("no parent mount point found")
+	}
+
+	return entry, nil
+}
+
+// mountInfoCache holds the snapshot of a procfs mountinfo file along
+// with the file kept open to poll mount table changes.
+type mountInfoCache struct {
+	file *os.File
+	ns   uint64
+	info *MountInfo
+}
+
+var mountInfoCaches = struct {
+	sync.Mutex
+	m map[string]*mountInfoCache
+}{
+	m: make(map[string]*mountInfoCache),
+}
+
+// mountNamespace returns the inode of the mount namespace of the process
+// whose mountinfo file is path, or 0 if it can't be determined.
+func mountNamespace(path string) uint64 {
+	var st syscall.Stat_t
+	if err := syscall.Stat(filepath.Join(filepath.Dir(path), "ns", "mnt"), &st); err != nil {
+		return 0
+	}
+	return st.Ino
+}
+
+// changed returns whether the mount table changed since the snapshot
+// was parsed. The kernel reports changes of the mount namespace to the
+// open mountinfo files with POLLPRI and POLLERR events, the snapshot
+// is also discarded if the process joined another mount namespace.
+func (c *mountInfoCache) changed(path string) bool {
+	if mountNamespace(path) != c.ns {
+		return true
+	}
+	fds := []unix.PollFd{{Fd: int32(c.file.Fd()), Events: unix.POLLPRI}}
+	n, err := unix.Poll(fds, 0)
+	if err != nil {
+		return true
+	}
+	return n > 0 && fds[0].Revents&(unix.POLLPRI|unix.POLLERR) != 0
+}
+
+// GetMountInfo returns the parsed snapshot of the mountinfo file path.
+// Snapshots of /proc mountinfo files are shared until the mount table
+// changes, including with the mounts done by the calling process, other
+// files are parsed on each call.
+func GetMountInfo(path string) (*MountInfo, error) {
+	mountInfoCaches.Lock()
+	defer mountInfoCaches.Unlock()
+
+	if c, ok := mountInfoCaches.m[path]; ok {
+		if !c.changed(path) {
+			return c.info, nil
+		}
+		c.file.Close()
+		delete(mountInfoCaches.m, path)
+	}
+
+	// the file is opened in blocking mode to not be registered
+	// by the Go runtime poller which would consume the events
+	fd, err := syscall.Open(path, syscall.O_RDONLY|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return nil, fmt.Errorf("can't open %s: %s", path, err)
+	}
+	f := os.NewFile(uintptr(fd), path)
+
+	info, err := parseMountInfo(f)
+	if err != nil {
+		f.Close()
+		return nil, fmt.Errorf("while reading %s: %s", path, err)
+	}
+
+	var stfs unix.Statfs_t
+	ns := mountNamespace(path)
+	if ns == 0 || unix.Fstatfs(int(f.Fd()), &stfs) != nil || stfs.Type != procSuperMagic {
+		f.Close()
+		return info, nil
+	}
+	mountInfoCaches.m[path] = &mountInfoCache{
+		file: f,
+		ns:   ns,
+		info: info,
+	}
+
+	return info, nil
+}
@@ -38,31 +38,11 @@ func HasFilesystem(fs string) (bool, error) {
 // GetMountPointMap parses mountinfo pointing to path and returns
 // a map of parent mount points with associated child mount points.
 func GetMountPointMap(path string) (map[string][]string, error) {
-	mp := make(map[string][]string)
-	entries := make(map[string]MountInfoEntry)
-
-	p, err := os.Open(path)
+	info, err := GetMountInfo(path)
 	if err != nil {
-		return mp, fmt.Errorf("can't open %s: %s", path, err)
+		return make(map[string][]string), err
 	}
-	defer p.Close()
-
-	scanner := bufio.NewScanner(p)
-	for scanner.Scan() {
-		entry := parseMountInfoLine(scanner.Text())
-		entries[entry.ID] = entry
-	}
-
-	for e := range entries {
-		parentID := entries[e].ParentID
-		if i, ok := entries[parentID]; ok {
-			point := i.Point
-			if entries[e].Point != point {
-				mp[point] = append(mp[point], entries[e].Point)
-			}
-		}
-	}
-	return mp, nil
+	return info.PointMap(), nil
 }
 
 // MountInfoEntry contains parsed fields of a mountinfo line.
@@ -133,38 +113,46 @@ func parseMountInfoLine(line string) MountInfoEntry {
 // GetMountInfoEntry parses a mountinfo file and returns all
 // parsed entries as an array of MountInfoEntry.
 func GetMountInfoEntry(path string) ([]MountInfoEntry, error) {
-	p, err := os.Open(path)
+	info, err := GetMountInfo(path)
 	if err != nil {
-		return nil, fmt.Errorf("can't open %s: %s", path, err)
+		return nil, err
 	}
-	defer p.Close()
 
-	entries := make([]MountInfoEntry, 0)
-	scanner := bufio.NewScanner(p)
-	for scanner.Scan() {
-		entry := parseMountInfoLine(scanner.Text())
-		entries = append(entries, entry)
-	}
+	// entries of the shared snapshot are copied as
+	// callers may modify them
+	entries := make([]MountInfoEntry, len(info.Entries()))
+	copy(entries, info.Entries())
 
 	return entries, nil
 }
 
-// FindParentMountEntry finds the parent mount point entry associated
-// to the provided path among the entry list provided in argument.
-func FindParentMountEntry(path string, entries []MountInfoEntry) (*MountInfoEntry, error) {
+// pathDevice returns the path with symbolic links resolved and the
+// major:minor number of the device it's located on.
+func pathDevice(path string) (string, string, error) {
 	p, err := filepath.EvalSymlinks(path)
 	if err != nil {
-		return nil, fmt.Errorf("while resolving path %s: %s", path, err)
+		return "", "", fmt.Errorf("while resolving path %s: %s", path, err)
 	}
 
 	fi, err := os.Stat(p)
 	if err != nil {
-		return nil, fmt.Errorf("while getting stat for %s: %s", path, err)
+		return "", "", fmt.Errorf("while getting stat for %s: %s", path, err)
 	}
 	st := fi.Sys().(*syscall.Stat_t)
 	// cast to uint64 as st.Dev is uint32 on MIPS
 	dev := fmt.Sprintf("%d:%d", unix.Major(uint64(st.Dev)), unix.Minor(uint64(st.Dev)))
 
+	return p, dev, nil
+}
+
+// FindParentMountEntry finds the parent mount point entry associated
+// to the provided path among the entry list provided in argument.
+func FindParentMountEntry(path string, entries []MountInfoEntry) (*MountInfoEntry, error) {
+	p, dev, err := pathDevice(path)
+	if err != nil {
+		return nil, err
+	}
+
 	var entry *MountInfoEntry
 	matchLen := 0
 
@@ -189,12 +177,12 @@ func FindParentMountEntry(path string, entries []MountInfoEntry) (*MountInfoEntr
 // ParentMount parses mountinfo and returns the path of parent
 // mount point for which the provided path is mounted in.
 func ParentMount(path string) (string, error) {
-	entries, err := GetMountInfoEntry("/proc/self/mountinfo")
+	info, err := GetMountInfo("/proc/self/mountinfo")
 	if err != nil {
 		return "", fmt.Errorf("while parsing %s: %s", path, err)
 	}
 
-	entry, err := FindParentMountEntry(path, entries)
+	entry, err := info.FindParentMountEntry(path)
 	if err != nil {
 		return "", err
 	}
@@ -402,6 +402,57 @@ func TestParentMount(t *testing.T) {
 	}
 }
 
+func TestGetMountInfoSnapshot(t *testing.T) {
+	test.EnsurePrivilege(t)
+
+	const path = "/proc/self/mountinfo"
+
+	info, err := GetMountInfo(path)
+	if err != nil {
+		t.Fatalf("unexpected error while parsing %s: %s", path, err)
+	}
+	if !info.IsMounted("/proc") {
+		t.Errorf("/proc is not reported as mounted")
+	}
+	if cached, _ := GetMountInfo(path); cached != info {
+		t.Errorf("snapshot not shared while mount table is unchanged")
+	}
+
+	dir, err := ioutil.TempDir("", "mountinfo-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer os.RemoveAll(dir)
+
+	// mount table changes are reported by polling mountinfo
+	if err := syscall.Mount("tmpfs", dir, "tmpfs", 0, ""); err != nil {
+		t.Fatal(err)
+	}
+	info, err = GetMountInfo(path)
+	if err != nil {
+		t.Fatalf("unexpected error while parsing %s: %s", path, err)
+	}
+	if !info.IsMounted(dir) {
+		t.Errorf("%s mount not reported in snapshot", dir)
+	}
+	if e, err := info.FindParentMountEntry(dir); err != nil {
+		t.Error(err)
+	} else if e.Point != dir || e.FSType != "tmpfs" {
+		t.Errorf("wrong parent mount entry %s (%s) for %s", e.Point, e.FSType, dir)
+	}
+
+	if err := syscall.Unmount(dir, syscall.MNT_DETACH); err != nil {
+		t.Fatal(err)
+	}
+	info, err = GetMountInfo(path)
+	if err != nil {
+		t.Fatalf("unexpected error while parsing %s: %s", path, err)
+	}
+	if info.IsMounted(dir) {
+		t.Errorf("%s unmount not reported in snapshot", dir)
+	}
+}
+
 func TestSetOOMScoreAdj(t *testing.T) {
 	test.EnsurePrivilege(t)
 
@@ -0,0 +1,144 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package gpu
+
+import (
+	"encoding/json"
+	"io/ioutil"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"runtime"
+	"strings"
+	"syscall"
+
+	"github.com/sylabs/singularity/internal/pkg/client/cache"
+	"github.com/sylabs/singularity/internal/pkg/sylog"
+)
+
+// resolutionDir is the GPU resolution cache directory inside the cache
+// root directory.
+const resolutionDir = "gpu"
+
+// fileID identifies a file content by its identity and times, it's
+// the zero value for missing files.
+type fileID struct {
+	Path   string `json:"path"`
+	Device uint64 `json:"device"`
+	Inode  uint64 `json:"inode"`
+	Size   int64  `json:"size"`
+	Mtime  int64  `json:"mtime"`
+	Ctime  int64  `json:"ctime"`
+}
+
+func newFileID(path string) fileID {
+	var st syscall.Stat_t
+	if path == "" || syscall.Stat(path, &st) != nil {
+		return fileID{}
+	}
+	return fileID{
+		Path: path,
+		// cast to uint64 as st.Dev is uint32 on MIPS
+		Device: uint64(st.Dev),
+		Inode:  st.Ino,
+		Size:   st.Size,
+		Mtime:  st.Mtim.Nano(),
+		Ctime:  st.Ctim.Nano(),
+	}
+}
+
+// resolutionKey holds the inputs of a GPU libraries and binaries
+// resolution, a cached resolution is valid as long as they don't
+// change.
+type resolutionKey struct {
+	Arch    string `json:"arch"`
+	Path    string `json:"path"`
+	LdCache fileID `json:"ldcache"`
+	Config  fileID `json:"config"`
+	CLI     fileID `json:"cli"`
+	Driver  string `json:"driver"`
+}
+
+// resolution is a GPU resolution cache entry.
+type resolution struct {
+	Key       resolutionKey `json:"key"`
+	Libraries []string      `json:"libraries"`
+	Binaries  []string      `json:"binaries"`
+}
+
+// moduleVersion returns the version of the kernel module name, or its
+// source version if the module doesn't report a version.
+func moduleVersion(name string) string {
+	for _, f := range []string{"version", "srcversion"} {
+		b, err := ioutil.ReadFile(filepath.Join("/sys/module", name, f))
+		if err == nil {
+			return strings.TrimSpace(string(b))
+		}
+	}
+	return ""
+}
+
+// newResolutionKey returns the resolution key of the GPU library list
+// configFilePath, the libraries/binaries lister cli if any and the
+// kernel driver module, for the current PATH.
+func newResolutionKey(configFilePath string, cli string, module string) resolutionKey {
+	cliPath := ""
+	if cli != "" {
+		cliPath, _ = exec.LookPath(cli)
+	}
+	return resolutionKey{
+		Arch:    runtime.GOARCH,
+		Path:    os.Getenv("PATH"),
+		LdCache: newFileID(ldSoCache),
+		Config:  newFileID(configFilePath),
+		CLI:     newFileID(cliPath),
+		Driver:  moduleVersion(module),
+	}
+}
+
+// loadResolution returns the cached resolution name matching key, or
+// nil if there is none or if a resolved file doesn't exist anymore.
+func loadResolution(name string, key resolutionKey) *resolution {
+	dir := cache.DataDir(resolutionDir)
+	if dir == "" {
+		return nil
+	}
+
+	b, err := ioutil.ReadFile(filepath.Join(dir, name+".json"))
+	if err != nil {
+		return nil
+	}
+	r := new(resolution)
+	if err := json.Unmarshal(b, r); err != nil || r.Key != key {
+		return nil
+	}
+	for _, files := range [][]string{r.Libraries, r.Binaries} {
+		for _, f := range files {
+			if _, err := os.Stat(f); err != nil {
+				return nil
+			}
+		}
+	}
+
+	return r
+}
+
+// storeResolution stores the resolution name in the cache, this is
+// best-effort.
+func storeResolution(name string, r *resolution) {
+	dir := cache.DataDir(resolutionDir)
+	if dir == "" {
+		return
+	}
+
+	b, err := json.Marshal(r)
+	if err != nil {
+		return
+	}
+	if err := cache.WriteDataFile(filepath.Join(dir, name+".json"), b); err != nil {
+		sylog.Debugf("Could not store GPU resolution cache entry: %s", err)
+	}
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package gpu
+
+import (
+	"bytes"
+	"encoding/binary"
+	"fmt"
+	"io/ioutil"
+	"unsafe"
+)
+
+// ldSoCache is the dynamic linker cache read by ldconfig -p.
+const ldSoCache = "/etc/ld.so.cache"
+
+const (
+	// ldCacheOldMagic starts the libc5 compatible format, possibly
+	// followed by the new format.
+	ldCacheOldMagic = "ld.so-1.7.0"
+	// ldCacheNewMagic starts the glibc format.
+	ldCacheNewMagic = "glibc-ld.so.cache1.1"
+
+	// ldCacheOldHeader is the size of the old format header, the
+	// magic padded to 12 bytes followed by the number of entries.
+	ldCacheOldHeader = 16
+	// ldCacheOldEntry is the size of old format entries: flags,
+	// key and value string offsets.
+	ldCacheOldEntry = 12
+	// ldCacheNewHeader is the size of the new format header, the
+	// number of entries is stored after the magic.
+	ldCacheNewHeader = 48
+	// ldCacheNewEntry is the size of new format entries: flags, key
+	// and value string offsets, OS version and hardware capabilities.
+	ldCacheNewEntry = 24
+)
+
+// nativeEndian is the byte order of ld.so.cache, written by the host
+// ldconfig.
+var nativeEndian binary.ByteOrder = binary.LittleEndian
+
+func init() {
+	i := uint16(1)
+	if *(*byte)(unsafe.Pointer(&i)) == 0 {
+		nativeEndian = binary.BigEndian
+	}
+}
+
+// cString returns the NUL terminated string at offset off of b.
+func cString(b []byte, off uint32) (string, error) {
+	if uint64(off) >= uint64(len(b)) {
+		return "", fmt.Errorf("string offset %d out of bounds", off)
+	}
+	n := bytes.IndexByte(b[off:], 0)
+	if n < 0 {
+		return "", fmt.Errorf("unterminated string at offset %d", off)
+	}
+	return string(b[off : off+uint32(n)]), nil
+}
+
+// parseLdCacheEntries returns the library paths with the associated
+// library names of the cache entries of size entrySize, key and value
+// being offsets of strings.
+func parseLdCacheEntries(entries []byte, entrySize int, strings []byte) (map[string]string, error) {
+	libs := make(map[string]string, len(entries)/entrySize)
+	for off := 0; off+entrySize <= len(entries); off += entrySize {
+		e := entries[off : off+entrySize]
+		name, err := cString(strings, nativeEndian.Uint32(e[4:8]))
+		if err != nil {
+			return nil, err
+		}
+		path, err := cString(strings, nativeEndian.Uint32(e[8:12]))
+		if err != nil {
+			return nil, err
+		}
+		libs[path] = name
+	}
+	return libs, nil
+}
+
+// parseLdCacheNew parses the new format, string offsets are relative
+// to the new format header.
+func parseLdCacheNew(b []byte) (map[string]string, error) {
+	if len(b) < ldCacheNewHeader {
+		return nil, fmt.Errorf("truncated cache header")
+	}
+	nlibs := nativeEndian.Uint32(b[20:24])
+	end := uint64(ldCacheNewHeader) + uint64(nlibs)*ldCacheNewEntry
+	if end > uint64(len(b)) {
+		return nil, fmt.Errorf("truncated cache entries")
+	}
+	return parseLdCacheEntries(b[ldCacheNewHeader:end], ldCacheNewEntry, b)
+}
+
+// parseLdCache parses the content of ld.so.cache and returns the library
+// paths with the associated library names, as listed by ldconfig -p.
+func parseLdCache(b []byte) (map[string]string, error) {
+	if bytes.HasPrefix(b, []byte(ldCacheNewMagic)) {
+		return parseLdCacheNew(b)
+	} else if !bytes.HasPrefix(b, []byte(ldCacheOldMagic)) {
+		return nil, fmt.Errorf("unknown cache format")
+	}
+
+	if len(b) < ldCacheOldHeader {
+		return nil, fmt.Errorf("truncated cache header")
+	}
+	nlibs := nativeEndian.Uint32(b[12:16])
+	end := uint64(ldCacheOldHeader) + uint64(nlibs)*ldCacheOldEntry
+	if end > uint64(len(b)) {
+		return nil, fmt.Errorf("truncated cache entries")
+	}
+
+	// the new format follows the old entries when present, aligned
+	// on 8 or 4 bytes depending on the architecture
+	for _, align := range []uint64{8, 4} {
+		off := (end + align - 1) &^ (align - 1)
+		if off < uint64(len(b)) && bytes.HasPrefix(b[off:], []byte(ldCacheNewMagic)) {
+			return parseLdCacheNew(b[off:])
+		}
+	}
+
+	// old format only, strings follow the entries
+	return parseLdCacheEntries(b[ldCacheOldHeader:end], ldCacheOldEntry, b[end:])
+}
+
+// readLdCache reads the host dynamic linker cache natively.
+func readLdCache() (map[string]string, error) {
+	b, err := ioutil.ReadFile(ldSoCache)
+	if err != nil {
+		return nil, err
+	}
+	libs, err := parseLdCache(b)
+	if err != nil {
+		return nil, fmt.Errorf("while parsing %s: %s", ldSoCache, err)
+	}
+	return libs, nil
+}
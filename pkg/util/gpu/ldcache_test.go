@@ -0,0 +1,141 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package gpu
+
+import (
+	"bytes"
+	"os"
+	"testing"
+)
+
+// ldCacheEntry is a library name and path stored in a test cache.
+type ldCacheEntry struct {
+	name string
+	path string
+}
+
+// buildLdCache returns a cache in the old format if old is true, followed
+// by the new format with entries aligned on align bytes if align is not 0.
+func buildLdCache(entries []ldCacheEntry, old bool, align int) []byte {
+	var b bytes.Buffer
+
+	u32 := func(buf *bytes.Buffer, v uint32) {
+		var n [4]byte
+		nativeEndian.PutUint32(n[:], v)
+		buf.Write(n[:])
+	}
+
+	if old {
+		var strs bytes.Buffer
+		b.WriteString(ldCacheOldMagic)
+		b.WriteByte(0)
+		u32(&b, uint32(len(entries)))
+		for _, e := range entries {
+			u32(&b, 1)
+			u32(&b, uint32(strs.Len()))
+			strs.WriteString(e.name + "\x00")
+			u32(&b, uint32(strs.Len()))
+			strs.WriteString(e.path + "\x00")
+		}
+		if align == 0 {
+			b.Write(strs.Bytes())
+			return b.Bytes()
+		}
+		for b.Len()%align != 0 {
+			b.WriteByte(0)
+		}
+	}
+	if align == 0 {
+		return b.Bytes()
+	}
+
+	// string offsets are relative to the new format header
+	var strs bytes.Buffer
+	strsOff := ldCacheNewHeader + len(entries)*ldCacheNewEntry
+	var hdr bytes.Buffer
+	hdr.WriteString(ldCacheNewMagic)
+	u32(&hdr, uint32(len(entries)))
+	hdr.Write(make([]byte, ldCacheNewHeader-hdr.Len()))
+	for _, e := range entries {
+		u32(&hdr, 0x303)
+		u32(&hdr, uint32(strsOff+strs.Len()))
+		strs.WriteString(e.name + "\x00")
+		u32(&hdr, uint32(strsOff+strs.Len()))
+		strs.WriteString(e.path + "\x00")
+		hdr.Write(make([]byte, ldCacheNewEntry-12))
+	}
+	b.Write(hdr.Bytes())
+	b.Write(strs.Bytes())
+
+	return b.Bytes()
+}
+
+func TestParseLdCache(t *testing.T) {
+	entries := []ldCacheEntry{
+		{"libnvidia-ml.so.1", "/usr/lib64/nvidia/libnvidia-ml.so.1"},
+		{"libcuda.so.1", "/usr/lib64/nvidia/libcuda.so.1"},
+		{"libc.so.6", "/lib64/libc.so.6"},
+	}
+
+	tests := []struct {
+		name  string
+		old   bool
+		align int
+	}{
+		{"new", false, 1},
+		{"old", true, 0},
+		{"compat", true, 8},
+		{"compat32", true, 4},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			libs, err := parseLdCache(buildLdCache(entries, tt.old, tt.align))
+			if err != nil {
+				t.Fatalf("unexpected error: %s", err)
+			}
+			if len(libs) != len(entries) {
+				t.Errorf("got %d libraries instead of %d", len(libs), len(entries))
+			}
+			for _, e := range entries {
+				if libs[e.path] != e.name {
+					t.Errorf("got %q for %s instead of %q", libs[e.path], e.path, e.name)
+				}
+			}
+		})
+	}
+
+	b := buildLdCache(entries, false, 1)
+	if _, err := parseLdCache(b[:len(b)-8]); err == nil {
+		t.Errorf("unexpected success with a truncated cache")
+	}
+	if _, err := parseLdCache(b[:ldCacheNewHeader]); err == nil {
+		t.Errorf("unexpected success with truncated entries")
+	}
+	if _, err := parseLdCache([]byte("unknown")); err == nil {
+		t.Errorf("unexpected success with an unknown format")
+	}
+}
+
+func TestReadLdCache(t *testing.T) {
+	if _, err := os.Stat(ldSoCache); err != nil {
+		t.Skipf("%s not found", ldSoCache)
+	}
+	expected, err := ldconfigCache()
+	if err != nil {
+		t.Skipf("ldconfig not available: %s", err)
+	}
+
+	libs, err := readLdCache()
+	if err != nil {
+		t.Fatalf("unexpected error: %s", err)
+	}
+	for path, name := range expected {
+		if libs[path] != name {
+			t.Errorf("got %q for %s instead of %q", libs[path], path, name)
+		}
+	}
+}
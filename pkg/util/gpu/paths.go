@@ -88,6 +88,12 @@ func NvidiaPaths(configFilePath, userEnvPath string) ([]string, []string, error)
 		defer os.Setenv("PATH", oldPath)
 	}
 
+	key := newResolutionKey(configFilePath, "nvidia-container-cli", "nvidia")
+	if r := loadResolution("nvidia", key); r != nil {
+		sylog.Debugf("Using cached Nvidia libraries/binaries resolution")
+		return r.Libraries, r.Binaries, nil
+	}
+
 	// Parse nvidia-container-cli for the necessary binaries/libs, fallback to a
 	// list of required binaries/libs if the nvidia-container-cli is unavailable
 	nvidiaFiles, err := nvidiaContainerCli("list", "--binaries", "--libraries")
@@ -101,7 +107,7 @@ func NvidiaPaths(configFilePath, userEnvPath string) ([]string, []string, error)
 		}
 	}
 
-	return paths(nvidiaFiles)
+	return cachedPaths("nvidia", key, nvidiaFiles)
 }
 
 // RocmPaths returns a list of rocm libraries/binaries that should be
@@ -113,48 +119,56 @@ func RocmPaths(configFilePath, userEnvPath string) ([]string, []string, error) {
 		defer os.Setenv("PATH", oldPath)
 	}
 
+	key := newResolutionKey(configFilePath, "", "amdgpu")
+	if r := loadResolution("rocm", key); r != nil {
+		sylog.Debugf("Using cached rocm libraries/binaries resolution")
+		return r.Libraries, r.Binaries, nil
+	}
+
 	rocmFiles, err := gpuliblist(configFilePath)
 	if err != nil {
 		return nil, nil, fmt.Errorf("could not read %s: %v", filepath.Base(configFilePath), err)
 	}
 
-	return paths(rocmFiles)
+	return cachedPaths("rocm", key, rocmFiles)
 }
 
-// paths handles generic library parsing functionality once the platform
-// specific libs/binaries have been identified
-func paths(gpuFileList []string) ([]string, []string, error) {
-	// walk through the ldconfig output and add entries which contain the filenames
-	// returned by nvidia-container-cli OR the nvliblist.conf file contents
+// cachedPaths resolves the libraries/binaries of gpuFileList with paths
+// and stores the resolution in the cache with key
+func cachedPaths(name string, key resolutionKey, gpuFileList []string) ([]string, []string, error) {
+	libraries, binaries, err := paths(gpuFileList)
+	if err != nil {
+		return nil, nil, err
+	}
+	storeResolution(name, &resolution{
+		Key:       key,
+		Libraries: libraries,
+		Binaries:  binaries,
+	})
+	return libraries, binaries, nil
+}
+
+// ldconfigCache returns the library paths with the associated library
+// names listed by ldconfig -p
+func ldconfigCache() (map[string]string, error) {
 	ldConfig, err := exec.LookPath("ldconfig")
 	if ee, ok := err.(*exec.Error); ok && ee.Err == exec.ErrNotFound {
 		sylog.Debugf("Could not find ldconfig in PATH")
 		ldConfig = "ldconfig"
 	}
 	if err != nil {
-		return nil, nil, fmt.Errorf("could not lookup ldconfig: %v", err)
+		return nil, fmt.Errorf("could not lookup ldconfig: %v", err)
 	}
 	out, err := exec.Command(ldConfig, "-p").Output()
 	if err != nil {
-		return nil, nil, fmt.Errorf("could not execute ldconfig: %v", err)
+		return nil, fmt.Errorf("could not execute ldconfig: %v", err)
 	}
 
 	// sample ldconfig -p output:
 	// libnvidia-ml.so.1 (libc6,x86-64) => /usr/lib64/nvidia/libnvidia-ml.so.1
 	r, err := regexp.Compile(`(?m)^(.*)\s*\(.*\)\s*=>\s*(.*)$`)
 	if err != nil {
-		return nil, nil, fmt.Errorf("could not compile ldconfig regexp: %v", err)
-	}
-
-	// get elf machine to match correct libraries during ldconfig lookup
-	self, err := elf.Open("/proc/self/exe")
-	if err != nil {
-		return nil, nil, fmt.Errorf("could not open /proc/self/exe: %v", err)
-	}
-
-	machine := self.Machine
-	if err := self.Close(); err != nil {
-		sylog.Warningf("Could not close ELF: %v", err)
+		return nil, fmt.Errorf("could not compile ldconfig regexp: %v", err)
 	}
 
 	// store library name with associated path
@@ -168,6 +182,35 @@ func paths(gpuFileList []string) ([]string, []string, error) {
 			ldCache[libPath] = libName
 		}
 	}
+	return ldCache, nil
+}
+
+// paths handles generic library parsing functionality once the platform
+// specific libs/binaries have been identified
+func paths(gpuFileList []string) ([]string, []string, error) {
+	// walk through the dynamic linker cache and add entries which contain the
+	// filenames returned by nvidia-container-cli OR the nvliblist.conf file
+	// contents, the cache is read directly and ldconfig is only executed if
+	// its format is not supported
+	ldCache, err := readLdCache()
+	if err != nil {
+		sylog.Debugf("Falling back to ldconfig: %s", err)
+		ldCache, err = ldconfigCache()
+		if err != nil {
+			return nil, nil, err
+		}
+	}
+
+	// get elf machine to match correct libraries during ldconfig lookup
+	self, err := elf.Open("/proc/self/exe")
+	if err != nil {
+		return nil, nil, fmt.Errorf("could not open /proc/self/exe: %v", err)
+	}
+
+	machine := self.Machine
+	if err := self.Close(); err != nil {
+		sylog.Warningf("Could not close ELF: %v", err)
+	}
 
 	// trach binaries/libraries to eliminate duplicates
 	bins := make(map[string]struct{})
@@ -0,0 +1,231 @@
+// Copyright (c) 2019, Sylabs Inc. All rights reserved.
+// This software is licensed under a 3-clause BSD license. Please consult the
+// LICENSE.md file distributed with the sources of this project regarding your
+// rights to use or distribute this software.
+
+package loop
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"os"
+	"syscall"
+)
+
+// indexPath is the path of the host loop device index, it lives
+// in /run to not survive a reboot.
+var indexPath = "/run/singularity-loop.index"
+
+// errNoIndex is returned when the loop device index can't be used.
+var errNoIndex = errors.New("loop device index not available")
+
+// indexEntrySize is the size of an index entry, the entry of loop
+// device N is stored at offset N*indexEntrySize.
+const indexEntrySize = 40
+
+// indexEntry identifies the image backing a loop device, an entry
+// with a zero inode is free.
+type indexEntry struct {
+	Device    uint64
+	Inode     uint64
+	Offset    uint64
+	SizeLimit uint64
+	Flags     uint64
+}
+
+// newIndexEntry returns the entry of image attached with info.
+func newIndexEntry(image *os.File, info *Info64) (indexEntry, error) {
+	var e indexEntry
+
+	fi, err := image.Stat()
+	if err != nil {
+		return e, err
+	}
+	st := fi.Sys().(*syscall.Stat_t)
+
+	// cast to uint64 as st.Dev is uint32 on MIPS
+	e.Device = uint64(st.Dev)
+	e.Inode = st.Ino
+	if info != nil {
+		e.Offset = info.Offset
+		e.SizeLimit = info.SizeLimit
+		e.Flags = uint64(info.Flags & FlagsReadOnly)
+	}
+	return e, nil
+}
+
+// match returns if the loop device status corresponds to the entry.
+func (e indexEntry) match(status *Info64) bool {
+	return status.Inode == e.Inode && status.Device == e.Device &&
+		status.Offset == e.Offset && status.SizeLimit == e.SizeLimit &&
+		uint64(status.Flags&FlagsReadOnly) == e.Flags
+}
+
+// index maps images to the loop devices they are attached to. Entries
+// are hints only, they must be checked against the loop device status
+// before use.
+type index struct {
+	fd int
+}
+
+// openIndex opens the loop device index, the index file is created
+// if it doesn't exist yet.
+func openIndex() (*index, error) {
+	fd, err := syscall.Open(indexPath, syscall.O_RDWR|syscall.O_CREAT|syscall.O_NOFOLLOW|syscall.O_CLOEXEC, 0600)
+	if err != nil {
+		return nil, errNoIndex
+	}
+
+	// ignore an index which could have been tampered with
+	var st syscall.Stat_t
+	if err := syscall.Fstat(fd, &st); err != nil || st.Mode&syscall.S_IFMT != syscall.S_IFREG || st.Uid != uint32(os.Geteuid()) {
+		syscall.Close(fd)
+		return nil, errNoIndex
+	}
+
+	return &index{fd: fd}, nil
+}
+
+// lock applies an exclusive lock on the index until close.
+func (i *index) lock() error {
+	return syscall.Flock(i.fd, syscall.LOCK_EX)
+}
+
+func (i *index) close() {
+	syscall.Close(i.fd)
+}
+
+// read returns the entries of the first max loop devices.
+func (i *index) read(max int) ([]indexEntry, error) {
+	buf := make([]byte, max*indexEntrySize)
+
+	n, err := syscall.Pread(i.fd, buf, 0)
+	if err != nil {
+		return nil, fmt.Errorf("failed to read loop device index: %s", err)
+	}
+
+	entries := make([]indexEntry, n/indexEntrySize)
+	for j := range entries {
+		b := buf[j*indexEntrySize:]
+		entries[j] = indexEntry{
+			Device:    binary.LittleEndian.Uint64(b[0:]),
+			Inode:     binary.LittleEndian.Uint64(b[8:]),
+			Offset:    binary.LittleEndian.Uint64(b[16:]),
+			SizeLimit: binary.LittleEndian.Uint64(b[24:]),
+			Flags:     binary.LittleEndian.Uint64(b[32:]),
+		}
+	}
+	return entries, nil
+}
+
+// write stores the entry of loop device number, each loop device
+// has its own entry so concurrent writers don't need to lock the
+// index.
+func (i *index) write(number int, e indexEntry) error {
+	var b [indexEntrySize]byte
+
+	binary.LittleEndian.PutUint64(b[0:], e.Device)
+	binary.LittleEndian.PutUint64(b[8:], e.Inode)
+	binary.LittleEndian.PutUint64(b[16:], e.Offset)
+	binary.LittleEndian.PutUint64(b[24:], e.SizeLimit)
+	binary.LittleEndian.PutUint64(b[32:], e.Flags)
+
+	if _, err := syscall.Pwrite(i.fd, b[:], int64(number*indexEntrySize)); err != nil {
+		return fmt.Errorf("failed to write loop device index: %s", err)
+	}
+	return nil
+}
+
+// indexAttached records in the index that image is attached to loop
+// device number, this is best-effort as the index is only a hint.
+func (loop *Device) indexAttached(number int, image *os.File) {
+	e, err := newIndexEntry(image, loop.Info)
+	if err != nil {
+		return
+	}
+	idx, err := openIndex()
+	if err != nil {
+		return
+	}
+	defer idx.close()
+
+	idx.write(number, e)
+}
+
+// attachShared looks up the index for a loop device already attached
+// to image and checks it against the loop device status, on miss image
+// is attached to a free loop device which is then added to the index.
+// The index lock serializes shared attachments, so the same image
+// can't be attached twice concurrently.
+func (loop *Device) attachShared(image *os.File, mode int, number *int) (int, error) {
+	e, err := newIndexEntry(image, loop.Info)
+	if err != nil {
+		return -1, err
+	}
+
+	idx, err := openIndex()
+	if err != nil {
+		return -1, err
+	}
+	defer idx.close()
+
+	if err := idx.lock(); err != nil {
+		return -1, errNoIndex
+	}
+
+	entries, err := idx.read(loop.MaxLoopDevices)
+	if err != nil {
+		return -1, err
+	}
+
+	for device, entry := range entries {
+		if entry != e {
+			continue
+		}
+		if loopFd := openAttached(device, mode, e); loopFd >= 0 {
+			*number = device
+			// keep the reference to the loop device file descriptor to
+			// be sure that the loop device won't be released between this
+			// check and the mount of the filesystem
+			return loopFd, nil
+		}
+		// stale entry, the loop device was released or reused
+		idx.write(device, indexEntry{})
+	}
+
+	free := *loop
+	free.Shared = false
+
+	loopFd, err := free.attachFree(image, mode, number)
+	if err == errNoLoopControl {
+		loopFd, err = free.attachScan(image, mode, number)
+	}
+	if err != nil {
+		return -1, err
+	}
+
+	idx.write(*number, e)
+
+	return loopFd, nil
+}
+
+// openAttached opens the loop device number and returns its file
+// descriptor if it's attached to the image identified by e, -1
+// otherwise.
+func openAttached(number int, mode int, e indexEntry) int {
+	path, err := createDevice(number)
+	if err != nil {
+		return -1
+	}
+	loopFd, err := syscall.Open(path, mode|syscall.O_CLOEXEC, 0600)
+	if err != nil {
+		return -1
+	}
+	status, err := GetStatusFromFd(uintptr(loopFd))
+	if err != nil || !e.match(status) {
+		syscall.Close(loopFd)
+		return -1
+	}
+	return loopFd
+}
@@ -37,15 +37,24 @@ const (
 
 // Loop device IOCTL commands
 const (
-	CmdSetFd       = 0x4C00
-	CmdClrFd       = 0x4C01
-	CmdSetStatus   = 0x4C02
-	CmdGetStatus   = 0x4C03
-	CmdSetStatus64 = 0x4C04
-	CmdGetStatus64 = 0x4C05
-	CmdChangeFd    = 0x4C06
-	CmdSetCapacity = 0x4C07
-	CmdSetDirectIO = 0x4C08
+	CmdSetFd        = 0x4C00
+	CmdClrFd        = 0x4C01
+	CmdSetStatus    = 0x4C02
+	CmdGetStatus    = 0x4C03
+	CmdSetStatus64  = 0x4C04
+	CmdGetStatus64  = 0x4C05
+	CmdChangeFd     = 0x4C06
+	CmdSetCapacity  = 0x4C07
+	CmdSetDirectIO  = 0x4C08
+	CmdSetBlockSize = 0x4C09
+	CmdConfigure    = 0x4C0A
+)
+
+// Loop control device IOCTL commands
+const (
+	CmdCtlAdd     = 0x4C80
+	CmdCtlRemove  = 0x4C81
+	CmdCtlGetFree = 0x4C82
 )
 
 // Info64 contains information about a loop device.
@@ -64,3 +73,12 @@ type Info64 struct {
 	EncryptKey     [32]byte
 	Init           [2]uint64
 }
+
+// Config contains loop device configuration passed
+// to CmdConfigure command.
+type Config struct {
+	Fd        uint32
+	BlockSize uint32
+	Info      Info64
+	Reserved  [8]uint64
+}
@@ -6,6 +6,7 @@
 package loop
 
 import (
+	"errors"
 	"fmt"
 	"os"
 	"syscall"
@@ -15,19 +16,176 @@ import (
 	"github.com/sylabs/singularity/pkg/util/fs/lock"
 )
 
+// errNoLoopControl is returned when /dev/loop-control can't be used.
+var errNoLoopControl = errors.New("loop control device not available")
+
 // AttachFromFile finds a free loop device, opens it, and stores file descriptor
 // provided by image file pointer
 func (loop *Device) AttachFromFile(image *os.File, mode int, number *int) error {
-	var path string
-	var loopFd int
-
 	if image == nil {
 		return fmt.Errorf("empty file pointer")
 	}
 
+	// the loop device file descriptor is voluntarily kept open
+	// to be sure that the loop device won't be released before
+	// the mount of the filesystem
+	_, err := loop.attach(image, mode, number)
+	return err
+}
+
+// attach attaches image to a loop device and returns the opened
+// loop device file descriptor. Attached loop devices are recorded
+// in the host loop device index, shared attachments look up this
+// index and only scan loop devices when it's not available.
+func (loop *Device) attach(image *os.File, mode int, number *int) (int, error) {
+	if loop.Shared {
+		fd, err := loop.attachShared(image, mode, number)
+		if err != errNoIndex {
+			return fd, err
+		}
+		return loop.attachScan(image, mode, number)
+	}
+
+	fd, err := loop.attachFree(image, mode, number)
+	if err == errNoLoopControl {
+		fd, err = loop.attachScan(image, mode, number)
+	}
+	if err != nil {
+		return -1, err
+	}
+	loop.indexAttached(*number, image)
+
+	return fd, nil
+}
+
+// attachFree attaches image to a free loop device requested to
+// /dev/loop-control (Linux 3.1+), without holding the /dev lock
+// nor scanning loop devices.
+func (loop *Device) attachFree(image *os.File, mode int, number *int) (int, error) {
+	ctlFd, err := syscall.Open("/dev/loop-control", syscall.O_RDWR|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return -1, errNoLoopControl
+	}
+	defer syscall.Close(ctlFd)
+
+	// a concurrent process may attach the same free loop device first,
+	// in which case attach fails with EBUSY and another one is requested
+	for i := 0; i < loop.MaxLoopDevices; i++ {
+		device, _, esys := syscall.Syscall(syscall.SYS_IOCTL, uintptr(ctlFd), CmdCtlGetFree, 0)
+		if esys != 0 {
+			return -1, fmt.Errorf("failed to get a free loop device: %s", esys.Error())
+		}
+		if int(device) >= loop.MaxLoopDevices {
+			break
+		}
+		*number = int(device)
+
+		path, err := createDevice(int(device))
+		if err != nil {
+			return -1, err
+		}
+		loopFd, err := syscall.Open(path, mode|syscall.O_CLOEXEC, 0600)
+		if err != nil {
+			return -1, fmt.Errorf("failed to open loop device %s: %s", path, err)
+		}
+
+		err = loop.configure(loopFd, image)
+		if err == syscall.EBUSY {
+			syscall.Close(loopFd)
+			continue
+		} else if err != nil {
+			syscall.Close(loopFd)
+			return -1, err
+		}
+		return loopFd, nil
+	}
+
+	return -1, fmt.Errorf("no loop devices available")
+}
+
+// configure attaches image to the loop device and sets its status
+// with a single LOOP_CONFIGURE call (Linux 5.8+), or with separate
+// LOOP_SET_FD and LOOP_SET_STATUS64 calls on older kernels. EBUSY is
+// returned if the loop device is already attached.
+func (loop *Device) configure(loopFd int, image *os.File) error {
+	config := &Config{Fd: uint32(image.Fd())}
+	if loop.Info != nil {
+		config.Info = *loop.Info
+	}
+
+	_, _, esys := syscall.Syscall(syscall.SYS_IOCTL, uintptr(loopFd), CmdConfigure, uintptr(unsafe.Pointer(config)))
+	switch esys {
+	case 0:
+		return nil
+	case syscall.EBUSY:
+		return esys
+	case syscall.EINVAL, syscall.ENOTTY:
+		// kernel without LOOP_CONFIGURE support
+	default:
+		return fmt.Errorf("failed to configure loop device: %s", esys.Error())
+	}
+
+	_, _, esys = syscall.Syscall(syscall.SYS_IOCTL, uintptr(loopFd), CmdSetFd, image.Fd())
+	if esys == syscall.EBUSY {
+		return esys
+	} else if esys != 0 {
+		return fmt.Errorf("failed to attach image to loop device: %s", esys.Error())
+	}
+	return loop.setStatus(loopFd)
+}
+
+// createDevice returns the path of the loop device number, the
+// device node is created if it doesn't exist yet.
+func createDevice(device int) (string, error) {
+	path := fmt.Sprintf("/dev/loop%d", device)
+	if fi, err := os.Stat(path); err != nil {
+		dev := int((7 << 8) | (device & 0xff) | ((device & 0xfff00) << 12))
+		esys := syscall.Mknod(path, syscall.S_IFBLK|0660, dev)
+		if errno, ok := esys.(syscall.Errno); ok {
+			if errno != syscall.EEXIST {
+				return "", esys
+			}
+		}
+	} else if fi.Mode()&os.ModeDevice == 0 {
+		return "", fmt.Errorf("%s is not a block device", path)
+	}
+	return path, nil
+}
+
+// setStatus sets loop device status, the image is detached from
+// the loop device on failure.
+func (loop *Device) setStatus(loopFd int) error {
+	maxRetries := 5
+	for i := 0; i < maxRetries; i++ {
+		if _, _, err := syscall.Syscall(syscall.SYS_IOCTL, uintptr(loopFd), CmdSetStatus64, uintptr(unsafe.Pointer(loop.Info))); err != 0 {
+			if err == syscall.EAGAIN && i < maxRetries-1 {
+				// with changes introduces in https://github.com/torvalds/linux/commit/5db470e229e22b7eda6e23b5566e532c96fb5bc3
+				// loop_set_status() can temporarily fail with EAGAIN -> sleep and try again
+				// (cf. https://github.com/karelzak/util-linux/blob/dab1303287b7ebe30b57ccc78591070dad0a85ea/lib/loopdev.c#L1355)
+				time.Sleep(250 * time.Millisecond)
+				continue
+			}
+			// clear associated file descriptor to release the loop device,
+			// best-effort here without error checking because we need the
+			// error from previous ioctl call
+			syscall.Syscall(syscall.SYS_IOCTL, uintptr(loopFd), CmdClrFd, 0)
+			return fmt.Errorf("failed to set loop flags on loop device: %s", syscall.Errno(err))
+		}
+		break
+	}
+	return nil
+}
+
+// attachScan finds a free loop device, or one already attached to image
+// when loop devices are shared, by scanning loop devices while holding
+// an exclusive lock on /dev.
+func (loop *Device) attachScan(image *os.File, mode int, number *int) (int, error) {
+	var path string
+	var loopFd int
+
 	fi, err := image.Stat()
 	if err != nil {
-		return err
+		return -1, err
 	}
 	st := fi.Sys().(*syscall.Stat_t)
 	imageIno := st.Ino
@@ -36,7 +194,7 @@ func (loop *Device) AttachFromFile(image *os.File, mode int, number *int) error
 
 	fd, err := lock.Exclusive("/dev")
 	if err != nil {
-		return err
+		return -1, err
 	}
 	defer lock.Release(fd)
 
@@ -53,20 +211,11 @@ func (loop *Device) AttachFromFile(image *os.File, mode int, number *int) error
 					continue
 				}
 			}
-			return fmt.Errorf("no loop devices available")
+			return -1, fmt.Errorf("no loop devices available")
 		}
 
-		path = fmt.Sprintf("/dev/loop%d", device)
-		if fi, err := os.Stat(path); err != nil {
-			dev := int((7 << 8) | (device & 0xff) | ((device & 0xfff00) << 12))
-			esys := syscall.Mknod(path, syscall.S_IFBLK|0660, dev)
-			if errno, ok := esys.(syscall.Errno); ok {
-				if errno != syscall.EEXIST {
-					return esys
-				}
-			}
-		} else if fi.Mode()&os.ModeDevice == 0 {
-			return fmt.Errorf("%s is not a block device", path)
+		if path, err = createDevice(device); err != nil {
+			return -1, err
 		}
 
 		if loopFd, err = syscall.Open(path, mode, 0600); err != nil {
@@ -76,7 +225,7 @@ func (loop *Device) AttachFromFile(image *os.File, mode int, number *int) error
 			status, err := GetStatusFromFd(uintptr(loopFd))
 			if err != nil {
 				syscall.Close(loopFd)
-				return err
+				return -1, err
 			}
 			// there is no associated image with loop device, save indice so second loop
 			// iteration will start from this device
@@ -91,7 +240,7 @@ func (loop *Device) AttachFromFile(image *os.File, mode int, number *int) error
 				// keep the reference to the loop device file descriptor to
 				// be sure that the loop device won't be released between this
 				// check and the mount of the filesystem
-				return nil
+				return loopFd, nil
 			}
 			syscall.Close(loopFd)
 		} else {
@@ -105,29 +254,15 @@ func (loop *Device) AttachFromFile(image *os.File, mode int, number *int) error
 	}
 
 	if _, _, err := syscall.Syscall(syscall.SYS_FCNTL, uintptr(loopFd), syscall.F_SETFD, syscall.FD_CLOEXEC); err != 0 {
-		return fmt.Errorf("failed to set close-on-exec on loop device %s: %s", path, err.Error())
+		return -1, fmt.Errorf("failed to set close-on-exec on loop device %s: %s", path, err.Error())
 	}
 
-	maxRetries := 5
-	for i := 0; i < maxRetries; i++ {
-		if _, _, err := syscall.Syscall(syscall.SYS_IOCTL, uintptr(loopFd), CmdSetStatus64, uintptr(unsafe.Pointer(loop.Info))); err != 0 {
-			if err == syscall.EAGAIN && i < maxRetries-1 {
-				// with changes introduces in https://github.com/torvalds/linux/commit/5db470e229e22b7eda6e23b5566e532c96fb5bc3
-				// loop_set_status() can temporarily fail with EAGAIN -> sleep and try again
-				// (cf. https://github.com/karelzak/util-linux/blob/dab1303287b7ebe30b57ccc78591070dad0a85ea/lib/loopdev.c#L1355)
-				time.Sleep(250 * time.Millisecond)
-				continue
-			}
-			// clear associated file descriptor to release the loop device,
-			// best-effort here without error checking because we need the
-			// error from previous ioctl call
-			syscall.Syscall(syscall.SYS_IOCTL, uintptr(loopFd), CmdClrFd, 0)
-			return fmt.Errorf("failed to set loop flags on loop device: %s", syscall.Errno(err))
-		}
-		break
+	if err := loop.setStatus(loopFd); err != nil {
+		syscall.Close(loopFd)
+		return -1, err
 	}
 
-	return nil
+	return loopFd, nil
 }
 
 // AttachFromPath finds a free loop device, opens it, and stores file descriptor
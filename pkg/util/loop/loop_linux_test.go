@@ -7,15 +7,33 @@ package loop
 
 import (
 	"fmt"
+	"io/ioutil"
 	"os"
+	"path/filepath"
 	"syscall"
 	"testing"
 
 	"github.com/sylabs/singularity/internal/pkg/test"
 )
 
+// tempIndex sets a temporary loop device index for the test.
+func tempIndex(t *testing.T) func() {
+	dir, err := ioutil.TempDir("", "loop-index-")
+	if err != nil {
+		t.Fatal(err)
+	}
+	path := indexPath
+	indexPath = filepath.Join(dir, "loop.index")
+
+	return func() {
+		indexPath = path
+		os.RemoveAll(dir)
+	}
+}
+
 func TestLoop(t *testing.T) {
 	test.EnsurePrivilege(t)
+	defer tempIndex(t)()
 
 	var i1 *Info64
 
@@ -102,3 +120,124 @@ func TestLoop(t *testing.T) {
 		t.Errorf("unexpected success with MaxLoopDevices = 0")
 	}
 }
+
+func TestSharedIndex(t *testing.T) {
+	test.EnsurePrivilege(t)
+	defer tempIndex(t)()
+
+	loopDev := &Device{
+		MaxLoopDevices: 256,
+		Info: &Info64{
+			Flags: FlagsAutoClear | FlagsReadOnly,
+		},
+	}
+
+	loopOne := -1
+	loopTwo := -1
+
+	if err := loopDev.AttachFromPath("/etc/passwd", os.O_RDONLY, &loopOne); err != nil {
+		t.Fatal(err)
+	}
+
+	group, err := os.Open("/etc/group")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer group.Close()
+
+	// stale entry pointing /etc/group to the /etc/passwd loop device
+	e, err := newIndexEntry(group, loopDev.Info)
+	if err != nil {
+		t.Fatal(err)
+	}
+	idx, err := openIndex()
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer idx.close()
+
+	if err := idx.write(loopOne, e); err != nil {
+		t.Fatal(err)
+	}
+
+	loopDev.Shared = true
+	if err := loopDev.AttachFromFile(group, os.O_RDONLY, &loopTwo); err != nil {
+		t.Fatal(err)
+	}
+	if loopOne == loopTwo {
+		t.Errorf("stale index entry used for /dev/loop%d", loopOne)
+	}
+
+	entries, err := idx.read(loopDev.MaxLoopDevices)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if entries[loopOne] != (indexEntry{}) {
+		t.Errorf("stale index entry of /dev/loop%d not cleared", loopOne)
+	}
+	if entries[loopTwo] != e {
+		t.Errorf("/dev/loop%d not indexed", loopTwo)
+	}
+
+	number := -1
+	if err := loopDev.AttachFromPath("/etc/group", os.O_RDONLY, &number); err != nil {
+		t.Fatal(err)
+	}
+	if number != loopTwo {
+		t.Errorf("not attached to the same loop block device /dev/loop%d", loopTwo)
+	}
+}
+
+// BenchmarkAttach measures concurrent loop device attachments, run it
+// with -cpu 64 to mimic 64 containers started at once on a node.
+func BenchmarkAttach(b *testing.B) {
+	if os.Geteuid() != 0 {
+		b.Skip("root privileges required")
+	}
+
+	f, err := ioutil.TempFile("", "loop-")
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer os.Remove(f.Name())
+	defer f.Close()
+
+	if err := f.Truncate(1024 * 1024); err != nil {
+		b.Fatal(err)
+	}
+
+	attachs := []struct {
+		name   string
+		attach func(*Device, *os.File, int, *int) (int, error)
+	}{
+		{"scan", (*Device).attachScan},
+		{"loop-control", (*Device).attachFree},
+	}
+
+	for _, a := range attachs {
+		attach := a.attach
+
+		b.Run(a.name, func(b *testing.B) {
+			b.RunParallel(func(pb *testing.PB) {
+				loopDev := &Device{
+					MaxLoopDevices: 256,
+					Info: &Info64{
+						Flags: FlagsAutoClear | FlagsReadOnly,
+					},
+				}
+				for pb.Next() {
+					var number int
+
+					fd, err := attach(loopDev, f, os.O_RDONLY, &number)
+					if err != nil {
+						b.Error(err)
+						return
+					}
+					// the loop device is released with the
+					// last file descriptor thanks to autoclear
+					syscall.Close(fd)
+				}
+			})
+		})
+	}
+}